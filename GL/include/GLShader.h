@@ -22,7 +22,6 @@ public:
 private:
 
 	GLuint m_iShaderHandle;
-	GLchar* m_szCode;
 
 	bool m_bIsCompiled;
 
@@ -2,7 +2,7 @@
 
 #include "GL/GLShader.h"
 
-#include "io/FileReader.h"
+#include "io/MappedFile.h"
 
 GLShader* GLShader::vertexShaderFromFile( const char* filename )
 {
@@ -23,9 +23,6 @@ GLShader::~GLShader()
 {
 	glDeleteShader( m_iShaderHandle );
 	m_iShaderHandle = -1;
-
-	delete[] m_szCode;
-	m_szCode = NULL;
 }
 
 bool GLShader::compile()
@@ -60,7 +57,6 @@ bool GLShader::isCompiled()
 
 GLShader::GLShader() :
 	m_iShaderHandle( 0 ),
-	m_szCode( NULL ),
 	m_bIsCompiled( false )
 {
 
@@ -69,16 +65,16 @@ GLShader::GLShader() :
 // static
 GLShader* GLShader::fromFile( const char* filename, GLenum eShaderType )
 {
-	char* buffer;
-	long length;
-
-	if( FileReader::readTextFile( filename, &buffer, &length ) )
+	// glShaderSource() copies the source: pass it straight out of the mapping
+	MappedFile file( filename, MappedFile::SEQUENTIAL );
+	if( file.isOpen() )
 	{
+		const GLchar* code = file.charData();
+		GLint length = static_cast< GLint >( file.size() );
+
 		GLShader* pShader = new GLShader;
-		pShader->m_szCode = buffer;
 		pShader->m_iShaderHandle = glCreateShader( eShaderType );
-		glShaderSource( pShader->m_iShaderHandle, 1,
-			( const GLchar ** )( &( pShader->m_szCode ) ), NULL ); // TODO: figure out the const correctness
+		glShaderSource( pShader->m_iShaderHandle, 1, &code, &length );
 
 		return pShader;
 	}
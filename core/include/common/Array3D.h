@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdio>
+#include <common/BasicTypes.h>
 #include <vecmath/Vector3i.h>
 
 // TODO: switch to using std::vector as underlying representation
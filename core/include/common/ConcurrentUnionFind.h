@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+// A disjoint set forest over the elements [ 0, size() )
+// where find() and unite() can be called concurrently without locks
+//
+// Parents are swapped in with compare and swap,
+// and a root is always linked under a smaller root,
+// so concurrent unions can't make a cycle
+// and each set's root is its smallest element
+// find() halves the path as it goes
+class ConcurrentUnionFind
+{
+public:
+
+	// makes n singleton sets
+	ConcurrentUnionFind( int n = 0 );
+
+	// back to n singleton sets
+	void reset( int n );
+
+	int size() const;
+
+	// the root of i's set
+	int find( int i );
+
+	// merges the sets containing i and j
+	// returns false if they were already the same set
+	bool unite( int i, int j );
+
+	// whether i and j are in the same set
+	// (only stable once the unions are done)
+	bool sameSet( int i, int j );
+
+	// once the unions are done:
+	// labels each element with the index of its set,
+	// numbering the sets in the order of their smallest elements
+	// returns the number of sets
+	int labelSets( std::vector< int >& labels );
+
+private:
+
+	// long for _InterlockedCompareExchange
+	volatile long* parents();
+
+	std::vector< long > m_parents;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <ppl.h>
+
+#include "common/BasicTypes.h"
+
+// Sorts large arrays on all cores
+//
+// The array is split into a power of 2 number of chunks,
+// which are sorted in parallel with std::sort,
+// then runs are merged pairwise, each round of merges in parallel
+// The sort is not stable
+class ParallelSort
+{
+public:
+
+	// arrays with fewer than 2 * MIN_CHUNK_SIZE elements are sorted with std::sort
+	static const int MIN_CHUNK_SIZE;
+
+	// the most chunks sorted in parallel
+	static const int MAX_CHUNKS;
+
+	template< typename T >
+	static void sort( std::vector< T >& values );
+
+	template< typename T, typename Less >
+	static void sort( std::vector< T >& values, Less less );
+};
+
+// static
+template< typename T >
+void ParallelSort::sort( std::vector< T >& values )
+{
+	ParallelSort::sort( values, std::less< T >() );
+}
+
+// static
+template< typename T, typename Less >
+void ParallelSort::sort( std::vector< T >& values, Less less )
+{
+	int n = static_cast< int >( values.size() );
+
+	int nChunks = 1;
+	while( nChunks < MAX_CHUNKS && n / ( 2 * nChunks ) >= MIN_CHUNK_SIZE )
+	{
+		nChunks *= 2;
+	}
+
+	if( nChunks == 1 )
+	{
+		std::sort( values.begin(), values.end(), less );
+		return;
+	}
+
+	// chunk c is [ chunkStarts[ c ], chunkStarts[ c + 1 ] )
+	std::vector< int > chunkStarts( nChunks + 1 );
+	for( int c = 0; c <= nChunks; ++c )
+	{
+		chunkStarts[ c ] = static_cast< int >( static_cast< int64 >( n ) * c / nChunks );
+	}
+
+	Concurrency::parallel_for( 0, nChunks, [&]( int c )
+	{
+		std::sort( values.begin() + chunkStarts[ c ], values.begin() + chunkStarts[ c + 1 ], less );
+	} );
+
+	// merge pairs of runs of width chunks,
+	// alternating between values and scratch
+	std::vector< T > scratch( n );
+	std::vector< T >* source = &values;
+	std::vector< T >* destination = &scratch;
+	for( int width = 1; width < nChunks; width *= 2 )
+	{
+		int nMerges = nChunks / ( 2 * width );
+		Concurrency::parallel_for( 0, nMerges, [&]( int m )
+		{
+			int begin = chunkStarts[ 2 * m * width ];
+			int middle = chunkStarts[ ( 2 * m + 1 ) * width ];
+			int end = chunkStarts[ ( 2 * m + 2 ) * width ];
+			std::merge( source->begin() + begin, source->begin() + middle,
+				source->begin() + middle, source->begin() + end,
+				destination->begin() + begin, less );
+		} );
+		std::swap( source, destination );
+	}
+
+	if( source != &values )
+	{
+		values.swap( scratch );
+	}
+}
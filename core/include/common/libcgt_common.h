@@ -5,5 +5,7 @@
 #include "ArrayUtils.h"
 #include "BasicTypes.h"
 #include "Comparators.h"
+#include "ConcurrentUnionFind.h"
+#include "ParallelSort.h"
 #include "ProgressReporter.h"
 #include "QAtomicQueue.h"
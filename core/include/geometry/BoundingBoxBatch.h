@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "geometry/BoundingBox3f.h"
+
+// A batch of axis aligned boxes in structure of arrays layout:
+// one array per component, so that consecutive boxes
+// load straight into SIMD registers
+//
+// Batches are culled with FrustumUtils::cullBoundingBoxes
+class BoundingBoxBatch
+{
+public:
+
+	// nBoxes boxes that are the single point at the origin
+	BoundingBoxBatch( int nBoxes = 0 );
+
+	BoundingBoxBatch( const std::vector< BoundingBox3f >& boxes );
+
+	int size() const;
+
+	// new boxes are the single point at the origin
+	void resize( int nBoxes );
+
+	BoundingBox3f box( int i ) const;
+
+	void setBox( int i, const BoundingBox3f& box );
+
+	// the components, each size() long
+	std::vector< float > minX;
+	std::vector< float > minY;
+	std::vector< float > minZ;
+
+	std::vector< float > maxX;
+	std::vector< float > maxY;
+	std::vector< float > maxZ;
+};
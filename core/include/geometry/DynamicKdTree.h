@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "geometry/KdTree.h"
+
+// A k-d tree that points can be added to, for nearest neighbor queries
+// Vector is Vector2f or Vector3f
+//
+// Points are kept in a few static KdTrees, largest first,
+// whose sizes count up like the bits of a binary number,
+// plus a buffer of up to BUFFER_SIZE points
+// that is scanned linearly (Bentley and Saxe's logarithmic method)
+// When the buffer fills up, it is merged with the smaller trees into a new tree,
+// so each point is rebuilt O( log n ) times
+// Queries search every tree, with one shared set of candidates
+//
+// Points are numbered in the order they were inserted
+// Queries are const and can run concurrently, but not with insert()
+template< typename Vector >
+class DynamicKdTree
+{
+public:
+
+	typedef typename KdTree< Vector >::Neighbor Neighbor;
+
+	// the most points waiting to be built into a tree
+	static const int BUFFER_SIZE;
+
+	// an empty tree
+	DynamicKdTree();
+
+	void clear();
+
+	int numPoints() const;
+	bool isEmpty() const;
+
+	// point i, in the order it was inserted
+	const Vector& point( int i ) const;
+
+	// adds a point, and returns its index
+	int insert( const Vector& point );
+
+	// adds points, and returns the index of the first one
+	int insert( const std::vector< Vector >& points );
+
+	// the index of the nearest point to query, or -1 if the tree is empty
+	// if distanceSquared is not null, it gets the squared distance to it
+	int nearest( const Vector& query, float* distanceSquared = nullptr ) const;
+
+	// the k nearest points to query, nearest first
+	// (see KdTree::kNearest for epsilon)
+	void kNearest( const Vector& query, int k, std::vector< Neighbor >& neighbors,
+		float epsilon = 0 ) const;
+
+	// all points within radius of query, nearest first
+	void radiusSearch( const Vector& query, float radius,
+		std::vector< Neighbor >& neighbors ) const;
+
+private:
+
+	// builds the buffer and the trees no larger than it into one tree
+	void flushBuffer();
+
+	// all the points, in the order they were inserted
+	std::vector< Vector > m_points;
+
+	// the indices of the points not in a tree yet
+	std::vector< int > m_buffer;
+
+	// in decreasing size
+	std::vector< KdTree< Vector > > m_trees;
+};
+
+typedef DynamicKdTree< Vector2f > DynamicKdTree2f;
+typedef DynamicKdTree< Vector3f > DynamicKdTree3f;
+
+#include "DynamicKdTree.inl"
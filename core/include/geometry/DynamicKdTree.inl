@@ -0,0 +1,168 @@
+#include <algorithm>
+
+// static
+template< typename Vector >
+const int DynamicKdTree< Vector >::BUFFER_SIZE = 64;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+template< typename Vector >
+DynamicKdTree< Vector >::DynamicKdTree()
+{
+
+}
+
+template< typename Vector >
+void DynamicKdTree< Vector >::clear()
+{
+	m_points.clear();
+	m_buffer.clear();
+	m_trees.clear();
+}
+
+template< typename Vector >
+int DynamicKdTree< Vector >::numPoints() const
+{
+	return static_cast< int >( m_points.size() );
+}
+
+template< typename Vector >
+bool DynamicKdTree< Vector >::isEmpty() const
+{
+	return m_points.empty();
+}
+
+template< typename Vector >
+const Vector& DynamicKdTree< Vector >::point( int i ) const
+{
+	return m_points[ i ];
+}
+
+template< typename Vector >
+int DynamicKdTree< Vector >::insert( const Vector& point )
+{
+	int index = numPoints();
+	m_points.push_back( point );
+	m_buffer.push_back( index );
+	if( static_cast< int >( m_buffer.size() ) >= BUFFER_SIZE )
+	{
+		flushBuffer();
+	}
+	return index;
+}
+
+template< typename Vector >
+int DynamicKdTree< Vector >::insert( const std::vector< Vector >& points )
+{
+	int firstIndex = numPoints();
+	int n = static_cast< int >( points.size() );
+	m_points.insert( m_points.end(), points.begin(), points.end() );
+	for( int i = 0; i < n; ++i )
+	{
+		m_buffer.push_back( firstIndex + i );
+	}
+
+	// one flush builds all of them at once
+	if( static_cast< int >( m_buffer.size() ) >= BUFFER_SIZE )
+	{
+		flushBuffer();
+	}
+	return firstIndex;
+}
+
+template< typename Vector >
+int DynamicKdTree< Vector >::nearest( const Vector& query, float* distanceSquared ) const
+{
+	std::vector< Neighbor > neighbors;
+	kNearest( query, 1, neighbors );
+	if( neighbors.empty() )
+	{
+		return -1;
+	}
+
+	if( distanceSquared != nullptr )
+	{
+		*distanceSquared = neighbors[ 0 ].distanceSquared;
+	}
+	return neighbors[ 0 ].index;
+}
+
+template< typename Vector >
+void DynamicKdTree< Vector >::kNearest( const Vector& query, int k, std::vector< Neighbor >& neighbors,
+	float epsilon ) const
+{
+	typename KdTree< Vector >::KNearestQuery state( k, epsilon, neighbors );
+	if( k > 0 )
+	{
+		for( int i = 0; i < static_cast< int >( m_buffer.size() ); ++i )
+		{
+			int index = m_buffer[ i ];
+			state.offer( index, KdTree< Vector >::distanceSquared( m_points[ index ], query ) );
+		}
+
+		for( int t = 0; t < static_cast< int >( m_trees.size() ); ++t )
+		{
+			m_trees[ t ].searchKNearest( 0, m_trees[ t ].numPoints(), query, state );
+		}
+	}
+	state.finish();
+}
+
+template< typename Vector >
+void DynamicKdTree< Vector >::radiusSearch( const Vector& query, float radius,
+	std::vector< Neighbor >& neighbors ) const
+{
+	float radiusSquared = radius * radius;
+	neighbors.clear();
+	for( int i = 0; i < static_cast< int >( m_buffer.size() ); ++i )
+	{
+		int index = m_buffer[ i ];
+		float d2 = KdTree< Vector >::distanceSquared( m_points[ index ], query );
+		if( d2 <= radiusSquared )
+		{
+			neighbors.push_back( Neighbor( index, d2 ) );
+		}
+	}
+
+	for( int t = 0; t < static_cast< int >( m_trees.size() ); ++t )
+	{
+		m_trees[ t ].searchRadius( 0, m_trees[ t ].numPoints(), query, radiusSquared, neighbors );
+	}
+	std::sort( neighbors.begin(), neighbors.end(), KdTree< Vector >::isCloser );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+template< typename Vector >
+void DynamicKdTree< Vector >::flushBuffer()
+{
+	// take the buffer and every tree no larger than what's been gathered so far,
+	// so the trees that are left are each larger than the next
+	std::vector< int > indices;
+	indices.swap( m_buffer );
+	while( !m_trees.empty() && m_trees.back().numPoints() <= static_cast< int >( indices.size() ) )
+	{
+		const std::vector< int >& treeIndices = m_trees.back().m_indices;
+		indices.insert( indices.end(), treeIndices.begin(), treeIndices.end() );
+		m_trees.pop_back();
+	}
+
+	int n = static_cast< int >( indices.size() );
+	std::vector< Vector > points( n );
+	for( int i = 0; i < n; ++i )
+	{
+		points[ i ] = m_points[ indices[ i ] ];
+	}
+
+	// the new tree indexes into points: relabel it to indices
+	m_trees.push_back( KdTree< Vector >( points ) );
+	std::vector< int >& treeIndices = m_trees.back().m_indices;
+	for( int i = 0; i < n; ++i )
+	{
+		treeIndices[ i ] = indices[ treeIndices[ i ] ];
+	}
+}
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <cassert>
+#include "common/BasicTypes.h"
 #include "geometry/BoundingBox3f.h"
 #include "geometry/Plane3f.h"
 
 #include <vector>
 #include "vecmath/Vector3f.h"
 
+class BoundingBoxBatch;
+class Sphere;
+
 class FrustumUtils
 {
 public:
@@ -18,8 +22,12 @@ public:
 		INTERESECTING
 	};
 
+	// batches are split into blocks of this many for the threads
+	static const int CULL_BLOCK_SIZE;
+
 	// *conservatively* tests whether a box intersects a *convex* set of planes defined by a camera frustum
-	// (by testing the 8 corners of the box against all 6 planes)
+	// (by testing, for each of the 6 planes, the corners of the box nearest to and farthest from it:
+	// the same as testing all 8 corners)
 	// 
 	// the test is conservative in the sense that:
 	//  it's guaranteed to return INSIDE if the box is inside
@@ -27,4 +35,47 @@ public:
 	//  it *usually* returns OUTSIDE if it's outside, but in some cases, may return INTERSECTING
 	static IntersectionResult intersectBoundingBox( const BoundingBox3f& box, Plane3f planes[ 6 ] );
 
+	// intersectBoundingBox for each box, 4 at a time with SSE, in parallel
+	// results[ i ] is an IntersectionResult
+	static void intersectBoundingBoxes( const BoundingBoxBatch& boxes, const Plane3f planes[ 6 ],
+		std::vector< uint8 >& results );
+
+	// the indices of the boxes that intersectBoundingBox doesn't find OUTSIDE,
+	// in increasing order, 4 at a time with SSE, in parallel
+	// returns the number of visible boxes
+	static int cullBoundingBoxes( const BoundingBoxBatch& boxes, const Plane3f planes[ 6 ],
+		std::vector< int >& visibleIndices );
+
+	// the indices of the spheres that are not entirely outside of any plane,
+	// in increasing order, 4 at a time with SSE, in parallel
+	// returns the number of visible spheres
+	static int cullSpheres( const std::vector< Sphere >& spheres, const Plane3f planes[ 6 ],
+		std::vector< int >& visibleIndices );
+
+	// culls a bounding volume hierarchy, skipping the subtrees of boxes that are OUTSIDE
+	// and taking all of the leaves of boxes that are INSIDE without testing them
+	// each node's children are only tested against the planes their parent straddles
+	//
+	// the nodes are in depth first order, with node i's subtree being the nodes
+	// [ i, subtreeEnds[ i ] ): leaves have subtreeEnds[ i ] = i + 1
+	// visibleLeaves gets the indices of the leaves that are not culled, in increasing order
+	// returns the number of visible leaves
+	static int cullHierarchy( const BoundingBoxBatch& nodeBoxes, const std::vector< int >& subtreeEnds,
+		const Plane3f planes[ 6 ], std::vector< int >& visibleLeaves );
+
+private:
+
+	// the planes' coefficients, as arrays
+	struct PlaneSet;
+
+	// tests the box against the planes in planeMask (bit p for planes[ p ])
+	// and sets straddledPlanes to those of them it straddles, unless it's OUTSIDE
+	static IntersectionResult intersectBoundingBox( const PlaneSet& planes,
+		const Vector3f& minimum, const Vector3f& maximum,
+		int planeMask, int* straddledPlanes );
+
+	// intersectBoundingBox for boxes [ begin, end ), into results[ 0, end - begin )
+	static void intersectBoundingBoxes( const PlaneSet& planes, const BoundingBoxBatch& boxes,
+		int begin, int end, uint8* results );
+
 };
\ No newline at end of file
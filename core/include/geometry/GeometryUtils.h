@@ -96,6 +96,9 @@ public:
 	// TODO: do these work??
 	static Vector2f closestPointOnTriangle( const Vector2f& p, const Vector2f& v0, const Vector2f& v1, const Vector2f& v2 );
 
+	// the point on the (filled) triangle v0, v1, v2 closest to p
+	static Vector3f closestPointOnTriangle( const Vector3f& p, const Vector3f& v0, const Vector3f& v1, const Vector3f& v2 );
+
     //dir1 and dir2 should be normalized
     static bool rayRayIntersection( const Vector2f& p1, const Vector2f& dir1,
                                     const Vector2f& p2, const Vector2f& dir2, Vector2f &outIntersection);
@@ -119,8 +122,9 @@ public:
 		const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
 		float& t, Vector3f& barycentrics );
 
-	static bool triangleAABBOverlap( Vector3f* pv0, Vector3f* pv1, Vector3f* pv2,
-		BoundingBox3f* pBox );
+	// whether the triangle and the (closed) box overlap
+	static bool triangleAABBOverlap( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
+		const BoundingBox3f& box );
 
 	// given u along edge 0 -> 1 and v along edge 0 -> 2
 	// and the interpolants on the vertices
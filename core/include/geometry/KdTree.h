@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+
+#include "common/BasicTypes.h"
+#include "vecmath/Vector2f.h"
+#include "vecmath/Vector3f.h"
+
+template< typename Vector > class DynamicKdTree;
+
+// A k-d tree over a fixed set of points, for nearest neighbor queries
+// Vector is Vector2f or Vector3f
+//
+// The tree is implicit: the points are reordered so that each node is a range
+// [ begin, end ) with its splitting point in the middle
+// and its children on either side
+// There are no node pointers, and each subtree is contiguous in memory
+// Ranges of at most LEAF_SIZE points are leaves and are scanned linearly
+//
+// Each node splits at the median along the widest dimension of its points,
+// found with std::nth_element, and large subtrees are built in parallel
+//
+// Queries are const and can run concurrently
+template< typename Vector >
+class KdTree
+{
+public:
+
+	struct Neighbor
+	{
+		Neighbor();
+		Neighbor( int index, float distanceSquared );
+
+		// the index of the point in the array the tree was built from
+		int index;
+		float distanceSquared;
+	};
+
+	// the number of coordinates of a Vector
+	static const int DIMENSIONS;
+
+	// the most points in a leaf
+	static const int LEAF_SIZE;
+
+	// subtrees with at least this many points are built in parallel
+	static const int PARALLEL_BUILD_SIZE;
+
+	// batch queries are split into blocks of this many for the threads
+	static const int QUERY_BLOCK_SIZE;
+
+	// an empty tree
+	KdTree();
+
+	KdTree( const std::vector< Vector >& points );
+
+	void build( const std::vector< Vector >& points );
+
+	void clear();
+
+	int numPoints() const;
+	bool isEmpty() const;
+
+	// the index of the nearest point to query, or -1 if the tree is empty
+	// if distanceSquared is not null, it gets the squared distance to it
+	int nearest( const Vector& query, float* distanceSquared = nullptr ) const;
+
+	// the k nearest points to query, nearest first
+	// (all of them if there are fewer than k)
+	//
+	// with epsilon > 0, the search is approximate and skips subtrees
+	// that can't hold a point ( 1 + epsilon ) times closer than the k-th so far:
+	// the i-th neighbor returned is at most ( 1 + epsilon ) times farther
+	// than the true i-th nearest
+	void kNearest( const Vector& query, int k, std::vector< Neighbor >& neighbors,
+		float epsilon = 0 ) const;
+
+	// all points within radius of query, nearest first
+	void radiusSearch( const Vector& query, float radius,
+		std::vector< Neighbor >& neighbors ) const;
+
+	// kNearest for each query, in parallel
+	// the neighbors of queries[ q ] are neighbors[ q * k, ( q + 1 ) * k ), nearest first
+	// padded with index -1 and infinite distance if there are fewer than k points
+	void kNearest( const std::vector< Vector >& queries, int k,
+		std::vector< Neighbor >& neighbors, float epsilon = 0 ) const;
+
+	// radiusSearch for each query, in parallel
+	// the neighbors of queries[ q ] are neighbors[ offsets[ q ], offsets[ q + 1 ] ),
+	// nearest first
+	void radiusSearch( const std::vector< Vector >& queries, float radius,
+		std::vector< int >& offsets, std::vector< Neighbor >& neighbors ) const;
+
+private:
+
+	// DynamicKdTree searches several trees with one query,
+	// and relabels the points of the trees it builds
+	template< typename > friend class DynamicKdTree;
+
+	// a point and its input index, sorted together while building
+	struct Entry;
+
+	// the k nearest points found so far, as a max heap on distance
+	struct KNearestQuery;
+
+	static float distanceSquared( const Vector& p0, const Vector& p1 );
+
+	// orders neighbors by distance, then index
+	static bool isCloser( const Neighbor& n0, const Neighbor& n1 );
+
+	void buildRange( std::vector< Entry >& entries, int begin, int end );
+
+	void searchKNearest( int begin, int end, const Vector& query,
+		KNearestQuery& state ) const;
+
+	// appends the points within the radius, unsorted
+	void searchRadius( int begin, int end, const Vector& query, float radiusSquared,
+		std::vector< Neighbor >& neighbors ) const;
+
+	// the points in tree order, and their indices in the input
+	std::vector< Vector > m_points;
+	std::vector< int > m_indices;
+
+	// the splitting dimension of the node whose splitting point is at i
+	std::vector< uint8 > m_splitDimensions;
+};
+
+typedef KdTree< Vector2f > KdTree2f;
+typedef KdTree< Vector3f > KdTree3f;
+
+#include "KdTree.inl"
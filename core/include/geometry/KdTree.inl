@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <limits>
+
+#include <ppl.h>
+
+template< typename Vector >
+struct KdTree< Vector >::Entry
+{
+	Vector point;
+	int index;
+};
+
+template< typename Vector >
+struct KdTree< Vector >::KNearestQuery
+{
+	// heap is scratch space, and ends up holding the neighbors
+	KNearestQuery( int k, float epsilon, std::vector< Neighbor >& heap ) :
+
+		k( k ),
+		pruneScale( ( 1 + epsilon ) * ( 1 + epsilon ) ),
+		heap( heap )
+
+	{
+		heap.clear();
+	}
+
+	float maxDistanceSquared() const
+	{
+		if( static_cast< int >( heap.size() ) < k )
+		{
+			return std::numeric_limits< float >::infinity();
+		}
+		return heap.front().distanceSquared;
+	}
+
+	// whether a subtree at cellDistanceSquared from the query is worth visiting
+	// (ties are, since they may have smaller indices)
+	bool canImprove( float cellDistanceSquared ) const
+	{
+		return( cellDistanceSquared * pruneScale <= maxDistanceSquared() );
+	}
+
+	void offer( int index, float distanceSquared )
+	{
+		Neighbor neighbor( index, distanceSquared );
+		if( static_cast< int >( heap.size() ) < k )
+		{
+			heap.push_back( neighbor );
+			std::push_heap( heap.begin(), heap.end(), KdTree< Vector >::isCloser );
+		}
+		else if( KdTree< Vector >::isCloser( neighbor, heap.front() ) )
+		{
+			std::pop_heap( heap.begin(), heap.end(), KdTree< Vector >::isCloser );
+			heap.back() = neighbor;
+			std::push_heap( heap.begin(), heap.end(), KdTree< Vector >::isCloser );
+		}
+	}
+
+	// sorts the heap, nearest first
+	void finish()
+	{
+		std::sort_heap( heap.begin(), heap.end(), KdTree< Vector >::isCloser );
+	}
+
+	int k;
+	float pruneScale;
+	std::vector< Neighbor >& heap;
+};
+
+// static
+template< typename Vector >
+const int KdTree< Vector >::DIMENSIONS = sizeof( Vector ) / sizeof( float );
+
+// static
+template< typename Vector >
+const int KdTree< Vector >::LEAF_SIZE = 8;
+
+// static
+template< typename Vector >
+const int KdTree< Vector >::PARALLEL_BUILD_SIZE = 65536;
+
+// static
+template< typename Vector >
+const int KdTree< Vector >::QUERY_BLOCK_SIZE = 256;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+template< typename Vector >
+KdTree< Vector >::Neighbor::Neighbor() :
+
+	index( -1 ),
+	distanceSquared( std::numeric_limits< float >::infinity() )
+
+{
+
+}
+
+template< typename Vector >
+KdTree< Vector >::Neighbor::Neighbor( int index, float distanceSquared ) :
+
+	index( index ),
+	distanceSquared( distanceSquared )
+
+{
+
+}
+
+template< typename Vector >
+KdTree< Vector >::KdTree()
+{
+
+}
+
+template< typename Vector >
+KdTree< Vector >::KdTree( const std::vector< Vector >& points )
+{
+	build( points );
+}
+
+template< typename Vector >
+void KdTree< Vector >::build( const std::vector< Vector >& points )
+{
+	int n = static_cast< int >( points.size() );
+
+	std::vector< Entry > entries( n );
+	Concurrency::parallel_for( 0, n, [&]( int i )
+	{
+		entries[ i ].point = points[ i ];
+		entries[ i ].index = i;
+	} );
+
+	m_splitDimensions.assign( n, 0 );
+	buildRange( entries, 0, n );
+
+	m_points.resize( n );
+	m_indices.resize( n );
+	Concurrency::parallel_for( 0, n, [&]( int i )
+	{
+		m_points[ i ] = entries[ i ].point;
+		m_indices[ i ] = entries[ i ].index;
+	} );
+}
+
+template< typename Vector >
+void KdTree< Vector >::clear()
+{
+	m_points.clear();
+	m_indices.clear();
+	m_splitDimensions.clear();
+}
+
+template< typename Vector >
+int KdTree< Vector >::numPoints() const
+{
+	return static_cast< int >( m_points.size() );
+}
+
+template< typename Vector >
+bool KdTree< Vector >::isEmpty() const
+{
+	return m_points.empty();
+}
+
+template< typename Vector >
+int KdTree< Vector >::nearest( const Vector& query, float* distanceSquared ) const
+{
+	std::vector< Neighbor > neighbors;
+	kNearest( query, 1, neighbors );
+	if( neighbors.empty() )
+	{
+		return -1;
+	}
+
+	if( distanceSquared != nullptr )
+	{
+		*distanceSquared = neighbors[ 0 ].distanceSquared;
+	}
+	return neighbors[ 0 ].index;
+}
+
+template< typename Vector >
+void KdTree< Vector >::kNearest( const Vector& query, int k, std::vector< Neighbor >& neighbors,
+	float epsilon ) const
+{
+	KNearestQuery state( k, epsilon, neighbors );
+	if( k > 0 )
+	{
+		searchKNearest( 0, numPoints(), query, state );
+	}
+	state.finish();
+}
+
+template< typename Vector >
+void KdTree< Vector >::radiusSearch( const Vector& query, float radius,
+	std::vector< Neighbor >& neighbors ) const
+{
+	neighbors.clear();
+	searchRadius( 0, numPoints(), query, radius * radius, neighbors );
+	std::sort( neighbors.begin(), neighbors.end(), isCloser );
+}
+
+template< typename Vector >
+void KdTree< Vector >::kNearest( const std::vector< Vector >& queries, int k,
+	std::vector< Neighbor >& neighbors, float epsilon ) const
+{
+	int nQueries = static_cast< int >( queries.size() );
+	int nBlocks = ( nQueries + QUERY_BLOCK_SIZE - 1 ) / QUERY_BLOCK_SIZE;
+	neighbors.assign( static_cast< size_t >( nQueries ) * std::max( k, 0 ), Neighbor() );
+
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		std::vector< Neighbor > heap;
+		heap.reserve( std::max( k, 0 ) );
+
+		int end = std::min( ( b + 1 ) * QUERY_BLOCK_SIZE, nQueries );
+		for( int q = b * QUERY_BLOCK_SIZE; q < end; ++q )
+		{
+			kNearest( queries[ q ], k, heap, epsilon );
+			std::copy( heap.begin(), heap.end(), neighbors.begin() + static_cast< size_t >( q ) * k );
+		}
+	} );
+}
+
+template< typename Vector >
+void KdTree< Vector >::radiusSearch( const std::vector< Vector >& queries, float radius,
+	std::vector< int >& offsets, std::vector< Neighbor >& neighbors ) const
+{
+	int nQueries = static_cast< int >( queries.size() );
+	int nBlocks = ( nQueries + QUERY_BLOCK_SIZE - 1 ) / QUERY_BLOCK_SIZE;
+
+	// each block gathers its neighbors, and the count for each query
+	std::vector< std::vector< Neighbor > > blockNeighbors( nBlocks );
+	offsets.assign( nQueries + 1, 0 );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		std::vector< Neighbor > queryNeighbors;
+
+		int end = std::min( ( b + 1 ) * QUERY_BLOCK_SIZE, nQueries );
+		for( int q = b * QUERY_BLOCK_SIZE; q < end; ++q )
+		{
+			radiusSearch( queries[ q ], radius, queryNeighbors );
+			offsets[ q + 1 ] = static_cast< int >( queryNeighbors.size() );
+			blockNeighbors[ b ].insert( blockNeighbors[ b ].end(),
+				queryNeighbors.begin(), queryNeighbors.end() );
+		}
+	} );
+
+	std::vector< int > blockOffsets( nBlocks );
+	for( int q = 0; q < nQueries; ++q )
+	{
+		offsets[ q + 1 ] += offsets[ q ];
+	}
+	for( int b = 0; b < nBlocks; ++b )
+	{
+		blockOffsets[ b ] = offsets[ b * QUERY_BLOCK_SIZE ];
+	}
+
+	neighbors.resize( offsets[ nQueries ] );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		std::copy( blockNeighbors[ b ].begin(), blockNeighbors[ b ].end(),
+			neighbors.begin() + blockOffsets[ b ] );
+	} );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+template< typename Vector >
+float KdTree< Vector >::distanceSquared( const Vector& p0, const Vector& p1 )
+{
+	float sum = 0;
+	for( int d = 0; d < DIMENSIONS; ++d )
+	{
+		float delta = p1[ d ] - p0[ d ];
+		sum += delta * delta;
+	}
+	return sum;
+}
+
+// static
+template< typename Vector >
+bool KdTree< Vector >::isCloser( const Neighbor& n0, const Neighbor& n1 )
+{
+	if( n0.distanceSquared != n1.distanceSquared )
+	{
+		return( n0.distanceSquared < n1.distanceSquared );
+	}
+	return( n0.index < n1.index );
+}
+
+template< typename Vector >
+void KdTree< Vector >::buildRange( std::vector< Entry >& entries, int begin, int end )
+{
+	if( end - begin <= LEAF_SIZE )
+	{
+		return;
+	}
+
+	// split along the widest dimension
+	Vector minimum = entries[ begin ].point;
+	Vector maximum = minimum;
+	for( int i = begin + 1; i < end; ++i )
+	{
+		const Vector& p = entries[ i ].point;
+		for( int d = 0; d < DIMENSIONS; ++d )
+		{
+			minimum[ d ] = std::min( minimum[ d ], p[ d ] );
+			maximum[ d ] = std::max( maximum[ d ], p[ d ] );
+		}
+	}
+
+	int dimension = 0;
+	for( int d = 1; d < DIMENSIONS; ++d )
+	{
+		if( maximum[ d ] - minimum[ d ] > maximum[ dimension ] - minimum[ dimension ] )
+		{
+			dimension = d;
+		}
+	}
+
+	int mid = begin + ( end - begin ) / 2;
+	std::nth_element( entries.begin() + begin, entries.begin() + mid, entries.begin() + end,
+		[dimension]( const Entry& e0, const Entry& e1 )
+		{
+			return e0.point[ dimension ] < e1.point[ dimension ];
+		} );
+	m_splitDimensions[ mid ] = static_cast< uint8 >( dimension );
+
+	if( end - begin >= PARALLEL_BUILD_SIZE )
+	{
+		Concurrency::parallel_invoke
+		(
+			[&]() { buildRange( entries, begin, mid ); },
+			[&]() { buildRange( entries, mid + 1, end ); }
+		);
+	}
+	else
+	{
+		buildRange( entries, begin, mid );
+		buildRange( entries, mid + 1, end );
+	}
+}
+
+template< typename Vector >
+void KdTree< Vector >::searchKNearest( int begin, int end, const Vector& query,
+	KNearestQuery& state ) const
+{
+	if( end - begin <= LEAF_SIZE )
+	{
+		for( int i = begin; i < end; ++i )
+		{
+			state.offer( m_indices[ i ], distanceSquared( m_points[ i ], query ) );
+		}
+		return;
+	}
+
+	int mid = begin + ( end - begin ) / 2;
+	const Vector& split = m_points[ mid ];
+	int dimension = m_splitDimensions[ mid ];
+	float offset = query[ dimension ] - split[ dimension ];
+
+	state.offer( m_indices[ mid ], distanceSquared( split, query ) );
+
+	// the near side first, then the far side if it can still hold something closer
+	if( offset < 0 )
+	{
+		searchKNearest( begin, mid, query, state );
+		if( state.canImprove( offset * offset ) )
+		{
+			searchKNearest( mid + 1, end, query, state );
+		}
+	}
+	else
+	{
+		searchKNearest( mid + 1, end, query, state );
+		if( state.canImprove( offset * offset ) )
+		{
+			searchKNearest( begin, mid, query, state );
+		}
+	}
+}
+
+template< typename Vector >
+void KdTree< Vector >::searchRadius( int begin, int end, const Vector& query, float radiusSquared,
+	std::vector< Neighbor >& neighbors ) const
+{
+	if( end - begin <= LEAF_SIZE )
+	{
+		for( int i = begin; i < end; ++i )
+		{
+			float d2 = distanceSquared( m_points[ i ], query );
+			if( d2 <= radiusSquared )
+			{
+				neighbors.push_back( Neighbor( m_indices[ i ], d2 ) );
+			}
+		}
+		return;
+	}
+
+	int mid = begin + ( end - begin ) / 2;
+	const Vector& split = m_points[ mid ];
+	int dimension = m_splitDimensions[ mid ];
+	float offset = query[ dimension ] - split[ dimension ];
+
+	float d2 = distanceSquared( split, query );
+	if( d2 <= radiusSquared )
+	{
+		neighbors.push_back( Neighbor( m_indices[ mid ], d2 ) );
+	}
+
+	if( offset <= 0 || offset * offset <= radiusSquared )
+	{
+		searchRadius( begin, mid, query, radiusSquared, neighbors );
+	}
+	if( offset >= 0 || offset * offset <= radiusSquared )
+	{
+		searchRadius( mid + 1, end, query, radiusSquared, neighbors );
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "common/Array3D.h"
+#include "common/BasicTypes.h"
+#include "geometry/TriangleMesh.h"
+#include "vecmath/Vector2f.h"
+#include "vecmath/Vector3f.h"
+
+// Extracts isosurfaces of volumes as indexed triangle meshes with marching cubes, in parallel
+//
+// Sample ( x, y, z ) is at origin + voxelSize * ( x + 0.5, y + 0.5, z + 0.5 ),
+// as in TriangleMeshDistanceField, and each cube of 8 neighboring samples is a cell
+// Samples less than isoValue are inside, and faces are wound counterclockwise seen from outside,
+// towards increasing values (negate volumes that are larger inside, such as densities)
+//
+// On cell faces with two diagonally opposite inside corners, the inside corners are always separated,
+// so neighboring cells agree and the surface is watertight
+// Vertices are on the edges between samples, each made once and shared by the cells around it,
+// with normals interpolated from the central difference gradients at the samples
+class MarchingCubes
+{
+public:
+
+	// extract() splits the volume into slabs along z of at least this many layers of samples
+	static const int MIN_SLAB_SIZE;
+
+	// and at most this many slabs
+	static const int MAX_SLABS;
+
+	// the width of a brick along each axis, in cells, for extractSparse()
+	static const int BRICK_SIZE;
+
+	// visits every cell
+	// each slab of layers, in parallel, counts the edges it owns that cross isoValue
+	// then, offset by the counts' prefix sum, makes their vertices and its faces in one pass,
+	// with edge caches of vertex indices for two layers
+	// returns false if the volume has fewer than 2 samples along an axis
+	static bool extract( const Array3D< float >& volume, float isoValue,
+		const Vector3f& origin, float voxelSize,
+		TriangleMesh& mesh );
+
+	// the ( min, max ) of each brick's samples, in parallel
+	// brick ( i, j, k ) is the cells [ BRICK_SIZE * i, BRICK_SIZE * ( i + 1 ) ) x ... x ...,
+	// and its samples include those it shares with the bricks after it
+	static void computeBrickRanges( const Array3D< float >& volume, Array3D< Vector2f >& brickRanges );
+
+	// visits only the bricks whose range contains isoValue, in parallel
+	// compute the ranges once, then extract many isovalues interactively
+	// vertices on the faces between bricks are welded by looking up their edges
+	// returns false if the volume has fewer than 2 samples along an axis
+	// or brickRanges doesn't match the volume (in size, or stale since the volume changed)
+	static bool extractSparse( const Array3D< float >& volume, const Array3D< Vector2f >& brickRanges,
+		float isoValue, const Vector3f& origin, float voxelSize,
+		TriangleMesh& mesh );
+
+private:
+
+	// defined in MarchingCubes.cpp
+	struct Brick;
+
+	static bool checkVolume( const Array3D< float >& volume );
+
+	// the number of bricks along each axis
+	static Vector3i numBricks( const Vector3i& resolution );
+
+	// which of the 8 corners of cell ( x, y, z ) are inside: bit x + 2 * y + 4 * z is corner ( x, y, z )
+	// given rows y and y + 1 of layer z and of layer z + 1
+	static int cellIndex( const float* row00, const float* row10, const float* row01, const float* row11,
+		int x, float isoValue );
+
+	// the vertices on the x and y edges from the samples of layer z, in scanline order, x before y,
+	// numbered from index, and returns the index after them
+	// each edge's vertex index is written to xIndices or yIndices at its sample's index in the layer,
+	// and its vertex to positions and normals, unless they are null
+	static int makeLayerVertices( const Array3D< float >& volume, float isoValue,
+		const Vector3f& origin, float voxelSize, int z, int index,
+		int* xIndices, int* yIndices, Vector3f* positions, Vector3f* normals );
+
+	// likewise for the z edges from layer z to layer z + 1
+	static int makeLayerZVertices( const Array3D< float >& volume, float isoValue,
+		const Vector3f& origin, float voxelSize, int z, int index,
+		int* zIndices, Vector3f* positions, Vector3f* normals );
+
+	// the gradient at sample ( x, y, z ), in samples
+	// with central differences, and one sided ones on the boundary
+	static Vector3f gradient( const Array3D< float >& volume, int x, int y, int z );
+
+	// the vertex where the edge from sample ( x, y, z ) along axis crosses isoValue
+	static void makeVertex( const Array3D< float >& volume, float isoValue,
+		const Vector3f& origin, float voxelSize,
+		int x, int y, int z, int axis,
+		Vector3f& position, Vector3f& normal );
+
+	// a unique key for the edge from sample ( x, y, z ) along axis
+	static uint64 edgeKey( const Vector3i& resolution, int x, int y, int z, int axis );
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include "geometry/BoundingBox3f.h"
+#include "vecmath/Vector3f.h"
+
+// An unstructured set of points
+// with optional per-point normals and colors
+//
+// normals and colors are either empty or the same size as positions
+class PointCloud
+{
+public:
+
+	// make an empty point cloud
+	PointCloud();
+
+	int numPoints() const;
+
+	bool hasNormals() const;
+	bool hasColors() const;
+
+	const std::vector< Vector3f >& positions() const;
+	std::vector< Vector3f >& positions();
+
+	const std::vector< Vector3f >& normals() const;
+	std::vector< Vector3f >& normals();
+
+	// rgb in [0,1]
+	const std::vector< Vector3f >& colors() const;
+	std::vector< Vector3f >& colors();
+
+	void clear();
+
+	BoundingBox3f boundingBox() const;
+
+private:
+
+	std::vector< Vector3f > m_positions;
+	std::vector< Vector3f > m_normals;
+	std::vector< Vector3f > m_colors;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "vecmath/Vector2i.h"
+#include "vecmath/Vector3f.h"
+
+class BoundingBox3f;
+class Camera;
+
+// A batch of rays in structure of arrays layout:
+// one array per component, so that consecutive rays
+// load straight into SIMD registers
+//
+// Batches are intersected with TriangleMeshBVH::intersectRays
+// and TriangleMeshBVH::intersectsRays, which trace
+// consecutive rays together: nearby rays should be next to each other,
+// and with boxes by intersectBox
+class RayBatch
+{
+public:
+
+	// nRays rays at the origin with zero direction (which hit nothing)
+	// and t in (0, infinity)
+	RayBatch( int nRays = 0 );
+
+	// one ray per pixel from camera.eye() through the pixel center
+	// ray x + y * screenSize.x goes through pixel (x, y)
+	static RayBatch fromCamera( const Camera& camera, const Vector2i& screenSize );
+
+	int size() const;
+
+	// new rays are at the origin with zero direction
+	void resize( int nRays );
+
+	Vector3f origin( int i ) const;
+	Vector3f direction( int i ) const;
+
+	void setRay( int i, const Vector3f& origin, const Vector3f& direction,
+		float tMin = 0, float tMax = std::numeric_limits< float >::infinity() );
+
+	// slab test of every ray against box, 4 rays at a time with SSE, in parallel
+	// ray i is inside box for t in [ tEnter[ i ], tExit[ i ] ],
+	// clipped to [ tMin[ i ], tMax[ i ] ]: it hits the box if tEnter[ i ] <= tExit[ i ]
+	// tEnter and tExit are resized to size()
+	// returns the number of rays that hit
+	int intersectBox( const BoundingBox3f& box,
+		std::vector< float >& tEnter, std::vector< float >& tExit ) const;
+
+	// the components, each size() long
+	std::vector< float > originX;
+	std::vector< float > originY;
+	std::vector< float > originZ;
+
+	std::vector< float > directionX;
+	std::vector< float > directionY;
+	std::vector< float > directionZ;
+
+	// hits are in the open interval (tMin, tMax)
+	std::vector< float > tMin;
+	std::vector< float > tMax;
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "common/BasicTypes.h"
+#include "geometry/BoundingBox3f.h"
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+// A uniform grid over a set of points, for fixed radius neighbor queries
+// on point sets that change every frame
+//
+// Points are bucketed by their cell, floor( ( p - bounds.minimum() ) / cellSize ),
+// clamped to the cells the bounding box overlaps, and sorted by bucket with a two pass parallel counting sort in O( n ):
+// the points of a bucket are contiguous, in increasing index order
+// If the grid over the points' bounding box has at most DENSE_CELLS_PER_POINT
+// cells per point, each cell is its own bucket, in x, y, z order
+// Otherwise, cells are hashed into a power of 2 number of buckets,
+// at least 2 per point, and queries skip points from other cells that collide
+//
+// With cellSize about the query radius, a query visits 27 cells
+// Queries are const and can run concurrently
+class SpatialHashGrid
+{
+public:
+
+	// the most cells per point for which the grid is stored densely
+	static const int DENSE_CELLS_PER_POINT;
+
+	// cell coordinates are clamped to at most this, so they fit in an int
+	// if there are more cells along an axis, the last one takes the rest
+	static const int MAX_CELL_INDEX;
+
+	// the points are split into blocks of this many for the threads
+	static const int BLOCK_SIZE;
+
+	// the sort by bucket first sorts by at most this many runs of buckets
+	static const int MAX_COARSE_BUCKETS;
+
+	// and splits the points into at most this many chunks to do it
+	static const int MAX_SORT_CHUNKS;
+
+	// an empty grid
+	SpatialHashGrid();
+
+	// buckets the points into cells of width cellSize
+	// returns false if cellSize is not positive
+	bool build( const std::vector< Vector3f >& points, float cellSize );
+
+	void clear();
+
+	int numPoints() const;
+	float cellSize() const;
+
+	// the bounding box of the points
+	const BoundingBox3f& bounds() const;
+
+	// whether each cell is its own bucket
+	bool isDense() const;
+
+	// the indices of the points sorted by bucket:
+	// visiting points in this order, nearby points are visited together
+	const std::vector< int >& sortedIndices() const;
+
+	// the cell containing p, clamped to the cells the bounding box overlaps
+	Vector3i cellOf( const Vector3f& p ) const;
+
+	// the minimum corner of cell
+	Vector3f cellOrigin( const Vector3i& cell ) const;
+
+	// calls visit( index, distanceSquared ) for each point within radius of query,
+	// in no particular order
+	template< typename Visitor >
+	void forEachNeighbor( const Vector3f& query, float radius, Visitor visit ) const;
+
+	// the indices of the points within radius of query, in no particular order
+	void radiusSearch( const Vector3f& query, float radius, std::vector< int >& indices ) const;
+
+	// for each point i, in parallel:
+	// the other points within radius of it are neighbors[ offsets[ i ], offsets[ i + 1 ] ),
+	// in no particular order
+	void radiusNeighbors( float radius,
+		std::vector< int >& offsets, std::vector< int >& neighbors ) const;
+
+private:
+
+	// the bucket of cell ( x, y, z ), which must be in the grid if it's dense
+	int bucket( int x, int y, int z ) const;
+
+	void cellOf( const Vector3f& p, int& x, int& y, int& z ) const;
+
+	Vector3f m_origin;
+	float m_cellSize;
+	float m_inverseCellSize;
+	BoundingBox3f m_bounds;
+
+	bool m_isDense;
+
+	// the cell of m_bounds.maximum(): cells are clamped to [ 0, m_maxCell ]
+	int m_maxCell[ 3 ];
+
+	// the number of cells along each axis, if dense
+	int m_resolution[ 3 ];
+
+	// the number of buckets (a power of 2, if hashed)
+	int m_nBuckets;
+
+	// bucket b is m_sortedIndices[ m_bucketStarts[ b ], m_bucketStarts[ b + 1 ] )
+	std::vector< int > m_bucketStarts;
+	std::vector< int > m_sortedIndices;
+
+	// m_sortedPoints[ i ] = points[ m_sortedIndices[ i ] ]
+	std::vector< Vector3f > m_sortedPoints;
+};
+
+template< typename Visitor >
+void SpatialHashGrid::forEachNeighbor( const Vector3f& query, float radius, Visitor visit ) const
+{
+	if( m_sortedPoints.empty() )
+	{
+		return;
+	}
+
+	// no point is outside the cells the bounding box overlaps,
+	// so cellOf's clamping bounds the cells visited, however far the query
+	float radiusSquared = radius * radius;
+	int lo[ 3 ];
+	int hi[ 3 ];
+	cellOf( query - Vector3f( radius, radius, radius ), lo[ 0 ], lo[ 1 ], lo[ 2 ] );
+	cellOf( query + Vector3f( radius, radius, radius ), hi[ 0 ], hi[ 1 ], hi[ 2 ] );
+
+	// a query spanning more cells than there are points tests every point instead
+	int nPoints = static_cast< int >( m_sortedPoints.size() );
+	double nQueryCells = ( hi[ 0 ] - lo[ 0 ] + 1.0 ) * ( hi[ 1 ] - lo[ 1 ] + 1.0 ) * ( hi[ 2 ] - lo[ 2 ] + 1.0 );
+	if( nQueryCells > nPoints )
+	{
+		for( int i = 0; i < nPoints; ++i )
+		{
+			const Vector3f& p = m_sortedPoints[ i ];
+			float dx = p.x - query.x;
+			float dy = p.y - query.y;
+			float dz = p.z - query.z;
+			float d2 = dx * dx + dy * dy + dz * dz;
+			if( d2 <= radiusSquared )
+			{
+				visit( m_sortedIndices[ i ], d2 );
+			}
+		}
+		return;
+	}
+
+	for( int z = lo[ 2 ]; z <= hi[ 2 ]; ++z )
+	{
+		for( int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+		{
+			for( int x = lo[ 0 ]; x <= hi[ 0 ]; ++x )
+			{
+				int b = bucket( x, y, z );
+				for( int i = m_bucketStarts[ b ]; i < m_bucketStarts[ b + 1 ]; ++i )
+				{
+					const Vector3f& p = m_sortedPoints[ i ];
+					if( !m_isDense )
+					{
+						// skip points from cells that hash to the same bucket
+						int px;
+						int py;
+						int pz;
+						cellOf( p, px, py, pz );
+						if( px != x || py != y || pz != z )
+						{
+							continue;
+						}
+					}
+
+					float dx = p.x - query.x;
+					float dy = p.y - query.y;
+					float dz = p.z - query.z;
+					float d2 = dx * dx + dy * dy + dz * dz;
+					if( d2 <= radiusSquared )
+					{
+						visit( m_sortedIndices[ i ], d2 );
+					}
+				}
+			}
+		}
+	}
+}
+
+inline int SpatialHashGrid::bucket( int x, int y, int z ) const
+{
+	if( m_isDense )
+	{
+		return x + m_resolution[ 0 ] * ( y + m_resolution[ 1 ] * z );
+	}
+
+	// Teschner et al. 2003
+	uint32 h = ( static_cast< uint32 >( x ) * 73856093u ) ^
+		( static_cast< uint32 >( y ) * 19349663u ) ^
+		( static_cast< uint32 >( z ) * 83492791u );
+	return static_cast< int >( h & static_cast< uint32 >( m_nBuckets - 1 ) );
+}
+
+inline void SpatialHashGrid::cellOf( const Vector3f& p, int& x, int& y, int& z ) const
+{
+	// clamped as floats, before the conversion can overflow
+	// (NaNs go to cell 0)
+	float fx = std::floor( ( p.x - m_origin.x ) * m_inverseCellSize );
+	float fy = std::floor( ( p.y - m_origin.y ) * m_inverseCellSize );
+	float fz = std::floor( ( p.z - m_origin.z ) * m_inverseCellSize );
+	x = static_cast< int >( std::min( std::max( 0.f, fx ), static_cast< float >( m_maxCell[ 0 ] ) ) );
+	y = static_cast< int >( std::min( std::max( 0.f, fy ), static_cast< float >( m_maxCell[ 1 ] ) ) );
+	z = static_cast< int >( std::min( std::max( 0.f, fz ), static_cast< float >( m_maxCell[ 2 ] ) ) );
+}
@@ -2,8 +2,6 @@
 
 #include <memory>
 #include <vector>
-#include <map>
-#include <list>
 
 #include <common/Comparators.h>
 
@@ -11,10 +9,14 @@
 #include "io/OBJGroup.h"
 #include "io/OBJFace.h"
 
+#include "geometry/TriangleMeshAdjacency.h"
+
 #include "vecmath/Vector3f.h"
 #include "vecmath/Vector2i.h"
 #include "vecmath/Vector3i.h"
 
+class TriangleMeshBVH;
+
 class TriangleMesh
 {
 public:
@@ -49,6 +51,7 @@ public:
 	std::vector< Vector3i >& faces();	
 
 	// returns -1 if edge i --> j is not on a face
+	// requires buildAdjacency()
 	int vertexOppositeEdge( int i, int j ) const;
 
 	// returns -1 if edge i --> j is not on a face
@@ -61,10 +64,21 @@ public:
 
 	bool obtuse( int faceIndex ) const;
 
+	// returns the closest hit with t > tMin
+	// uses the BVH if buildBVH() was called, otherwise tests every face
 	bool intersectRay( const Vector3f& origin, const Vector3f& direction,
 		float& t, Vector3f& barycentrics, int& faceIndex,
 		float tMin = 0 ) const;
 
+	// builds a TriangleMeshBVH over the faces, used by intersectRay
+	// call again after changing the faces,
+	// or refitBVH() after only moving the positions
+	void buildBVH();
+	void refitBVH();
+
+	// nullptr if buildBVH() hasn't been called
+	const TriangleMeshBVH* bvh() const;
+
 	Vector3f barycentricInterpolatePosition( int faceIndex, const Vector3f& barycentrics ) const;
 
 	// returns a normalized normal
@@ -74,30 +88,50 @@ public:
 	// returns a consolidated mesh
 	// where vertices not referenced by a face are removed
 	// and faces index vertices from [0,nVertices)
-	TriangleMesh consolidate( const std::vector< int >& connectedComponent );
+	TriangleMesh consolidate( const std::vector< int >& connectedComponent ) const;
+
+	// consolidates every connected component into its own mesh, in parallel
+	// requires computeConnectedComponents()
+	std::vector< TriangleMesh > consolidateComponents() const;
 
 	// checks that each edge is shared by at most 2 triangles (1 in each direction)
 	// if an edge (v0,v1) is touched more than once, the second face is discarded
 	//   (TODO: split the edge?)
 	// 
 	// returns the number of pruned faces
-	// if it's 0, then edgeToFace is valid
 	// replaces m_faces with a set of valid faces
-	//int pruneInvalidFaces( QHash< Vector2i, int >& edgeToFace );
-	int pruneInvalidFaces( std::map< Vector2i, int >& edgeToFace );	
-
+	// and if any were pruned, invalidates the adjacency, BVH, components, areas and edge lengths
+	int pruneInvalidFaces();
+
+	// welds vertices within tolerance of each other (see VertexWelder), in parallel
+	// each welded vertex takes the position of its first vertex
+	// and the normalized sum of their normals
+	// faces are remapped, and the ones left with a repeated vertex are removed
+	// invalidates the adjacency, BVH, components, areas and edge lengths
+	// returns false if tolerance is negative
+	bool weldVertices( float tolerance );
+
+	// prunes invalid faces, then builds the half edge adjacency
 	void buildAdjacency();
 	void invalidateAdjancency();
 
+	// valid after buildAdjacency()
+	const TriangleMeshAdjacency& adjacency() const;
+
+	// labels the faces with a parallel union-find:
+	// faces are connected if they share an edge
+	// (requires buildAdjacency()), or with vertexConnectivity, a vertex
+	void computeConnectedComponents( bool vertexConnectivity = false );
 
-	void computeConnectedComponents();
+	int numConnectedComponents() const;
 
 	void computeAreas();
 
 	void computeEdgeLengths();
 
 	// e = (v0,v1) is a boundary edge if it there is no twin edge (v1,v0)
-	bool isBoundaryEdge( const Vector2i& edge );
+	// requires buildAdjacency()
+	bool isBoundaryEdge( const Vector2i& edge ) const;
 
 	std::vector< Vector3f > m_positions;
 	std::vector< Vector3f > m_normals;
@@ -105,38 +139,43 @@ public:
 	// each face indexes into m_positions
 	std::vector< Vector3i > m_faces;	
 
-	// connected components of faces sharing an edge
-	// m_connectedComponents.size() is the number of components
-	// each m_connectedComponents[i] is a vector of face indices
-	// belonging to that component
-	std::vector< std::vector< int > > m_connectedComponents;
+	// connected components of faces sharing an edge (or a vertex)
+	// component c is the faces
+	// m_componentFaces[ m_componentOffsets[ c ], m_componentOffsets[ c + 1 ] ),
+	// in increasing order
+	// components are ordered by their first face
+	std::vector< int > m_componentOffsets;
+	std::vector< int > m_componentFaces;
+
+	// face index --> component index
+	std::vector< int > m_faceToComponent;
 
 	std::vector< float > m_areas;
 
-	std::map< Vector2i, float > m_edgeLengths;
+	// per half edge (see TriangleMeshAdjacency)
+	std::vector< float > m_edgeLengths;
 
-	void saveOBJ( QString filename );
+	// see OBJWriter
+	bool saveOBJ( QString filename, int precision = -1 ) const;
 
-	// TODO: mark if one-ring is closed?
-	// or use an actual linked list
-	std::vector< bool > m_oneRingIsClosed; // whether the one ring is closed (loops around)
-	std::vector< std::list< int > > m_vertexToVertex; // vertex index --> one-ring vertices, in counterclockwise order
-	std::vector< std::list< int > > m_vertexToFace; // vertex index --> one-ring faces, in counterclockwise order
+private:
 
-	// adjacency data structures
-	std::map< Vector2i, int > m_edgeToFace; // edge (v0,v1) --> face index
+	// they rewrite m_faces in place
+	friend class TriangleMeshOptimizer;
+	friend class TriangleMeshSimplifier;
 
-	// TODO: use a Vector3i, use -1 to indicate missing face
-	std::vector< std::vector< int > > m_faceToFace; // face index --> adjacent face indices (shared by edges, not vertices, at most 3, and in counterclockwise order)
+	// marks the adjacency dirty and drops the BVH, components, areas and edge lengths
+	// called whenever m_faces is rewritten
+	void invalidateDerivedData();
 
-	std::map< Vector2i, Vector2i > m_edgeToPrevEdge;
-	std::map< Vector2i, Vector2i > m_edgeToNextEdge;
+	bool m_adjacencyIsDirty; // marks whether the cached adjacency data structures are dirty	
 
-	std::vector< int > m_vertexToOutgoingEdge; // vertex index --> one outgoing edge
+	// one rings, face to face and edge to edge adjacency
+	TriangleMeshAdjacency m_adjacency;
 
-private:
-
-	bool m_adjacencyIsDirty; // marks whether the cached adjacency data structures are dirty	
+	// copies of a mesh share the BVH until one of them refits it:
+	// refitBVH() first gives the mesh its own copy if it is shared
+	std::shared_ptr< TriangleMeshBVH > m_bvh;
 
 	// the input data might have different number of normals vs vertices
 	// if the input has *more* normals,
@@ -146,4 +185,7 @@ private:
 	// they indices should line up with the positions
 	// since the faces indexing them is authoritative
 	void consolidateNormalsWithPositions( const std::vector< Vector3i >& normalIndices );
+
+	// the mesh of faces faceIndices[ 0, nFaces ) and the vertices they use
+	void consolidate( const int* faceIndices, int nFaces, TriangleMesh& output ) const;
 };
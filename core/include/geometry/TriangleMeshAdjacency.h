@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "vecmath/Vector3i.h"
+
+// Half edge adjacency over the faces of a triangle mesh, in flat arrays
+//
+// Half edge h = 3 * f + k goes from faces[ f ][ k ] to faces[ f ][ ( k + 1 ) % 3 ],
+// so its face and its next and previous half edges follow from its index
+//
+// Opposite half edges are found by sorting the edges in parallel:
+// an edge shared by exactly 2 faces, in opposite directions, links them
+// anything else (a boundary or a non-manifold edge) has no opposite
+//
+// Each vertex's outgoing half edges are stored contiguously
+// (in compressed rows), counterclockwise around it
+class TriangleMeshAdjacency
+{
+public:
+
+	// makes empty adjacency
+	TriangleMeshAdjacency();
+
+	// faces index vertices in [ 0, nVertices )
+	TriangleMeshAdjacency( const std::vector< Vector3i >& faces, int nVertices );
+
+	void build( const std::vector< Vector3i >& faces, int nVertices );
+
+	int numVertices() const;
+	int numFaces() const;
+	int numHalfEdges() const;
+
+	static int face( int h );
+	static int next( int h );
+	static int prev( int h );
+
+	int origin( int h ) const;
+	int target( int h ) const;
+
+	// returns -1 if h is on a boundary or a non-manifold edge
+	int opposite( int h ) const;
+	bool isBoundary( int h ) const;
+
+	// the face across half edge h, -1 if there isn't one
+	int oppositeFace( int h ) const;
+
+	// the half edge from vertex i to vertex j, -1 if no face has it
+	int findHalfEdge( int i, int j ) const;
+
+	// the outgoing half edges of vertex v, counterclockwise around it
+	// an open one ring starts at the boundary (the half edge with no opposite)
+	// and the one ring of a non-manifold vertex lists its fans one after another
+	//
+	// the one ring's vertices are the half edges' targets
+	// (an open one ring has one more: origin( prev( last ) ))
+	// and its faces are the half edges' faces
+	int oneRingSize( int v ) const;
+	const int* oneRingBegin( int v ) const;
+	const int* oneRingEnd( int v ) const;
+
+	// whether v's one ring loops all the way around it
+	bool isOneRingClosed( int v ) const;
+
+private:
+
+	// orders v's outgoing half edges counterclockwise
+	void sortOneRing( int v );
+
+	// per half edge
+	std::vector< int > m_origins;
+	std::vector< int > m_opposites;
+
+	// vertex v's outgoing half edges are
+	// m_oneRings[ m_oneRingOffsets[ v ], m_oneRingOffsets[ v + 1 ] )
+	std::vector< int > m_oneRingOffsets;
+	std::vector< int > m_oneRings;
+};
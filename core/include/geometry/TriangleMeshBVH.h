@@ -0,0 +1,157 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "common/BasicTypes.h"
+#include "geometry/BoundingBox3f.h"
+#include "vecmath/Vector3f.h"
+
+class RayBatch;
+class TriangleMesh;
+
+// A bounding volume hierarchy over the faces of a TriangleMesh
+//
+// Built top-down with a binned surface area heuristic,
+// with large subtrees built in parallel
+//
+// Nodes are 32 bytes and stored depth first:
+// an interior node's first child immediately follows it
+// Face vertices are copied into the BVH in leaf order,
+// so a leaf's triangles are contiguous in memory
+//
+// Rays are intersected with GeometryUtils::rayTriangleIntersection,
+// so the results match a loop over all the faces
+//
+// Batches of rays are traced in packets of PACKET_SIZE consecutive rays
+// with SSE: each node's box and each leaf triangle is tested
+// against the whole packet at once, and the packets run in parallel
+class TriangleMeshBVH
+{
+public:
+
+	struct Node
+	{
+		Vector3f boundsMin;
+
+		// interior: the index of the second child
+		// leaf: the index of the first face (into the leaf-ordered faces)
+		int32 offset;
+
+		Vector3f boundsMax;
+
+		// 0 for interior nodes
+		int16 nFaces;
+
+		// interior: the split axis, children are ordered along it
+		int16 axis;
+
+		bool isLeaf() const;
+	};
+
+	struct Hit
+	{
+		Hit();
+
+		float t;
+		Vector3f barycentrics;
+		int faceIndex; // into the mesh's faces
+	};
+
+	// the number of SAH bins per axis
+	static const int NUM_BINS;
+
+	// subtrees with more faces than this are built in parallel
+	static const int PARALLEL_BUILD_THRESHOLD;
+
+	// the largest leaf the SAH may choose
+	static const int MAX_LEAF_SIZE;
+
+	// the number of rays traced together by intersectRays and intersectsRays
+	static const int PACKET_SIZE;
+
+	// makes an empty BVH: no ray hits it
+	TriangleMeshBVH();
+
+	// builds over the faces of mesh
+	// nodes with at most minLeafSize faces are always leaves
+	TriangleMeshBVH( const TriangleMesh& mesh, int minLeafSize = 2 );
+
+	void build( const TriangleMesh& mesh, int minLeafSize = 2 );
+
+	// updates the vertices and bounds after mesh's positions changed
+	// the faces must be the same as when it was built
+	// (the tree quality degrades if the mesh deforms a lot: rebuild then)
+	void refit( const TriangleMesh& mesh );
+
+	bool isEmpty() const;
+	int numFaces() const;
+	int numNodes() const;
+	const std::vector< Node >& nodes() const;
+
+	// the bounds of all the faces
+	BoundingBox3f boundingBox() const;
+
+	// the closest hit with t in (tMin, tMax)
+	bool intersectRay( const Vector3f& origin, const Vector3f& direction,
+		Hit& hit,
+		float tMin = 0, float tMax = std::numeric_limits< float >::infinity() ) const;
+
+	// whether there is any hit with t in (tMin, tMax)
+	// stops at the first one found (e.g., for shadow rays)
+	bool intersectsRay( const Vector3f& origin, const Vector3f& direction,
+		float tMin = 0, float tMax = std::numeric_limits< float >::infinity() ) const;
+
+	// the (up to) k closest hits with t in (tMin, tMax), sorted by t
+	// returns the number of hits
+	int intersectRay( const Vector3f& origin, const Vector3f& direction,
+		int k, std::vector< Hit >& hits,
+		float tMin = 0, float tMax = std::numeric_limits< float >::infinity() ) const;
+
+	// the closest hit for each ray i with t in (rays.tMin[ i ], rays.tMax[ i ])
+	// hits is resized to rays.size(), rays that miss get a default Hit
+	// returns the number of rays that hit
+	int intersectRays( const RayBatch& rays, std::vector< Hit >& hits ) const;
+
+	// whether each ray i hits anything with t in (rays.tMin[ i ], rays.tMax[ i ])
+	// occluded is resized to rays.size() and set to 1 or 0
+	// returns the number of rays that hit
+	int intersectsRays( const RayBatch& rays, std::vector< uint8 >& occluded ) const;
+
+private:
+
+	// defined in TriangleMeshBVH.cpp
+	struct BuildContext;
+	struct RayPacket;
+
+	// builds the subtree over m_faceIndices[ begin, end )
+	// appending its nodes to nodes in depth first order
+	// below a maximum depth, nodes are split at the median instead of by SAH
+	void buildSubtree( BuildContext& context, int begin, int end, int depth,
+		std::vector< Node >& nodes );
+
+	// copies the face vertices in leaf order
+	void gatherVertices( const TriangleMesh& mesh );
+
+	// calls visitLeafFace( i, tMax ) for the faces in the leaves the ray reaches
+	// visitLeafFace returns false to stop the traversal
+	// tMax is the ray's current extent, which visitLeafFace may shrink
+	template< typename VisitLeafFace >
+	void traverse( const Vector3f& origin, const Vector3f& direction,
+		float tMin, float& tMax, VisitLeafFace visitLeafFace ) const;
+
+	// calls visitLeafFace( i ) for the faces in the leaves
+	// that any active ray in packet reaches
+	// visitLeafFace may shrink the rays' tMax or deactivate them
+	// and returns false to stop the traversal
+	template< typename VisitLeafFace >
+	void traversePacket( RayPacket& packet, VisitLeafFace visitLeafFace ) const;
+
+	std::vector< Node > m_nodes;
+
+	// the mesh's face index for each leaf-ordered face
+	std::vector< int > m_faceIndices;
+
+	// 3 vertices per leaf-ordered face
+	std::vector< Vector3f > m_vertices;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "common/Array3D.h"
+#include "geometry/TriangleMeshVoxelizer.h"
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+// Signed distance fields of triangle meshes, sampled at voxel centers
+//
+// Sample ( x, y, z ) is at origin + voxelSize * ( x + 0.5, y + 0.5, z + 0.5 ),
+// the center of voxel ( x, y, z ) of TriangleMeshVoxelizer
+// Distances are negative inside, where the sign is that of
+// TriangleMeshVoxelizer::voxelizeSolid: the winding number (or parity)
+// of the ray from the sample along -z
+// The mesh should be closed: a crack flips the sign of every sample
+// whose ray passes through it, a whole column along z
+//
+// Samples within EXACT_BAND voxels of a face's bounding box get exact
+// distances, with faces binned to BRICK_SIZE^3 bricks of samples processed in parallel
+// The closest points on the faces are then propagated to the other samples
+// by sweeping along each axis in both directions, NUM_SWEEPS times:
+// a slice at a time, each sample takes the closest point of its 9 neighbors
+// in the previous slice if it's closer, in parallel over the slice's rows
+// The whole grid costs O( samples ), with 12 bytes per sample while sweeping
+// Finally, each sample's distance is the exact distance to the face of its point,
+// which is almost always the closest face, and within a small fraction of a voxel otherwise
+class TriangleMeshDistanceField
+{
+public:
+
+	// the distance from faces, in voxels, within which distances are exact
+	static const float EXACT_BAND;
+
+	// the width of a brick along each axis, in voxels
+	static const int BRICK_SIZE;
+
+	// the number of times to sweep along all 6 directions
+	static const int NUM_SWEEPS;
+
+	// the signed distances from the mesh at each sample, in world units
+	//
+	// if narrowBand > 0, only samples within narrowBand (in world units)
+	// of a face's bounding box are computed, exactly,
+	// and the rest are clamped to +/- narrowBand
+	//
+	// if closestFaces is not null, it gets the index of the closest face to each sample,
+	// or -1 outside a narrow band (or if there are no faces)
+	//
+	// returns false if voxelSize is not positive or resolution is empty
+	static bool compute( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+		const Vector3f& origin, float voxelSize, const Vector3i& resolution,
+		Array3D< float >& distances,
+		float narrowBand = 0,
+		TriangleMeshVoxelizer::FillRule fillRule = TriangleMeshVoxelizer::NONZERO,
+		Array3D< int >* closestFaces = nullptr );
+
+private:
+
+	// the closest point on face f to p
+	static Vector3f closestPoint( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+		int f, const Vector3f& p );
+
+	// computes exact squared distances, closest faces and closest points
+	// within band voxels of each face's bounding box,
+	// leaving the other samples at infinity and -1
+	static void computeBand( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+		const Vector3f& origin, float voxelSize, const Vector3i& resolution, float band,
+		Array3D< float >& distancesSquared, Array3D< int >& closestFaces, std::vector< Vector3f >& closestPoints );
+
+	// sweeps the closest points along axis, forward then backward
+	static void sweep( const Vector3f& origin, float voxelSize, int axis,
+		Array3D< float >& distancesSquared, Array3D< int >& closestFaces, std::vector< Vector3f >& closestPoints );
+};
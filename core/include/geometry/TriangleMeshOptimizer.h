@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+
+#include "common/BasicTypes.h"
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+class TriangleMesh;
+
+// Reorders a mesh's faces and vertices for rendering and for passes that walk them
+//
+// Faces are ordered for a post-transform vertex cache with Tipsify
+// (Sander, Nehab and Barczak 2007): fanning around vertices
+// and jumping to the vertex most likely to still be in the cache, in linear time
+// To reduce overdraw, the face order is then cut into clusters,
+// which are sorted so that faces that tend to occlude others come first
+//
+// Vertices are reordered by first use in the faces,
+// so that consecutive faces read nearby vertices
+class TriangleMeshOptimizer
+{
+public:
+
+	struct CacheStatistics
+	{
+		CacheStatistics();
+
+		// cache misses per face: 0.5 is ideal for large regular meshes, 3 is the worst
+		float acmr;
+
+		// cache misses per referenced vertex: 1 is ideal
+		float atvr;
+
+		int nMisses;
+	};
+
+	// the number of entries in the simulated FIFO cache
+	static const int DEFAULT_CACHE_SIZE;
+
+	// overdraw clusters are cut where the cache misses per face so far
+	// are within this factor of the whole cluster's
+	static const float OVERDRAW_THRESHOLD;
+
+	// the fewest faces in an overdraw cluster
+	static const int MIN_CLUSTER_SIZE;
+
+	// orders the faces for the cache, then the vertices by first use
+	// with reduceOverdraw, also sorts face clusters by how much they occlude
+	// invalidates the mesh's adjacency, BVH, components, areas and edge lengths
+	static void optimize( TriangleMesh& mesh,
+		int cacheSize = DEFAULT_CACHE_SIZE, bool reduceOverdraw = true );
+
+	// reorders faces (indexing [ 0, nVertices ) ) for a cache with cacheSize entries
+	static void optimizeVertexCache( std::vector< Vector3i >& faces, int nVertices,
+		int cacheSize = DEFAULT_CACHE_SIZE );
+
+	// like optimizeVertexCache, then sorts the clusters of the face order
+	// by how much they occlude the rest of the mesh
+	static void optimizeVertexCacheAndOverdraw( std::vector< Vector3i >& faces,
+		const std::vector< Vector3f >& positions,
+		int cacheSize = DEFAULT_CACHE_SIZE );
+
+	// renumbers mesh's vertices in the order the faces first use them
+	// and moves the positions and normals to match
+	// unused vertices are removed
+	// invalidates the mesh's adjacency, BVH, components, areas and edge lengths
+	static void optimizeVertexOrder( TriangleMesh& mesh );
+
+	// simulates a FIFO cache with cacheSize entries
+	static CacheStatistics cacheStatistics( const std::vector< Vector3i >& faces, int nVertices,
+		int cacheSize = DEFAULT_CACHE_SIZE );
+
+private:
+
+	// the new face order
+	// clusterStarts gets the positions in order where Tipsify hit a dead end
+	// and restarted with a cold cache (starting with 0)
+	static void tipsify( const std::vector< Vector3i >& faces, int nVertices, int cacheSize,
+		std::vector< int >& order, std::vector< int >& clusterStarts );
+
+	// cuts each cluster where its cache misses per face so far are low enough
+	static void splitClusters( const std::vector< Vector3i >& faces, int nVertices, int cacheSize,
+		const std::vector< int >& order, std::vector< int >& clusterStarts );
+
+	static void permuteFaces( std::vector< Vector3i >& faces, const std::vector< int >& order );
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "common/BasicTypes.h"
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+class TriangleMesh;
+
+// Simplifies a TriangleMesh by edge collapses (Garland and Heckbert 1997)
+//
+// Each vertex accumulates a quadric: the sum of squared distances
+// to the planes of the faces around it in the input
+// The edge whose collapse adds the least error is collapsed first,
+// to the point that minimizes the sum of its endpoints' quadrics
+// Edges wait in a binary heap: an edge is pushed again when an endpoint changes,
+// and stale entries are skipped when they are popped
+//
+// Boundary edges add planes perpendicular to their face, weighted by BOUNDARY_WEIGHT
+// so that boundaries stay in place
+// Collapses are rejected if they would make the mesh non-manifold,
+// or turn a face's normal by more than acos( MIN_NORMAL_COSINE )
+// If the mesh has per-vertex normals, a collapsed edge's normals are averaged
+class TriangleMeshSimplifier
+{
+public:
+
+	// the weight of the planes along boundary edges
+	static const float BOUNDARY_WEIGHT;
+
+	// the smallest cosine between a face's normal before and after a collapse
+	static const float MIN_NORMAL_COSINE;
+
+	// collapses edges until mesh has at most targetFaces faces,
+	// or the next collapse would have an error above maxError
+	// (the error is a sum of squared distances, in squared mesh units)
+	// unused vertices are removed
+	// invalidates the mesh's adjacency, BVH, components, areas and edge lengths
+	// returns the number of faces left
+	static int simplify( TriangleMesh& mesh, int targetFaces,
+		float maxError = std::numeric_limits< float >::infinity() );
+
+	// splits the faces into gridResolution^3 clusters by their centroids
+	// and simplifies the clusters in parallel,
+	// keeping the vertices they share fixed so they stitch back together,
+	// then simplifies the stitched mesh to targetFaces
+	// each cluster is reduced in proportion to its number of faces
+	static int simplifyPartitioned( TriangleMesh& mesh, int targetFaces,
+		float maxError = std::numeric_limits< float >::infinity(),
+		int gridResolution = 4 );
+
+private:
+
+	// defined in TriangleMeshSimplifier.cpp
+	struct Simplification;
+
+	// simplifies the faces, positions and normals in place
+	// vertices with isFixed[ v ] != 0 are never moved or removed
+	// (isFixed may be empty)
+	// vertexSources is set to the input index of each output vertex
+	static void simplify( std::vector< Vector3f >& positions, std::vector< Vector3f >& normals,
+		std::vector< Vector3i >& faces, const std::vector< uint8 >& isFixed,
+		int targetFaces, float maxError,
+		std::vector< int >& vertexSources );
+};
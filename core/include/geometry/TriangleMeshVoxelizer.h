@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vector>
+
+#include "common/Array3D.h"
+#include "common/BasicTypes.h"
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+// Voxelizes triangle meshes into occupancy grids, in parallel
+//
+// Voxel ( x, y, z ) is the box origin + voxelSize * ( [ x, x + 1 ] x [ y, y + 1 ] x [ z, z + 1 ] )
+// Grids are either an Array3D< ubyte > of resolution, 1 where occupied and 0 elsewhere,
+// or bit packed into an Array3D< uint32 > of ( resolution.x + 31 ) / 32 x resolution.y x resolution.z words,
+// where voxel ( x, y, z ) is bit x % 32 of word ( x / 32, y, z ):
+// 1024^3 voxels take 128 MB packed
+//
+// Faces are binned to bricks of BRICK_SIZE^3 voxels (a word wide),
+// and the bricks are voxelized in parallel, each by one thread
+class TriangleMeshVoxelizer
+{
+public:
+
+	// which voxels are inside a solid
+	enum FillRule
+	{
+		// an odd number of faces along the ray from the voxel's center to +z
+		PARITY,
+
+		// a nonzero winding number, counting faces facing -z as +1 and +z as -1
+		// along the ray from the voxel's center to -z
+		NONZERO
+	};
+
+	// the width of a brick along each axis, in voxels: the bits in a word
+	static const int BRICK_SIZE;
+
+	// faces are binned in at most this many chunks, one per thread
+	static const int MAX_BIN_CHUNKS;
+
+	// and at least this many faces per chunk
+	static const int MIN_BIN_CHUNK_SIZE;
+
+	// the largest vertex coordinate, in voxels from the origin, for voxelizeSolid
+	static const float GUARD_BAND;
+
+	// the voxels whose boxes overlap a face
+	// uses the separating axis test of GeometryUtils::triangleAABBOverlap,
+	// on 4 voxels of a row at a time with SSE
+	// returns false if voxelSize is not positive or resolution is empty
+	static bool voxelizeSurface( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+		const Vector3f& origin, float voxelSize, const Vector3i& resolution,
+		Array3D< uint32 >& bits );
+
+	static bool voxelizeSurface( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+		const Vector3f& origin, float voxelSize, const Vector3i& resolution,
+		Array3D< ubyte >& voxels );
+
+	// the voxels whose centers are inside the mesh, which should be closed,
+	// by casting a ray from each column of voxel centers along +z
+	// vertices are snapped to 1/256 of a voxel in x and y,
+	// and rays through shared edges and vertices cross exactly one of the faces
+	// faces with a vertex outside GUARD_BAND are skipped
+	// returns false if voxelSize is not positive or resolution is empty
+	static bool voxelizeSolid( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+		const Vector3f& origin, float voxelSize, const Vector3i& resolution, FillRule fillRule,
+		Array3D< uint32 >& bits );
+
+	static bool voxelizeSolid( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+		const Vector3f& origin, float voxelSize, const Vector3i& resolution, FillRule fillRule,
+		Array3D< ubyte >& voxels );
+
+	// whether voxel ( x, y, z ) of a packed grid is occupied
+	static bool isOccupied( const Array3D< uint32 >& bits, int x, int y, int z );
+
+	// unpacks a packed grid of resolution into 0s and 1s
+	static void unpack( const Array3D< uint32 >& bits, const Vector3i& resolution,
+		Array3D< ubyte >& voxels );
+
+private:
+
+	// defined in TriangleMeshVoxelizer.cpp
+	struct SurfaceFace;
+	struct Crossing;
+
+	static bool checkGrid( float voxelSize, const Vector3i& resolution );
+
+	// counting sorts the faces into a grid of nBins bins, keeping their order
+	// faceBins[ 6 * f, 6 * f + 6 ) is the inclusive range of bins of face f: lo x, y, z, hi x, y, z
+	// bin b gets faces binFaces[ binStarts[ b ], binStarts[ b + 1 ] )
+	static void binFaces( const std::vector< int >& faceBins, const Vector3i& nBins,
+		std::vector< int >& binStarts, std::vector< int >& binFaces );
+
+	// sets up the separating axis tests of face, in voxels
+	// and its range of voxels, clipped to resolution
+	// returns false if it's outside the grid
+	static bool setUpSurfaceFace( const std::vector< Vector3f >& positions, const Vector3i& face,
+		const Vector3f& origin, float inverseVoxelSize, const Vector3i& resolution,
+		SurfaceFace& surfaceFace );
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include "common/Array2D.h"
+#include "vecmath/Vector2f.h"
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+class Image1f;
+class Image1i;
+
+// A multithreaded software rasterizer with a depth buffer
+//
+// Vertices are in screen space: ( x, y ) in pixels, with pixel ( i, j )
+// centered at ( i + 0.5, j + 0.5 ), and z the depth, where smaller is nearer
+// z and the barycentrics are interpolated linearly in screen space
+// Both windings are drawn
+//
+// Triangles are first binned to TILE_SIZE^2 pixel tiles,
+// keeping their order, then the tiles are rasterized in parallel
+// In a tile, each triangle's 3 edge functions are stepped 2x2 pixels at a time with SSE2
+//
+// Vertices are snapped to 1 / 2^SUBPIXEL_BITS of a pixel and the edge functions
+// are evaluated in double precision, where they are exact:
+// with the top-left rule, triangles sharing an edge never both cover a pixel
+// or leave a gap between them
+// Triangles with a vertex outside [ -GUARD_BAND, GUARD_BAND ]^2 are skipped
+//
+// With STANDARD coverage, a pixel is covered if its center is in the triangle
+// With CONSERVATIVE coverage, a pixel is covered if the triangle overlaps its square
+// (depth is clamped to the triangle's range, but barycentrics may be outside [0,1])
+class TriangleRasterizer
+{
+public:
+
+	enum Coverage
+	{
+		STANDARD,
+		CONSERVATIVE
+	};
+
+	// the width and height of a tile, in pixels (even)
+	static const int TILE_SIZE;
+
+	// the precision of vertex positions: 1 / 2^SUBPIXEL_BITS of a pixel
+	static const int SUBPIXEL_BITS;
+
+	// the largest vertex coordinate, in pixels
+	static const float GUARD_BAND;
+
+	// triangles are binned in at most this many chunks, one per thread
+	static const int MAX_BIN_CHUNKS;
+
+	// and at least this many triangles per chunk
+	static const int MIN_BIN_CHUNK_SIZE;
+
+	// draws the faces into depth, which should be cleared (to infinity, say) beforehand
+	// a pixel is written if the triangle's depth there is less than depth's
+	//
+	// if faceIds is not null, it gets the index of the face drawn at each pixel
+	// if barycentrics is not null, it gets the barycentrics of vertices 1 and 2
+	// of the face drawn at each pixel (vertex 0's is 1 minus their sum)
+	// returns false if the targets are not the same size
+	static bool rasterize( const std::vector< Vector3f >& vertices, const std::vector< Vector3i >& faces,
+		Array2D< float >& depth, Array2D< int >* faceIds = nullptr,
+		Array2D< Vector2f >* barycentrics = nullptr,
+		Coverage coverage = STANDARD );
+
+	// the same, into images
+	static bool rasterize( const std::vector< Vector3f >& vertices, const std::vector< Vector3i >& faces,
+		Image1f& depth, Image1i* faceIds = nullptr,
+		Coverage coverage = STANDARD );
+
+private:
+
+	// defined in TriangleRasterizer.cpp
+	struct Triangle;
+
+	// faceIds and barycentrics may be null
+	static void rasterize( const std::vector< Vector3f >& vertices, const std::vector< Vector3i >& faces,
+		Coverage coverage, int width, int height,
+		float* depth, int* faceIds, Vector2f* barycentrics );
+
+	// sets up the edge functions of face and its pixel bounds in a width x height target
+	// returns false if it's degenerate, outside the guard band or covers no pixels
+	static bool setUpTriangle( const std::vector< Vector3f >& vertices, const Vector3i& face,
+		Coverage coverage, int width, int height, Triangle& triangle );
+
+	// draws triangle, clipped to the pixels [ x0, x1 ] x [ y0, y1 ]
+	static void rasterizeTriangle( const Triangle& triangle, int faceId,
+		int x0, int y0, int x1, int y1, int width,
+		float* depth, int* faceIds, Vector2f* barycentrics );
+};
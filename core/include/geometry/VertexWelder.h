@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+// Welds coincident vertices, such as the duplicates in meshes from OBJ files
+// or in triangle soups from tessellators (where face i is 3 * i, 3 * i + 1, 3 * i + 2)
+//
+// Vertices are welded if they're linked by a chain of vertices within tolerance of each other:
+// each vertex looks up its neighbors in a SpatialHashGrid, in parallel,
+// and unites its set with theirs in a ConcurrentUnionFind
+// The result doesn't depend on the threads:
+// the sets are numbered in the order of their first vertex
+class VertexWelder
+{
+public:
+
+	// the grid's cells are at least 2 * tolerance wide,
+	// and at least the points' bounding box / MAX_GRID_RESOLUTION,
+	// so that cell coordinates fit in an int
+	static const int MAX_GRID_RESOLUTION;
+
+	// vertex i becomes welded vertex vertexMap[ i ], in [ 0, nWeldedVertices )
+	// a tolerance of 0 welds exact duplicates only
+	// returns false if tolerance is negative
+	static bool weld( const std::vector< Vector3f >& positions, float tolerance,
+		std::vector< int >& vertexMap, int& nWeldedVertices );
+
+	// the position of each welded vertex: that of its first vertex
+	static void weldPositions( const std::vector< Vector3f >& positions,
+		const std::vector< int >& vertexMap, int nWeldedVertices,
+		std::vector< Vector3f >& weldedPositions );
+
+	// the normalized sum of the normals of each welded vertex's vertices
+	static void weldNormals( const std::vector< Vector3f >& normals,
+		const std::vector< int >& vertexMap, int nWeldedVertices,
+		std::vector< Vector3f >& weldedNormals );
+
+	// maps the vertices of faces through vertexMap,
+	// and removes the faces left with a repeated vertex, keeping the order of the rest
+	// returns the number of faces removed
+	static int remapFaces( const std::vector< int >& vertexMap, std::vector< Vector3i >& faces );
+};
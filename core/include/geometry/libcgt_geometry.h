@@ -3,12 +3,28 @@
 
 #include "BoundingBox2f.h"
 #include "BoundingBox3f.h"
+#include "BoundingBoxBatch.h"
+#include "DynamicKdTree.h"
 #include "GeometryUtils.h"
 #include "IndexedFace.h"
+#include "KdTree.h"
 #include "LineIntersection.h"
+#include "MarchingCubes.h"
 #include "OpenNaturalCubicSpline.h"
+#include "PointCloud.h"
+#include "RayBatch.h"
 #include "Primitive2f.h"
+#include "SpatialHashGrid.h"
 #include "Spline2f.h"
 #include "TriangleList3f.h"
+#include "TriangleMesh.h"
+#include "TriangleMeshAdjacency.h"
+#include "TriangleMeshDistanceField.h"
+#include "TriangleMeshOptimizer.h"
+#include "TriangleMeshSimplifier.h"
+#include "TriangleMeshVoxelizer.h"
+#include "TriangleMeshBVH.h"
+#include "TriangleRasterizer.h"
+#include "VertexWelder.h"
 
 #endif // LIBCGT_GEOMETRY_H
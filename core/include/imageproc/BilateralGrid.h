@@ -0,0 +1,106 @@
+#pragma once
+
+#include "common/Array3D.h"
+#include "vecmath/Vector2f.h"
+#include "vecmath/Vector2i.h"
+#include "vecmath/Vector3i.h"
+
+#include "Image1f.h"
+#include "Image4f.h"
+
+// A bilateral grid (Chen, Paris, and Durand, SIGGRAPH 2007)
+//
+// Edge-aware smoothing is done in three steps:
+//   splat: each pixel accumulates ( value, 1 ) into the grid cell at
+//          ( x / spatialSigma, y / spatialSigma, edge / rangeSigma )
+//   blur:  the grid is convolved with a separable Gaussian (sigma = 1 cell)
+//   slice: each pixel reads back the trilinearly interpolated ( value, weight )
+//          at its grid position and outputs value / weight
+//
+// The cost is linear in the number of pixels plus the number of grid cells
+// and is independent of the spatial radius.
+// All three steps run in parallel.
+class BilateralGrid
+{
+public:
+
+	// edge-preserving smoothing of input, using input itself as the edge image
+	static Image1f filter( const Image1f& input, float spatialSigma, float rangeSigma );
+
+	// cross (joint) bilateral filter:
+	// smooths input while preserving the edges in edgeImage
+	// input and edgeImage must be the same size
+	// (otherwise, prints an error and returns an empty image)
+	static Image1f filter( const Image1f& input, const Image1f& edgeImage,
+		float spatialSigma, float rangeSigma );
+
+	// edge-preserving smoothing of the RGB channels of input,
+	// using its luminance as the edge image
+	// alpha is copied unchanged
+	static Image4f filter( const Image4f& input, float spatialSigma, float rangeSigma );
+
+	// cross bilateral filter of the RGB channels of input
+	// one grid is built per channel, all sharing the edges in edgeImage
+	// alpha is copied unchanged
+	// input and edgeImage must be the same size, as above
+	static Image4f filter( const Image4f& input, const Image1f& edgeImage,
+		float spatialSigma, float rangeSigma );
+
+	// allocates an empty grid for an image of size imageSize
+	// whose edge values lie in [edgeMin, edgeMax]
+	// spatialSigma is in pixels, rangeSigma is in units of the edge image
+	BilateralGrid( const Vector2i& imageSize, float edgeMin, float edgeMax,
+		float spatialSigma, float rangeSigma );
+
+	Vector3i gridSize() const;
+
+	// each cell is ( sum of values, sum of weights )
+	const Array3D< Vector2f >& grid() const;
+	Array3D< Vector2f >& grid();
+
+	// clears the grid to 0
+	void clear();
+
+	// accumulates ( input( x, y ), 1 ) into the cell nearest
+	// to each pixel's grid coordinate
+	void splat( const Image1f& input, const Image1f& edgeImage );
+
+	// accumulates channel c of input
+	void splat( const Image4f& input, int c, const Image1f& edgeImage );
+
+	// convolves the grid in place with a 5-tap binomial kernel
+	// along x, then y, then z
+	void blur();
+
+	// samples the grid at each pixel's grid coordinate
+	// and writes the normalized value to output
+	// output must be the same size as edgeImage
+	void slice( const Image1f& edgeImage, Image1f& output ) const;
+
+	// writes the normalized value to channel c of output
+	void slice( const Image1f& edgeImage, int c, Image4f& output ) const;
+
+private:
+
+	// number of empty cells on each side of the grid
+	// so that the blur kernel never reads outside it
+	static const int PADDING;
+
+	// values and output are strided by valueStride and outputStride floats
+	void splat( const float* values, int valueStride, const float* edgePixels );
+	void slice( const float* edgePixels, float* output, int outputStride ) const;
+
+	// convolves the grid along one axis (0 = x, 1 = y, 2 = z)
+	void blurAxis( int axis );
+
+	int gridX( int x ) const;
+	int gridY( int y ) const;
+	int gridZ( float edge ) const;
+
+	Vector2i m_imageSize;
+	float m_edgeMin;
+	float m_spatialSigma;
+	float m_rangeSigma;
+
+	Array3D< Vector2f > m_grid;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Image1f.h"
+#include "Image4f.h"
+
+// The guided filter (He, Sun, and Tang, ECCV 2010)
+//
+// The output is locally a linear function of the guide:
+//   q = a * I + b
+// where a and b are fit to the input over each (2 * radius + 1)^2 window
+// and epsilon regularizes a (larger epsilon = more smoothing).
+// Edges in the guide are preserved where its local variance >> epsilon.
+//
+// Everything is built out of box filters computed with running sums,
+// so the cost is independent of the radius.
+// All passes run in parallel.
+class GuidedFilter
+{
+public:
+
+	// the mean over the (2 * radius + 1)^2 window around each pixel
+	// the window is clipped to the image
+	static Image1f boxFilter( const Image1f& input, int radius );
+
+	// filters input, preserving the edges in guide
+	// input and guide must be the same size
+	// (otherwise, prints an error and returns an empty image)
+	static Image1f filter( const Image1f& input, const Image1f& guide,
+		int radius, float epsilon );
+
+	// edge-preserving smoothing of input, using input itself as the guide
+	static Image1f filter( const Image1f& input, int radius, float epsilon );
+
+	// filters each of the RGB channels of input with the same guide
+	// alpha is copied unchanged
+	// input and guide must be the same size, as above
+	static Image4f filter( const Image4f& input, const Image1f& guide,
+		int radius, float epsilon );
+
+	// filters each of the RGB channels of input using itself as the guide
+	// alpha is copied unchanged
+	static Image4f filter( const Image4f& input, int radius, float epsilon );
+
+private:
+
+	// box filters a width x height array of floats
+	// input and output may alias
+	static void boxFilter( const float* input, float* output,
+		int width, int height, int radius );
+
+	// guided filter of one channel
+	// meanGuide and varianceGuide are the box-filtered guide statistics
+	// input and output are strided by inputStride and outputStride floats
+	static void filterChannel( const float* guide,
+		const float* meanGuide, const float* varianceGuide,
+		const float* input, int inputStride,
+		float* output, int outputStride,
+		int width, int height, int radius, float epsilon );
+
+	// computes the box-filtered mean and variance of guide
+	static void guideStatistics( const float* guide, int width, int height, int radius,
+		float* meanGuide, float* varianceGuide );
+};
@@ -16,7 +16,7 @@ public:
 
 	Image1f(); // default constructor creates the null image
 
-	// Creates an Image1f from a PFM file	
+	// Creates an Image1f from a PFM, PGM or OpenEXR file	
 	Image1f( QString filename );
 	
 	Image1f( int width, int height, float fill = 0.f );
@@ -54,15 +54,16 @@ public:
 	QImage toQImage();
 
 	// ---- I/O ----
+	// PFM (either byte order), 8- or 16-bit PGM or OpenEXR (channel "Y")
 	bool load( QString filename );
+
+	// little-endian PFM, 8-bit PGM, OpenEXR (channel "Y", 32-bit floats), TXT or PNG
 	bool save( QString filename );
 	
 private:
 
-	bool loadPFM( QString filename );
 	bool savePNG( QString filename );
 	bool saveTXT( QString filename );
-	bool savePFM( QString filename );
 
 	int m_width;
 	int m_height;
@@ -16,7 +16,8 @@ public:
 	Image4f(); // default constructor creates the null image
 
 	// Creates an Image4f from any format readable by QImage
-	// as well as little-endian PFM and "PFM4" (4-component PFM with header "PF4")
+	// as well as PFM (either byte order), "PFM4" (4-component PFM with header "PF4"),
+	// 8- and 16-bit PPM / PGM and OpenEXR (RGBA)
 	Image4f( QString filename );
 	
 	Image4f( int width, int height, const Vector4f& fill = Vector4f( 0, 0, 0, 0 ) );
@@ -70,6 +71,8 @@ public:
 	//   portable network graphics (PNG) (4-component, 8 bits per channel)
 	//   little-endian PFM (3-component PFM with header "PF", 32 bits per channel alpha is dropped)
 	//   *non-standard* little-endian PFM4 (4-component PFM with header "PF4", 32 bits per channel)
+	//   PPM (3-component, 8 bits per channel, alpha is dropped)
+	//   OpenEXR (RGBA, 16-bit half floats, ZIP compressed)
 	//   human-readable TXT
 	// TODO: re-expose savePNG, saveTXT
 	bool save( QString filename );	
@@ -77,12 +80,8 @@ public:
 private:
 
 	bool loadQImage( QString filename );
-	bool loadPFM( QString filename );
-	bool loadPFM4( QString filename );
 
 	bool savePNG( QString filename );
-	bool savePFM( QString filename );
-	bool savePFM4( QString filename );
 	bool saveTXT( QString filename );
 
 	int m_width;
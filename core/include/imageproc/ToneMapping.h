@@ -0,0 +1,94 @@
+#pragma once
+
+#include "common/BasicTypes.h"
+
+#include "Image1f.h"
+#include "Image4f.h"
+#include "Image4ub.h"
+
+// HDR to LDR tone mapping for previewing Image4f renders
+//
+// The final pass is fused:
+// exposure, tone curve, sRGB encoding, and quantization to 8 bits
+// are applied in a single multithreaded SSE pass over the image.
+class ToneMapping
+{
+public:
+
+	enum Operator
+	{
+		// Reinhard et al. 2002, global operator with a white point
+		REINHARD_GLOBAL,
+
+		// Narkowicz's curve fit of the ACES filmic reference transform
+		// applied per channel
+		FILMIC_ACES,
+
+		// Durand and Dorsey 2002:
+		// compresses the bilateral-filtered log luminance (base layer)
+		// and keeps the detail layer
+		LOCAL_BILATERAL
+	};
+
+	struct Parameters
+	{
+		// defaults to automatic-exposure global Reinhard
+		Parameters();
+
+		Operator toneOperator;
+
+		// the input is scaled by 2^exposureStops before the tone curve
+		float exposureStops;
+
+		// if > 0, the input is additionally scaled by
+		// keyValue / logAverageLuminance( input )
+		// (automatic exposure)
+		float keyValue;
+
+		// REINHARD_GLOBAL: the (exposed) luminance that maps to white
+		float whitePoint;
+
+		// LOCAL_BILATERAL: spatial sigma in pixels
+		// and range sigma in log10 luminance
+		float spatialSigma;
+		float rangeSigma;
+
+		// LOCAL_BILATERAL: the dynamic range of the base layer after compression
+		// (as a ratio, e.g. 5 means 5:1)
+		float baseContrast;
+
+		// if true, the output is sRGB encoded, otherwise it's linear
+		bool srgbEncode;
+	};
+
+	// returns exp( mean( log( delta + L ) ) ), where L is the Rec. 709 luminance
+	// computed with a parallel reduction
+	static float logAverageLuminance( const Image4f& input, float delta = 1e-4f );
+
+	// tone maps input into output
+	// output is reallocated if it's not the same size as input
+	// alpha is clamped to [0,1] and quantized, but otherwise untouched
+	static void toneMap( const Image4f& input, Image4ub& output,
+		const Parameters& parameters = Parameters() );
+
+	static Image4ub toneMap( const Image4f& input,
+		const Parameters& parameters = Parameters() );
+
+	// encodes a linear value in [0,1] to sRGB
+	static float linearToSRGB( float x );
+
+	// decodes an sRGB value in [0,1] to linear
+	static float srgbToLinear( float x );
+
+private:
+
+	// computes the per-pixel luminance scale of the local operator:
+	// scale( x, y ) = L_out( x, y ) / L_in( x, y )
+	static Image1f localBilateralScale( const Image4f& input, float exposure,
+		const Parameters& parameters );
+
+	// the fused pass
+	// pixel ( x, y ) is scaled by exposure, and by perPixelScale( x, y ) if it's not null
+	static void toneMapPass( const Image4f& input, float exposure, const Image1f* perPixelScale,
+		const Parameters& parameters, Image4ub& output );
+};
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "BilateralGrid.h"
 #include "Compositing.h"
+#include "GuidedFilter.h"
 #include "Image1f.h"
 #include "Image1ub.h"
 #include "Image1i.h"
 #include "Image4f.h"
 #include "Image4ub.h"
 #include "Patterns.h"
+#include "ToneMapping.h"
@@ -2,29 +2,105 @@
 #define BINARY_FILE_INPUT_STREAM_H
 
 #include <cstdio>
+#include <vector>
 
-// TODO: replace with QDataStream and QTextStream
+#include "common/BasicTypes.h"
+#include "io/ByteOrder.h"
+#include "io/MappedFile.h"
 
+// Reads binary files in a given byte order
+//
+// Reads are served from a large user-space buffer (BUFFERED)
+// or straight out of a memory mapping of the whole file (MEMORY_MAPPED)
+// Values in the other byte order than the host's are swapped after reading
 class BinaryFileInputStream
 {
 public:
 
-	static BinaryFileInputStream* open( const char* filename );
+	enum Mode
+	{
+		BUFFERED,
+		MEMORY_MAPPED
+	};
+
+	// size of the user-space buffer in BUFFERED mode
+	static const int BUFFER_SIZE;
+
+	// returns NULL if filename can't be opened
+	// byteOrder is the byte order of the file
+	static BinaryFileInputStream* open( const char* filename,
+		ByteOrder::Order byteOrder = ByteOrder::nativeOrder(),
+		Mode mode = BUFFERED );
 	virtual ~BinaryFileInputStream();
 
 	void close();
 
 	bool readInt( int* i );
-	bool readIntArray( int[], int nCount );
+	bool readIntArray( int i[], int nCount );
 
 	bool readFloat( float* f );
 	bool readFloatArray( float f[], int nCount );
 
+	// reads one value of a trivially copyable type T
+	template< typename T >
+	bool readValue( T* value, int componentSize = sizeof( T ) );
+
+	// reads nCount values of a trivially copyable type T
+	// componentSize is the size of the scalars that T is made of,
+	// which are byte swapped individually
+	// e.g. readArray( vector3fs, n, sizeof( float ) )
+	template< typename T >
+	bool readArray( T* values, int64 nCount, int componentSize = sizeof( T ) );
+
+	// reads nBytes bytes, swapping each of the nBytes / componentSize components
+	// if the file isn't in the host's byte order
+	// componentSize must be 1, 2, 4 or 8
+	bool readBytes( void* data, int64 nBytes, int componentSize = 1 );
+
+	// MEMORY_MAPPED mode only: returns a pointer to the next nBytes bytes
+	// in the mapping without copying them, and advances past them
+	// no byte swapping is done
+	// returns NULL if there are fewer than nBytes left, or in BUFFERED mode
+	const void* readInPlace( int64 nBytes );
+
+	// advances nBytes bytes
+	bool skip( int64 nBytes );
+
+	// the number of bytes read so far
+	int64 position() const;
+
 private:
 
-	BinaryFileInputStream( FILE* pFilePointer );
+	BinaryFileInputStream( ByteOrder::Order byteOrder );
+
+	// refills the buffer with up to BUFFER_SIZE bytes
+	// returns the number of bytes now in the buffer
+	int64 refill();
 
 	FILE* m_pFilePointer;
+	MappedFile m_mappedFile;
+	Mode m_mode;
+	bool m_swapBytes;
+
+	std::vector< ubyte > m_buffer;
+	int64 m_bufferPosition; // the next byte to read in m_buffer
+	int64 m_bufferEnd; // the number of valid bytes in m_buffer
+
+	int64 m_position;
 };
 
+// T is copied with memcpy: it must be a plain aggregate of scalars
+// (e.g. int, float, Vector3f), with no pointers or virtual functions
+template< typename T >
+bool BinaryFileInputStream::readValue( T* value, int componentSize )
+{
+	return readBytes( value, sizeof( T ), componentSize );
+}
+
+template< typename T >
+bool BinaryFileInputStream::readArray( T* values, int64 nCount, int componentSize )
+{
+	return readBytes( values, nCount * sizeof( T ), componentSize );
+}
+
 #endif
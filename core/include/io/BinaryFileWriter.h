@@ -2,26 +2,87 @@
 #define BINARY_FILE_WRITER_H
 
 #include <cstdio>
+#include <vector>
 
-// TODO: binary file output stream
+#include "common/BasicTypes.h"
+#include "io/ByteOrder.h"
+
+// Writes binary files in a given byte order
+//
+// Writes are collected in a large user-space buffer
+// and handed to the OS in big blocks
+// Values are swapped (in the buffer) if the file's byte order isn't the host's
 class BinaryFileWriter
 {
 public:
 
-	static BinaryFileWriter* open( const char* filename );
+	// size of the user-space buffer
+	static const int BUFFER_SIZE;
+
+	// returns NULL if filename can't be created
+	// byteOrder is the byte order of the file
+	static BinaryFileWriter* open( const char* filename,
+		ByteOrder::Order byteOrder = ByteOrder::nativeOrder() );
 	virtual ~BinaryFileWriter();
 
-	void close();
+	// flushes the buffer and closes the file
+	// returns false if any write failed
+	bool close();
 
 	bool writeInt( int i );
+	bool writeIntArray( const int i[], int nCount );
+
 	bool writeFloat( float f );
-	bool writeFloatArray( float f[], int nCount );
+	bool writeFloatArray( const float f[], int nCount );
+
+	// writes one value of a trivially copyable type T
+	template< typename T >
+	bool writeValue( const T& value, int componentSize = sizeof( T ) );
+
+	// writes nCount values of a trivially copyable type T
+	// componentSize is the size of the scalars that T is made of,
+	// which are byte swapped individually
+	// e.g. writeArray( vector3fs, n, sizeof( float ) )
+	template< typename T >
+	bool writeArray( const T* values, int64 nCount, int componentSize = sizeof( T ) );
+
+	// writes nBytes bytes, swapping each of the nBytes / componentSize components
+	// if the file isn't in the host's byte order
+	// componentSize must be 1, 2, 4 or 8
+	bool writeBytes( const void* data, int64 nBytes, int componentSize = 1 );
+
+	// writes the buffer to the file
+	bool flush();
+
+	// the number of bytes written so far
+	int64 position() const;
 
 private:
 
-	BinaryFileWriter( FILE* pFilePointer );
+	BinaryFileWriter( FILE* pFilePointer, ByteOrder::Order byteOrder );
 
 	FILE* m_pFilePointer;
+	bool m_swapBytes;
+	bool m_failed;
+
+	std::vector< ubyte > m_buffer;
+	int64 m_bufferEnd; // the number of bytes in m_buffer
+
+	int64 m_position;
 };
 
-#endif BINARY_FILE_WRITER_H
+// T is copied with memcpy: it must be a plain aggregate of scalars
+// (e.g. int, float, Vector3f), with no pointers or virtual functions
+template< typename T >
+bool BinaryFileWriter::writeValue( const T& value, int componentSize )
+{
+	return writeBytes( &value, sizeof( T ), componentSize );
+}
+
+template< typename T >
+bool BinaryFileWriter::writeArray( const T* values, int64 nCount, int componentSize )
+{
+	return writeBytes( values, nCount * sizeof( T ), componentSize );
+}
+
+#endif // BINARY_FILE_WRITER_H
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "common/BasicTypes.h"
+
+// Byte order conversion
+// for reading and writing files that are not in the host's byte order
+class ByteOrder
+{
+public:
+
+	enum Order
+	{
+		LITTLE,
+		BIG
+	};
+
+	// whether the host is little endian
+	static bool isLittleEndian();
+
+	// the byte order of the host
+	static Order nativeOrder();
+
+	static uint16 swap( uint16 x );
+	static uint32 swap( uint32 x );
+	static uint64 swap( uint64 x );
+	static float swap( float x );
+	static double swap( double x );
+
+	// reverses the bytes of each of nElements elements of 2, 4 or 8 bytes in place
+	// 16 bytes at a time with SSE2
+	static void swap16( void* data, int64 nElements );
+	static void swap32( void* data, int64 nElements );
+	static void swap64( void* data, int64 nElements );
+
+	// reverses the bytes of each of nElements elements of elementSize bytes in place
+	// elementSize must be 1, 2, 4 or 8
+	static void swap( void* data, int elementSize, int64 nElements );
+};
@@ -3,6 +3,11 @@
 
 #include "common/BasicTypes.h"
 
+// Reads whole files into caller owned buffers
+//
+// Both functions copy out of a memory mapping of the file (see MappedFile)
+// Callers that only scan a file once should use a MappedFile directly,
+// which avoids the copy altogether
 class FileReader
 {
 public:
@@ -10,11 +15,12 @@ public:
 	// allocates a new buffer and points *ppBuffer to it
 	// buffer contains *length characters followed by '\0'
 	// the buffer size is 1 + fileSize bytes
-	// note that length may be less than fileSize due to fread() converting "\r\n" to "\n"
+	// note that length may be less than fileSize: "\r\n" is converted to "\n"
 	// returns true if succeeded
 	// if failed, buffer is correctly deallocated
 	static bool readTextFile( const char* filename, char** ppBuffer, long* length );
 
+	// allocates a new buffer of *size bytes and points *ppBuffer to it
 	static bool readBinaryFile( const char* filename, ubyte** ppBuffer, long* size );
 };
 
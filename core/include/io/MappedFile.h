@@ -0,0 +1,129 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include "common/BasicTypes.h"
+
+// A read-only memory-mapped file
+// The mapping is released when the MappedFile is destroyed
+//
+// The contents are exposed in place, as spans and lines that point into the mapping,
+// so reading a file never copies it
+class MappedFile
+{
+public:
+
+	// how the mapping will be read, a hint to the OS's read-ahead
+	enum AccessPattern
+	{
+		NORMAL,
+		SEQUENTIAL,
+		RANDOM
+	};
+
+	// a range [begin, end) of the mapping
+	// valid until the file is closed
+	struct Span
+	{
+		Span();
+		Span( const char* begin, const char* end );
+
+		int64 size() const;
+		bool isEmpty() const;
+		const ubyte* data() const;
+
+		// copies
+		QByteArray toByteArray() const;
+		QString toString() const; // from UTF-8
+
+		const char* begin;
+		const char* end;
+	};
+
+	// iterates over the lines of a span without copying them:
+	//
+	// for( MappedFile::LineIterator itr( file ); !itr.atEnd(); itr.next() )
+	// {
+	//     MappedFile::Span line = itr.line();
+	// }
+	//
+	// lines are terminated by "\n" or "\r\n", which are not part of line()
+	// a final line without a terminator is still a line
+	class LineIterator
+	{
+	public:
+
+		LineIterator( const MappedFile& file );
+		LineIterator( const Span& span );
+
+		bool atEnd() const;
+		void next();
+
+		Span line() const;
+
+		// 0-based
+		int lineNumber() const;
+
+	private:
+
+		const char* m_next; // the beginning of the line after the current one
+		const char* m_end;
+		Span m_line;
+		int m_lineNumber;
+		bool m_atEnd;
+	};
+
+	// creates a closed MappedFile
+	MappedFile();
+
+	// maps filename
+	// check isOpen() for success
+	MappedFile( QString filename, AccessPattern accessPattern = NORMAL );
+
+	virtual ~MappedFile();
+
+	// maps filename, closing any previously mapped file
+	// returns false on failure
+	// empty files open successfully with size() == 0 and data() == nullptr
+	bool open( QString filename, AccessPattern accessPattern = NORMAL );
+
+	// changes the access pattern hint of an open file
+	// (on Windows, the hint can only be given to open())
+	void advise( AccessPattern accessPattern );
+
+	void close();
+
+	bool isOpen() const;
+
+	// the mapped bytes, valid until close()
+	const ubyte* data() const;
+
+	// data(), reinterpreted as characters
+	// note that the content is *not* '\0' terminated
+	const char* charData() const;
+
+	// size in bytes
+	int64 size() const;
+
+	// the whole file
+	Span span() const;
+
+	// [offset, offset + size), clamped to the file
+	Span span( int64 offset, int64 size ) const;
+
+private:
+
+	// not copyable
+	MappedFile( const MappedFile& copy );
+	MappedFile& operator = ( const MappedFile& copy );
+
+	bool m_isOpen;
+	const ubyte* m_data;
+	int64 m_size;
+
+#ifdef _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#endif
+};
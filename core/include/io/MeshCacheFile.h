@@ -0,0 +1,217 @@
+#pragma once
+
+#include <memory>
+#include <QString>
+
+#include "common/BasicTypes.h"
+#include "io/MappedFile.h"
+#include "vecmath/Vector2f.h"
+#include "vecmath/Vector3f.h"
+#include "vecmath/Vector3i.h"
+
+class OBJData;
+class TriangleMesh;
+
+// A versioned binary mesh format for caching parsed meshes
+//
+// The file is a fixed header, a table of blocks, and the blocks themselves,
+// each a contiguous array aligned to 64 bytes in native (little endian) byte order.
+// Polygons are stored fan-triangulated, with per-corner position,
+// texture coordinate and normal indices (-1 if absent).
+// Groups are ranges of triangles, split into runs of one material each.
+//
+// Opening a cache maps it into memory: the arrays are exposed
+// in place, without copying or parsing.
+class MeshCacheFile
+{
+public:
+
+	// incremented whenever the layout changes
+	static const uint32 VERSION;
+
+	// the extension appended to a source filename for its side-car cache
+	static const char* CACHE_EXTENSION;
+
+	// identifies the source file a cache was built from
+	struct SourceInfo
+	{
+		SourceInfo();
+
+		int64 size;
+		int64 modifiedTime; // milliseconds since the epoch
+		uint64 contentHash;
+	};
+
+	// a group: triangles [firstTriangle, firstTriangle + nTriangles)
+	// and material runs [firstMaterialRun, firstMaterialRun + nMaterialRuns)
+	struct Group
+	{
+		uint32 nameOffset; // into the string table
+		uint32 nameLength;
+		int32 firstTriangle;
+		int32 nTriangles;
+		int32 firstMaterialRun;
+		int32 nMaterialRuns;
+		int32 hasTextureCoordinates;
+		int32 hasNormals;
+	};
+
+	// consecutive triangles of a group using the same material
+	// the material is referenced by name, as in OBJGroup
+	struct MaterialRun
+	{
+		uint32 nameOffset;
+		uint32 nameLength;
+		int32 firstTriangle;
+		int32 nTriangles;
+	};
+
+	struct Material
+	{
+		uint32 nameOffset;
+		uint32 nameLength;
+		uint32 ambientTextureOffset;
+		uint32 ambientTextureLength;
+		uint32 diffuseTextureOffset;
+		uint32 diffuseTextureLength;
+		int32 illuminationModel;
+		float alpha;
+		float shininess;
+		Vector3f ambientColor;
+		Vector3f diffuseColor;
+		Vector3f specularColor;
+	};
+
+	// ----- Side-car cache -----
+
+	// loads objFilename through its side-car cache objFilename + CACHE_EXTENSION
+	// the cache is used if the source size matches and either its modification time
+	// or its content hash matches (in which case the cached time is refreshed)
+	// otherwise, the OBJ is parsed and the cache is (re)written
+	// returns nullptr if the OBJ can't be loaded
+	// note: from the cache, polygons come back fan-triangulated
+	// (prefer loadTriangleMesh() when only the mesh is needed)
+	static std::shared_ptr< OBJData > loadOBJ( QString objFilename, bool removeEmptyGroups = true );
+
+	// loads objFilename as a TriangleMesh through the same side-car cache
+	// on a hit, the mesh is built straight from the mapped arrays, without an OBJData
+	// either way, the result is the same as TriangleMesh( OBJLoader::loadFile( objFilename ) )
+	// returns false if the OBJ can't be loaded
+	static bool loadTriangleMesh( QString objFilename, TriangleMesh& mesh );
+
+	// size, modification time and content hash of filename
+	// returns false if it can't be read
+	static bool getSourceInfo( QString filename, SourceInfo* pInfo );
+
+	// a 64-bit hash of the contents of filename
+	// blocks are hashed in parallel and combined in order
+	static bool hashFile( QString filename, uint64* pHash );
+
+	// ----- Writing -----
+
+	// writes pData with its polygons triangulated
+	// the file is written to a temporary and renamed, so readers never see a partial file
+	static bool write( QString filename, std::shared_ptr< OBJData > pData,
+		const SourceInfo& sourceInfo = SourceInfo() );
+
+	// writes the positions, normals and faces of mesh
+	static bool write( QString filename, const TriangleMesh& mesh,
+		const SourceInfo& sourceInfo = SourceInfo() );
+
+	// ----- Reading -----
+
+	MeshCacheFile();
+
+	// maps filename and validates its header, block table, ranges, strings and indices
+	// returns false if it's missing, truncated, corrupt, or a different version
+	bool open( QString filename );
+	void close();
+	bool isOpen() const;
+
+	const SourceInfo& sourceInfo() const;
+
+	int numPositions() const;
+	const Vector3f* positions() const;
+
+	int numTextureCoordinates() const;
+	const Vector2f* textureCoordinates() const;
+
+	int numNormals() const;
+	const Vector3f* normals() const;
+
+	// per-triangle indices
+	// the texture coordinate and normal arrays are null if absent
+	int numTriangles() const;
+	const Vector3i* trianglePositionIndices() const;
+	const Vector3i* triangleTextureCoordinateIndices() const;
+	const Vector3i* triangleNormalIndices() const;
+
+	int numGroups() const;
+	const Group* groups() const;
+	QString groupName( int groupIndex ) const;
+
+	int numMaterialRuns() const;
+	const MaterialRun* materialRuns() const;
+	QString materialRunName( int runIndex ) const;
+
+	int numMaterials() const;
+	const Material* materials() const;
+	QString materialName( int materialIndex ) const;
+
+	// copies the contents into a new OBJData
+	std::shared_ptr< OBJData > toOBJData() const;
+
+	// copies the contents into a TriangleMesh, straight from the arrays
+	// position and normal indices are merged the same way as TriangleMesh( OBJData )
+	TriangleMesh toTriangleMesh() const;
+
+private:
+
+	// not copyable
+	MeshCacheFile( const MeshCacheFile& copy );
+	MeshCacheFile& operator = ( const MeshCacheFile& copy );
+
+	// returns the block of the given type and element size, or nullptr
+	// *pCount is set to its number of elements (0 if missing)
+	const void* findBlock( uint32 type, uint32 elementSize, int* pCount ) const;
+
+	// whether [ offset, offset + length ) is within the string table
+	bool isValidString( uint32 offset, uint32 length ) const;
+
+	QString string( uint32 offset, uint32 length ) const;
+
+	// opens the side-car cache of objFilename into cache if it's up to date (see loadOBJ)
+	static bool openSideCar( QString objFilename, MeshCacheFile& cache );
+
+	// parses objFilename and (re)writes its side-car cache
+	static std::shared_ptr< OBJData > parseAndCache( QString objFilename, bool removeEmptyGroups );
+
+	// overwrites just the source modification time in the header of filename
+	static bool updateSourceModifiedTime( QString filename, int64 modifiedTime );
+
+	MappedFile m_file;
+	SourceInfo m_sourceInfo;
+	int m_nBlocks;
+
+	const Vector3f* m_positions;
+	int m_nPositions;
+	const Vector2f* m_textureCoordinates;
+	int m_nTextureCoordinates;
+	const Vector3f* m_normals;
+	int m_nNormals;
+
+	const Vector3i* m_trianglePositionIndices;
+	const Vector3i* m_triangleTextureCoordinateIndices;
+	const Vector3i* m_triangleNormalIndices;
+	int m_nTriangles;
+
+	const Group* m_groups;
+	int m_nGroups;
+	const MaterialRun* m_materialRuns;
+	int m_nMaterialRuns;
+	const Material* m_materials;
+	int m_nMaterials;
+
+	const char* m_strings;
+	int m_nStringBytes;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "common/BasicTypes.h"
+
+// Fast formatting of numbers directly into character buffers
+// (the counterpart of NumberParser), without locales, '\0' termination or allocation
+//
+// Each format function writes the number starting at buffer
+// and returns a pointer one past its last character
+// buffer must have room for MAX_LENGTH characters
+class NumberFormatter
+{
+public:
+
+	// enough for the output of any format function
+	static const int MAX_LENGTH = 64;
+
+	// the fewest significant digits that parse back to exactly f
+	// (with a correctly rounding parser, such as NumberParser)
+	// e.g. 0.1f is "0.1", 3.f is "3", 1e-7f is "1e-7"
+	//
+	// Candidates are generated and checked in double precision
+	// outside about [1e-13, 1e22], where that isn't exact,
+	// it falls back to 9 significant digits, which always round trip
+	static char* formatFloat( float f, char* buffer );
+
+	// f with exactly precision digits after the decimal point, like printf( "%.*f" )
+	// precision is clamped to [0, 9]
+	// halfway cases are rounded away from zero
+	static char* formatFloat( float f, int precision, char* buffer );
+
+	static char* formatInt( int i, char* buffer );
+
+private:
+
+	// writes the decimal digits of value
+	static char* formatUnsigned( uint64 value, char* buffer );
+
+	// whether digits * 10^exponent rounds to f
+	// returns false if that can't be decided exactly in double precision
+	static bool roundTrips( uint32 digits, int exponent, float f );
+};
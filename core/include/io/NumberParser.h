@@ -0,0 +1,43 @@
+#pragma once
+
+// Fast parsing of numbers directly out of character ranges
+// (e.g., a memory-mapped text file), without '\0' termination or allocation
+//
+// Each parse function reads the number starting at begin,
+// without reading past end, and returns a pointer one past its last character
+// On failure (no number at begin), it returns nullptr and leaves *value untouched
+class NumberParser
+{
+public:
+
+	// parses [+-]digits[.digits][(e|E)[+-]digits], as well as inf and nan
+	//
+	// Numbers with up to 19 significant digits and small exponents
+	// (the common case) are correctly rounded using one floating point operation
+	// otherwise, it falls back to strtof() in the "C" locale
+	static const char* parseFloat( const char* begin, const char* end, float* value );
+
+	// parses [+-]digits
+	// returns nullptr if the number overflows an int
+	static const char* parseInt( const char* begin, const char* end, int* value );
+
+	// returns true if c is a space, tab, or carriage return
+	static bool isSpace( char c );
+
+	// returns a pointer to the first non-space character in [begin, end)
+	// (or end)
+	static const char* skipSpaces( const char* begin, const char* end );
+
+	// returns a pointer to the first space character in [begin, end)
+	// (or end)
+	static const char* skipToSpace( const char* begin, const char* end );
+
+	// returns a pointer to the first '\n' in [begin, end)
+	// (or end)
+	static const char* findLineEnd( const char* begin, const char* end );
+
+private:
+
+	// parses [begin, end) with _strtof_l() in the "C" locale
+	static bool parseFloatSlow( const char* begin, const char* end, float* value );
+};
@@ -61,7 +61,10 @@ public:
 	void removeEmptyGroups();
 
 	// ----- I/O -----
-	bool save( QString filename );
+
+	// see OBJWriter: precision < 0 writes the shortest round trip digits,
+	// otherwise precision digits after the decimal point
+	bool save( QString filename, int precision = -1 );
 
 private:
 
@@ -69,10 +72,12 @@ private:
 	std::vector< Vector2f > m_textureCoordinates;
 	std::vector< Vector3f > m_normals;
 
+	// the hashes store indices, since pointers into the vectors
+	// are invalidated when they grow
 	std::vector< OBJGroup > m_groups;
-	QHash< QString, OBJGroup* > m_groupsByName;
+	QHash< QString, int > m_groupIndicesByName;
 
 	std::vector< OBJMaterial > m_materials;
-	QHash< QString, OBJMaterial* > m_materialsByName;
+	QHash< QString, int > m_materialIndicesByName;
 
 };
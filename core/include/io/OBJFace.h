@@ -9,6 +9,11 @@ public:
 	OBJFace();
 	OBJFace( bool hasTextureCoordinates, bool hasNormals );
 
+	OBJFace( const OBJFace& copy );
+	OBJFace( OBJFace&& move );
+	OBJFace& operator = ( const OBJFace& copy );
+	OBJFace& operator = ( OBJFace&& move );
+
 	bool hasTextureCoordinates() const;
 	bool hasNormals() const;
 
@@ -26,6 +26,10 @@ public:
 
 	// adds a new face to the current material
 	void addFace( const OBJFace& face );
+	void addFace( OBJFace&& face );
+
+	// reserves space for nFaces faces in total
+	void reserveFaces( int nFaces );
 
 	int numMaterials() const;
 	const std::vector< QString >& materialNames() const;
@@ -45,7 +49,13 @@ private:
 	bool m_hasNormals;
 
 	std::vector< QString > m_materialNames;
-	QHash< QString, std::vector< int > > m_facesByMaterial;
+
+	// the face indices for each distinct material name
+	// m_currentFaceList is the list for the current material
+	// so that adding a face doesn't need a hash lookup
+	QHash< QString, int > m_faceListIndexByMaterial;
+	std::vector< std::vector< int > > m_faceLists;
+	int m_currentFaceList;
 
 	std::vector< OBJFace > m_faces;
 
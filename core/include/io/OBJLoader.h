@@ -1,11 +1,28 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include <QString>
 
+#include "common/BasicTypes.h"
+
 class OBJData;
 class OBJGroup;
 
+// Loads Wavefront OBJ files
+//
+// The file is memory mapped and tokenized in place:
+// numbers are parsed directly out of the mapped characters
+// and no per-line strings are allocated
+//
+// Parsing is parallel: the file is split at line boundaries into chunks
+// 1. each chunk counts its lines and elements
+// 2. a prefix sum gives each chunk its global element offsets,
+//    and the OBJData vertex arrays are sized once
+// 3. chunks are parsed concurrently: vertices are written directly into OBJData,
+//    faces (with globally resolved indices) into per-chunk buffers
+// 4. the chunks are stitched together in file order,
+//    replaying group and material changes
 class OBJLoader
 {
 public:
@@ -14,44 +31,69 @@ public:
 
 private:
 
+	// defined in OBJLoader.cpp
+	struct ElementCounts;
+	struct ChunkCommand;
+	struct Chunk;
+
 	static bool parseOBJ( QString objFilename, std::shared_ptr< OBJData > pOBJData );
 	static bool parseMTL( QString mtlFilename, std::shared_ptr< OBJData > pOBJData );
 
-	// parses a position line (starting with "v")
-	// returns false on an error
-	static bool parsePosition( int lineNumber, QString line,
-		QStringList tokens, std::shared_ptr< OBJData > pOBJData );
+	// splits [begin, end) into chunks of about chunkSize bytes
+	// each ending just after a '\n' (or at end)
+	static void splitIntoChunks( const char* begin, const char* end, int64 chunkSize,
+		std::vector< Chunk >& chunks );
 
-	// parses a texture coordinate line (starting with "vt")
-	// returns false on an error
-	static bool parseTextureCoordinate( int lineNumber, QString line,
-		QStringList tokens, std::shared_ptr< OBJData > pOBJData );
+	// a quick pass over a chunk that counts its lines and elements
+	// by looking only at the command at the beginning of each line
+	static void countElements( Chunk& chunk );
 
-	// parses a normal line (starting with "vn")
-	// returns false on an error
-	static bool parseNormal( int lineNumber, QString line,
-		QStringList tokens, std::shared_ptr< OBJData > pOBJData );
+	// parses a chunk:
+	// vertices are written into pOBJData at the chunk's offsets
+	// faces and group / material changes are appended to the chunk
+	static void parseChunk( Chunk& chunk, OBJData* pOBJData );
 
-	// parses a face line (starting with "f" or "fo")
-	// returns false on an error
-	static bool parseFace( int lineNumber, QString line,
-		QStringList tokens, OBJGroup* pCurrentGroup );
+	// replays the chunk commands in order
+	static void stitchChunks( QString objFilename, std::vector< Chunk >& chunks,
+		std::shared_ptr< OBJData > pOBJData );
 
-	// given the tokens in a face line
-	// returns if the attached attributes are consistent
-	static bool isFaceLineAttributesConsistent( QStringList tokens,
-		bool* pHasTextureCoordinates, bool* pHasNormals );
+	// parses nComponents whitespace separated floats from [begin, end)
+	// extra components are ignored
+	// returns false if there are fewer than nComponents or one is malformed
+	static bool parseFloats( const char* begin, const char* end,
+		int nComponents, float* values );
 
-	// objFaceVertexToken is something of the form:
+	// parses the vertices of a face line (the part after "f" or "fo")
+	// into the chunk's faces
+	// relative (negative) indices are resolved against
+	// the number of elements before this line in the whole file
+	// returns false on an error
+	static bool parseFace( int lineNumber, const char* begin, const char* end,
+		int nPositions, int nTextureCoordinates, int nNormals,
+		Chunk& chunk );
+
+	// objFaceVertexToken [begin, end) is something of the form:
 	// "int"
 	// "int/int"
-	// "int/int/int", 
+	// "int/int/int",
 	// "int//int"
 	// i.e. one of the delimited int strings that specify a vertex and its attributes
-	// 
+	//
 	// returns:
 	// whether the vertex is valid
-	// and the indices in the out parameters
-	static bool getVertexAttributes( QString objFaceVertexToken,
+	// and the 0-based indices in the out parameters (-1 if not present)
+	static bool getVertexAttributes( const char* begin, const char* end,
+		int nPositions, int nTextureCoordinates, int nNormals,
 		int* pPositionIndex, int* pTextureCoordinateIndex, int* pNormalIndex );
+
+	// converts a 1-based OBJ index, which counts backwards from the end if negative,
+	// to a 0-based index
+	// returns -1 if the index is 0, or not one of the nElements elements so far
+	static int resolveIndex( int objIndex, int nElements );
+
+	// returns true if [begin, end) is exactly command
+	static bool isCommand( const char* begin, const char* end, const char* command );
+
+	// returns [begin, end) as a QString with surrounding whitespace removed
+	static QString trimmedString( const char* begin, const char* end );
 };
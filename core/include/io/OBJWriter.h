@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdio>
+#include <QByteArray>
+#include <QString>
+
+class OBJData;
+class TriangleMesh;
+
+// Writes Wavefront OBJ files
+//
+// Lines are formatted with NumberFormatter into large buffers:
+// the vertices and faces are split into chunks of lines,
+// a round of chunks is formatted in parallel,
+// and then the chunks are written to the file in order
+//
+// Floats are written with the fewest digits that parse back to the same value,
+// or, if precision >= 0, with precision digits after the decimal point
+class OBJWriter
+{
+public:
+
+	// lines per chunk
+	static const int CHUNK_SIZE;
+
+	// chunks formatted in parallel before they are written
+	static const int CHUNKS_PER_ROUND;
+
+	// writes the positions, texture coordinates and normals,
+	// then for each group, "g <name>" followed by its faces,
+	// one "usemtl <name>" run per distinct material
+	static bool write( QString filename, OBJData& data, int precision = -1 );
+
+	// writes the positions, normals and faces
+	// faces index normals like positions ("f v//v") if the mesh has normals
+	static bool write( QString filename, const TriangleMesh& mesh, int precision = -1 );
+
+private:
+
+	// formats nLines lines into chunks and writes them to fp in order
+	// maxLineSize( i ) is an upper bound on the length of line i
+	// formatLine( i, p ) writes line i at p and returns its end
+	template< typename MaxLineSize, typename FormatLine >
+	static bool writeLines( FILE* fp, int nLines, MaxLineSize maxLineSize, FormatLine formatLine );
+
+	// writes nVectors "<command> x y [z]" lines
+	// of nComponents floats each, from consecutive vectors in components
+	static bool writeVectors( FILE* fp, const char* command,
+		const float* components, int nComponents, int nVectors, int precision );
+
+	static bool writeText( FILE* fp, const QByteArray& text );
+};
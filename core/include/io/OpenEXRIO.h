@@ -1,12 +1,28 @@
 #ifndef OPEN_EXR_IO_H
 #define OPEN_EXR_IO_H
 
-#if 0
-
 #include <QPair>
+#include <QString>
 #include <QVector>
-#include <vecmath/MatrixT.h>
 
+#include "common/BasicTypes.h"
+
+class Image1f;
+class Image4f;
+
+// Reads and writes single-part OpenEXR files
+// without depending on the OpenEXR library
+//
+// Supported:
+//   scanline and tiled (ONE_LEVEL) images
+//   HALF, FLOAT and (read only) UINT channels, without subsampling
+//   NONE, ZIPS and ZIP compression (zlib through qCompress / qUncompress)
+//
+// Blocks (scanline blocks or tiles) are decoded and encoded in parallel
+// and converted directly to or from the image's pixels
+//
+// Like Image4f, y = 0 is the *bottom* row of the image:
+// rows are flipped relative to the file, whose first line is the top one
 class OpenEXRIO
 {
 public:
@@ -18,21 +34,61 @@ public:
 		FLOAT = 2			// 32-bit float
 	};
 
+	// values match the file format
+	enum Compression
+	{
+		NO_COMPRESSION = 0,
+		ZIPS_COMPRESSION = 2, // zlib, one scanline per block
+		ZIP_COMPRESSION = 3 // zlib, 16 scanlines per block
+	};
+
 	// returns a vector of pairs
-	// each pair is a channel name and a channel type	
+	// each pair is a channel name and a channel type
+	// (empty if filename can't be read)
 	static QVector< QPair< QString, ChannelType > >
-		getChannelNamesAndTypes( const char* filename );
+		getChannelNamesAndTypes( QString filename );
 
-	static FloatMatrix getFloatBufferByName( const char* filename,
-		const char* channelName );
+	// reads channels "R", "G", "B" and "A" of the data window into image
+	// if there are no color channels but a luminance channel "Y", it's copied into R, G and B
+	// missing color channels are 0 and a missing alpha is 1
+	static bool read( QString filename, Image4f& image );
 
-#if 0
-	static void readZBuffer( const char* filename,
-		Imf::Array2D< float >& zPixels,
-		int& width, int& height );
-#endif
-};
+	// reads channel channelName of the data window into image
+	static bool read( QString filename, QString channelName, Image1f& image );
 
-#endif
+	// writes image as channels "R", "G", "B" and "A" of type channelType (HALF or FLOAT)
+	// if tileSize > 0, the image is tiled with tileSize x tileSize tiles
+	// otherwise, it's written in scanlines
+	static bool write( QString filename, const Image4f& image,
+		ChannelType channelType = HALF, Compression compression = ZIP_COMPRESSION,
+		int tileSize = 0 );
+
+	// writes image as the single channel channelName
+	static bool write( QString filename, const Image1f& image, QString channelName = "Y",
+		ChannelType channelType = FLOAT, Compression compression = ZIP_COMPRESSION,
+		int tileSize = 0 );
+
+private:
+
+	// defined in OpenEXRIO.cpp
+	struct Channel;
+	struct Header;
+
+	// parses the header of the file [data, data + size)
+	// on success, *pOffsetTable is the offset of the block offset table
+	static bool parseHeader( const ubyte* data, int64 size, Header& header, int64* pOffsetTable );
+
+	// decodes every block of the mapped file
+	// channel c of the file is written to component channelComponents[ c ]
+	// of pixels (nComponents per pixel, y flipped), or skipped if it's -1
+	static bool readPixels( const ubyte* data, int64 size, const Header& header, int64 offsetTable,
+		const int* channelComponents, float* pixels, int nComponents );
+
+	// encodes pixels (nComponents per pixel, y flipped) as the channels named channelNames,
+	// one per component
+	static bool writePixels( QString filename, const float* pixels, int width, int height,
+		int nComponents, const QVector< QString >& channelNames,
+		ChannelType channelType, Compression compression, int tileSize );
+};
 
 #endif
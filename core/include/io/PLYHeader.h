@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include "common/BasicTypes.h"
+
+// The header of a Stanford PLY file:
+// its format and the list of elements, each with a count and a list of properties
+//
+// A property is either a scalar or a list (a count followed by that many values)
+// The body stores every instance of each element in header order,
+// and each instance stores its properties in order
+class PLYHeader
+{
+public:
+
+	enum Format
+	{
+		ASCII,
+		BINARY_LITTLE_ENDIAN,
+		BINARY_BIG_ENDIAN
+	};
+
+	enum Type
+	{
+		INVALID_TYPE,
+		INT8,
+		UINT8,
+		INT16,
+		UINT16,
+		INT32,
+		UINT32,
+		FLOAT32,
+		FLOAT64
+	};
+
+	struct Property
+	{
+		Property();
+
+		QString name;
+		Type type; // the value type (of each value, for lists)
+		bool isList;
+		Type countType; // lists only
+	};
+
+	struct Element
+	{
+		Element();
+
+		QString name;
+		int64 count;
+		std::vector< Property > properties;
+	};
+
+	// an empty, binary little endian header
+	PLYHeader();
+
+	Format format() const;
+	void setFormat( Format format );
+
+	const QStringList& comments() const;
+	void addComment( QString comment );
+
+	int numElements() const;
+	const Element& element( int elementIndex ) const;
+	const std::vector< Element >& elements() const;
+
+	// returns -1 if not found
+	int findElement( QString name ) const;
+	int findProperty( int elementIndex, QString name ) const;
+
+	// appends an element with no properties
+	void addElement( QString name, int64 count );
+
+	// appends a property to the last element
+	void addProperty( QString name, Type type );
+	void addListProperty( QString name, Type countType, Type valueType );
+
+	// the number of bytes of one instance of the element in a binary file
+	// or -1 if it has a list property, and therefore a variable size
+	int64 fixedInstanceSize( int elementIndex ) const;
+
+	// parses the header at the beginning of [begin, end)
+	// on success, *pDataOffset is set to the offset of the first byte of the body
+	// returns false (and prints an error) if it's malformed
+	bool parse( const char* begin, const char* end, int64* pDataOffset );
+
+	// the header as it is written to a file, through "end_header\n"
+	QByteArray toByteArray() const;
+
+	// size in bytes of a value of type
+	static int typeSize( Type type );
+
+	// the canonical (PLY 1.0) name of type
+	static const char* typeName( Type type );
+
+	// accepts both the original names ("uchar") and the sized ones ("uint8")
+	// returns INVALID_TYPE if name is not a type
+	static Type typeFromName( const QString& name );
+
+	// whether type is an integer type
+	static bool isInteger( Type type );
+
+private:
+
+	Format m_format;
+	QStringList m_comments;
+	std::vector< Element > m_elements;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <QString>
+
+#include "common/BasicTypes.h"
+#include "io/MappedFile.h"
+#include "io/PLYHeader.h"
+
+class PointCloud;
+class TriangleMesh;
+
+// Reads Stanford PLY files: ascii, binary little endian and binary big endian
+//
+// The file is memory mapped and each element is decoded in bulk:
+// the caller names the properties it wants and where to put them,
+// and every instance of the element is decoded in one pass
+// (in parallel, for binary elements without list properties;
+// binary elements with lists are walked once to size the list targets,
+// then decoded straight into them)
+// Properties that are not requested are skipped
+class PLYReader
+{
+public:
+
+	// one scalar property of every instance of an element, converted to float
+	// instance i is written to output[ i * stride ]
+	struct ScalarTarget
+	{
+		ScalarTarget( QString propertyName, float* output, int stride = 1 );
+
+		QString propertyName;
+		float* output;
+		int stride; // in floats
+	};
+
+	// one list property of every instance of an element
+	// the list lengths are appended to counts
+	// and the values, concatenated, to values
+	struct ListTarget
+	{
+		ListTarget( QString propertyName, std::vector< int >* counts, std::vector< int >* values );
+
+		QString propertyName;
+		std::vector< int >* counts;
+		std::vector< int >* values;
+	};
+
+	// ----- Meshes and point clouds -----
+
+	// reads element "vertex" (x, y, z and optionally nx, ny, nz)
+	// and element "face" (list vertex_indices or vertex_index), fan triangulating polygons
+	// if there are no normals, mesh.m_normals is filled with zeros
+	static bool readTriangleMesh( QString filename, TriangleMesh& mesh );
+
+	// reads element "vertex": x, y, z and optionally nx, ny, nz and red, green, blue
+	// integer colors are normalized to [0,1]
+	static bool readPointCloud( QString filename, PointCloud& cloud );
+
+	// ----- Generic elements -----
+
+	PLYReader();
+
+	// maps filename and parses its header
+	// returns false (and prints an error) if it's not a valid PLY file
+	bool open( QString filename );
+	void close();
+	bool isOpen() const;
+
+	const PLYHeader& header() const;
+
+	// decodes every instance of element elementIndex into the targets
+	// a target naming a property that doesn't exist, or whose kind
+	// (scalar vs. list) doesn't match, is an error
+	// returns false (and prints an error) if the element is truncated or malformed
+	bool readElement( int elementIndex,
+		const std::vector< ScalarTarget >& scalars,
+		const std::vector< ListTarget >& lists = std::vector< ListTarget >() );
+
+private:
+
+	// not copyable
+	PLYReader( const PLYReader& copy );
+	PLYReader& operator = ( const PLYReader& copy );
+
+	// the offset of the first byte of element elementIndex
+	// if it's not known, the elements before it are skipped over
+	// returns -1 if the file is truncated
+	int64 elementOffset( int elementIndex );
+
+	// decodes element elementIndex starting at offset
+	// with the output (or nullptr) of each property
+	// returns the offset just past its end, or -1 on an error
+	int64 readBinaryElement( int elementIndex, int64 offset,
+		const std::vector< const ScalarTarget* >& scalarTargets,
+		const std::vector< const ListTarget* >& listTargets );
+
+	int64 readASCIIElement( int elementIndex, int64 offset,
+		const std::vector< const ScalarTarget* >& scalarTargets,
+		const std::vector< const ListTarget* >& listTargets );
+
+	MappedFile m_file;
+	PLYHeader m_header;
+	bool m_swapBytes;
+
+	// the offset of each element in the file, -1 if not yet known
+	std::vector< int64 > m_elementOffsets;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+#include <QString>
+
+#include "common/BasicTypes.h"
+#include "io/PLYHeader.h"
+
+class PointCloud;
+class TriangleMesh;
+
+// Writes Stanford PLY files: ascii, binary little endian and binary big endian
+//
+// The header is written first, then each element in header order
+// Each element is written in bulk from caller arrays, one per property,
+// and the encoded bytes are streamed through a large buffer
+// Binary elements are encoded a property at a time over blocks of instances,
+// with the conversion for each property's type chosen once per block
+class PLYWriter
+{
+public:
+
+	// one scalar property of every instance of an element
+	// instance i is read from input[ i * stride ]
+	// integer properties are rounded and clamped to the range of their type
+	struct ScalarSource
+	{
+		ScalarSource( QString propertyName, const float* input, int stride = 1 );
+
+		QString propertyName;
+		const float* input;
+		int stride; // in floats
+	};
+
+	// one list property of every instance of an element
+	// instance i has counts[ i ] values (or fixedCount values if counts is nullptr)
+	// taken consecutively from values
+	struct ListSource
+	{
+		ListSource( QString propertyName, const int* counts, const int* values );
+		ListSource( QString propertyName, int fixedCount, const int* values );
+
+		QString propertyName;
+		const int* counts;
+		int fixedCount;
+		const int* values;
+	};
+
+	// ----- Meshes and point clouds -----
+
+	// writes element "vertex" (x, y, z and nx, ny, nz if the mesh has a normal per vertex)
+	// and element "face" (list uchar int vertex_indices)
+	static bool writeTriangleMesh( QString filename, const TriangleMesh& mesh,
+		PLYHeader::Format format = PLYHeader::BINARY_LITTLE_ENDIAN );
+
+	// writes element "vertex": x, y, z, then nx, ny, nz and uchar red, green, blue
+	// if the cloud has them
+	static bool writePointCloud( QString filename, const PointCloud& cloud,
+		PLYHeader::Format format = PLYHeader::BINARY_LITTLE_ENDIAN );
+
+	// ----- Generic elements -----
+
+	PLYWriter();
+	virtual ~PLYWriter();
+
+	// creates filename and writes header
+	bool open( QString filename, const PLYHeader& header );
+
+	// flushes and closes the file
+	// returns false if any write failed or an element was not written
+	bool close();
+
+	// writes every instance of the next element, which must be elementIndex
+	// properties without a source are written as 0 (or an empty list)
+	bool writeElement( int elementIndex,
+		const std::vector< ScalarSource >& scalars,
+		const std::vector< ListSource >& lists = std::vector< ListSource >() );
+
+private:
+
+	// not copyable
+	PLYWriter( const PLYWriter& copy );
+	PLYWriter& operator = ( const PLYWriter& copy );
+
+	// encodes every instance of a binary element a property at a time,
+	// in blocks of instances, straight into the buffer
+	// listValues is the next value of each list source
+	void writeBinaryInstances( int elementIndex,
+		const std::vector< const ScalarSource* >& scalarSources,
+		const std::vector< const ListSource* >& listSources,
+		std::vector< const int* >& listValues );
+
+	// appends value to the buffer as ascii text of type
+	// (preceded by a space unless it's the first on the line)
+	void writeValue( double value, PLYHeader::Type type, bool firstOnLine );
+
+	// writes out the buffer if it's fuller than the threshold
+	void flushIfFull();
+	void flush();
+
+	FILE* m_pFilePointer;
+	PLYHeader m_header;
+	bool m_swapBytes;
+	int m_nextElement;
+	bool m_failed;
+
+	std::vector< char > m_buffer;
+};
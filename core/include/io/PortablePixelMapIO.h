@@ -1,35 +1,121 @@
 #pragma once
 
 #include <common/BasicTypes.h>
+#include "io/ByteOrder.h"
 
+class Image1f;
+class Image4f;
 class Vector3f;
 class QString;
 
+// Binary netpbm and PFM images
+//
+// Reads and writes:
+//   P5 (PGM) and P6 (PPM) with 8 or 16 bits per sample (16-bit samples are big endian)
+//   Pf (1-component PFM), PF (3-component PFM)
+//   and the *non-standard* PF4 (4-component PFM)
+//   PFM samples are 32-bit floats in the byte order given by the sign of the scale
+//
+// Files are memory mapped and rows are decoded in parallel
+// straight into the destination image
+// PFM rows are stored bottom-up, like Image4f and Image1f, and are copied as is
+// netpbm rows are stored top-down and are flipped
 class PortablePixelMapIO
 {
 public:
 
+	enum Format
+	{
+		PGM, // P5
+		PPM, // P6
+		PFM_GRAY, // Pf
+		PFM_RGB, // PF
+		PFM_RGBA // PF4
+	};
+
+	struct Header
+	{
+		Header();
+
+		// 1, 3 or 4
+		int numComponents() const;
+
+		// 1 or 2 for netpbm, 4 for PFM
+		int bytesPerSample() const;
+
+		int64 bytesPerRow() const;
+
+		bool isPFM() const;
+
+		Format format;
+		int width;
+		int height;
+
+		// netpbm: the largest sample value, in [1, 65535]
+		int maxValue;
+
+		// PFM: the absolute value of the scale and the byte order given by its sign
+		float scale;
+		ByteOrder::Order byteOrder;
+
+		// the size of the header, where the samples start
+		int64 dataOffset;
+	};
+
+	// parses the header at the beginning of [begin, end)
+	// returns false if it's malformed or the samples don't fit in [begin, end)
+	static bool parseHeader( const char* begin, const char* end, Header& header );
+
+	// reads any of the formats:
+	// gray is replicated into RGB and a missing alpha is 1
+	// netpbm samples are normalized to [0,1]
+	static bool read( QString filename, Image4f& image );
+
+	// reads P5 or Pf
+	static bool read( QString filename, Image1f& image );
+
+	// writes the RGB of image as P6, clamped to [0,1] and rescaled to [0, maxValue]
+	// maxValue > 255 writes 16 bits per sample
+	static bool writePPM( QString filename, const Image4f& image, int maxValue = 255 );
+
+	// writes image as P5, clamped to [0,1] and rescaled to [0, maxValue]
+	static bool writePGM( QString filename, const Image1f& image, int maxValue = 255 );
+
+	// writes image as PF, or PF4 if includeAlpha is true
+	static bool writePFM( QString filename, const Image4f& image, bool includeAlpha = false,
+		ByteOrder::Order byteOrder = ByteOrder::LITTLE );
+
+	// writes image as Pf
+	static bool writePFM( QString filename, const Image1f& image,
+		ByteOrder::Order byteOrder = ByteOrder::LITTLE );
+
 	// TODO: text vs binary
 	// TODO: stride to skip alpha channel
 
-	/*
-	// scale > 0 is big endian, < 0 is little endian
-	static bool writeRGB( QString filename,
-		Vector3f* avRGB,
-		int width, int height,
-		float scale = -1.0f );
-		*/
-
-	// set yAxisPointsUp to true if the *input array* is in OpenGL order	
+	// set yAxisPointsUp to true if the *input array* is in OpenGL order
 	static bool writeRGB( QString filename,
 		ubyte* aubRGBArray,
-		int width, int height,		
+		int width, int height,
 		bool yAxisPointsUp = false );
 
 	// set yAxisPointsUp to true if the *input array* is in OpenGL order
 	// the float values are clamped to [0,1] and rescaled to [0,255]
 	static bool writeRGB( QString filename,
 		float* afRGBArray,
-		int width, int height,		
+		int width, int height,
 		bool yAxisPointsUp = false );
+
+private:
+
+	// decodes all the rows of the file starting at data
+	// into nDestinationComponents (1 or 4) floats per pixel
+	// header.numComponents() must be 1 or nDestinationComponents must be 4
+	static void readPixels( const ubyte* data, const Header& header,
+		float* destination, int nDestinationComponents );
+
+	// writes the header and rows of samples
+	// each row is fetched with getRow( fileRow, rowBuffer )
+	// which returns a pointer to bytesPerRow bytes in the host byte order
+	template< typename GetRow >
+	static bool writeRows( QString filename, const Header& header, GetRow getRow );
 };
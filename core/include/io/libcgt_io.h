@@ -1,11 +1,20 @@
 #ifndef LIBCGT_IO_H
 #define LIBCGT_IO_H
 
+#include "ByteOrder.h"
 #include "FileReader.h"
+#include "MappedFile.h"
+#include "MeshCacheFile.h"
+#include "NumberFormatter.h"
+#include "NumberParser.h"
 #include "OBJData.h"
 #include "OBJFace.h"
 #include "OBJGroup.h"
+#include "OBJWriter.h"
 #include "OpenEXRIO.h"
+#include "PLYHeader.h"
+#include "PLYReader.h"
+#include "PLYWriter.h"
 #include "PortableFloatMapIO.h"
 #include "PortablePixelMapIO.h"
 
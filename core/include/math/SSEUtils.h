@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+
+#include <emmintrin.h>
+
+// SSE2 helpers shared by the 4-wide ray code (RayBatch, TriangleMeshBVH)
+class SSEUtils
+{
+public:
+
+	// per lane, mask ? a : b
+	// each lane of mask is all ones or all zeros (e.g., the result of a comparison)
+	static inline __m128 select( __m128 mask, __m128 a, __m128 b );
+
+	// values[ first, first + nLanes ), nLanes <= 4, padded with zeros
+	static inline __m128 loadLanes( const std::vector< float >& values, int first, int nLanes );
+};
+
+#include "SSEUtils.inl"
@@ -0,0 +1,23 @@
+#pragma once
+
+// static
+inline __m128 SSEUtils::select( __m128 mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+// static
+inline __m128 SSEUtils::loadLanes( const std::vector< float >& values, int first, int nLanes )
+{
+	if( nLanes == 4 )
+	{
+		return _mm_loadu_ps( &( values[ first ] ) );
+	}
+
+	float lanes[ 4 ] = { 0, 0, 0, 0 };
+	for( int i = 0; i < nLanes; ++i )
+	{
+		lanes[ i ] = values[ first + i ];
+	}
+	return _mm_loadu_ps( lanes );
+}
@@ -0,0 +1,117 @@
+#include "common/ConcurrentUnionFind.h"
+
+#include <algorithm>
+
+#include <intrin.h>
+#include <ppl.h>
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+ConcurrentUnionFind::ConcurrentUnionFind( int n )
+{
+	reset( n );
+}
+
+void ConcurrentUnionFind::reset( int n )
+{
+	m_parents.resize( n );
+	for( int i = 0; i < n; ++i )
+	{
+		m_parents[ i ] = i;
+	}
+}
+
+int ConcurrentUnionFind::size() const
+{
+	return static_cast< int >( m_parents.size() );
+}
+
+int ConcurrentUnionFind::find( int i )
+{
+	volatile long* p = parents();
+	for( ;; )
+	{
+		long parent = p[ i ];
+		if( parent == i )
+		{
+			return i;
+		}
+
+		// path halving: point i at its grandparent
+		// (if another thread already moved it, that's just as good)
+		long grandparent = p[ parent ];
+		if( grandparent != parent )
+		{
+			_InterlockedCompareExchange( &( p[ i ] ), grandparent, parent );
+		}
+		i = grandparent;
+	}
+}
+
+bool ConcurrentUnionFind::unite( int i, int j )
+{
+	volatile long* p = parents();
+	for( ;; )
+	{
+		i = find( i );
+		j = find( j );
+		if( i == j )
+		{
+			return false;
+		}
+
+		// link the larger root under the smaller,
+		// if it's still a root
+		if( i < j )
+		{
+			std::swap( i, j );
+		}
+		if( _InterlockedCompareExchange( &( p[ i ] ), j, i ) == i )
+		{
+			return true;
+		}
+	}
+}
+
+bool ConcurrentUnionFind::sameSet( int i, int j )
+{
+	return( find( i ) == find( j ) );
+}
+
+int ConcurrentUnionFind::labelSets( std::vector< int >& labels )
+{
+	int n = size();
+	labels.resize( n );
+	Concurrency::parallel_for( 0, n, [&]( int i )
+	{
+		labels[ i ] = find( i );
+	} );
+
+	// roots are the smallest elements of their sets,
+	// so each root is labeled before the rest of its set
+	int nSets = 0;
+	for( int i = 0; i < n; ++i )
+	{
+		if( labels[ i ] == i )
+		{
+			labels[ i ] = nSets;
+			++nSets;
+		}
+		else
+		{
+			labels[ i ] = labels[ labels[ i ] ];
+		}
+	}
+	return nSets;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+volatile long* ConcurrentUnionFind::parents()
+{
+	return m_parents.empty() ? nullptr : &( m_parents[ 0 ] );
+}
@@ -0,0 +1,7 @@
+#include "common/ParallelSort.h"
+
+// static
+const int ParallelSort::MIN_CHUNK_SIZE = 16384;
+
+// static
+const int ParallelSort::MAX_CHUNKS = 64;
@@ -0,0 +1,51 @@
+#include "geometry/BoundingBoxBatch.h"
+
+BoundingBoxBatch::BoundingBoxBatch( int nBoxes )
+{
+	resize( nBoxes );
+}
+
+BoundingBoxBatch::BoundingBoxBatch( const std::vector< BoundingBox3f >& boxes )
+{
+	int n = static_cast< int >( boxes.size() );
+	resize( n );
+	for( int i = 0; i < n; ++i )
+	{
+		setBox( i, boxes[ i ] );
+	}
+}
+
+int BoundingBoxBatch::size() const
+{
+	return static_cast< int >( minX.size() );
+}
+
+void BoundingBoxBatch::resize( int nBoxes )
+{
+	minX.resize( nBoxes, 0.f );
+	minY.resize( nBoxes, 0.f );
+	minZ.resize( nBoxes, 0.f );
+
+	maxX.resize( nBoxes, 0.f );
+	maxY.resize( nBoxes, 0.f );
+	maxZ.resize( nBoxes, 0.f );
+}
+
+BoundingBox3f BoundingBoxBatch::box( int i ) const
+{
+	return BoundingBox3f( minX[ i ], minY[ i ], minZ[ i ], maxX[ i ], maxY[ i ], maxZ[ i ] );
+}
+
+void BoundingBoxBatch::setBox( int i, const BoundingBox3f& box )
+{
+	Vector3f minimum = box.minimum();
+	Vector3f maximum = box.maximum();
+
+	minX[ i ] = minimum.x;
+	minY[ i ] = minimum.y;
+	minZ[ i ] = minimum.z;
+
+	maxX[ i ] = maximum.x;
+	maxY[ i ] = maximum.y;
+	maxZ[ i ] = maximum.z;
+}
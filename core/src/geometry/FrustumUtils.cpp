@@ -1,65 +1,360 @@
 #include "geometry/FrustumUtils.h"
 
+#include <algorithm>
+#include <utility>
+
+#include <emmintrin.h>
+#include <ppl.h>
+
+#include "geometry/BoundingBoxBatch.h"
+#include "geometry/Sphere.h"
+
+struct FrustumUtils::PlaneSet
+{
+	PlaneSet( const Plane3f planes[ 6 ] )
+	{
+		for( int p = 0; p < 6; ++p )
+		{
+			a[ p ] = planes[ p ].a;
+			b[ p ] = planes[ p ].b;
+			c[ p ] = planes[ p ].c;
+			d[ p ] = planes[ p ].d;
+			norm[ p ] = planes[ p ].normal().norm();
+		}
+	}
+
+	float a[ 6 ];
+	float b[ 6 ];
+	float c[ 6 ];
+	float d[ 6 ];
+
+	// the length of each normal: a*x + b*y + c*z + d is the distance times this
+	float norm[ 6 ];
+};
+
+// static
+const int FrustumUtils::CULL_BLOCK_SIZE = 4096;
+
 // static
 FrustumUtils::IntersectionResult FrustumUtils::intersectBoundingBox( const BoundingBox3f& box, Plane3f planes[ 6 ] )
 {
-	auto boxCorners = box.corners();
+	int straddledPlanes;
+	return intersectBoundingBox( PlaneSet( planes ), box.minimum(), box.maximum(),
+		0x3f, &straddledPlanes );
+}
+
+// static
+void FrustumUtils::intersectBoundingBoxes( const BoundingBoxBatch& boxes, const Plane3f planes[ 6 ],
+	std::vector< uint8 >& results )
+{
+	PlaneSet planeSet( planes );
+	int n = boxes.size();
+	int nBlocks = ( n + CULL_BLOCK_SIZE - 1 ) / CULL_BLOCK_SIZE;
+	results.resize( n );
+
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		int begin = b * CULL_BLOCK_SIZE;
+		int end = std::min( begin + CULL_BLOCK_SIZE, n );
+		intersectBoundingBoxes( planeSet, boxes, begin, end, &( results[ begin ] ) );
+	} );
+}
+
+// static
+int FrustumUtils::cullBoundingBoxes( const BoundingBoxBatch& boxes, const Plane3f planes[ 6 ],
+	std::vector< int >& visibleIndices )
+{
+	PlaneSet planeSet( planes );
+	int n = boxes.size();
+	int nBlocks = ( n + CULL_BLOCK_SIZE - 1 ) / CULL_BLOCK_SIZE;
+
+	// each block compacts its visible boxes, then they're concatenated in order
+	std::vector< std::vector< int > > blockVisible( nBlocks );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		int begin = b * CULL_BLOCK_SIZE;
+		int end = std::min( begin + CULL_BLOCK_SIZE, n );
+
+		std::vector< uint8 > results( end - begin );
+		intersectBoundingBoxes( planeSet, boxes, begin, end, &( results[ 0 ] ) );
+
+		std::vector< int >& visible = blockVisible[ b ];
+		for( int i = begin; i < end; ++i )
+		{
+			if( results[ i - begin ] != OUTSIDE )
+			{
+				visible.push_back( i );
+			}
+		}
+	} );
+
+	visibleIndices.clear();
+	for( int b = 0; b < nBlocks; ++b )
+	{
+		visibleIndices.insert( visibleIndices.end(), blockVisible[ b ].begin(), blockVisible[ b ].end() );
+	}
+	return static_cast< int >( visibleIndices.size() );
+}
+
+// static
+int FrustumUtils::cullSpheres( const std::vector< Sphere >& spheres, const Plane3f planes[ 6 ],
+	std::vector< int >& visibleIndices )
+{
+	PlaneSet planeSet( planes );
+	int n = static_cast< int >( spheres.size() );
+	int nBlocks = ( n + CULL_BLOCK_SIZE - 1 ) / CULL_BLOCK_SIZE;
+
+	// a sphere is outside a plane if its center is at least its radius in front of it
+	auto isOutside = [&]( const Sphere& sphere ) -> bool
+	{
+		for( int p = 0; p < 6; ++p )
+		{
+			float d = planeSet.a[ p ] * sphere.center.x + planeSet.b[ p ] * sphere.center.y +
+				planeSet.c[ p ] * sphere.center.z + planeSet.d[ p ];
+			if( d >= sphere.radius * planeSet.norm[ p ] )
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	std::vector< std::vector< int > > blockVisible( nBlocks );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		int begin = b * CULL_BLOCK_SIZE;
+		int end = std::min( begin + CULL_BLOCK_SIZE, n );
+		std::vector< int >& visible = blockVisible[ b ];
+
+		int i = begin;
+		for( ; i + 4 <= end; i += 4 )
+		{
+			const Sphere& s0 = spheres[ i ];
+			const Sphere& s1 = spheres[ i + 1 ];
+			const Sphere& s2 = spheres[ i + 2 ];
+			const Sphere& s3 = spheres[ i + 3 ];
+			__m128 x = _mm_setr_ps( s0.center.x, s1.center.x, s2.center.x, s3.center.x );
+			__m128 y = _mm_setr_ps( s0.center.y, s1.center.y, s2.center.y, s3.center.y );
+			__m128 z = _mm_setr_ps( s0.center.z, s1.center.z, s2.center.z, s3.center.z );
+			__m128 radius = _mm_setr_ps( s0.radius, s1.radius, s2.radius, s3.radius );
+
+			__m128 outside = _mm_setzero_ps();
+			for( int p = 0; p < 6; ++p )
+			{
+				__m128 d = _mm_add_ps( _mm_add_ps( _mm_add_ps(
+					_mm_mul_ps( _mm_set1_ps( planeSet.a[ p ] ), x ),
+					_mm_mul_ps( _mm_set1_ps( planeSet.b[ p ] ), y ) ),
+					_mm_mul_ps( _mm_set1_ps( planeSet.c[ p ] ), z ) ),
+					_mm_set1_ps( planeSet.d[ p ] ) );
+				outside = _mm_or_ps( outside,
+					_mm_cmpge_ps( d, _mm_mul_ps( radius, _mm_set1_ps( planeSet.norm[ p ] ) ) ) );
+			}
+
+			int visibleBits = ~_mm_movemask_ps( outside ) & 0xf;
+			for( int k = 0; k < 4; ++k )
+			{
+				if( visibleBits & ( 1 << k ) )
+				{
+					visible.push_back( i + k );
+				}
+			}
+		}
+
+		for( ; i < end; ++i )
+		{
+			if( !isOutside( spheres[ i ] ) )
+			{
+				visible.push_back( i );
+			}
+		}
+	} );
 
-	// by default, we assume the box is completely inside
-	IntersectionResult result = INSIDE;
+	visibleIndices.clear();
+	for( int b = 0; b < nBlocks; ++b )
+	{
+		visibleIndices.insert( visibleIndices.end(), blockVisible[ b ].begin(), blockVisible[ b ].end() );
+	}
+	return static_cast< int >( visibleIndices.size() );
+}
 
-	// and keep track, for each corner of the box
-	// how many vertices are inside vs outside
-	int nVerticesInside;
-	int nVerticesOutside;
+// static
+int FrustumUtils::cullHierarchy( const BoundingBoxBatch& nodeBoxes, const std::vector< int >& subtreeEnds,
+	const Plane3f planes[ 6 ], std::vector< int >& visibleLeaves )
+{
+	PlaneSet planeSet( planes );
+	int nNodes = nodeBoxes.size();
+	visibleLeaves.clear();
 
-	// for each plane do ...
-	for( int i = 0; i < 6; ++i )
+	// the subtrees being descended: their ends, and the planes their roots straddle
+	std::vector< std::pair< int, int > > stack;
+
+	int i = 0;
+	while( i < nNodes )
 	{
-		// reset counters for corners nVerticesInside and nVerticesOutside
-		nVerticesInside = 0;
-		nVerticesOutside = 0;
-
-		// for each corner of the box do ...
-		// get nVerticesOutside of the cycle as soon as a box as corners
-		// both inside and nVerticesOutside of the frustum
-		for( int k = 0; k < 8 && ( nVerticesInside == 0 || nVerticesOutside == 0 ); k++ )
+		while( !stack.empty() && stack.back().first <= i )
+		{
+			stack.pop_back();
+		}
+		int planeMask = stack.empty() ? 0x3f : stack.back().second;
+		int end = subtreeEnds[ i ];
+
+		int straddledPlanes;
+		IntersectionResult result = intersectBoundingBox( planeSet,
+			Vector3f( nodeBoxes.minX[ i ], nodeBoxes.minY[ i ], nodeBoxes.minZ[ i ] ),
+			Vector3f( nodeBoxes.maxX[ i ], nodeBoxes.maxY[ i ], nodeBoxes.maxZ[ i ] ),
+			planeMask, &straddledPlanes );
+
+		if( result == OUTSIDE )
+		{
+			i = end;
+		}
+		else if( result == INSIDE )
 		{
-			// is the corner inside or outside?
-			float d = planes[ i ].distance( boxCorners[ k ] );
-			if( d < 0 )
+			for( int j = i; j < end; ++j )
 			{
-				++nVerticesInside;
+				if( subtreeEnds[ j ] == j + 1 )
+				{
+					visibleLeaves.push_back( j );
+				}
+			}
+			i = end;
+		}
+		else
+		{
+			if( end == i + 1 )
+			{
+				visibleLeaves.push_back( i );
 			}
 			else
 			{
-				++nVerticesOutside;
+				stack.push_back( std::make_pair( end, straddledPlanes ) );
 			}
+			++i;
 		}
+	}
+
+	return static_cast< int >( visibleLeaves.size() );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
 
-		// if none of the box corners are on the inside halfspace
-		// then it's guaranteed to be outside, done
-		if( nVerticesInside == 0 )
+// static
+FrustumUtils::IntersectionResult FrustumUtils::intersectBoundingBox( const PlaneSet& planes,
+	const Vector3f& minimum, const Vector3f& maximum,
+	int planeMask, int* straddledPlanes )
+{
+	int straddled = 0;
+	for( int p = 0; p < 6; ++p )
+	{
+		if( ( planeMask & ( 1 << p ) ) == 0 )
+		{
+			continue;
+		}
+
+		// the corner of the box farthest behind the plane
+		// (on the inside) and the one farthest in front
+		float nearX = ( planes.a[ p ] > 0 ) ? minimum.x : maximum.x;
+		float nearY = ( planes.b[ p ] > 0 ) ? minimum.y : maximum.y;
+		float nearZ = ( planes.c[ p ] > 0 ) ? minimum.z : maximum.z;
+		float farX = ( planes.a[ p ] > 0 ) ? maximum.x : minimum.x;
+		float farY = ( planes.b[ p ] > 0 ) ? maximum.y : minimum.y;
+		float farZ = ( planes.c[ p ] > 0 ) ? maximum.z : minimum.z;
+
+		// if even the nearest corner isn't inside, none of them are
+		float dNear = planes.a[ p ] * nearX + planes.b[ p ] * nearY + planes.c[ p ] * nearZ + planes.d[ p ];
+		if( dNear >= 0 )
 		{
 			return OUTSIDE;
 		}
-		// otherwise, at least some of them are inside
-		// but if some of them are *also* outside
-		// then we know for now that it intersects this plane
-		// (but it's not guaranteed to actually intersect the entire frustum)
-		else if( nVerticesOutside != 0 )
+
+		// if the farthest corner is outside, the box straddles the plane
+		float dFar = planes.a[ p ] * farX + planes.b[ p ] * farY + planes.c[ p ] * farZ + planes.d[ p ];
+		if( dFar >= 0 )
 		{
-			result = INTERESECTING;
+			straddled |= ( 1 << p );
 		}
-		// otherwise, we know that some vertices are inside
-		// and none are outside
-		// --> this box is completely inside (for this plane anyway)
-		else
+	}
+
+	*straddledPlanes = straddled;
+	return( straddled != 0 ) ? INTERESECTING : INSIDE;
+}
+
+// static
+void FrustumUtils::intersectBoundingBoxes( const PlaneSet& planes, const BoundingBoxBatch& boxes,
+	int begin, int end, uint8* results )
+{
+	__m128 zero = _mm_setzero_ps();
+
+	int i = begin;
+	for( ; i + 4 <= end; i += 4 )
+	{
+		__m128 minimum[ 3 ];
+		__m128 maximum[ 3 ];
+		minimum[ 0 ] = _mm_loadu_ps( &( boxes.minX[ i ] ) );
+		minimum[ 1 ] = _mm_loadu_ps( &( boxes.minY[ i ] ) );
+		minimum[ 2 ] = _mm_loadu_ps( &( boxes.minZ[ i ] ) );
+		maximum[ 0 ] = _mm_loadu_ps( &( boxes.maxX[ i ] ) );
+		maximum[ 1 ] = _mm_loadu_ps( &( boxes.maxY[ i ] ) );
+		maximum[ 2 ] = _mm_loadu_ps( &( boxes.maxZ[ i ] ) );
+
+		// which corner is nearest depends only on the plane,
+		// so it's the same for all 4 boxes
+		__m128 outside = zero;
+		__m128 straddles = zero;
+		for( int p = 0; p < 6; ++p )
+		{
+			const __m128* nearX = ( planes.a[ p ] > 0 ) ? minimum : maximum;
+			const __m128* nearY = ( planes.b[ p ] > 0 ) ? minimum : maximum;
+			const __m128* nearZ = ( planes.c[ p ] > 0 ) ? minimum : maximum;
+			const __m128* farX = ( planes.a[ p ] > 0 ) ? maximum : minimum;
+			const __m128* farY = ( planes.b[ p ] > 0 ) ? maximum : minimum;
+			const __m128* farZ = ( planes.c[ p ] > 0 ) ? maximum : minimum;
+
+			__m128 a = _mm_set1_ps( planes.a[ p ] );
+			__m128 b = _mm_set1_ps( planes.b[ p ] );
+			__m128 c = _mm_set1_ps( planes.c[ p ] );
+			__m128 d = _mm_set1_ps( planes.d[ p ] );
+
+			__m128 dNear = _mm_add_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( a, nearX[ 0 ] ), _mm_mul_ps( b, nearY[ 1 ] ) ),
+				_mm_mul_ps( c, nearZ[ 2 ] ) ), d );
+			__m128 dFar = _mm_add_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( a, farX[ 0 ] ), _mm_mul_ps( b, farY[ 1 ] ) ),
+				_mm_mul_ps( c, farZ[ 2 ] ) ), d );
+
+			outside = _mm_or_ps( outside, _mm_cmpge_ps( dNear, zero ) );
+			straddles = _mm_or_ps( straddles, _mm_cmpge_ps( dFar, zero ) );
+		}
+
+		int outsideBits = _mm_movemask_ps( outside );
+		int straddleBits = _mm_movemask_ps( straddles );
+		for( int k = 0; k < 4; ++k )
 		{
-			assert( nVerticesInside == 8 );
-			assert( nVerticesOutside == 0 );
+			uint8 result;
+			if( outsideBits & ( 1 << k ) )
+			{
+				result = OUTSIDE;
+			}
+			else if( straddleBits & ( 1 << k ) )
+			{
+				result = INTERESECTING;
+			}
+			else
+			{
+				result = INSIDE;
+			}
+			results[ i + k - begin ] = result;
 		}
 	}
 
-	return result;
+	for( ; i < end; ++i )
+	{
+		int straddledPlanes;
+		results[ i - begin ] = static_cast< uint8 >( intersectBoundingBox( planes,
+			Vector3f( boxes.minX[ i ], boxes.minY[ i ], boxes.minZ[ i ] ),
+			Vector3f( boxes.maxX[ i ], boxes.maxY[ i ], boxes.maxZ[ i ] ),
+			0x3f, &straddledPlanes ) );
+	}
 }
@@ -380,6 +380,64 @@ Vector2f GeometryUtils::closestPointOnTriangle( const Vector2f& p, const Vector2
 	}
 }
 
+// static
+Vector3f GeometryUtils::closestPointOnTriangle( const Vector3f& p, const Vector3f& v0, const Vector3f& v1, const Vector3f& v2 )
+{
+	// finds the Voronoi region of p among the vertices, edges and face (Ericson 2005, 5.1.5)
+	Vector3f e01 = v1 - v0;
+	Vector3f e02 = v2 - v0;
+
+	Vector3f p0 = p - v0;
+	float d1 = Vector3f::dot( e01, p0 );
+	float d2 = Vector3f::dot( e02, p0 );
+	if( d1 <= 0 && d2 <= 0 )
+	{
+		return v0;
+	}
+
+	Vector3f p1 = p - v1;
+	float d3 = Vector3f::dot( e01, p1 );
+	float d4 = Vector3f::dot( e02, p1 );
+	if( d3 >= 0 && d4 <= d3 )
+	{
+		return v1;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+	if( vc <= 0 && d1 >= 0 && d3 <= 0 )
+	{
+		return v0 + ( d1 / ( d1 - d3 ) ) * e01;
+	}
+
+	Vector3f p2 = p - v2;
+	float d5 = Vector3f::dot( e01, p2 );
+	float d6 = Vector3f::dot( e02, p2 );
+	if( d6 >= 0 && d5 <= d6 )
+	{
+		return v2;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+	if( vb <= 0 && d2 >= 0 && d6 <= 0 )
+	{
+		return v0 + ( d2 / ( d2 - d6 ) ) * e02;
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if( va <= 0 && ( d4 - d3 ) >= 0 && ( d5 - d6 ) >= 0 )
+	{
+		return v1 + ( ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) ) ) * ( v2 - v1 );
+	}
+
+	float sum = va + vb + vc;
+	if( !( sum > 0 ) )
+	{
+		// degenerate
+		return v0;
+	}
+	return v0 + ( vb / sum ) * e01 + ( vc / sum ) * e02;
+}
+
 //static
 //dir1 and dir2 should be normalized
 bool GeometryUtils::rayRayIntersection( const Vector2f& p1, const Vector2f& dir1,
@@ -543,143 +601,57 @@ bool GeometryUtils::rayTriangleIntersection( const Vector3f& rayOrigin, const Ve
 	return true;
 }
 
-#if 0
 // static
-bool GeometryUtils::triangleAABBOverlap( Vector3f* pv0, Vector3f* pv1, Vector3f* pv2,
-										BoundingBox3f* pBox )
+bool GeometryUtils::triangleAABBOverlap( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
+	const BoundingBox3f& box )
 {
-	// use separating axis theorem to test overlap between triangle and box
-	// need to test for overlap in these directions:
-	// 1) the {x,y,z}-directions (actually, since we use the AABB of the triangle
-	//    we do not even need to test these)
-	// 2) normal of the triangle
-	// 3) crossproduct(edge from tri, {x,y,z}-direction)
-	//    this gives 3x3=9 more tests
-
-	Vector3f v0;
-	Vector3f v1;
-	Vector3f v2;
-
-	float min,max,p0,p1,p2,rad;
-
-	float fex;
-	float fey;
-	float fez;
-
-	Vector3f normal;
-	Vector3f e0;
-	Vector3f e1;
-	Vector3f e2;
-
-	Vector3f boxCenter;
-	pBox->getCenter( &boxCenter );
-
-	// move everything so that the box center is in (0,0,0)
-	Vector3f::subtract( pv0, &boxCenter, &v0 );
-	Vector3f::subtract( pv1, &boxCenter, &v1 );
-	Vector3f::subtract( pv2, &boxCenter, &v2 );
-
-	// compute triangle edges
-	Vector3f::subtract( &v1, &v0, &e0 );
-	Vector3f::subtract( &v2, &v1, &e1 );
-	Vector3f::subtract( &v0, &v2, &e2 );
-
-	// Bullet 3:
-	// test the 9 tests first (this was faster)
-
-	fex = fabs( e0[0] );
-	fey = fabs( e0[1] );
-	fez = fabs( e0[2] );
-
-	AXISTEST_X01(e0[Z], e0[Y], fez, fey);
-
-	AXISTEST_Y02(e0[Z], e0[X], fez, fex);
-
-	AXISTEST_Z12(e0[Y], e0[X], fey, fex);
-
-
-
-	fex = fabsf(e1[X]);
-
-	fey = fabsf(e1[Y]);
-
-	fez = fabsf(e1[Z]);
-
-	AXISTEST_X01(e1[Z], e1[Y], fez, fey);
-
-	AXISTEST_Y02(e1[Z], e1[X], fez, fex);
-
-	AXISTEST_Z0(e1[Y], e1[X], fey, fex);
-
+	// separating axis test (Akenine-Moller 2001), with the box centered at the origin
+	// the axes are the box's 3 face normals, the triangle's normal,
+	// and the 9 cross products of the box's and the triangle's edges
+	Vector3f center = box.center();
+	Vector3f halfSize = 0.5f * box.range();
 
+	Vector3f v[ 3 ] = { v0 - center, v1 - center, v2 - center };
+	Vector3f edges[ 3 ] = { v[ 1 ] - v[ 0 ], v[ 2 ] - v[ 1 ], v[ 0 ] - v[ 2 ] };
 
-	fex = fabsf(e2[X]);
-
-	fey = fabsf(e2[Y]);
-
-	fez = fabsf(e2[Z]);
-
-	AXISTEST_X2(e2[Z], e2[Y], fez, fey);
-
-	AXISTEST_Y1(e2[Z], e2[X], fez, fex);
-
-	AXISTEST_Z12(e2[Y], e2[X], fey, fex);
-
-
-
-	/* Bullet 1: */
-
-	/*  first test overlap in the {x,y,z}-directions */
-
-	/*  find min, max of the triangle each direction, and test for overlap in */
-
-	/*  that direction -- this is equivalent to testing a minimal AABB around */
-
-	/*  the triangle against the AABB */
-
-
-
-	/* test in X-direction */
-
-	FINDMINMAX(v0[X],v1[X],v2[X],min,max);
-
-	if(min>boxhalfsize[X] || max<-boxhalfsize[X]) return 0;
-
-
-
-	/* test in Y-direction */
-
-	FINDMINMAX(v0[Y],v1[Y],v2[Y],min,max);
-
-	if(min>boxhalfsize[Y] || max<-boxhalfsize[Y]) return 0;
-
-
-
-	/* test in Z-direction */
-
-	FINDMINMAX(v0[Z],v1[Z],v2[Z],min,max);
-
-	if(min>boxhalfsize[Z] || max<-boxhalfsize[Z]) return 0;
-
-
-
-	/* Bullet 2: */
-
-	/*  test if the box intersects the plane of the triangle */
-
-	/*  compute plane equation of triangle: normal*x+d=0 */
-
-	CROSS(normal,e0,e1);
-
-	// -NJMP- (line removed here)
-
-	if(!planeBoxOverlap(normal,v0,boxhalfsize)) return 0;	// -NJMP-
-
+	// the box's face normals, which is the same as overlapping the triangle's bounding box
+	for( int k = 0; k < 3; ++k )
+	{
+		float triangleMin = std::min( v[ 0 ][ k ], std::min( v[ 1 ][ k ], v[ 2 ][ k ] ) );
+		float triangleMax = std::max( v[ 0 ][ k ], std::max( v[ 1 ][ k ], v[ 2 ][ k ] ) );
+		if( triangleMin > halfSize[ k ] || triangleMax < -halfSize[ k ] )
+		{
+			return false;
+		}
+	}
 
+	// axis k cross each edge
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			Vector3f unitAxis( 0, 0, 0 );
+			unitAxis[ k ] = 1;
+			Vector3f axis = Vector3f::cross( unitAxis, edges[ i ] );
+
+			float p0 = Vector3f::dot( axis, v[ 0 ] );
+			float p1 = Vector3f::dot( axis, v[ 1 ] );
+			float p2 = Vector3f::dot( axis, v[ 2 ] );
+			float radius = halfSize.x * fabs( axis.x ) + halfSize.y * fabs( axis.y ) + halfSize.z * fabs( axis.z );
+			if( std::min( p0, std::min( p1, p2 ) ) > radius ||
+				std::max( p0, std::max( p1, p2 ) ) < -radius )
+			{
+				return false;
+			}
+		}
+	}
 
-	return 1;   /* box and triangle overlaps */
+	// the triangle's plane
+	Vector3f normal = Vector3f::cross( edges[ 0 ], edges[ 1 ] );
+	float radius = halfSize.x * fabs( normal.x ) + halfSize.y * fabs( normal.y ) + halfSize.z * fabs( normal.z );
+	float distance = Vector3f::dot( normal, v[ 0 ] );
+	return( fabs( distance ) <= radius );
 }
-#endif
 
 // static
 float GeometryUtils::triangleInterpolation( float interpolant0, float interpolant1, float interpolant2,
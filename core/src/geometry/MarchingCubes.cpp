@@ -0,0 +1,880 @@
+#include "geometry/MarchingCubes.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include <ppl.h>
+
+#include "common/ParallelSort.h"
+
+namespace
+{
+	// the faces of each cell index, as the cell edges of their vertices, ending with -1
+	// generated by walking the crossed edges on each cell face counterclockwise (seen from outside),
+	// pairing the edge into each run of inside corners with the edge out of it,
+	// and chaining the pairs into loops, triangulated without diagonals across a cell face
+	// (which the neighboring cell could also use)
+	const signed char CELL_FACES[ 256 ][ 16 ] =
+	{
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 8, 6, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 10, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 6, 6, 10, 9, 9, 10, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 1, 1, 9, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 11, 11, 4, 9, 9, 4, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 6, 10, 10, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 10, 10, 6, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 4, 4, 9, 10, 10, 9, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 9, 10, 10, 9, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 8, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 2, 8, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 9, 5, 5, 9, 4, 4, 9, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 4, 2, 8, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 2, 2, 1, 5, 5, 1, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 10, 4, 2, 8, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 6, 6, 10, 9, 9, 10, 2, 2, 10, 5, -1, -1, -1, -1 },
+		{ 1, 6, 11, 2, 8, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 5, 1, 6, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 1, 1, 9, 11, 2, 8, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 11, 11, 4, 9, 9, 4, 2, 2, 4, 5, -1, -1, -1, -1 },
+		{ 2, 8, 5, 4, 6, 10, 10, 6, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 2, 2, 6, 5, 5, 6, 10, 10, 6, 11, -1, -1, -1, -1 },
+		{ 0, 9, 4, 4, 9, 10, 10, 9, 11, 2, 8, 5, -1, -1, -1, -1 },
+		{ 2, 9, 5, 5, 9, 10, 10, 9, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 2, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 6, 6, 2, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 7, 8, 8, 7, 4, 4, 7, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 4, 2, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 10, 2, 7, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 6, 6, 2, 7, 1, 10, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 6, 6, 10, 7, 7, 10, 2, 2, 10, 8, -1, -1, -1, -1 },
+		{ 1, 6, 11, 2, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 11, 2, 7, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 1, 1, 2, 11, 11, 2, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 11, 11, 4, 7, 7, 4, 2, 2, 4, 8, -1, -1, -1, -1 },
+		{ 2, 7, 9, 4, 6, 10, 10, 6, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 10, 10, 6, 11, 2, 7, 9, -1, -1, -1, -1 },
+		{ 0, 2, 4, 4, 2, 10, 10, 2, 11, 11, 2, 7, -1, -1, -1, -1 },
+		{ 2, 7, 8, 8, 7, 10, 10, 7, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 7, 8, 8, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 4, 7, 7, 4, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 6, 6, 8, 7, 7, 8, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 5, 6, 6, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 4, 5, 7, 8, 8, 7, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 9, 1, 7, 7, 1, 5, 5, 1, 10, -1, -1, -1, -1 },
+		{ 0, 8, 6, 6, 8, 7, 7, 8, 5, 1, 10, 4, -1, -1, -1, -1 },
+		{ 1, 10, 6, 6, 10, 7, 7, 10, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 6, 11, 5, 7, 8, 8, 7, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 4, 7, 7, 4, 5, 1, 6, 11, -1, -1, -1, -1 },
+		{ 0, 8, 1, 1, 8, 11, 11, 8, 7, 7, 8, 5, -1, -1, -1, -1 },
+		{ 1, 4, 11, 11, 4, 7, 7, 4, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 6, 10, 10, 6, 11, 5, 7, 8, 8, 7, 9, -1, -1, -1, -1 },
+		{ 0, 5, 9, 9, 5, 7, 0, 6, 5, 5, 6, 10, 10, 6, 11, -1 },
+		{ 0, 11, 4, 4, 11, 10, 0, 8, 11, 11, 8, 7, 7, 8, 5, -1 },
+		{ 5, 7, 10, 10, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 5, 10, 4, 8, 6, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 4, 4, 3, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 5, 5, 1, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 3, 4, 4, 3, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 6, 6, 3, 9, 9, 3, 8, 8, 3, 5, -1, -1, -1, -1 },
+		{ 1, 6, 11, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 11, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 1, 1, 9, 11, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 11, 11, 4, 9, 9, 4, 8, 3, 5, 10, -1, -1, -1, -1 },
+		{ 3, 5, 11, 11, 5, 6, 6, 5, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 5, 5, 6, 3, 3, 6, 11, -1, -1, -1, -1 },
+		{ 0, 9, 4, 4, 9, 5, 5, 9, 3, 3, 9, 11, -1, -1, -1, -1 },
+		{ 3, 5, 11, 11, 5, 9, 9, 5, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 8, 3, 3, 8, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 3, 3, 4, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 2, 8, 3, 3, 8, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 9, 3, 3, 9, 10, 10, 9, 4, 4, 9, 6, -1, -1, -1, -1 },
+		{ 1, 3, 4, 4, 3, 8, 8, 3, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 2, 2, 1, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 3, 4, 4, 3, 8, 8, 3, 2, -1, -1, -1, -1 },
+		{ 1, 3, 6, 6, 3, 9, 9, 3, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 6, 11, 2, 8, 3, 3, 8, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 3, 3, 4, 10, 1, 6, 11, -1, -1, -1, -1 },
+		{ 0, 9, 1, 1, 9, 11, 2, 8, 3, 3, 8, 10, -1, -1, -1, -1 },
+		{ 1, 4, 11, 11, 4, 9, 9, 4, 2, 2, 4, 3, 3, 4, 10, -1 },
+		{ 2, 8, 3, 3, 8, 11, 11, 8, 6, 6, 8, 4, -1, -1, -1, -1 },
+		{ 0, 6, 2, 2, 6, 3, 3, 6, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 4, 4, 3, 8, 8, 3, 2, 4, 9, 3, 3, 9, 11, -1 },
+		{ 2, 9, 3, 3, 9, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 7, 9, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 2, 7, 9, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 6, 6, 2, 7, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 7, 8, 8, 7, 4, 4, 7, 6, 3, 5, 10, -1, -1, -1, -1 },
+		{ 1, 3, 4, 4, 3, 5, 2, 7, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 5, 5, 1, 3, 2, 7, 9, -1, -1, -1, -1 },
+		{ 0, 2, 6, 6, 2, 7, 1, 3, 4, 4, 3, 5, -1, -1, -1, -1 },
+		{ 1, 3, 6, 6, 8, 7, 7, 8, 2, 6, 3, 8, 8, 3, 5, -1 },
+		{ 1, 6, 11, 2, 7, 9, 3, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 11, 2, 7, 9, 3, 5, 10, -1, -1, -1, -1 },
+		{ 0, 2, 1, 1, 2, 11, 11, 2, 7, 3, 5, 10, -1, -1, -1, -1 },
+		{ 1, 4, 11, 11, 4, 7, 7, 4, 2, 2, 4, 8, 3, 5, 10, -1 },
+		{ 2, 7, 9, 3, 5, 11, 11, 5, 6, 6, 5, 4, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 5, 5, 6, 3, 3, 6, 11, 2, 7, 9, -1 },
+		{ 0, 2, 4, 4, 11, 5, 5, 11, 3, 4, 2, 11, 11, 2, 7, -1 },
+		{ 2, 7, 8, 8, 11, 5, 5, 11, 3, 8, 7, 11, -1, -1, -1, -1 },
+		{ 3, 7, 10, 10, 7, 8, 8, 7, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 4, 7, 7, 4, 3, 3, 4, 10, -1, -1, -1, -1 },
+		{ 0, 8, 6, 6, 8, 7, 7, 8, 3, 3, 8, 10, -1, -1, -1, -1 },
+		{ 3, 7, 10, 10, 7, 4, 4, 7, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 3, 4, 4, 3, 8, 8, 3, 9, 9, 3, 7, -1, -1, -1, -1 },
+		{ 0, 1, 9, 9, 1, 7, 7, 1, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 6, 6, 8, 7, 7, 8, 3, 3, 8, 1, 1, 8, 4, -1 },
+		{ 1, 3, 6, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 6, 11, 3, 7, 10, 10, 7, 8, 8, 7, 9, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 4, 7, 7, 4, 3, 3, 4, 10, 1, 6, 11, -1 },
+		{ 0, 8, 1, 1, 8, 11, 11, 8, 7, 7, 8, 3, 3, 8, 10, -1 },
+		{ 1, 4, 11, 11, 4, 7, 7, 4, 3, 3, 4, 10, -1, -1, -1, -1 },
+		{ 3, 4, 11, 11, 4, 6, 3, 7, 4, 4, 7, 8, 8, 7, 9, -1 },
+		{ 0, 3, 9, 9, 3, 7, 0, 6, 3, 3, 6, 11, -1, -1, -1, -1 },
+		{ 0, 8, 4, 3, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 7, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 11, 7, 4, 8, 6, 6, 8, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 4, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 10, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 10, 4, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 6, 6, 10, 9, 9, 10, 8, 3, 11, 7, -1, -1, -1, -1 },
+		{ 1, 6, 3, 3, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 3, 3, 6, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 1, 1, 9, 3, 3, 9, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 3, 3, 4, 7, 7, 4, 9, 9, 4, 8, -1, -1, -1, -1 },
+		{ 3, 10, 7, 7, 10, 6, 6, 10, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 10, 10, 6, 3, 3, 6, 7, -1, -1, -1, -1 },
+		{ 0, 9, 4, 4, 9, 10, 10, 9, 3, 3, 9, 7, -1, -1, -1, -1 },
+		{ 3, 10, 7, 7, 10, 9, 9, 10, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 8, 5, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 5, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 2, 8, 5, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 9, 5, 5, 9, 4, 4, 9, 6, 3, 11, 7, -1, -1, -1, -1 },
+		{ 1, 10, 4, 2, 8, 5, 3, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 2, 2, 1, 5, 5, 1, 10, 3, 11, 7, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 10, 4, 2, 8, 5, 3, 11, 7, -1, -1, -1, -1 },
+		{ 1, 10, 6, 6, 10, 9, 9, 10, 2, 2, 10, 5, 3, 11, 7, -1 },
+		{ 1, 6, 3, 3, 6, 7, 2, 8, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 5, 1, 6, 3, 3, 6, 7, -1, -1, -1, -1 },
+		{ 0, 9, 1, 1, 9, 3, 3, 9, 7, 2, 8, 5, -1, -1, -1, -1 },
+		{ 1, 4, 3, 3, 4, 7, 7, 4, 9, 9, 4, 2, 2, 4, 5, -1 },
+		{ 2, 8, 5, 3, 10, 7, 7, 10, 6, 6, 10, 4, -1, -1, -1, -1 },
+		{ 0, 6, 2, 2, 6, 5, 5, 6, 10, 10, 6, 3, 3, 6, 7, -1 },
+		{ 0, 9, 4, 4, 9, 10, 10, 9, 3, 3, 9, 7, 2, 8, 5, -1 },
+		{ 2, 9, 5, 5, 9, 10, 10, 9, 3, 3, 9, 7, -1, -1, -1, -1 },
+		{ 2, 3, 9, 9, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 2, 3, 9, 9, 3, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 2, 6, 6, 2, 11, 11, 2, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 8, 8, 3, 4, 4, 3, 6, 6, 3, 11, -1, -1, -1, -1 },
+		{ 1, 10, 4, 2, 3, 9, 9, 3, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 10, 2, 3, 9, 9, 3, 11, -1, -1, -1, -1 },
+		{ 0, 2, 6, 6, 2, 11, 11, 2, 3, 1, 10, 4, -1, -1, -1, -1 },
+		{ 1, 10, 6, 6, 2, 11, 11, 2, 3, 6, 10, 2, 2, 10, 8, -1 },
+		{ 1, 6, 3, 3, 6, 2, 2, 6, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 3, 3, 6, 2, 2, 6, 9, -1, -1, -1, -1 },
+		{ 0, 2, 1, 1, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 3, 3, 4, 2, 2, 4, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 9, 9, 3, 6, 6, 3, 4, 4, 3, 10, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 10, 10, 6, 3, 3, 6, 2, 2, 6, 9, -1 },
+		{ 0, 2, 4, 4, 2, 10, 10, 2, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 3, 8, 8, 3, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 11, 5, 5, 11, 8, 8, 11, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 4, 11, 11, 4, 3, 3, 4, 5, -1, -1, -1, -1 },
+		{ 0, 8, 6, 6, 8, 11, 11, 8, 3, 3, 8, 5, -1, -1, -1, -1 },
+		{ 3, 11, 5, 5, 11, 4, 4, 11, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 10, 4, 3, 11, 5, 5, 11, 8, 8, 11, 9, -1, -1, -1, -1 },
+		{ 0, 1, 9, 9, 5, 11, 11, 5, 3, 9, 1, 5, 5, 1, 10, -1 },
+		{ 0, 8, 6, 6, 8, 11, 11, 8, 3, 3, 8, 5, 1, 10, 4, -1 },
+		{ 1, 10, 6, 6, 5, 11, 11, 5, 3, 6, 10, 5, -1, -1, -1, -1 },
+		{ 1, 6, 3, 3, 6, 5, 5, 6, 8, 8, 6, 9, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 3, 6, 6, 3, 1, 9, 4, 3, 3, 4, 5, -1 },
+		{ 0, 8, 1, 1, 8, 3, 3, 8, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 3, 3, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 9, 5, 5, 9, 8, 3, 10, 9, 9, 10, 6, 6, 10, 4, -1 },
+		{ 0, 6, 9, 3, 10, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 3, 4, 4, 3, 10, 0, 8, 3, 3, 8, 5, -1, -1, -1, -1 },
+		{ 3, 10, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 10, 7, 7, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 5, 10, 7, 7, 10, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 5, 10, 7, 7, 10, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 8, 6, 6, 8, 9, 5, 10, 7, 7, 10, 11, -1, -1, -1, -1 },
+		{ 1, 11, 4, 4, 11, 5, 5, 11, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 5, 5, 1, 7, 7, 1, 11, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 11, 4, 4, 11, 5, 5, 11, 7, -1, -1, -1, -1 },
+		{ 1, 8, 6, 6, 8, 9, 1, 11, 8, 8, 11, 5, 5, 11, 7, -1 },
+		{ 1, 6, 10, 10, 6, 5, 5, 6, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 10, 10, 6, 5, 5, 6, 7, -1, -1, -1, -1 },
+		{ 0, 9, 1, 1, 9, 10, 10, 9, 5, 5, 9, 7, -1, -1, -1, -1 },
+		{ 1, 7, 10, 10, 7, 5, 1, 4, 7, 7, 4, 9, 9, 4, 8, -1 },
+		{ 4, 6, 5, 5, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 5, 5, 6, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 4, 4, 9, 5, 5, 9, 7, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 8, 7, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 8, 7, 7, 8, 11, 11, 8, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 7, 7, 4, 11, 11, 4, 10, -1, -1, -1, -1 },
+		{ 0, 9, 6, 2, 8, 7, 7, 8, 11, 11, 8, 10, -1, -1, -1, -1 },
+		{ 2, 10, 7, 7, 10, 11, 2, 9, 10, 10, 9, 4, 4, 9, 6, -1 },
+		{ 1, 11, 4, 4, 11, 8, 8, 11, 2, 2, 11, 7, -1, -1, -1, -1 },
+		{ 0, 1, 2, 2, 1, 7, 7, 1, 11, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 6, 1, 11, 4, 4, 11, 8, 8, 11, 2, 2, 11, 7, -1 },
+		{ 1, 2, 6, 6, 2, 9, 1, 11, 2, 2, 11, 7, -1, -1, -1, -1 },
+		{ 1, 6, 10, 10, 6, 8, 8, 6, 2, 2, 6, 7, -1, -1, -1, -1 },
+		{ 0, 4, 2, 2, 4, 7, 7, 10, 6, 6, 10, 1, 7, 4, 10, -1 },
+		{ 0, 9, 1, 1, 9, 10, 10, 7, 8, 8, 7, 2, 10, 9, 7, -1 },
+		{ 1, 4, 10, 2, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 8, 7, 7, 8, 6, 6, 8, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 2, 2, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 9, 4, 4, 7, 8, 8, 7, 2, 4, 9, 7, -1, -1, -1, -1 },
+		{ 2, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 5, 9, 9, 5, 11, 11, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 8, 2, 5, 9, 9, 5, 11, 11, 5, 10, -1, -1, -1, -1 },
+		{ 0, 2, 6, 6, 2, 11, 11, 2, 10, 10, 2, 5, -1, -1, -1, -1 },
+		{ 2, 6, 8, 8, 6, 4, 2, 5, 6, 6, 5, 11, 11, 5, 10, -1 },
+		{ 1, 11, 4, 4, 11, 5, 5, 11, 2, 2, 11, 9, -1, -1, -1, -1 },
+		{ 0, 1, 8, 8, 1, 5, 5, 1, 2, 2, 1, 9, 9, 1, 11, -1 },
+		{ 0, 2, 6, 6, 2, 11, 11, 2, 1, 1, 2, 4, 4, 2, 5, -1 },
+		{ 1, 11, 6, 2, 5, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 6, 10, 10, 6, 5, 5, 6, 2, 2, 6, 9, -1, -1, -1, -1 },
+		{ 0, 4, 8, 1, 6, 10, 10, 6, 5, 5, 6, 2, 2, 6, 9, -1 },
+		{ 0, 2, 1, 1, 2, 10, 10, 2, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, 10, 2, 5, 1, 4, 2, 2, 4, 8, -1, -1, -1, -1 },
+		{ 2, 5, 9, 9, 5, 6, 6, 5, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 8, 8, 6, 5, 5, 6, 2, 2, 6, 9, -1, -1, -1, -1 },
+		{ 0, 2, 4, 4, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 2, 5, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 10, 9, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 4, 11, 11, 4, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 6, 6, 8, 11, 11, 8, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 10, 6, 6, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 11, 4, 4, 11, 8, 8, 11, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 1, 9, 9, 1, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 6, 6, 8, 11, 11, 8, 1, 1, 8, 4, -1, -1, -1, -1 },
+		{ 1, 11, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 6, 10, 10, 6, 8, 8, 6, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 4, 9, 9, 10, 6, 6, 10, 1, 9, 4, 10, -1, -1, -1, -1 },
+		{ 0, 8, 1, 1, 8, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 6, 8, 8, 6, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 6, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 0, 8, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }
+	};
+
+	// cell edge e is along axis EDGE_OFFSETS[ e ][ 0 ],
+	// from the corner at ( EDGE_OFFSETS[ e ][ 1 ], EDGE_OFFSETS[ e ][ 2 ], EDGE_OFFSETS[ e ][ 3 ] )
+	// edge 4 * axis + k is offset by k & 1 along axis + 1 and k >> 1 along axis + 2 (mod 3)
+	const int EDGE_OFFSETS[ 12 ][ 4 ] =
+	{
+		{ 0, 0, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 }, { 0, 0, 1, 1 },
+		{ 1, 0, 0, 0 }, { 1, 0, 0, 1 }, { 1, 1, 0, 0 }, { 1, 1, 0, 1 },
+		{ 2, 0, 0, 0 }, { 2, 1, 0, 0 }, { 2, 0, 1, 0 }, { 2, 1, 1, 0 }
+	};
+}
+
+// The cells of a brick for extractSparse()
+// A brick owns the edges from its samples, excluding the samples it shares with the bricks after it
+// Its faces index its own vertices with indices >= 0, and the edges it doesn't own
+// with -1 - i, where externalKeys[ i ] is the edge's key
+// Its vertices on its faces shared with the bricks before it are listed with their keys
+struct MarchingCubes::Brick
+{
+	// the cells [ start, end ) along each axis
+	Vector3i start;
+	Vector3i end;
+
+	std::vector< Vector3f > positions;
+	std::vector< Vector3f > normals;
+	std::vector< Vector3i > faces;
+
+	std::vector< uint64 > externalKeys;
+
+	// ( key, index )
+	std::vector< std::pair< uint64, int > > sharedVertices;
+};
+
+// static
+const int MarchingCubes::MIN_SLAB_SIZE = 4;
+
+// static
+const int MarchingCubes::MAX_SLABS = 64;
+
+// static
+const int MarchingCubes::BRICK_SIZE = 16;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool MarchingCubes::extract( const Array3D< float >& volume, float isoValue,
+	const Vector3f& origin, float voxelSize,
+	TriangleMesh& mesh )
+{
+	if( !checkVolume( volume ) )
+	{
+		return false;
+	}
+
+	int width = volume.width();
+	int height = volume.height();
+	int depth = volume.depth();
+	int layerSize = width * height;
+
+	// slab s is the layers of samples [ slabStarts[ s ], slabStarts[ s + 1 ] )
+	// it owns the edges from its samples, and its cells are the ones above its layers
+	// in each layer, the vertices on the x and y edges come before the ones on the z edges
+	int slabSize = std::max( MIN_SLAB_SIZE, ( depth + MAX_SLABS - 1 ) / MAX_SLABS );
+	int nSlabs = ( depth + slabSize - 1 ) / slabSize;
+	std::vector< int > slabStarts( nSlabs + 1 );
+	for( int s = 0; s <= nSlabs; ++s )
+	{
+		slabStarts[ s ] = std::min( s * slabSize, depth );
+	}
+
+	std::vector< int > vertexOffsets( nSlabs + 1, 0 );
+	Concurrency::parallel_for( 0, nSlabs, [&]( int s )
+	{
+		int index = 0;
+		for( int z = slabStarts[ s ]; z < slabStarts[ s + 1 ]; ++z )
+		{
+			index = makeLayerVertices( volume, isoValue, origin, voxelSize, z, index,
+				nullptr, nullptr, nullptr, nullptr );
+			if( z + 1 < depth )
+			{
+				index = makeLayerZVertices( volume, isoValue, origin, voxelSize, z, index,
+					nullptr, nullptr, nullptr );
+			}
+		}
+		vertexOffsets[ s + 1 ] = index;
+	} );
+	for( int s = 0; s < nSlabs; ++s )
+	{
+		vertexOffsets[ s + 1 ] += vertexOffsets[ s ];
+	}
+
+	mesh = TriangleMesh();
+	mesh.m_positions.resize( vertexOffsets[ nSlabs ] );
+	mesh.m_normals.resize( vertexOffsets[ nSlabs ] );
+	Vector3f* positions = mesh.m_positions.data();
+	Vector3f* normals = mesh.m_normals.data();
+
+	std::vector< std::vector< Vector3i > > slabFaces( nSlabs );
+	Concurrency::parallel_for( 0, nSlabs, [&]( int s )
+	{
+		// the vertex indices on the edges from layers z and z + 1
+		std::vector< int > edgeCaches( 5 * layerSize );
+		int* xIndices[ 2 ] = { &( edgeCaches[ 0 ] ), &( edgeCaches[ layerSize ] ) };
+		int* yIndices[ 2 ] = { &( edgeCaches[ 2 * layerSize ] ), &( edgeCaches[ 3 * layerSize ] ) };
+		int* zIndices = &( edgeCaches[ 4 * layerSize ] );
+
+		int z0 = slabStarts[ s ];
+		int z1 = slabStarts[ s + 1 ];
+		std::vector< Vector3i >& faces = slabFaces[ s ];
+
+		int index = makeLayerVertices( volume, isoValue, origin, voxelSize, z0, vertexOffsets[ s ],
+			xIndices[ 0 ], yIndices[ 0 ], positions, normals );
+		for( int z = z0; z < std::min( z1, depth - 1 ); ++z )
+		{
+			index = makeLayerZVertices( volume, isoValue, origin, voxelSize, z, index,
+				zIndices, positions, normals );
+
+			// the first layer of the next slab is numbered the same way it numbers it
+			if( z + 1 < z1 )
+			{
+				index = makeLayerVertices( volume, isoValue, origin, voxelSize, z + 1, index,
+					xIndices[ 1 ], yIndices[ 1 ], positions, normals );
+			}
+			else
+			{
+				makeLayerVertices( volume, isoValue, origin, voxelSize, z + 1, vertexOffsets[ s + 1 ],
+					xIndices[ 1 ], yIndices[ 1 ], nullptr, nullptr );
+			}
+
+			for( int y = 0; y < height - 1; ++y )
+			{
+				const float* row00 = volume.rowPointer( y, z );
+				const float* row10 = volume.rowPointer( y + 1, z );
+				const float* row01 = volume.rowPointer( y, z + 1 );
+				const float* row11 = volume.rowPointer( y + 1, z + 1 );
+				for( int x = 0; x < width - 1; ++x )
+				{
+					const signed char* cellFaces = CELL_FACES[ cellIndex( row00, row10, row01, row11, x, isoValue ) ];
+					for( int i = 0; cellFaces[ i ] >= 0; i += 3 )
+					{
+						int vertices[ 3 ];
+						for( int j = 0; j < 3; ++j )
+						{
+							const int* offsets = EDGE_OFFSETS[ cellFaces[ i + j ] ];
+							int k = ( y + offsets[ 2 ] ) * width + x + offsets[ 1 ];
+							if( offsets[ 0 ] == 0 )
+							{
+								vertices[ j ] = xIndices[ offsets[ 3 ] ][ k ];
+							}
+							else if( offsets[ 0 ] == 1 )
+							{
+								vertices[ j ] = yIndices[ offsets[ 3 ] ][ k ];
+							}
+							else
+							{
+								vertices[ j ] = zIndices[ k ];
+							}
+						}
+						faces.push_back( Vector3i( vertices[ 0 ], vertices[ 1 ], vertices[ 2 ] ) );
+					}
+				}
+			}
+
+			std::swap( xIndices[ 0 ], xIndices[ 1 ] );
+			std::swap( yIndices[ 0 ], yIndices[ 1 ] );
+		}
+	} );
+
+	std::vector< int > faceOffsets( nSlabs + 1, 0 );
+	for( int s = 0; s < nSlabs; ++s )
+	{
+		faceOffsets[ s + 1 ] = faceOffsets[ s ] + static_cast< int >( slabFaces[ s ].size() );
+	}
+	mesh.m_faces.resize( faceOffsets[ nSlabs ] );
+	Concurrency::parallel_for( 0, nSlabs, [&]( int s )
+	{
+		std::copy( slabFaces[ s ].begin(), slabFaces[ s ].end(), mesh.m_faces.begin() + faceOffsets[ s ] );
+	} );
+
+	return true;
+}
+
+// static
+void MarchingCubes::computeBrickRanges( const Array3D< float >& volume, Array3D< Vector2f >& brickRanges )
+{
+	Vector3i nBricks = numBricks( volume.size() );
+	brickRanges.resize( nBricks );
+
+	int nTotalBricks = nBricks.x * nBricks.y * nBricks.z;
+	Concurrency::parallel_for( 0, nTotalBricks, [&]( int b )
+	{
+		int i = b % nBricks.x;
+		int j = ( b / nBricks.x ) % nBricks.y;
+		int k = b / ( nBricks.x * nBricks.y );
+
+		int x0 = BRICK_SIZE * i;
+		int x1 = std::min( x0 + BRICK_SIZE, volume.width() - 1 );
+		int y0 = BRICK_SIZE * j;
+		int y1 = std::min( y0 + BRICK_SIZE, volume.height() - 1 );
+		int z0 = BRICK_SIZE * k;
+		int z1 = std::min( z0 + BRICK_SIZE, volume.depth() - 1 );
+
+		float minValue = volume( x0, y0, z0 );
+		float maxValue = minValue;
+		for( int z = z0; z <= z1; ++z )
+		{
+			for( int y = y0; y <= y1; ++y )
+			{
+				const float* row = volume.rowPointer( y, z );
+				for( int x = x0; x <= x1; ++x )
+				{
+					minValue = std::min( minValue, row[ x ] );
+					maxValue = std::max( maxValue, row[ x ] );
+				}
+			}
+		}
+		brickRanges( b ) = Vector2f( minValue, maxValue );
+	} );
+}
+
+// static
+bool MarchingCubes::extractSparse( const Array3D< float >& volume, const Array3D< Vector2f >& brickRanges,
+	float isoValue, const Vector3f& origin, float voxelSize,
+	TriangleMesh& mesh )
+{
+	if( !checkVolume( volume ) )
+	{
+		return false;
+	}
+
+	Vector3i nBricks = numBricks( volume.size() );
+	if( brickRanges.width() != nBricks.x || brickRanges.height() != nBricks.y || brickRanges.depth() != nBricks.z )
+	{
+		fprintf( stderr, "MarchingCubes: expected %d x %d x %d brick ranges, got %d x %d x %d\n",
+			nBricks.x, nBricks.y, nBricks.z,
+			brickRanges.width(), brickRanges.height(), brickRanges.depth() );
+		return false;
+	}
+
+	Vector3i resolution = volume.size();
+	Vector3i lastSample = resolution - Vector3i( 1, 1, 1 );
+
+	// a cell has vertices if some corner is < isoValue and some isn't
+	std::vector< Brick > bricks;
+	for( int k = 0; k < nBricks.z; ++k )
+	{
+		for( int j = 0; j < nBricks.y; ++j )
+		{
+			for( int i = 0; i < nBricks.x; ++i )
+			{
+				Vector2f range = brickRanges( i, j, k );
+				if( range.x < isoValue && !( range.y < isoValue ) )
+				{
+					Brick brick;
+					brick.start = BRICK_SIZE * Vector3i( i, j, k );
+					brick.end = Vector3i(
+						std::min( brick.start.x + BRICK_SIZE, lastSample.x ),
+						std::min( brick.start.y + BRICK_SIZE, lastSample.y ),
+						std::min( brick.start.z + BRICK_SIZE, lastSample.z ) );
+					bricks.push_back( brick );
+				}
+			}
+		}
+	}
+	int nActiveBricks = static_cast< int >( bricks.size() );
+
+	Concurrency::parallel_for( 0, nActiveBricks, [&]( int b )
+	{
+		Brick& brick = bricks[ b ];
+		Vector3i start = brick.start;
+		Vector3i end = brick.end;
+
+		// the vertex index on each edge from the brick's samples [ start, end ]
+		int sizeX = end.x - start.x + 1;
+		int sizeY = end.y - start.y + 1;
+		int sizeZ = end.z - start.z + 1;
+		std::vector< int > edgeIndices( 3 * sizeX * sizeY * sizeZ );
+
+		for( int z = start.z; z <= end.z; ++z )
+		{
+			for( int y = start.y; y <= end.y; ++y )
+			{
+				const float* row = volume.rowPointer( y, z );
+				const float* nextRows[ 3 ] =
+				{
+					row + 1,
+					( y < end.y ) ? volume.rowPointer( y + 1, z ) : nullptr,
+					( z < end.z ) ? volume.rowPointer( y, z + 1 ) : nullptr
+				};
+				int* indices = &( edgeIndices[ 3 * ( ( z - start.z ) * sizeY + ( y - start.y ) ) * sizeX ] );
+
+				// samples shared with the bricks after this one belong to them,
+				// unless the brick is last along that axis
+				bool ownedYZ = ( y < end.y || end.y == lastSample.y ) && ( z < end.z || end.z == lastSample.z );
+				bool sharedYZ = ( y == start.y && y > 0 ) || ( z == start.z && z > 0 );
+
+				for( int x = start.x; x <= end.x; ++x )
+				{
+					bool inside = row[ x ] < isoValue;
+					bool owned = ownedYZ && ( x < end.x || end.x == lastSample.x );
+					bool shared = sharedYZ || ( x == start.x && x > 0 );
+					const int coordinates[ 3 ] = { x, y, z };
+					const int ends[ 3 ] = { end.x, end.y, end.z };
+					for( int axis = 0; axis < 3; ++axis )
+					{
+						// only the edges of the brick's cells
+						if( coordinates[ axis ] == ends[ axis ] ||
+							( nextRows[ axis ][ x ] < isoValue ) == inside )
+						{
+							continue;
+						}
+
+						int& index = indices[ 3 * ( x - start.x ) + axis ];
+						if( owned )
+						{
+							index = static_cast< int >( brick.positions.size() );
+							Vector3f position;
+							Vector3f normal;
+							makeVertex( volume, isoValue, origin, voxelSize, x, y, z, axis, position, normal );
+							brick.positions.push_back( position );
+							brick.normals.push_back( normal );
+							if( shared )
+							{
+								brick.sharedVertices.push_back( std::make_pair( edgeKey( resolution, x, y, z, axis ), index ) );
+							}
+						}
+						else
+						{
+							index = -1 - static_cast< int >( brick.externalKeys.size() );
+							brick.externalKeys.push_back( edgeKey( resolution, x, y, z, axis ) );
+						}
+					}
+				}
+			}
+		}
+
+		for( int z = start.z; z < end.z; ++z )
+		{
+			for( int y = start.y; y < end.y; ++y )
+			{
+				const float* row00 = volume.rowPointer( y, z );
+				const float* row10 = volume.rowPointer( y + 1, z );
+				const float* row01 = volume.rowPointer( y, z + 1 );
+				const float* row11 = volume.rowPointer( y + 1, z + 1 );
+				for( int x = start.x; x < end.x; ++x )
+				{
+					const signed char* cellFaces = CELL_FACES[ cellIndex( row00, row10, row01, row11, x, isoValue ) ];
+					for( int i = 0; cellFaces[ i ] >= 0; i += 3 )
+					{
+						int vertices[ 3 ];
+						for( int j = 0; j < 3; ++j )
+						{
+							const int* offsets = EDGE_OFFSETS[ cellFaces[ i + j ] ];
+							int sample = ( ( z + offsets[ 3 ] - start.z ) * sizeY + ( y + offsets[ 2 ] - start.y ) ) * sizeX +
+								x + offsets[ 1 ] - start.x;
+							vertices[ j ] = edgeIndices[ 3 * sample + offsets[ 0 ] ];
+						}
+						brick.faces.push_back( Vector3i( vertices[ 0 ], vertices[ 1 ], vertices[ 2 ] ) );
+					}
+				}
+			}
+		}
+	} );
+
+	std::vector< int > vertexOffsets( nActiveBricks + 1, 0 );
+	std::vector< int > faceOffsets( nActiveBricks + 1, 0 );
+	std::vector< int > sharedOffsets( nActiveBricks + 1, 0 );
+	for( int b = 0; b < nActiveBricks; ++b )
+	{
+		vertexOffsets[ b + 1 ] = vertexOffsets[ b ] + static_cast< int >( bricks[ b ].positions.size() );
+		faceOffsets[ b + 1 ] = faceOffsets[ b ] + static_cast< int >( bricks[ b ].faces.size() );
+		sharedOffsets[ b + 1 ] = sharedOffsets[ b ] + static_cast< int >( bricks[ b ].sharedVertices.size() );
+	}
+
+	// the shared vertices, sorted by key, with their indices in the mesh
+	std::vector< std::pair< uint64, int > > sharedVertices( sharedOffsets[ nActiveBricks ] );
+	Concurrency::parallel_for( 0, nActiveBricks, [&]( int b )
+	{
+		const Brick& brick = bricks[ b ];
+		for( int i = 0; i < static_cast< int >( brick.sharedVertices.size() ); ++i )
+		{
+			sharedVertices[ sharedOffsets[ b ] + i ] = std::make_pair(
+				brick.sharedVertices[ i ].first, brick.sharedVertices[ i ].second + vertexOffsets[ b ] );
+		}
+	} );
+	ParallelSort::sort( sharedVertices );
+
+	mesh = TriangleMesh();
+	mesh.m_positions.resize( vertexOffsets[ nActiveBricks ] );
+	mesh.m_normals.resize( vertexOffsets[ nActiveBricks ] );
+	mesh.m_faces.resize( faceOffsets[ nActiveBricks ] );
+
+	// whether each brick found all of its external edges
+	std::vector< ubyte > brickIsWelded( nActiveBricks, 1 );
+	Concurrency::parallel_for( 0, nActiveBricks, [&]( int b )
+	{
+		const Brick& brick = bricks[ b ];
+		std::copy( brick.positions.begin(), brick.positions.end(), mesh.m_positions.begin() + vertexOffsets[ b ] );
+		std::copy( brick.normals.begin(), brick.normals.end(), mesh.m_normals.begin() + vertexOffsets[ b ] );
+
+		// an edge crossed by a face of this brick is shared with the brick that owns it,
+		// which is active since its range contains both samples of the edge
+		// (unless brickRanges is stale, or a NaN sample kept it out of a range)
+		std::vector< int > externalIndices( brick.externalKeys.size() );
+		for( int i = 0; i < static_cast< int >( externalIndices.size() ); ++i )
+		{
+			auto itr = std::lower_bound( sharedVertices.begin(), sharedVertices.end(),
+				std::make_pair( brick.externalKeys[ i ], -1 ) );
+			if( itr == sharedVertices.end() || itr->first != brick.externalKeys[ i ] )
+			{
+				brickIsWelded[ b ] = 0;
+				return;
+			}
+			externalIndices[ i ] = itr->second;
+		}
+
+		for( int f = 0; f < static_cast< int >( brick.faces.size() ); ++f )
+		{
+			const Vector3i& face = brick.faces[ f ];
+			int vertices[ 3 ] = { face.x, face.y, face.z };
+			for( int j = 0; j < 3; ++j )
+			{
+				vertices[ j ] = ( vertices[ j ] >= 0 ) ?
+					vertices[ j ] + vertexOffsets[ b ] :
+					externalIndices[ -1 - vertices[ j ] ];
+			}
+			mesh.m_faces[ faceOffsets[ b ] + f ] = Vector3i( vertices[ 0 ], vertices[ 1 ], vertices[ 2 ] );
+		}
+	} );
+
+	if( std::find( brickIsWelded.begin(), brickIsWelded.end(), 0 ) != brickIsWelded.end() )
+	{
+		fprintf( stderr, "MarchingCubes: an edge between bricks has no vertex: "
+			"brickRanges doesn't match the volume (or the volume has NaNs)\n" );
+		mesh = TriangleMesh();
+		return false;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool MarchingCubes::checkVolume( const Array3D< float >& volume )
+{
+	if( volume.width() < 2 || volume.height() < 2 || volume.depth() < 2 )
+	{
+		fprintf( stderr, "MarchingCubes: volume must have at least 2 samples along each axis, got %d x %d x %d\n",
+			volume.width(), volume.height(), volume.depth() );
+		return false;
+	}
+	return true;
+}
+
+// static
+Vector3i MarchingCubes::numBricks( const Vector3i& resolution )
+{
+	return Vector3i(
+		std::max( resolution.x - 1 + BRICK_SIZE - 1, 0 ) / BRICK_SIZE,
+		std::max( resolution.y - 1 + BRICK_SIZE - 1, 0 ) / BRICK_SIZE,
+		std::max( resolution.z - 1 + BRICK_SIZE - 1, 0 ) / BRICK_SIZE );
+}
+
+// static
+int MarchingCubes::cellIndex( const float* row00, const float* row10, const float* row01, const float* row11,
+	int x, float isoValue )
+{
+	return
+		( row00[ x ] < isoValue ? 1 : 0 ) |
+		( row00[ x + 1 ] < isoValue ? 2 : 0 ) |
+		( row10[ x ] < isoValue ? 4 : 0 ) |
+		( row10[ x + 1 ] < isoValue ? 8 : 0 ) |
+		( row01[ x ] < isoValue ? 16 : 0 ) |
+		( row01[ x + 1 ] < isoValue ? 32 : 0 ) |
+		( row11[ x ] < isoValue ? 64 : 0 ) |
+		( row11[ x + 1 ] < isoValue ? 128 : 0 );
+}
+
+// static
+int MarchingCubes::makeLayerVertices( const Array3D< float >& volume, float isoValue,
+	const Vector3f& origin, float voxelSize, int z, int index,
+	int* xIndices, int* yIndices, Vector3f* positions, Vector3f* normals )
+{
+	int width = volume.width();
+	int height = volume.height();
+	for( int y = 0; y < height; ++y )
+	{
+		const float* row = volume.rowPointer( y, z );
+		const float* nextRow = ( y + 1 < height ) ? volume.rowPointer( y + 1, z ) : nullptr;
+		for( int x = 0; x < width; ++x )
+		{
+			bool inside = row[ x ] < isoValue;
+			if( x + 1 < width && ( row[ x + 1 ] < isoValue ) != inside )
+			{
+				if( xIndices != nullptr )
+				{
+					xIndices[ y * width + x ] = index;
+				}
+				if( positions != nullptr )
+				{
+					makeVertex( volume, isoValue, origin, voxelSize, x, y, z, 0, positions[ index ], normals[ index ] );
+				}
+				++index;
+			}
+			if( nextRow != nullptr && ( nextRow[ x ] < isoValue ) != inside )
+			{
+				if( yIndices != nullptr )
+				{
+					yIndices[ y * width + x ] = index;
+				}
+				if( positions != nullptr )
+				{
+					makeVertex( volume, isoValue, origin, voxelSize, x, y, z, 1, positions[ index ], normals[ index ] );
+				}
+				++index;
+			}
+		}
+	}
+	return index;
+}
+
+// static
+int MarchingCubes::makeLayerZVertices( const Array3D< float >& volume, float isoValue,
+	const Vector3f& origin, float voxelSize, int z, int index,
+	int* zIndices, Vector3f* positions, Vector3f* normals )
+{
+	int width = volume.width();
+	int height = volume.height();
+	for( int y = 0; y < height; ++y )
+	{
+		const float* row = volume.rowPointer( y, z );
+		const float* nextRow = volume.rowPointer( y, z + 1 );
+		for( int x = 0; x < width; ++x )
+		{
+			if( ( row[ x ] < isoValue ) != ( nextRow[ x ] < isoValue ) )
+			{
+				if( zIndices != nullptr )
+				{
+					zIndices[ y * width + x ] = index;
+				}
+				if( positions != nullptr )
+				{
+					makeVertex( volume, isoValue, origin, voxelSize, x, y, z, 2, positions[ index ], normals[ index ] );
+				}
+				++index;
+			}
+		}
+	}
+	return index;
+}
+
+// static
+Vector3f MarchingCubes::gradient( const Array3D< float >& volume, int x, int y, int z )
+{
+	int x0 = std::max( x - 1, 0 );
+	int x1 = std::min( x + 1, volume.width() - 1 );
+	int y0 = std::max( y - 1, 0 );
+	int y1 = std::min( y + 1, volume.height() - 1 );
+	int z0 = std::max( z - 1, 0 );
+	int z1 = std::min( z + 1, volume.depth() - 1 );
+
+	return Vector3f(
+		( volume( x1, y, z ) - volume( x0, y, z ) ) / ( x1 - x0 ),
+		( volume( x, y1, z ) - volume( x, y0, z ) ) / ( y1 - y0 ),
+		( volume( x, y, z1 ) - volume( x, y, z0 ) ) / ( z1 - z0 ) );
+}
+
+// static
+void MarchingCubes::makeVertex( const Array3D< float >& volume, float isoValue,
+	const Vector3f& origin, float voxelSize,
+	int x, int y, int z, int axis,
+	Vector3f& position, Vector3f& normal )
+{
+	int x1 = x + ( axis == 0 ? 1 : 0 );
+	int y1 = y + ( axis == 1 ? 1 : 0 );
+	int z1 = z + ( axis == 2 ? 1 : 0 );
+
+	float v0 = volume( x, y, z );
+	float v1 = volume( x1, y1, z1 );
+	float t = ( isoValue - v0 ) / ( v1 - v0 );
+
+	Vector3f p( x + 0.5f, y + 0.5f, z + 0.5f );
+	p[ axis ] += t;
+	position = origin + voxelSize * p;
+
+	normal = Vector3f::lerp( gradient( volume, x, y, z ), gradient( volume, x1, y1, z1 ), t );
+	float norm = normal.norm();
+	if( norm > 0 )
+	{
+		normal /= norm;
+	}
+}
+
+// static
+uint64 MarchingCubes::edgeKey( const Vector3i& resolution, int x, int y, int z, int axis )
+{
+	return 3 * ( ( static_cast< uint64 >( z ) * resolution.y + y ) * resolution.x + x ) + axis;
+}
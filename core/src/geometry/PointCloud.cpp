@@ -0,0 +1,67 @@
+#include "geometry/PointCloud.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+PointCloud::PointCloud()
+{
+
+}
+
+int PointCloud::numPoints() const
+{
+	return static_cast< int >( m_positions.size() );
+}
+
+bool PointCloud::hasNormals() const
+{
+	return( !m_normals.empty() && m_normals.size() == m_positions.size() );
+}
+
+bool PointCloud::hasColors() const
+{
+	return( !m_colors.empty() && m_colors.size() == m_positions.size() );
+}
+
+const std::vector< Vector3f >& PointCloud::positions() const
+{
+	return m_positions;
+}
+
+std::vector< Vector3f >& PointCloud::positions()
+{
+	return m_positions;
+}
+
+const std::vector< Vector3f >& PointCloud::normals() const
+{
+	return m_normals;
+}
+
+std::vector< Vector3f >& PointCloud::normals()
+{
+	return m_normals;
+}
+
+const std::vector< Vector3f >& PointCloud::colors() const
+{
+	return m_colors;
+}
+
+std::vector< Vector3f >& PointCloud::colors()
+{
+	return m_colors;
+}
+
+void PointCloud::clear()
+{
+	m_positions.clear();
+	m_normals.clear();
+	m_colors.clear();
+}
+
+BoundingBox3f PointCloud::boundingBox() const
+{
+	return BoundingBox3f( m_positions );
+}
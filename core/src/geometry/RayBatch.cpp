@@ -0,0 +1,144 @@
+#include "geometry/RayBatch.h"
+
+#include <algorithm>
+
+#include <emmintrin.h>
+#include <ppl.h>
+
+#include "cameras/Camera.h"
+#include "geometry/BoundingBox3f.h"
+#include "math/SSEUtils.h"
+
+namespace
+{
+	// rays are split into blocks of this many for the threads
+	const int BLOCK_SIZE = 4096;
+}
+
+RayBatch::RayBatch( int nRays )
+{
+	resize( nRays );
+}
+
+// static
+RayBatch RayBatch::fromCamera( const Camera& camera, const Vector2i& screenSize )
+{
+	RayBatch rays( screenSize.x * screenSize.y );
+	Vector3f eye = camera.eye();
+
+	Concurrency::parallel_for( 0, screenSize.y, [&]( int y )
+	{
+		for( int x = 0; x < screenSize.x; ++x )
+		{
+			rays.setRay( x + y * screenSize.x, eye, camera.pixelToDirection( x, y, screenSize ) );
+		}
+	} );
+
+	return rays;
+}
+
+int RayBatch::size() const
+{
+	return static_cast< int >( originX.size() );
+}
+
+void RayBatch::resize( int nRays )
+{
+	originX.resize( nRays, 0.f );
+	originY.resize( nRays, 0.f );
+	originZ.resize( nRays, 0.f );
+
+	directionX.resize( nRays, 0.f );
+	directionY.resize( nRays, 0.f );
+	directionZ.resize( nRays, 0.f );
+
+	tMin.resize( nRays, 0.f );
+	tMax.resize( nRays, std::numeric_limits< float >::infinity() );
+}
+
+Vector3f RayBatch::origin( int i ) const
+{
+	return Vector3f( originX[ i ], originY[ i ], originZ[ i ] );
+}
+
+Vector3f RayBatch::direction( int i ) const
+{
+	return Vector3f( directionX[ i ], directionY[ i ], directionZ[ i ] );
+}
+
+void RayBatch::setRay( int i, const Vector3f& origin, const Vector3f& direction,
+	float tMin, float tMax )
+{
+	originX[ i ] = origin.x;
+	originY[ i ] = origin.y;
+	originZ[ i ] = origin.z;
+
+	directionX[ i ] = direction.x;
+	directionY[ i ] = direction.y;
+	directionZ[ i ] = direction.z;
+
+	this->tMin[ i ] = tMin;
+	this->tMax[ i ] = tMax;
+}
+
+int RayBatch::intersectBox( const BoundingBox3f& box,
+	std::vector< float >& tEnter, std::vector< float >& tExit ) const
+{
+	int nRays = size();
+	tEnter.resize( nRays );
+	tExit.resize( nRays );
+
+	Vector3f boxMin = box.minimum();
+	Vector3f boxMax = box.maximum();
+	const std::vector< float >* origins[ 3 ] = { &originX, &originY, &originZ };
+	const std::vector< float >* directions[ 3 ] = { &directionX, &directionY, &directionZ };
+
+	int nBlocks = ( nRays + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+	std::vector< int > nBlockHits( nBlocks, 0 );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		int end = std::min( ( b + 1 ) * BLOCK_SIZE, nRays );
+		for( int first = b * BLOCK_SIZE; first < end; first += 4 )
+		{
+			int nLanes = std::min( 4, end - first );
+
+			// as in TriangleMeshBVH, the slabs are ordered by the sign of the direction
+			// so that NaNs (0 * inf) leave the interval unchanged
+			__m128 enterLanes = SSEUtils::loadLanes( tMin, first, nLanes );
+			__m128 exitLanes = SSEUtils::loadLanes( tMax, first, nLanes );
+			for( int a = 0; a < 3; ++a )
+			{
+				__m128 origin = SSEUtils::loadLanes( *( origins[ a ] ), first, nLanes );
+				__m128 invDirection = _mm_div_ps( _mm_set1_ps( 1.f ), SSEUtils::loadLanes( *( directions[ a ] ), first, nLanes ) );
+				__m128 isNegative = _mm_cmplt_ps( invDirection, _mm_setzero_ps() );
+
+				__m128 t0 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( boxMin[ a ] ), origin ), invDirection );
+				__m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( boxMax[ a ] ), origin ), invDirection );
+				enterLanes = _mm_max_ps( SSEUtils::select( isNegative, t1, t0 ), enterLanes );
+				exitLanes = _mm_min_ps( SSEUtils::select( isNegative, t0, t1 ), exitLanes );
+			}
+
+			float enters[ 4 ];
+			float exits[ 4 ];
+			_mm_storeu_ps( enters, enterLanes );
+			_mm_storeu_ps( exits, exitLanes );
+			int isHit = _mm_movemask_ps( _mm_cmple_ps( enterLanes, exitLanes ) );
+			for( int i = 0; i < nLanes; ++i )
+			{
+				tEnter[ first + i ] = enters[ i ];
+				tExit[ first + i ] = exits[ i ];
+				if( isHit & ( 1 << i ) )
+				{
+					++( nBlockHits[ b ] );
+				}
+			}
+		}
+	} );
+
+	int nHits = 0;
+	for( int b = 0; b < nBlocks; ++b )
+	{
+		nHits += nBlockHits[ b ];
+	}
+	return nHits;
+}
@@ -0,0 +1,337 @@
+#include "geometry/SpatialHashGrid.h"
+
+#include <climits>
+#include <cstdio>
+
+#include <ppl.h>
+
+// static
+const int SpatialHashGrid::DENSE_CELLS_PER_POINT = 4;
+
+// static
+const int SpatialHashGrid::MAX_CELL_INDEX = 1 << 30;
+
+// static
+const int SpatialHashGrid::BLOCK_SIZE = 4096;
+
+// static
+const int SpatialHashGrid::MAX_COARSE_BUCKETS = 1024;
+
+// static
+const int SpatialHashGrid::MAX_SORT_CHUNKS = 64;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+SpatialHashGrid::SpatialHashGrid() :
+
+	m_origin( 0, 0, 0 ),
+	m_cellSize( 1 ),
+	m_inverseCellSize( 1 ),
+	m_isDense( true ),
+	m_nBuckets( 0 )
+
+{
+	for( int d = 0; d < 3; ++d )
+	{
+		m_maxCell[ d ] = 0;
+		m_resolution[ d ] = 0;
+	}
+}
+
+bool SpatialHashGrid::build( const std::vector< Vector3f >& points, float cellSize )
+{
+	if( !( cellSize > 0 ) )
+	{
+		fprintf( stderr, "SpatialHashGrid: cell size must be positive, got %f\n", cellSize );
+		return false;
+	}
+
+	clear();
+	m_cellSize = cellSize;
+	m_inverseCellSize = 1.f / cellSize;
+
+	int n = static_cast< int >( points.size() );
+	if( n == 0 )
+	{
+		return true;
+	}
+	int nBlocks = ( n + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+
+	std::vector< BoundingBox3f > blockBounds( nBlocks );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		int end = std::min( ( b + 1 ) * BLOCK_SIZE, n );
+		for( int i = b * BLOCK_SIZE; i < end; ++i )
+		{
+			blockBounds[ b ].enlarge( points[ i ] );
+		}
+	} );
+	for( int b = 0; b < nBlocks; ++b )
+	{
+		m_bounds = BoundingBox3f::unite( m_bounds, blockBounds[ b ] );
+	}
+	m_origin = m_bounds.minimum();
+
+	// the last cell along each axis, clamped to MAX_CELL_INDEX
+	// so that a tiny cellSize can't overflow the cell coordinates
+	int maxCell[ 3 ];
+	for( int d = 0; d < 3; ++d )
+	{
+		m_maxCell[ d ] = MAX_CELL_INDEX;
+	}
+	cellOf( m_bounds.maximum(), maxCell[ 0 ], maxCell[ 1 ], maxCell[ 2 ] );
+	for( int d = 0; d < 3; ++d )
+	{
+		m_maxCell[ d ] = maxCell[ d ];
+	}
+
+	// store the grid densely if it's not much bigger than the points,
+	// otherwise hash into at least 2 buckets per point
+	// (the number of cells is counted in double: it can overflow an int64)
+	double nCells = ( maxCell[ 0 ] + 1.0 ) * ( maxCell[ 1 ] + 1.0 ) * ( maxCell[ 2 ] + 1.0 );
+	m_isDense = ( nCells <= static_cast< double >( DENSE_CELLS_PER_POINT ) * n &&
+		nCells < INT_MAX );
+	if( m_isDense )
+	{
+		for( int d = 0; d < 3; ++d )
+		{
+			m_resolution[ d ] = maxCell[ d ] + 1;
+		}
+		m_nBuckets = static_cast< int >( nCells );
+	}
+	else
+	{
+		m_nBuckets = 1;
+		while( m_nBuckets < 2 * n )
+		{
+			m_nBuckets *= 2;
+		}
+	}
+
+	std::vector< int > pointBuckets( n );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		int end = std::min( ( b + 1 ) * BLOCK_SIZE, n );
+		for( int i = b * BLOCK_SIZE; i < end; ++i )
+		{
+			int x;
+			int y;
+			int z;
+			cellOf( points[ i ], x, y, z );
+			pointBuckets[ i ] = bucket( x, y, z );
+		}
+	} );
+
+	// a stable counting sort by bucket, in two passes so that there are no atomics
+	// first by the high bits of the bucket, with a histogram for each chunk of points
+	int nLowBits = 0;
+	while( ( ( m_nBuckets - 1 ) >> nLowBits ) >= MAX_COARSE_BUCKETS )
+	{
+		++nLowBits;
+	}
+	int nCoarseBuckets = ( ( m_nBuckets - 1 ) >> nLowBits ) + 1;
+
+	int nChunks = std::min( nBlocks, MAX_SORT_CHUNKS );
+	std::vector< int > chunkStarts( nChunks + 1 );
+	for( int c = 0; c <= nChunks; ++c )
+	{
+		chunkStarts[ c ] = static_cast< int >( static_cast< int64 >( n ) * c / nChunks );
+	}
+
+	std::vector< int > histograms( nChunks * nCoarseBuckets, 0 );
+	Concurrency::parallel_for( 0, nChunks, [&]( int c )
+	{
+		int* histogram = &( histograms[ c * nCoarseBuckets ] );
+		for( int i = chunkStarts[ c ]; i < chunkStarts[ c + 1 ]; ++i )
+		{
+			++histogram[ pointBuckets[ i ] >> nLowBits ];
+		}
+	} );
+
+	// each chunk writes each coarse bucket after the chunks before it
+	std::vector< int > coarseStarts( nCoarseBuckets + 1 );
+	int sum = 0;
+	for( int k = 0; k < nCoarseBuckets; ++k )
+	{
+		coarseStarts[ k ] = sum;
+		for( int c = 0; c < nChunks; ++c )
+		{
+			int count = histograms[ c * nCoarseBuckets + k ];
+			histograms[ c * nCoarseBuckets + k ] = sum;
+			sum += count;
+		}
+	}
+	coarseStarts[ nCoarseBuckets ] = n;
+
+	std::vector< int > coarseIndices( n );
+	std::vector< int > coarseBuckets( n );
+	Concurrency::parallel_for( 0, nChunks, [&]( int c )
+	{
+		int* cursors = &( histograms[ c * nCoarseBuckets ] );
+		for( int i = chunkStarts[ c ]; i < chunkStarts[ c + 1 ]; ++i )
+		{
+			int j = cursors[ pointBuckets[ i ] >> nLowBits ]++;
+			coarseIndices[ j ] = i;
+			coarseBuckets[ j ] = pointBuckets[ i ];
+		}
+	} );
+
+	// then each coarse bucket by the low bits, on its own
+	m_bucketStarts.assign( m_nBuckets + 1, 0 );
+	m_bucketStarts[ m_nBuckets ] = n;
+	m_sortedIndices.resize( n );
+	Concurrency::parallel_for( 0, nCoarseBuckets, [&]( int k )
+	{
+		int firstBucket = k << nLowBits;
+		int endBucket = std::min( ( k + 1 ) << nLowBits, m_nBuckets );
+		int begin = coarseStarts[ k ];
+		int end = coarseStarts[ k + 1 ];
+
+		std::vector< int > cursors( endBucket - firstBucket, 0 );
+		for( int j = begin; j < end; ++j )
+		{
+			++cursors[ coarseBuckets[ j ] - firstBucket ];
+		}
+
+		int start = begin;
+		for( int b = firstBucket; b < endBucket; ++b )
+		{
+			int count = cursors[ b - firstBucket ];
+			m_bucketStarts[ b ] = start;
+			cursors[ b - firstBucket ] = start;
+			start += count;
+		}
+
+		for( int j = begin; j < end; ++j )
+		{
+			m_sortedIndices[ cursors[ coarseBuckets[ j ] - firstBucket ]++ ] = coarseIndices[ j ];
+		}
+	} );
+
+	m_sortedPoints.resize( n );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		int end = std::min( ( b + 1 ) * BLOCK_SIZE, n );
+		for( int i = b * BLOCK_SIZE; i < end; ++i )
+		{
+			m_sortedPoints[ i ] = points[ m_sortedIndices[ i ] ];
+		}
+	} );
+
+	return true;
+}
+
+void SpatialHashGrid::clear()
+{
+	m_bounds = BoundingBox3f();
+	m_origin = Vector3f( 0, 0, 0 );
+	m_isDense = true;
+	for( int d = 0; d < 3; ++d )
+	{
+		m_maxCell[ d ] = 0;
+		m_resolution[ d ] = 0;
+	}
+	m_nBuckets = 0;
+	m_bucketStarts.clear();
+	m_sortedIndices.clear();
+	m_sortedPoints.clear();
+}
+
+int SpatialHashGrid::numPoints() const
+{
+	return static_cast< int >( m_sortedPoints.size() );
+}
+
+float SpatialHashGrid::cellSize() const
+{
+	return m_cellSize;
+}
+
+const BoundingBox3f& SpatialHashGrid::bounds() const
+{
+	return m_bounds;
+}
+
+bool SpatialHashGrid::isDense() const
+{
+	return m_isDense;
+}
+
+const std::vector< int >& SpatialHashGrid::sortedIndices() const
+{
+	return m_sortedIndices;
+}
+
+Vector3i SpatialHashGrid::cellOf( const Vector3f& p ) const
+{
+	Vector3i cell;
+	cellOf( p, cell.x, cell.y, cell.z );
+	return cell;
+}
+
+Vector3f SpatialHashGrid::cellOrigin( const Vector3i& cell ) const
+{
+	return m_origin + m_cellSize * Vector3f( static_cast< float >( cell.x ),
+		static_cast< float >( cell.y ), static_cast< float >( cell.z ) );
+}
+
+void SpatialHashGrid::radiusSearch( const Vector3f& query, float radius, std::vector< int >& indices ) const
+{
+	indices.clear();
+	forEachNeighbor( query, radius, [&]( int i, float )
+	{
+		indices.push_back( i );
+	} );
+}
+
+void SpatialHashGrid::radiusNeighbors( float radius,
+	std::vector< int >& offsets, std::vector< int >& neighbors ) const
+{
+	int n = numPoints();
+	int nBlocks = ( n + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+
+	// query in sorted order, so nearby queries run together
+	// each block gathers its neighbors, and where each query's neighbors start
+	std::vector< std::vector< int > > blockNeighbors( nBlocks );
+	std::vector< int > localStarts( n );
+	offsets.assign( n + 1, 0 );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		std::vector< int >& found = blockNeighbors[ b ];
+		int end = std::min( ( b + 1 ) * BLOCK_SIZE, n );
+		for( int j = b * BLOCK_SIZE; j < end; ++j )
+		{
+			int i = m_sortedIndices[ j ];
+			localStarts[ j ] = static_cast< int >( found.size() );
+			forEachNeighbor( m_sortedPoints[ j ], radius, [&]( int neighbor, float )
+			{
+				if( neighbor != i )
+				{
+					found.push_back( neighbor );
+				}
+			} );
+			offsets[ i + 1 ] = static_cast< int >( found.size() ) - localStarts[ j ];
+		}
+	} );
+
+	for( int i = 0; i < n; ++i )
+	{
+		offsets[ i + 1 ] += offsets[ i ];
+	}
+
+	neighbors.resize( offsets[ n ] );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		const std::vector< int >& found = blockNeighbors[ b ];
+		int end = std::min( ( b + 1 ) * BLOCK_SIZE, n );
+		for( int j = b * BLOCK_SIZE; j < end; ++j )
+		{
+			int i = m_sortedIndices[ j ];
+			std::copy( found.begin() + localStarts[ j ],
+				found.begin() + localStarts[ j ] + ( offsets[ i + 1 ] - offsets[ i ] ),
+				neighbors.begin() + offsets[ i ] );
+		}
+	} );
+}
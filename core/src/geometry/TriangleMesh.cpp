@@ -2,14 +2,30 @@
 
 #include <algorithm>
 #include <numeric>
-#include <stack>
 #include <cstdio>
 #include <cassert>
+#include <map>
 
+#include <ppl.h>
+
+#include "common/ConcurrentUnionFind.h"
+#include "common/ParallelSort.h"
 #include "common/ProgressReporter.h"
 #include "geometry/GeometryUtils.h"
+#include "geometry/TriangleMeshBVH.h"
+#include "geometry/VertexWelder.h"
+#include "io/OBJWriter.h"
 #include "math/MathUtils.h"
 
+namespace
+{
+	// the edge from vertex i to vertex j
+	inline uint64 directedEdgeKey( int i, int j )
+	{
+		return( ( static_cast< uint64 >( static_cast< uint32 >( i ) ) << 32 ) | static_cast< uint32 >( j ) );
+	}
+}
+
 TriangleMesh::TriangleMesh() :
 
 	m_adjacencyIsDirty( true )
@@ -37,13 +53,17 @@ TriangleMesh::TriangleMesh( std::shared_ptr< OBJData > pData ) :
 		m_normals = std::vector< Vector3f >( m_positions.size() );
 	}
 	
+	// faces of groups without normals get normal indices -1
+	// and leave the normals of their vertices alone
 	std::vector< Vector3i > normalIndices;
+	bool anyNormals = false;
 
 	int nGroups = pData->numGroups();
 	const auto& groups = pData->groups();
 	for( int g = 0; g < nGroups; ++g )
 	{
 		const OBJGroup& group = groups[ g ];
+		anyNormals |= group.hasNormals();
 		int nFaces = group.numFaces();
 		const auto& faces = group.faces();
 		for( int f = 0; f < nFaces; ++f )
@@ -59,7 +79,7 @@ TriangleMesh::TriangleMesh( std::shared_ptr< OBJData > pData ) :
 			else
 			{
 				int p0 = pFace.positionIndices()[ 0 ];
-				int n0 = pFace.normalIndices()[ 0 ];
+				int n0 = group.hasNormals() ? pFace.normalIndices()[ 0 ] : -1;
 
 				for( int i = 2; i < nVerticesInFace; ++i )
 				{
@@ -75,12 +95,16 @@ TriangleMesh::TriangleMesh( std::shared_ptr< OBJData > pData ) :
 
 						normalIndices.push_back( Vector3i( n0, n1, n2 ) );
 					}
+					else
+					{
+						normalIndices.push_back( Vector3i( -1 ) );
+					}
 				}				
 			}
 		}
 	}
 
-	if( normalIndices.size() > 0 )
+	if( anyNormals )
 	{
 		consolidateNormalsWithPositions( normalIndices );
 	}
@@ -184,10 +208,10 @@ int TriangleMesh::vertexOppositeEdge( int i, int j ) const
 
 int TriangleMesh::vertexOppositeEdge( const Vector2i& ij ) const
 {
-	auto itr = m_edgeToNextEdge.find( ij );
-	if( itr != m_edgeToNextEdge.end() )
+	int h = m_adjacency.findHalfEdge( ij.x, ij.y );
+	if( h != -1 )
 	{
-		return itr->second.y;
+		return m_adjacency.origin( TriangleMeshAdjacency::prev( h ) );
 	}
 	return -1;
 }
@@ -197,7 +221,7 @@ float TriangleMesh::meanEdgeLength()
 	float sum = 0;
 	for( auto itr = m_edgeLengths.begin(); itr != m_edgeLengths.end(); ++itr )
 	{
-		float len = itr->second;
+		float len = *itr;
 		sum += len;
 	}
 	return sum / m_edgeLengths.size();
@@ -241,6 +265,19 @@ bool TriangleMesh::obtuse( int faceIndex ) const
 bool TriangleMesh::intersectRay( const Vector3f& origin, const Vector3f& direction,
 	float& t, Vector3f& barycentrics, int& faceIndex, float tMin ) const
 {
+	if( m_bvh != nullptr )
+	{
+		TriangleMeshBVH::Hit bvhHit;
+		bool hit = m_bvh->intersectRay( origin, direction, bvhHit, tMin );
+		t = bvhHit.t;
+		if( hit )
+		{
+			barycentrics = bvhHit.barycentrics;
+			faceIndex = bvhHit.faceIndex;
+		}
+		return hit;
+	}
+
 	bool hit = false;
 	t = MathUtils::POSITIVE_INFINITY;
 
@@ -260,7 +297,8 @@ bool TriangleMesh::intersectRay( const Vector3f& origin, const Vector3f& directi
 			v0, v1, v2,
 			faceT, lambda );
 		if( faceHit &&
-			faceT > tMin )
+			faceT > tMin &&
+			faceT < t )
 		{
 			hit = true;
 			t = faceT;
@@ -272,6 +310,29 @@ bool TriangleMesh::intersectRay( const Vector3f& origin, const Vector3f& directi
 	return hit;
 }
 
+void TriangleMesh::buildBVH()
+{
+	m_bvh = std::make_shared< TriangleMeshBVH >( *this );
+}
+
+void TriangleMesh::refitBVH()
+{
+	if( m_bvh != nullptr )
+	{
+		// don't refit a BVH that copies of this mesh still use
+		if( m_bvh.use_count() > 1 )
+		{
+			m_bvh = std::make_shared< TriangleMeshBVH >( *m_bvh );
+		}
+		m_bvh->refit( *this );
+	}
+}
+
+const TriangleMeshBVH* TriangleMesh::bvh() const
+{
+	return m_bvh.get();
+}
+
 Vector3f TriangleMesh::barycentricInterpolatePosition( int faceIndex, const Vector3f& barycentrics ) const
 {
 	Vector3i vertexIndices = m_faces[ faceIndex ];
@@ -302,313 +363,160 @@ Vector3f TriangleMesh::barycentricInterpolateNormal( int faceIndex, const Vector
 	return normal.normalized();
 }
 
-TriangleMesh TriangleMesh::consolidate( const std::vector< int >& connectedComponent )
+TriangleMesh TriangleMesh::consolidate( const std::vector< int >& connectedComponent ) const
 {
 	TriangleMesh output;
+	if( !( connectedComponent.empty() ) )
+	{
+		consolidate( &( connectedComponent[ 0 ] ), static_cast< int >( connectedComponent.size() ), output );
+	}
+	return output;
+}
 
-	int nVertices = static_cast< int >( m_positions.size() );
-	std::vector< bool > touchedVertices( nVertices, false );
-
-	// walk over all faces in the component
-	// and mark all vertices that are used
-	int nFaces = static_cast< int >( connectedComponent.size() );
-	for( int i = 0; i < nFaces; ++i )
+std::vector< TriangleMesh > TriangleMesh::consolidateComponents() const
+{
+	int nComponents = numConnectedComponents();
+	std::vector< TriangleMesh > components( nComponents );
+	Concurrency::parallel_for( 0, nComponents, [&]( int c )
 	{
-		int f = connectedComponent[ i ];
-		Vector3i face = m_faces[f];
+		int begin = m_componentOffsets[ c ];
+		int end = m_componentOffsets[ c + 1 ];
+		consolidate( &( m_componentFaces[ begin ] ), end - begin, components[ c ] );
+	} );
+	return components;
+}
 
-		touchedVertices[ face.x ] = true;
-		touchedVertices[ face.y ] = true;
-		touchedVertices[ face.z ] = true;
-	}
+int TriangleMesh::pruneInvalidFaces()
+{
+	// walk over all faces
+	// a face is valid if none of its edges (v0,v1)
+	// is on an earlier valid face
+	// and we will throw the invalid faces away
+	int nFaces = numFaces();
 
-	// walk over all used vertices and assign them new indices [0, nUsedVertices)
-	// -1 is unused
-	std::vector< int > oldVertexToNewVertexMap( nVertices, -1 );
-	int nUsedVertices = 0;
-	for( int i = 0; i < nVertices; ++i )
+	// sort the directed edges, so that faces sharing one are next to each other
+	std::vector< std::pair< uint64, int > > edges( 3 * nFaces );
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
 	{
-		if( touchedVertices[i] )
+		for( int k = 0; k < 3; ++k )
 		{
-			oldVertexToNewVertexMap[i] = nUsedVertices;
-			++nUsedVertices;
+			edges[ 3 * f + k ] = std::make_pair( directedEdgeKey( m_faces[ f ][ k ], m_faces[ f ][ ( k + 1 ) % 3 ] ), f );
 		}
-	}
-
-	// now that we know how many used vertices there are
-	// resize output arrays
-	output.m_positions.resize( nUsedVertices );
-	output.m_normals.resize( nUsedVertices );
-	output.m_faces.resize( nFaces );
+	} );
+	ParallelSort::sort( edges );
 
-	// walk over all used vertices and copy them onto the output
-	for( int i = 0; i < nVertices; ++i )
+	// only faces with a shared edge can be invalid
+	std::vector< int > sharingFaces;
+	for( int i = 1; i < 3 * nFaces; ++i )
 	{
-		if( touchedVertices[i] )
+		if( edges[ i ].first == edges[ i - 1 ].first )
 		{
-			Vector3f p = m_positions[i];
-			Vector3f n = m_normals[i];
-
-			int j = oldVertexToNewVertexMap[i];			
-			
-			output.m_positions[j] = p;
-			output.m_normals[j] = n;
+			sharingFaces.push_back( edges[ i - 1 ].second );
+			sharingFaces.push_back( edges[ i ].second );
 		}
 	}
-
-	// walk over faces and assign them their new indices
-	for( int i = 0; i < nFaces; ++i )
+	if( sharingFaces.empty() )
 	{
-		int f = connectedComponent[i];
-		Vector3i face = m_faces[ f ];
-		
-		Vector3i newFace
-		(
-			oldVertexToNewVertexMap[ face.x ],
-			oldVertexToNewVertexMap[ face.y ],
-			oldVertexToNewVertexMap[ face.z ]
-		);
-
-		output.m_faces.push_back( newFace );
+		return 0;
 	}
+	std::sort( sharingFaces.begin(), sharingFaces.end() );
+	sharingFaces.erase( std::unique( sharingFaces.begin(), sharingFaces.end() ), sharingFaces.end() );
 
-	return output;
-}
-
-int TriangleMesh::pruneInvalidFaces( std::map< Vector2i, int >& edgeToFace )
-{
-	// walk over all faces
-	// build for each edge (v0,v1)
-	//   edgeToFace[ v0, v1 ] = face
-	//   if it already exists, we have a problem
-	//   and we will throw the face away
-
-	int nFaces = numFaces();
-	edgeToFace.clear();
-	//edgeToFace.reserve( 3 * nFaces );
-	std::vector< Vector3i > validFaces;
-	validFaces.reserve( nFaces );
-
-	//ProgressReporter pr( "Pruning invalid faces", nFaces );
-
+	// visit them in order, claiming the edges of the valid ones
+	std::map< uint64, int > edgeToFace;
+	std::vector< bool > isValid( nFaces, true );
 	int nPruned = 0;
-	for( int f = 0; f < nFaces; ++f )
+	for( int i = 0; i < static_cast< int >( sharingFaces.size() ); ++i )
 	{
+		int f = sharingFaces[ i ];
 		Vector3i face = m_faces[ f ];
 
-		Vector2i e0 = face.xy();
-		Vector2i e1 = face.yz();
-		Vector2i e2 = face.zx();
+		uint64 e[ 3 ];
+		bool isClaimed = false;
+		for( int k = 0; k < 3; ++k )
+		{
+			e[ k ] = directedEdgeKey( face[ k ], face[ ( k + 1 ) % 3 ] );
+			isClaimed = isClaimed || ( edgeToFace.find( e[ k ] ) != edgeToFace.end() );
+		}
 
-		if( edgeToFace.find( e0 ) == edgeToFace.end() &&
-			edgeToFace.find( e1 ) == edgeToFace.end() &&
-			edgeToFace.find( e2 ) == edgeToFace.end() )
+		if( !isClaimed )
 		{
-			edgeToFace[ e0 ] = f;
-			edgeToFace[ e1 ] = f;
-			edgeToFace[ e2 ] = f;
-			validFaces.push_back( face );
+			for( int k = 0; k < 3; ++k )
+			{
+				edgeToFace[ e[ k ] ] = f;
+			}
 		}
 		else
 		{
 			++nPruned;
+			isValid[ f ] = false;
 
 			fprintf( stderr, "Found invalid face: (%d, %d, %d)\n",
 				face.x, face.y, face.z );
-			
-			if( edgeToFace.find( e0 ) != edgeToFace.end() )
-			{
-				Vector3i existingFace = m_faces[ edgeToFace[ e0 ] ];
-				fprintf( stderr, "Existing face: (%d, %d, %d)\n",
-					existingFace.x, existingFace.y, existingFace.z );
-			}
-			if( edgeToFace.find( e1 ) != edgeToFace.end() )
-			{
-				Vector3i existingFace = m_faces[ edgeToFace[ e1 ] ];
-				fprintf( stderr, "Existing face: (%d, %d, %d)\n",
-					existingFace.x, existingFace.y, existingFace.z );
-			}
-			if( edgeToFace.find( e2 ) != edgeToFace.end() )
+
+			for( int k = 0; k < 3; ++k )
 			{
-				Vector3i existingFace = m_faces[ edgeToFace[ e2 ] ];
-				fprintf( stderr, "Existing face: (%d, %d, %d)\n",
-					existingFace.x, existingFace.y, existingFace.z );
+				auto itr = edgeToFace.find( e[ k ] );
+				if( itr != edgeToFace.end() )
+				{
+					Vector3i existingFace = m_faces[ itr->second ];
+					fprintf( stderr, "Existing face: (%d, %d, %d)\n",
+						existingFace.x, existingFace.y, existingFace.z );
+				}
 			}
 		}
-
-		//pr.notifyAndPrintProgressString();
 	}
 	if( nPruned > 0 )
 	{
 		fprintf( stderr, "Pruned %d faces\n", nPruned );
+
+		std::vector< Vector3i > validFaces;
+		validFaces.reserve( nFaces - nPruned );
+		for( int f = 0; f < nFaces; ++f )
+		{
+			if( isValid[ f ] )
+			{
+				validFaces.push_back( m_faces[ f ] );
+			}
+		}
 		m_faces = validFaces;
+		invalidateDerivedData();
 	}
 
 	return nPruned;
 }
 
-void TriangleMesh::buildAdjacency()
+bool TriangleMesh::weldVertices( float tolerance )
 {
-	int nPruned = pruneInvalidFaces( m_edgeToFace );
-
-	int nFaces = numFaces();
-
-	// walk over all faces
-	// and build an adjacency map:
-	// edge -> adjacent face
-	// if nothing was pruned, then it's already valid
-	if( nPruned != 0 )
+	std::vector< int > vertexMap;
+	int nWeldedVertices;
+	if( !VertexWelder::weld( m_positions, tolerance, vertexMap, nWeldedVertices ) )
 	{
-		m_edgeToFace.clear();
-
-		for( int f = 0; f < nFaces; ++f )
-		{
-			Vector3i face = m_faces[ f ];
-
-			Vector2i e0 = face.xy();
-			Vector2i e1 = face.yz();
-			Vector2i e2 = face.zx();
-
-			m_edgeToFace[ e0 ] = f;
-			m_edgeToFace[ e1 ] = f;
-			m_edgeToFace[ e2 ] = f;
-		}
-	}
-
-	// build face to face adjacency
-	// for each face:
-	//    find 3 edges
-	//    flip edge: if the flipped edge has an adjacent face
-	//       add it as a neighbor of this face
-	m_faceToFace.clear();
-	m_faceToFace.resize( nFaces );
-	for( int f = 0; f < nFaces; ++f )
-	{
-		Vector3i face = m_faces[ f ];
-		// get 3 edge twins
-		Vector2i e0t = face.yx();
-		Vector2i e1t = face.zy();
-		Vector2i e2t = face.xz();
-
-		if( m_edgeToFace.find( e0t ) != m_edgeToFace.end() )
-		{
-			m_faceToFace[ f ].push_back( m_edgeToFace[ e0t ] );
-		}
-		if( m_edgeToFace.find( e1t ) != m_edgeToFace.end() )
-		{
-			m_faceToFace[ f ].push_back( m_edgeToFace[ e1t ] );
-		}
-		if( m_edgeToFace.find( e2t ) != m_edgeToFace.end() )
-		{
-			m_faceToFace[ f ].push_back( m_edgeToFace[ e2t ] );
-		}
+		return false;
 	}
 
-	// build edge to next edge adjacency
-	// iterate over all faces
-	m_edgeToPrevEdge.clear();
-	m_edgeToNextEdge.clear();
-	for( int f = 0; f < nFaces; ++f )
-	{
-		Vector3i face = m_faces[ f ];
+	std::vector< Vector3f > weldedPositions;
+	VertexWelder::weldPositions( m_positions, vertexMap, nWeldedVertices, weldedPositions );
+	m_positions.swap( weldedPositions );
 
-		Vector2i e0 = face.xy();
-		Vector2i e1 = face.yz();
-		Vector2i e2 = face.zx();
-
-		m_edgeToPrevEdge[ e0 ] = e2;
-		m_edgeToPrevEdge[ e1 ] = e0;
-		m_edgeToPrevEdge[ e2 ] = e1;
-
-		m_edgeToNextEdge[ e0 ] = e1;
-		m_edgeToNextEdge[ e1 ] = e2;
-		m_edgeToNextEdge[ e2 ] = e0;
-	}
-
-	// build vertex to outgoing edge adjacency
-	int nVertices = numVertices();
-	m_vertexToOutgoingEdge.clear();
-	m_vertexToOutgoingEdge.resize( nVertices );
-	for( int f = 0; f < nFaces; ++f )
+	if( m_normals.size() == vertexMap.size() )
 	{
-		Vector3i face = m_faces[ f ];
-		m_vertexToOutgoingEdge[ face[0] ] = face[ 1 ];
-		m_vertexToOutgoingEdge[ face[1] ] = face[ 2 ];
-		m_vertexToOutgoingEdge[ face[2] ] = face[ 0 ];
+		std::vector< Vector3f > weldedNormals;
+		VertexWelder::weldNormals( m_normals, vertexMap, nWeldedVertices, weldedNormals );
+		m_normals.swap( weldedNormals );
 	}
 
-	// build vertex to vertex (one-ring neighborhoods)
-	// for each vertex v
-	//   start with initial outgoing edge
-	//   next edge = edge->next->next->twin
-	m_oneRingIsClosed.clear();
-	m_vertexToVertex.clear();
-	m_vertexToFace.clear();
-	m_oneRingIsClosed.resize( nVertices );
-	m_vertexToVertex.resize( nVertices );
-	m_vertexToFace.resize( nVertices );
-	for( int v = 0; v < nVertices; ++v )
-	{
-		Vector2i initialOutgoingEdge( v, m_vertexToOutgoingEdge[ v ] );
-
-		m_vertexToVertex[ v ].push_back( initialOutgoingEdge.y );
-		m_vertexToFace[ v ].push_back( m_edgeToFace[ initialOutgoingEdge ] );
-
-		Vector2i nextIncomingEdge = m_edgeToNextEdge[ m_edgeToNextEdge[ initialOutgoingEdge ] ];
-		Vector2i nextOutgoingEdge = nextIncomingEdge.yx();
-
-		while( !( isBoundaryEdge( nextIncomingEdge ) ) &&
-			nextOutgoingEdge != initialOutgoingEdge )
-		{
-			m_vertexToVertex[ v ].push_back( nextIncomingEdge.x );
-			m_vertexToFace[ v ].push_back( m_edgeToFace[ nextOutgoingEdge ] );
-
-			nextIncomingEdge = m_edgeToNextEdge[ m_edgeToNextEdge[ nextOutgoingEdge ] ];
-			nextOutgoingEdge = nextIncomingEdge.yx();
-		}
-
-		// if we looped around, great, we're done
-		// otherwise, we hit a boundary, need to go the other way around!
-		if( isBoundaryEdge( nextIncomingEdge ) )
-		{
-			m_oneRingIsClosed[ v ] = false;
-
-			// don't forget to push on the last vertex
-			m_vertexToVertex[ v ].push_back( nextIncomingEdge.x );
-			// no face
-
-			// check that the initial outgoing edge is not a boundary
-			// (otherwise we're done)
-
-			if( isBoundaryEdge( initialOutgoingEdge ) )
-			{
-				continue;
-			}
-			
-			// flip orientation: start from the initial outgoing edge
-			// and go clockwise, pushing to the front
-			Vector2i initialIncomingEdge = initialOutgoingEdge.yx();
-
-			nextOutgoingEdge = m_edgeToNextEdge[ initialIncomingEdge ];
-			nextIncomingEdge = nextOutgoingEdge.yx();
-			while( !( isBoundaryEdge( nextOutgoingEdge ) ) )
-			{
-				m_vertexToVertex[ v ].push_front( nextOutgoingEdge.y );
-				m_vertexToFace[ v ].push_front( m_edgeToFace[ nextOutgoingEdge ] );
+	VertexWelder::remapFaces( vertexMap, m_faces );
+	invalidateDerivedData();
 
-				nextOutgoingEdge = m_edgeToNextEdge[ nextIncomingEdge ];
-				nextIncomingEdge = nextOutgoingEdge.yx();
-			}
+	return true;
+}
 
-			// don't forget the last vertex
-			m_vertexToVertex[ v ].push_front( nextOutgoingEdge.y );
-			m_vertexToFace[ v ].push_front( m_edgeToFace[ nextOutgoingEdge ] );
-		}
-		else
-		{
-			m_oneRingIsClosed[ v ] = true;
-		}
-	}
+void TriangleMesh::buildAdjacency()
+{
+	pruneInvalidFaces();
+	m_adjacency.build( m_faces, numVertices() );
+	m_adjacencyIsDirty = false;
 }
 
 void TriangleMesh::invalidateAdjancency()
@@ -616,51 +524,85 @@ void TriangleMesh::invalidateAdjancency()
 	m_adjacencyIsDirty = true;
 }
 
-void TriangleMesh::computeConnectedComponents()
+const TriangleMeshAdjacency& TriangleMesh::adjacency() const
 {
-	m_connectedComponents.clear();
+	return m_adjacency;
+}
 
-	// build a bit vector of length nFaces
-	// set them all to true for now
-	int nFaces = numFaces();
-	std::vector< bool > remainingFaces( nFaces, true );
+void TriangleMesh::computeConnectedComponents( bool vertexConnectivity )
+{
+	if( !vertexConnectivity && ( m_adjacencyIsDirty || m_adjacency.numFaces() != numFaces() ) )
+	{
+		buildAdjacency();
+	}
 
-	// loop until out of faces
-	auto rootItr = std::find( remainingFaces.begin(), remainingFaces.end(), true );
-	while( rootItr != remainingFaces.end() )
+	int nFaces = numFaces();
+	int nComponents = 0;
+	if( vertexConnectivity )
 	{
-		int rootFaceIndex = static_cast< int >( rootItr - remainingFaces.begin() );
-		std::vector< int > connectedComponent;
-		
-		// start with a root face and push it onto the stack
-		// while the stack is not empty
-		//    pop a face off the stack and add it to the component
-		//    mark it as taken
-		//    then add its adjacent faces onto the stack
-		std::stack< int > adjStack;
-		adjStack.push( rootFaceIndex );
-		remainingFaces[ rootFaceIndex ] = false;
-		while( !( adjStack.empty() ) )
+		int nVertices = numVertices();
+		ConcurrentUnionFind vertexSets( nVertices );
+		Concurrency::parallel_for( 0, nFaces, [&]( int f )
 		{
-			int currentFaceIndex = adjStack.top();
-			adjStack.pop();
-			
-			connectedComponent.push_back( currentFaceIndex );
+			vertexSets.unite( m_faces[ f ].x, m_faces[ f ].y );
+			vertexSets.unite( m_faces[ f ].y, m_faces[ f ].z );
+		} );
 
-			for( int i = 0; i < m_faceToFace[ currentFaceIndex ].size(); ++i )
+		// number the components in the order of their first face
+		std::vector< int > rootToComponent( nVertices, -1 );
+		m_faceToComponent.resize( nFaces );
+		for( int f = 0; f < nFaces; ++f )
+		{
+			int& component = rootToComponent[ vertexSets.find( m_faces[ f ].x ) ];
+			if( component == -1 )
 			{
-				int adjacentFaceIndex = m_faceToFace[ currentFaceIndex ][ i ];
-				if( remainingFaces[ adjacentFaceIndex ] )
-				{
-					adjStack.push( adjacentFaceIndex );
-					remainingFaces[ adjacentFaceIndex ] = false;
-				}
+				component = nComponents;
+				++nComponents;
 			}
+			m_faceToComponent[ f ] = component;
 		}
+	}
+	else
+	{
+		// each edge joins the faces on either side
+		ConcurrentUnionFind faceSets( nFaces );
+		Concurrency::parallel_for( 0, 3 * nFaces, [&]( int h )
+		{
+			int o = m_adjacency.opposite( h );
+			if( o > h )
+			{
+				faceSets.unite( TriangleMeshAdjacency::face( h ), TriangleMeshAdjacency::face( o ) );
+			}
+		} );
 
-		m_connectedComponents.push_back( connectedComponent );
-		rootItr = std::find( remainingFaces.begin(), remainingFaces.end(), true );
+		// a set's root is its first face
+		nComponents = faceSets.labelSets( m_faceToComponent );
 	}
+
+	// bucket the faces by component
+	m_componentOffsets.assign( nComponents + 1, 0 );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		++( m_componentOffsets[ m_faceToComponent[ f ] + 1 ] );
+	}
+	for( int c = 0; c < nComponents; ++c )
+	{
+		m_componentOffsets[ c + 1 ] += m_componentOffsets[ c ];
+	}
+
+	std::vector< int > componentEnds( m_componentOffsets.begin(), m_componentOffsets.end() - 1 );
+	m_componentFaces.resize( nFaces );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		int& end = componentEnds[ m_faceToComponent[ f ] ];
+		m_componentFaces[ end ] = f;
+		++end;
+	}
+}
+
+int TriangleMesh::numConnectedComponents() const
+{
+	return m_componentOffsets.empty() ? 0 : static_cast< int >( m_componentOffsets.size() ) - 1;
 }
 
 void TriangleMesh::computeAreas()
@@ -685,21 +627,25 @@ void TriangleMesh::computeAreas()
 
 void TriangleMesh::computeEdgeLengths()
 {
-	for( auto itr = m_edgeToFace.begin(); itr != m_edgeToFace.end(); ++itr )
-	{
-		Vector2i vertexIndices = itr->first;
+	int nFaces = numFaces();
+	m_edgeLengths.resize( 3 * nFaces );
 
-		Vector3f p0 = m_positions[ vertexIndices.x ];
-		Vector3f p1 = m_positions[ vertexIndices.y ];
+	for( int f = 0; f < nFaces; ++f )
+	{
+		Vector3i face = m_faces[ f ];
+		for( int k = 0; k < 3; ++k )
+		{
+			Vector3f p0 = m_positions[ face[ k ] ];
+			Vector3f p1 = m_positions[ face[ ( k + 1 ) % 3 ] ];
 
-		m_edgeLengths[ vertexIndices ] = ( p1 - p0 ).norm();
+			m_edgeLengths[ 3 * f + k ] = ( p1 - p0 ).norm();
+		}
 	}
 }
 
-bool TriangleMesh::isBoundaryEdge( const Vector2i& edge )
+bool TriangleMesh::isBoundaryEdge( const Vector2i& edge ) const
 {
-	// TODO: check cache
-	return m_edgeToFace.find( edge.yx() ) == m_edgeToFace.end();
+	return( m_adjacency.findHalfEdge( edge.y, edge.x ) == -1 );
 }
 
 void TriangleMesh::consolidateNormalsWithPositions( const std::vector< Vector3i >& normalIndices )
@@ -717,36 +663,70 @@ void TriangleMesh::consolidateNormalsWithPositions( const std::vector< Vector3i
 			int pIndex = pIndices[i];
 			int nIndex = nIndices[i];
 
-			Vector3f normal = m_normals[ nIndex ];
-			outputNormalIndices[ pIndex ] = normal;
+			if( nIndex >= 0 )
+			{
+				Vector3f normal = m_normals[ nIndex ];
+				outputNormalIndices[ pIndex ] = normal;
+			}
 		}
 	}
 
 	m_normals = outputNormalIndices;
 }
 
-void TriangleMesh::saveOBJ( QString filename )
+bool TriangleMesh::saveOBJ( QString filename, int precision ) const
 {
-	FILE* fp = fopen( qPrintable( filename ), "w" );
+	return OBJWriter::write( filename, *this, precision );
+}
 
-	for( int i = 0; i < m_positions.size(); ++i )
+void TriangleMesh::consolidate( const int* faceIndices, int nFaces, TriangleMesh& output ) const
+{
+	// the vertices used by the faces, in increasing order
+	std::vector< int > usedVertices( 3 * nFaces );
+	for( int i = 0; i < nFaces; ++i )
 	{
-		Vector3f p = m_positions[i];
-		fprintf( fp, "v %f %f %f\n", p.x, p.y, p.z );
+		Vector3i face = m_faces[ faceIndices[ i ] ];
+		usedVertices[ 3 * i ] = face.x;
+		usedVertices[ 3 * i + 1 ] = face.y;
+		usedVertices[ 3 * i + 2 ] = face.z;
 	}
+	std::sort( usedVertices.begin(), usedVertices.end() );
+	usedVertices.erase( std::unique( usedVertices.begin(), usedVertices.end() ), usedVertices.end() );
 
-	for( int i = 0; i < m_normals.size(); ++i )
+	int nUsedVertices = static_cast< int >( usedVertices.size() );
+	bool hasNormals = ( m_normals.size() == m_positions.size() );
+
+	output.m_positions.resize( nUsedVertices );
+	output.m_normals.resize( hasNormals ? nUsedVertices : 0 );
+	for( int j = 0; j < nUsedVertices; ++j )
 	{
-		Vector3f n = m_normals[i];
-		fprintf( fp, "vn %f %f %f\n", n.x, n.y, n.z );
+		output.m_positions[ j ] = m_positions[ usedVertices[ j ] ];
+		if( hasNormals )
+		{
+			output.m_normals[ j ] = m_normals[ usedVertices[ j ] ];
+		}
 	}
 
-	for( int i = 0; i < m_faces.size(); ++i )
+	// a vertex's new index is its position in usedVertices
+	output.m_faces.resize( nFaces );
+	for( int i = 0; i < nFaces; ++i )
 	{
-		Vector3i f = m_faces[ i ];
-		fprintf( fp, "f %d//%d %d//%d %d//%d\n",
-			f.x + 1, f.x + 1, f.y + 1, f.y + 1, f.z + 1, f.z + 1 );
+		Vector3i face = m_faces[ faceIndices[ i ] ];
+		for( int k = 0; k < 3; ++k )
+		{
+			output.m_faces[ i ][ k ] = static_cast< int >(
+				std::lower_bound( usedVertices.begin(), usedVertices.end(), face[ k ] ) - usedVertices.begin() );
+		}
 	}
+}
 
-	fclose( fp );
+void TriangleMesh::invalidateDerivedData()
+{
+	m_adjacencyIsDirty = true;
+	m_bvh.reset();
+	m_componentOffsets.clear();
+	m_componentFaces.clear();
+	m_faceToComponent.clear();
+	m_areas.clear();
+	m_edgeLengths.clear();
 }
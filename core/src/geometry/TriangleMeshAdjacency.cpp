@@ -0,0 +1,263 @@
+#include "geometry/TriangleMeshAdjacency.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <ppl.h>
+
+#include "common/BasicTypes.h"
+#include "common/ParallelSort.h"
+
+namespace
+{
+	// the undirected edge between vertices i and j
+	inline uint64 edgeKey( int i, int j )
+	{
+		uint64 lo = static_cast< uint32 >( std::min( i, j ) );
+		uint64 hi = static_cast< uint32 >( std::max( i, j ) );
+		return( ( lo << 32 ) | hi );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+TriangleMeshAdjacency::TriangleMeshAdjacency() :
+
+	m_oneRingOffsets( 1, 0 )
+
+{
+
+}
+
+TriangleMeshAdjacency::TriangleMeshAdjacency( const std::vector< Vector3i >& faces, int nVertices )
+{
+	build( faces, nVertices );
+}
+
+void TriangleMeshAdjacency::build( const std::vector< Vector3i >& faces, int nVertices )
+{
+	int nFaces = static_cast< int >( faces.size() );
+	int nHalfEdges = 3 * nFaces;
+
+	m_origins.resize( nHalfEdges );
+	m_opposites.assign( nHalfEdges, -1 );
+
+	// sort the half edges by their undirected edge
+	// so that the half edges of an edge are next to each other
+	std::vector< std::pair< uint64, int > > edges( nHalfEdges );
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			int h = 3 * f + k;
+			int v0 = faces[ f ][ k ];
+			int v1 = faces[ f ][ ( k + 1 ) % 3 ];
+			m_origins[ h ] = v0;
+			edges[ h ] = std::make_pair( edgeKey( v0, v1 ), h );
+		}
+	} );
+	ParallelSort::sort( edges );
+
+	// each run of half edges on the same edge is handled by its first one
+	// only runs of 2 in opposite directions are linked
+	Concurrency::parallel_for( 0, nHalfEdges, [&]( int i )
+	{
+		uint64 key = edges[ i ].first;
+		if( i > 0 && edges[ i - 1 ].first == key )
+		{
+			return;
+		}
+		if( i + 1 >= nHalfEdges || edges[ i + 1 ].first != key ||
+			( i + 2 < nHalfEdges && edges[ i + 2 ].first == key ) )
+		{
+			return;
+		}
+
+		int h0 = edges[ i ].second;
+		int h1 = edges[ i + 1 ].second;
+		if( m_origins[ h0 ] != m_origins[ h1 ] )
+		{
+			m_opposites[ h0 ] = h1;
+			m_opposites[ h1 ] = h0;
+		}
+	} );
+
+	// bucket the half edges by origin
+	m_oneRingOffsets.assign( nVertices + 1, 0 );
+	for( int h = 0; h < nHalfEdges; ++h )
+	{
+		++( m_oneRingOffsets[ m_origins[ h ] + 1 ] );
+	}
+	for( int v = 0; v < nVertices; ++v )
+	{
+		m_oneRingOffsets[ v + 1 ] += m_oneRingOffsets[ v ];
+	}
+
+	std::vector< int > ringEnds( m_oneRingOffsets.begin(), m_oneRingOffsets.end() - 1 );
+	m_oneRings.resize( nHalfEdges );
+	for( int h = 0; h < nHalfEdges; ++h )
+	{
+		int& end = ringEnds[ m_origins[ h ] ];
+		m_oneRings[ end ] = h;
+		++end;
+	}
+
+	Concurrency::parallel_for( 0, nVertices, [&]( int v )
+	{
+		sortOneRing( v );
+	} );
+}
+
+int TriangleMeshAdjacency::numVertices() const
+{
+	return static_cast< int >( m_oneRingOffsets.size() ) - 1;
+}
+
+int TriangleMeshAdjacency::numFaces() const
+{
+	return numHalfEdges() / 3;
+}
+
+int TriangleMeshAdjacency::numHalfEdges() const
+{
+	return static_cast< int >( m_origins.size() );
+}
+
+// static
+int TriangleMeshAdjacency::face( int h )
+{
+	return h / 3;
+}
+
+// static
+int TriangleMeshAdjacency::next( int h )
+{
+	return( ( h % 3 == 2 ) ? ( h - 2 ) : ( h + 1 ) );
+}
+
+// static
+int TriangleMeshAdjacency::prev( int h )
+{
+	return( ( h % 3 == 0 ) ? ( h + 2 ) : ( h - 1 ) );
+}
+
+int TriangleMeshAdjacency::origin( int h ) const
+{
+	return m_origins[ h ];
+}
+
+int TriangleMeshAdjacency::target( int h ) const
+{
+	return m_origins[ next( h ) ];
+}
+
+int TriangleMeshAdjacency::opposite( int h ) const
+{
+	return m_opposites[ h ];
+}
+
+bool TriangleMeshAdjacency::isBoundary( int h ) const
+{
+	return( m_opposites[ h ] == -1 );
+}
+
+int TriangleMeshAdjacency::oppositeFace( int h ) const
+{
+	int o = m_opposites[ h ];
+	return( ( o == -1 ) ? -1 : face( o ) );
+}
+
+int TriangleMeshAdjacency::findHalfEdge( int i, int j ) const
+{
+	if( i < 0 || i >= numVertices() )
+	{
+		return -1;
+	}
+
+	const int* end = oneRingEnd( i );
+	for( const int* itr = oneRingBegin( i ); itr != end; ++itr )
+	{
+		if( target( *itr ) == j )
+		{
+			return *itr;
+		}
+	}
+	return -1;
+}
+
+int TriangleMeshAdjacency::oneRingSize( int v ) const
+{
+	return m_oneRingOffsets[ v + 1 ] - m_oneRingOffsets[ v ];
+}
+
+const int* TriangleMeshAdjacency::oneRingBegin( int v ) const
+{
+	return m_oneRings.empty() ? nullptr : &( m_oneRings[ 0 ] ) + m_oneRingOffsets[ v ];
+}
+
+const int* TriangleMeshAdjacency::oneRingEnd( int v ) const
+{
+	return m_oneRings.empty() ? nullptr : &( m_oneRings[ 0 ] ) + m_oneRingOffsets[ v + 1 ];
+}
+
+bool TriangleMeshAdjacency::isOneRingClosed( int v ) const
+{
+	int n = oneRingSize( v );
+	if( n == 0 )
+	{
+		return false;
+	}
+
+	// the last half edge's counterclockwise neighbor is the first
+	const int* ring = oneRingBegin( v );
+	return( m_opposites[ prev( ring[ n - 1 ] ) ] == ring[ 0 ] );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+void TriangleMeshAdjacency::sortOneRing( int v )
+{
+	int n = oneRingSize( v );
+	if( n == 0 )
+	{
+		return;
+	}
+
+	int* ring = &( m_oneRings[ m_oneRingOffsets[ v ] ] );
+	int nPlaced = 0;
+	while( nPlaced < n )
+	{
+		// start a fan at a boundary half edge if there is one:
+		// there's no face clockwise of it
+		int start = nPlaced;
+		for( int i = nPlaced; i < n; ++i )
+		{
+			if( m_opposites[ ring[ i ] ] == -1 )
+			{
+				start = i;
+				break;
+			}
+		}
+		std::swap( ring[ nPlaced ], ring[ start ] );
+		int h = ring[ nPlaced ];
+		++nPlaced;
+
+		// the next half edge counterclockwise is opposite( prev( h ) )
+		// the fan ends at a boundary or when it loops back around
+		for( ;; )
+		{
+			int* found = std::find( ring + nPlaced, ring + n, m_opposites[ prev( h ) ] );
+			if( found == ring + n )
+			{
+				break;
+			}
+			std::swap( ring[ nPlaced ], *found );
+			h = ring[ nPlaced ];
+			++nPlaced;
+		}
+	}
+}
@@ -0,0 +1,889 @@
+#include "geometry/TriangleMeshBVH.h"
+
+#include <algorithm>
+
+#include <emmintrin.h>
+#include <ppl.h>
+
+#include "geometry/GeometryUtils.h"
+#include "geometry/RayBatch.h"
+#include "geometry/TriangleMesh.h"
+#include "math/SSEUtils.h"
+
+namespace
+{
+	static_assert( sizeof( TriangleMeshBVH::Node ) == 32, "TriangleMeshBVH::Node must be 32 bytes" );
+
+	// relative costs of visiting a node and intersecting a triangle
+	const float TRAVERSAL_COST = 1.f;
+	const float INTERSECTION_COST = 1.f;
+
+	// past this depth, nodes are split at the median
+	// which bounds the depth (and the traversal stack) by MAX_SAH_DEPTH + 31
+	const int MAX_SAH_DEPTH = 48;
+	const int TRAVERSAL_STACK_SIZE = 96;
+
+	// widens the far end of a ray / box interval
+	// so that rounding can't cull a box whose triangle the ray hits
+	const float BOX_EXIT_SCALE = 1.f + 4e-7f;
+
+	float surfaceArea( const Vector3f& boundsMin, const Vector3f& boundsMax )
+	{
+		Vector3f d = boundsMax - boundsMin;
+		if( d.x < 0 || d.y < 0 || d.z < 0 )
+		{
+			return 0;
+		}
+		return 2 * ( d.x * d.y + d.y * d.z + d.z * d.x );
+	}
+
+	// the interval test is written so that NaNs (0 * inf)
+	// leave the interval unchanged
+	inline bool intersectsBox( const TriangleMeshBVH::Node& node,
+		const Vector3f& origin, const Vector3f& invDirection,
+		float tMin, float tMax )
+	{
+		float tEnter = tMin;
+		float tExit = tMax;
+		for( int a = 0; a < 3; ++a )
+		{
+			float t0 = ( node.boundsMin[ a ] - origin[ a ] ) * invDirection[ a ];
+			float t1 = ( node.boundsMax[ a ] - origin[ a ] ) * invDirection[ a ];
+			if( invDirection[ a ] < 0 )
+			{
+				std::swap( t0, t1 );
+			}
+			t1 *= BOX_EXIT_SCALE;
+
+			tEnter = ( t0 > tEnter ) ? t0 : tEnter;
+			tExit = ( t1 < tExit ) ? t1 : tExit;
+		}
+		return( tEnter <= tExit );
+	}
+}
+
+// 4 rays in SSE registers, one per lane
+struct TriangleMeshBVH::RayPacket
+{
+	RayPacket( const RayBatch& rays, int first, int nRays );
+
+	// intersectsBox for each lane:
+	// all ones in the lanes whose ray overlaps [ boundsMin, boundsMax ]
+	__m128 intersectsBox( const Node& node ) const;
+
+	// GeometryUtils::rayTriangleIntersection for each lane,
+	// computed in the same order so the results are identical
+	// returns all ones in the lanes that hit with t in (tMin, tMax)
+	__m128 intersectTriangle( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
+		__m128& t, __m128& u, __m128& v ) const;
+
+	__m128 origin[ 3 ];
+	__m128 direction[ 3 ];
+	__m128 invDirection[ 3 ];
+
+	// all ones in the lanes whose ray is negative along each axis
+	__m128 isNegative[ 3 ];
+
+	// whether the near child along each axis is the second one for most rays
+	bool visitSecondFirst[ 3 ];
+
+	__m128 tMin;
+	__m128 tMax;
+
+	// all ones in the lanes that are still being traced
+	__m128 active;
+};
+
+struct TriangleMeshBVH::BuildContext
+{
+	// per mesh face
+	std::vector< Vector3f > faceMin;
+	std::vector< Vector3f > faceMax;
+	std::vector< Vector3f > centroids;
+
+	int minLeafSize;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+const int TriangleMeshBVH::NUM_BINS = 16;
+
+// static
+const int TriangleMeshBVH::PARALLEL_BUILD_THRESHOLD = 4096;
+
+// static
+const int TriangleMeshBVH::MAX_LEAF_SIZE = 16;
+
+// static
+const int TriangleMeshBVH::PACKET_SIZE = 4;
+
+bool TriangleMeshBVH::Node::isLeaf() const
+{
+	return( nFaces > 0 );
+}
+
+TriangleMeshBVH::Hit::Hit() :
+
+	t( std::numeric_limits< float >::infinity() ),
+	barycentrics( 0, 0, 0 ),
+	faceIndex( -1 )
+
+{
+
+}
+
+TriangleMeshBVH::TriangleMeshBVH()
+{
+
+}
+
+TriangleMeshBVH::TriangleMeshBVH( const TriangleMesh& mesh, int minLeafSize )
+{
+	build( mesh, minLeafSize );
+}
+
+void TriangleMeshBVH::build( const TriangleMesh& mesh, int minLeafSize )
+{
+	m_nodes.clear();
+	m_faceIndices.clear();
+	m_vertices.clear();
+
+	int nFaces = mesh.numFaces();
+	if( nFaces == 0 )
+	{
+		return;
+	}
+
+	const std::vector< Vector3f >& positions = mesh.positions();
+	const std::vector< Vector3i >& faces = mesh.faces();
+
+	BuildContext context;
+	context.minLeafSize = std::max( 1, std::min( minLeafSize, MAX_LEAF_SIZE ) );
+	context.faceMin.resize( nFaces );
+	context.faceMax.resize( nFaces );
+	context.centroids.resize( nFaces );
+	m_faceIndices.resize( nFaces );
+
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
+	{
+		const Vector3f& v0 = positions[ faces[ f ][ 0 ] ];
+		const Vector3f& v1 = positions[ faces[ f ][ 1 ] ];
+		const Vector3f& v2 = positions[ faces[ f ][ 2 ] ];
+
+		context.faceMin[ f ] = Vector3f::minimum( v0, Vector3f::minimum( v1, v2 ) );
+		context.faceMax[ f ] = Vector3f::maximum( v0, Vector3f::maximum( v1, v2 ) );
+		context.centroids[ f ] = 0.5f * ( context.faceMin[ f ] + context.faceMax[ f ] );
+		m_faceIndices[ f ] = f;
+	} );
+
+	// about 2 * nFaces / minLeafSize nodes
+	m_nodes.reserve( 2 * nFaces / context.minLeafSize + 1 );
+	buildSubtree( context, 0, nFaces, 0, m_nodes );
+
+	gatherVertices( mesh );
+}
+
+void TriangleMeshBVH::refit( const TriangleMesh& mesh )
+{
+	if( isEmpty() )
+	{
+		return;
+	}
+
+	gatherVertices( mesh );
+
+	// children are stored after their parents
+	for( int n = numNodes() - 1; n >= 0; --n )
+	{
+		Node& node = m_nodes[ n ];
+		if( node.isLeaf() )
+		{
+			const Vector3f* vertices = &( m_vertices[ 3 * node.offset ] );
+			Vector3f boundsMin = vertices[ 0 ];
+			Vector3f boundsMax = vertices[ 0 ];
+			for( int i = 1; i < 3 * node.nFaces; ++i )
+			{
+				boundsMin = Vector3f::minimum( boundsMin, vertices[ i ] );
+				boundsMax = Vector3f::maximum( boundsMax, vertices[ i ] );
+			}
+			node.boundsMin = boundsMin;
+			node.boundsMax = boundsMax;
+		}
+		else
+		{
+			const Node& first = m_nodes[ n + 1 ];
+			const Node& second = m_nodes[ node.offset ];
+			node.boundsMin = Vector3f::minimum( first.boundsMin, second.boundsMin );
+			node.boundsMax = Vector3f::maximum( first.boundsMax, second.boundsMax );
+		}
+	}
+}
+
+bool TriangleMeshBVH::isEmpty() const
+{
+	return m_nodes.empty();
+}
+
+int TriangleMeshBVH::numFaces() const
+{
+	return static_cast< int >( m_faceIndices.size() );
+}
+
+int TriangleMeshBVH::numNodes() const
+{
+	return static_cast< int >( m_nodes.size() );
+}
+
+const std::vector< TriangleMeshBVH::Node >& TriangleMeshBVH::nodes() const
+{
+	return m_nodes;
+}
+
+BoundingBox3f TriangleMeshBVH::boundingBox() const
+{
+	if( isEmpty() )
+	{
+		return BoundingBox3f();
+	}
+	return BoundingBox3f( m_nodes[ 0 ].boundsMin, m_nodes[ 0 ].boundsMax );
+}
+
+bool TriangleMeshBVH::intersectRay( const Vector3f& origin, const Vector3f& direction,
+	Hit& hit,
+	float tMin, float tMax ) const
+{
+	bool found = false;
+	traverse( origin, direction, tMin, tMax, [&]( int i, float& tFar ) -> bool
+	{
+		float t;
+		Vector3f barycentrics;
+		if( GeometryUtils::rayTriangleIntersection( origin, direction,
+				m_vertices[ 3 * i ], m_vertices[ 3 * i + 1 ], m_vertices[ 3 * i + 2 ],
+				t, barycentrics ) &&
+			t > tMin && t < tFar )
+		{
+			tFar = t;
+			hit.t = t;
+			hit.barycentrics = barycentrics;
+			hit.faceIndex = m_faceIndices[ i ];
+			found = true;
+		}
+		return true;
+	} );
+	return found;
+}
+
+bool TriangleMeshBVH::intersectsRay( const Vector3f& origin, const Vector3f& direction,
+	float tMin, float tMax ) const
+{
+	bool found = false;
+	traverse( origin, direction, tMin, tMax, [&]( int i, float& tFar ) -> bool
+	{
+		float t;
+		Vector3f barycentrics;
+		found = GeometryUtils::rayTriangleIntersection( origin, direction,
+				m_vertices[ 3 * i ], m_vertices[ 3 * i + 1 ], m_vertices[ 3 * i + 2 ],
+				t, barycentrics ) &&
+			t > tMin && t < tFar;
+		return !found;
+	} );
+	return found;
+}
+
+int TriangleMeshBVH::intersectRay( const Vector3f& origin, const Vector3f& direction,
+	int k, std::vector< Hit >& hits,
+	float tMin, float tMax ) const
+{
+	hits.clear();
+	if( k <= 0 )
+	{
+		return 0;
+	}
+
+	// hits is kept sorted: once it has k,
+	// the ray is shortened to the k-th so farther boxes are culled
+	traverse( origin, direction, tMin, tMax, [&]( int i, float& tFar ) -> bool
+	{
+		Hit hit;
+		if( GeometryUtils::rayTriangleIntersection( origin, direction,
+				m_vertices[ 3 * i ], m_vertices[ 3 * i + 1 ], m_vertices[ 3 * i + 2 ],
+				hit.t, hit.barycentrics ) &&
+			hit.t > tMin && hit.t < tFar )
+		{
+			hit.faceIndex = m_faceIndices[ i ];
+
+			int position = static_cast< int >( hits.size() );
+			while( position > 0 && hits[ position - 1 ].t > hit.t )
+			{
+				--position;
+			}
+			hits.insert( hits.begin() + position, hit );
+
+			if( static_cast< int >( hits.size() ) > k )
+			{
+				hits.pop_back();
+			}
+			if( static_cast< int >( hits.size() ) == k )
+			{
+				tFar = hits.back().t;
+			}
+		}
+		return true;
+	} );
+	return static_cast< int >( hits.size() );
+}
+
+int TriangleMeshBVH::intersectRays( const RayBatch& rays, std::vector< Hit >& hits ) const
+{
+	int nRays = rays.size();
+	hits.assign( nRays, Hit() );
+
+	int nPackets = ( nRays + PACKET_SIZE - 1 ) / PACKET_SIZE;
+	std::vector< int > nPacketHits( nPackets, 0 );
+	Concurrency::parallel_for( 0, nPackets, [&]( int p )
+	{
+		int first = p * PACKET_SIZE;
+		int nLanes = std::min( PACKET_SIZE, nRays - first );
+		RayPacket packet( rays, first, nLanes );
+
+		// the lanes' closest hits so far
+		__m128 tHit = _mm_setzero_ps();
+		__m128 uHit = _mm_setzero_ps();
+		__m128 vHit = _mm_setzero_ps();
+		__m128i faceHit = _mm_set1_epi32( -1 );
+
+		traversePacket( packet, [&]( int i ) -> bool
+		{
+			__m128 t;
+			__m128 u;
+			__m128 v;
+			__m128 isHit = _mm_and_ps( packet.active, packet.intersectTriangle(
+				m_vertices[ 3 * i ], m_vertices[ 3 * i + 1 ], m_vertices[ 3 * i + 2 ], t, u, v ) );
+			if( _mm_movemask_ps( isHit ) != 0 )
+			{
+				__m128i isHitInt = _mm_castps_si128( isHit );
+				tHit = SSEUtils::select( isHit, t, tHit );
+				uHit = SSEUtils::select( isHit, u, uHit );
+				vHit = SSEUtils::select( isHit, v, vHit );
+				faceHit = _mm_or_si128( _mm_and_si128( isHitInt, _mm_set1_epi32( i ) ),
+					_mm_andnot_si128( isHitInt, faceHit ) );
+				packet.tMax = SSEUtils::select( isHit, t, packet.tMax );
+			}
+			return true;
+		} );
+
+		float ts[ 4 ];
+		float us[ 4 ];
+		float vs[ 4 ];
+		int faces[ 4 ];
+		_mm_storeu_ps( ts, tHit );
+		_mm_storeu_ps( us, uHit );
+		_mm_storeu_ps( vs, vHit );
+		_mm_storeu_si128( reinterpret_cast< __m128i* >( faces ), faceHit );
+
+		for( int lane = 0; lane < nLanes; ++lane )
+		{
+			if( faces[ lane ] >= 0 )
+			{
+				Hit& hit = hits[ first + lane ];
+				hit.t = ts[ lane ];
+				hit.barycentrics = Vector3f( 1 - us[ lane ] - vs[ lane ], us[ lane ], vs[ lane ] );
+				hit.faceIndex = m_faceIndices[ faces[ lane ] ];
+				++( nPacketHits[ p ] );
+			}
+		}
+	} );
+
+	int nHits = 0;
+	for( int p = 0; p < nPackets; ++p )
+	{
+		nHits += nPacketHits[ p ];
+	}
+	return nHits;
+}
+
+int TriangleMeshBVH::intersectsRays( const RayBatch& rays, std::vector< uint8 >& occluded ) const
+{
+	int nRays = rays.size();
+	occluded.assign( nRays, 0 );
+
+	int nPackets = ( nRays + PACKET_SIZE - 1 ) / PACKET_SIZE;
+	std::vector< int > nPacketHits( nPackets, 0 );
+	Concurrency::parallel_for( 0, nPackets, [&]( int p )
+	{
+		int first = p * PACKET_SIZE;
+		int nLanes = std::min( PACKET_SIZE, nRays - first );
+		RayPacket packet( rays, first, nLanes );
+		__m128 valid = packet.active;
+
+		// a lane is done once its ray hits anything
+		traversePacket( packet, [&]( int i ) -> bool
+		{
+			__m128 t;
+			__m128 u;
+			__m128 v;
+			__m128 isHit = _mm_and_ps( packet.active, packet.intersectTriangle(
+				m_vertices[ 3 * i ], m_vertices[ 3 * i + 1 ], m_vertices[ 3 * i + 2 ], t, u, v ) );
+			packet.active = _mm_andnot_ps( isHit, packet.active );
+			return( _mm_movemask_ps( packet.active ) != 0 );
+		} );
+
+		int isHit = _mm_movemask_ps( _mm_andnot_ps( packet.active, valid ) );
+		for( int lane = 0; lane < nLanes; ++lane )
+		{
+			if( ( isHit & ( 1 << lane ) ) != 0 )
+			{
+				occluded[ first + lane ] = 1;
+				++( nPacketHits[ p ] );
+			}
+		}
+	} );
+
+	int nHits = 0;
+	for( int p = 0; p < nPackets; ++p )
+	{
+		nHits += nPacketHits[ p ];
+	}
+	return nHits;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+void TriangleMeshBVH::buildSubtree( BuildContext& context, int begin, int end, int depth,
+	std::vector< Node >& nodes )
+{
+	int nodeIndex = static_cast< int >( nodes.size() );
+	nodes.push_back( Node() );
+
+	int n = end - begin;
+	int* faceIndices = &( m_faceIndices[ 0 ] );
+
+	Vector3f boundsMin = context.faceMin[ faceIndices[ begin ] ];
+	Vector3f boundsMax = context.faceMax[ faceIndices[ begin ] ];
+	Vector3f centroidMin = context.centroids[ faceIndices[ begin ] ];
+	Vector3f centroidMax = centroidMin;
+	for( int i = begin + 1; i < end; ++i )
+	{
+		int f = faceIndices[ i ];
+		boundsMin = Vector3f::minimum( boundsMin, context.faceMin[ f ] );
+		boundsMax = Vector3f::maximum( boundsMax, context.faceMax[ f ] );
+		centroidMin = Vector3f::minimum( centroidMin, context.centroids[ f ] );
+		centroidMax = Vector3f::maximum( centroidMax, context.centroids[ f ] );
+	}
+
+	nodes[ nodeIndex ].boundsMin = boundsMin;
+	nodes[ nodeIndex ].boundsMax = boundsMax;
+
+	if( n <= context.minLeafSize )
+	{
+		nodes[ nodeIndex ].offset = begin;
+		nodes[ nodeIndex ].nFaces = static_cast< int16 >( n );
+		nodes[ nodeIndex ].axis = 0;
+		return;
+	}
+
+	// binned SAH: faces are binned by centroid along each axis
+	// and the boundary between two bins with the lowest cost is the split
+	int bestAxis = -1;
+	int bestBin = -1;
+	float bestCost = std::numeric_limits< float >::infinity();
+	Vector3f centroidExtent = centroidMax - centroidMin;
+
+	if( depth < MAX_SAH_DEPTH )
+	{
+		for( int axis = 0; axis < 3; ++axis )
+		{
+			if( centroidExtent[ axis ] <= 0 )
+			{
+				continue;
+			}
+
+			int binCounts[ NUM_BINS ];
+			Vector3f binMin[ NUM_BINS ];
+			Vector3f binMax[ NUM_BINS ];
+			for( int b = 0; b < NUM_BINS; ++b )
+			{
+				binCounts[ b ] = 0;
+				binMin[ b ] = Vector3f( std::numeric_limits< float >::max() );
+				binMax[ b ] = Vector3f( -std::numeric_limits< float >::max() );
+			}
+
+			float binScale = NUM_BINS / centroidExtent[ axis ];
+			for( int i = begin; i < end; ++i )
+			{
+				int f = faceIndices[ i ];
+				int b = std::min( NUM_BINS - 1,
+					static_cast< int >( binScale * ( context.centroids[ f ][ axis ] - centroidMin[ axis ] ) ) );
+				++binCounts[ b ];
+				binMin[ b ] = Vector3f::minimum( binMin[ b ], context.faceMin[ f ] );
+				binMax[ b ] = Vector3f::maximum( binMax[ b ], context.faceMax[ f ] );
+			}
+
+			// sweep from the right, then from the left
+			float rightCosts[ NUM_BINS ];
+			Vector3f sweepMin = binMin[ NUM_BINS - 1 ];
+			Vector3f sweepMax = binMax[ NUM_BINS - 1 ];
+			int sweepCount = binCounts[ NUM_BINS - 1 ];
+			for( int b = NUM_BINS - 2; b >= 0; --b )
+			{
+				// the cost of the right side if the split is after bin b
+				rightCosts[ b ] = sweepCount * surfaceArea( sweepMin, sweepMax );
+				sweepMin = Vector3f::minimum( sweepMin, binMin[ b ] );
+				sweepMax = Vector3f::maximum( sweepMax, binMax[ b ] );
+				sweepCount += binCounts[ b ];
+			}
+
+			sweepMin = binMin[ 0 ];
+			sweepMax = binMax[ 0 ];
+			sweepCount = binCounts[ 0 ];
+			for( int b = 0; b < NUM_BINS - 1; ++b )
+			{
+				float cost = sweepCount * surfaceArea( sweepMin, sweepMax ) + rightCosts[ b ];
+				if( sweepCount > 0 && sweepCount < n && cost < bestCost )
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+				sweepMin = Vector3f::minimum( sweepMin, binMin[ b + 1 ] );
+				sweepMax = Vector3f::maximum( sweepMax, binMax[ b + 1 ] );
+				sweepCount += binCounts[ b + 1 ];
+			}
+		}
+	}
+
+	int mid = begin;
+	int splitAxis = bestAxis;
+	if( bestAxis != -1 )
+	{
+		float area = surfaceArea( boundsMin, boundsMax );
+		float leafCost = INTERSECTION_COST * n;
+		float splitCost = ( area > 0 ) ?
+			( TRAVERSAL_COST + INTERSECTION_COST * bestCost / area ) :
+			leafCost;
+
+		if( splitCost >= leafCost && n <= MAX_LEAF_SIZE )
+		{
+			nodes[ nodeIndex ].offset = begin;
+			nodes[ nodeIndex ].nFaces = static_cast< int16 >( n );
+			nodes[ nodeIndex ].axis = 0;
+			return;
+		}
+
+		float binScale = NUM_BINS / centroidExtent[ bestAxis ];
+		float splitMin = centroidMin[ bestAxis ];
+		mid = static_cast< int >( std::partition( faceIndices + begin, faceIndices + end, [&]( int f )
+		{
+			int b = std::min( NUM_BINS - 1,
+				static_cast< int >( binScale * ( context.centroids[ f ][ bestAxis ] - splitMin ) ) );
+			return( b <= bestBin );
+		} ) - faceIndices );
+	}
+
+	// no SAH split (coincident centroids, or too deep): split at the median
+	// along the longest centroid axis
+	if( mid == begin || mid == end )
+	{
+		if( n <= MAX_LEAF_SIZE && bestAxis == -1 && depth < MAX_SAH_DEPTH )
+		{
+			nodes[ nodeIndex ].offset = begin;
+			nodes[ nodeIndex ].nFaces = static_cast< int16 >( n );
+			nodes[ nodeIndex ].axis = 0;
+			return;
+		}
+
+		splitAxis = 0;
+		if( centroidExtent[ 1 ] > centroidExtent[ splitAxis ] )
+		{
+			splitAxis = 1;
+		}
+		if( centroidExtent[ 2 ] > centroidExtent[ splitAxis ] )
+		{
+			splitAxis = 2;
+		}
+
+		mid = begin + n / 2;
+		std::nth_element( faceIndices + begin, faceIndices + mid, faceIndices + end, [&]( int f0, int f1 )
+		{
+			return( context.centroids[ f0 ][ splitAxis ] < context.centroids[ f1 ][ splitAxis ] );
+		} );
+	}
+
+	int secondChild;
+	if( n > PARALLEL_BUILD_THRESHOLD )
+	{
+		// the second subtree is built into its own array
+		// then appended, with its child offsets shifted
+		std::vector< Node > secondNodes;
+		Concurrency::parallel_invoke(
+			[&]
+			{
+				buildSubtree( context, begin, mid, depth + 1, nodes );
+			},
+			[&]
+			{
+				buildSubtree( context, mid, end, depth + 1, secondNodes );
+			} );
+
+		secondChild = static_cast< int >( nodes.size() );
+		for( size_t i = 0; i < secondNodes.size(); ++i )
+		{
+			if( !( secondNodes[ i ].isLeaf() ) )
+			{
+				secondNodes[ i ].offset += secondChild;
+			}
+		}
+		nodes.insert( nodes.end(), secondNodes.begin(), secondNodes.end() );
+	}
+	else
+	{
+		buildSubtree( context, begin, mid, depth + 1, nodes );
+		secondChild = static_cast< int >( nodes.size() );
+		buildSubtree( context, mid, end, depth + 1, nodes );
+	}
+
+	nodes[ nodeIndex ].offset = secondChild;
+	nodes[ nodeIndex ].nFaces = 0;
+	nodes[ nodeIndex ].axis = static_cast< int16 >( splitAxis );
+}
+
+void TriangleMeshBVH::gatherVertices( const TriangleMesh& mesh )
+{
+	const std::vector< Vector3f >& positions = mesh.positions();
+	const std::vector< Vector3i >& faces = mesh.faces();
+
+	int nFaces = numFaces();
+	m_vertices.resize( 3 * nFaces );
+	Concurrency::parallel_for( 0, nFaces, [&]( int i )
+	{
+		const Vector3i& face = faces[ m_faceIndices[ i ] ];
+		m_vertices[ 3 * i ] = positions[ face[ 0 ] ];
+		m_vertices[ 3 * i + 1 ] = positions[ face[ 1 ] ];
+		m_vertices[ 3 * i + 2 ] = positions[ face[ 2 ] ];
+	} );
+}
+
+template< typename VisitLeafFace >
+void TriangleMeshBVH::traverse( const Vector3f& origin, const Vector3f& direction,
+	float tMin, float& tMax, VisitLeafFace visitLeafFace ) const
+{
+	if( isEmpty() )
+	{
+		return;
+	}
+
+	Vector3f invDirection( 1.f / direction.x, 1.f / direction.y, 1.f / direction.z );
+
+	int stack[ TRAVERSAL_STACK_SIZE ];
+	int stackSize = 0;
+	int nodeIndex = 0;
+
+	for( ;; )
+	{
+		const Node& node = m_nodes[ nodeIndex ];
+		if( intersectsBox( node, origin, invDirection, tMin, tMax ) )
+		{
+			if( node.isLeaf() )
+			{
+				int faceEnd = node.offset + node.nFaces;
+				for( int i = node.offset; i < faceEnd; ++i )
+				{
+					if( !visitLeafFace( i, tMax ) )
+					{
+						return;
+					}
+				}
+			}
+			else
+			{
+				// visit the near child first
+				int first = nodeIndex + 1;
+				int second = node.offset;
+				if( direction[ node.axis ] < 0 )
+				{
+					std::swap( first, second );
+				}
+				stack[ stackSize ] = second;
+				++stackSize;
+				nodeIndex = first;
+				continue;
+			}
+		}
+
+		if( stackSize == 0 )
+		{
+			break;
+		}
+		--stackSize;
+		nodeIndex = stack[ stackSize ];
+	}
+}
+
+template< typename VisitLeafFace >
+void TriangleMeshBVH::traversePacket( RayPacket& packet, VisitLeafFace visitLeafFace ) const
+{
+	if( isEmpty() || _mm_movemask_ps( packet.active ) == 0 )
+	{
+		return;
+	}
+
+	int stack[ TRAVERSAL_STACK_SIZE ];
+	int stackSize = 0;
+	int nodeIndex = 0;
+
+	for( ;; )
+	{
+		const Node& node = m_nodes[ nodeIndex ];
+		if( _mm_movemask_ps( _mm_and_ps( packet.active, packet.intersectsBox( node ) ) ) != 0 )
+		{
+			if( node.isLeaf() )
+			{
+				int faceEnd = node.offset + node.nFaces;
+				for( int i = node.offset; i < faceEnd; ++i )
+				{
+					if( !visitLeafFace( i ) )
+					{
+						return;
+					}
+				}
+			}
+			else
+			{
+				int first = nodeIndex + 1;
+				int second = node.offset;
+				if( packet.visitSecondFirst[ node.axis ] )
+				{
+					std::swap( first, second );
+				}
+				stack[ stackSize ] = second;
+				++stackSize;
+				nodeIndex = first;
+				continue;
+			}
+		}
+
+		if( stackSize == 0 )
+		{
+			break;
+		}
+		--stackSize;
+		nodeIndex = stack[ stackSize ];
+	}
+}
+
+TriangleMeshBVH::RayPacket::RayPacket( const RayBatch& rays, int first, int nRays )
+{
+	origin[ 0 ] = SSEUtils::loadLanes( rays.originX, first, nRays );
+	origin[ 1 ] = SSEUtils::loadLanes( rays.originY, first, nRays );
+	origin[ 2 ] = SSEUtils::loadLanes( rays.originZ, first, nRays );
+
+	direction[ 0 ] = SSEUtils::loadLanes( rays.directionX, first, nRays );
+	direction[ 1 ] = SSEUtils::loadLanes( rays.directionY, first, nRays );
+	direction[ 2 ] = SSEUtils::loadLanes( rays.directionZ, first, nRays );
+
+	tMin = SSEUtils::loadLanes( rays.tMin, first, nRays );
+	tMax = SSEUtils::loadLanes( rays.tMax, first, nRays );
+
+	int validLanes[ 4 ];
+	for( int lane = 0; lane < 4; ++lane )
+	{
+		validLanes[ lane ] = ( lane < nRays ) ? -1 : 0;
+	}
+	active = _mm_castsi128_ps( _mm_loadu_si128( reinterpret_cast< const __m128i* >( validLanes ) ) );
+
+	__m128 one = _mm_set1_ps( 1.f );
+	for( int a = 0; a < 3; ++a )
+	{
+		invDirection[ a ] = _mm_div_ps( one, direction[ a ] );
+		isNegative[ a ] = _mm_cmplt_ps( invDirection[ a ], _mm_setzero_ps() );
+
+		// count the rays that would visit the second child first
+		int negativeLanes = _mm_movemask_ps( _mm_and_ps( active, _mm_cmplt_ps( direction[ a ], _mm_setzero_ps() ) ) );
+		int nNegative = 0;
+		for( int lane = 0; lane < 4; ++lane )
+		{
+			nNegative += ( negativeLanes >> lane ) & 1;
+		}
+		visitSecondFirst[ a ] = ( 2 * nNegative > nRays );
+	}
+}
+
+__m128 TriangleMeshBVH::RayPacket::intersectsBox( const Node& node ) const
+{
+	__m128 tEnter = tMin;
+	__m128 tExit = tMax;
+	__m128 exitScale = _mm_set1_ps( BOX_EXIT_SCALE );
+	for( int a = 0; a < 3; ++a )
+	{
+		__m128 t0 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.boundsMin[ a ] ), origin[ a ] ), invDirection[ a ] );
+		__m128 t1 = _mm_mul_ps( _mm_sub_ps( _mm_set1_ps( node.boundsMax[ a ] ), origin[ a ] ), invDirection[ a ] );
+		__m128 tNear = SSEUtils::select( isNegative[ a ], t1, t0 );
+		__m128 tFar = _mm_mul_ps( SSEUtils::select( isNegative[ a ], t0, t1 ), exitScale );
+
+		// maxps and minps return the second operand if either is NaN
+		tEnter = _mm_max_ps( tNear, tEnter );
+		tExit = _mm_min_ps( tFar, tExit );
+	}
+	return _mm_cmple_ps( tEnter, tExit );
+}
+
+__m128 TriangleMeshBVH::RayPacket::intersectTriangle( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
+	__m128& t, __m128& u, __m128& v ) const
+{
+	Vector3f edge1 = v1 - v0;
+	Vector3f edge2 = v2 - v0;
+
+	__m128 e1x = _mm_set1_ps( edge1.x );
+	__m128 e1y = _mm_set1_ps( edge1.y );
+	__m128 e1z = _mm_set1_ps( edge1.z );
+	__m128 e2x = _mm_set1_ps( edge2.x );
+	__m128 e2y = _mm_set1_ps( edge2.y );
+	__m128 e2z = _mm_set1_ps( edge2.z );
+
+	const __m128& dx = direction[ 0 ];
+	const __m128& dy = direction[ 1 ];
+	const __m128& dz = direction[ 2 ];
+
+	// pvec = cross( direction, edge2 )
+	__m128 px = _mm_sub_ps( _mm_mul_ps( dy, e2z ), _mm_mul_ps( dz, e2y ) );
+	__m128 py = _mm_sub_ps( _mm_mul_ps( dz, e2x ), _mm_mul_ps( dx, e2z ) );
+	__m128 pz = _mm_sub_ps( _mm_mul_ps( dx, e2y ), _mm_mul_ps( dy, e2x ) );
+
+	__m128 det = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e1x, px ), _mm_mul_ps( e1y, py ) ), _mm_mul_ps( e1z, pz ) );
+
+	// tvec = origin - v0
+	__m128 tx = _mm_sub_ps( origin[ 0 ], _mm_set1_ps( v0.x ) );
+	__m128 ty = _mm_sub_ps( origin[ 1 ], _mm_set1_ps( v0.y ) );
+	__m128 tz = _mm_sub_ps( origin[ 2 ], _mm_set1_ps( v0.z ) );
+
+	u = _mm_add_ps( _mm_add_ps( _mm_mul_ps( tx, px ), _mm_mul_ps( ty, py ) ), _mm_mul_ps( tz, pz ) );
+
+	// qvec = cross( tvec, edge1 )
+	__m128 qx = _mm_sub_ps( _mm_mul_ps( ty, e1z ), _mm_mul_ps( tz, e1y ) );
+	__m128 qy = _mm_sub_ps( _mm_mul_ps( tz, e1x ), _mm_mul_ps( tx, e1z ) );
+	__m128 qz = _mm_sub_ps( _mm_mul_ps( tx, e1y ), _mm_mul_ps( ty, e1x ) );
+
+	v = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, qx ), _mm_mul_ps( dy, qy ) ), _mm_mul_ps( dz, qz ) );
+	t = _mm_add_ps( _mm_add_ps( _mm_mul_ps( e2x, qx ), _mm_mul_ps( e2y, qy ) ), _mm_mul_ps( e2z, qz ) );
+
+	// back faces and rays in the triangle's plane miss
+	__m128 zero = _mm_setzero_ps();
+	__m128 isHit = _mm_cmpge_ps( det, _mm_set1_ps( GeometryUtils::EPSILON ) );
+	isHit = _mm_and_ps( isHit, _mm_cmpge_ps( u, zero ) );
+	isHit = _mm_and_ps( isHit, _mm_cmple_ps( u, det ) );
+	isHit = _mm_and_ps( isHit, _mm_cmpge_ps( v, zero ) );
+	isHit = _mm_and_ps( isHit, _mm_cmple_ps( _mm_add_ps( u, v ), det ) );
+
+	__m128 invDet = _mm_div_ps( _mm_set1_ps( 1.f ), det );
+	t = _mm_mul_ps( t, invDet );
+	u = _mm_mul_ps( u, invDet );
+	v = _mm_mul_ps( v, invDet );
+
+	isHit = _mm_and_ps( isHit, _mm_cmpgt_ps( t, tMin ) );
+	return _mm_and_ps( isHit, _mm_cmplt_ps( t, tMax ) );
+}
@@ -0,0 +1,319 @@
+#include "geometry/TriangleMeshDistanceField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <ppl.h>
+
+#include "common/BasicTypes.h"
+#include "geometry/GeometryUtils.h"
+
+// static
+const float TriangleMeshDistanceField::EXACT_BAND = 2.f;
+
+// static
+const int TriangleMeshDistanceField::BRICK_SIZE = 16;
+
+// static
+const int TriangleMeshDistanceField::NUM_SWEEPS = 1;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool TriangleMeshDistanceField::compute( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+	const Vector3f& origin, float voxelSize, const Vector3i& resolution,
+	Array3D< float >& distances,
+	float narrowBand,
+	TriangleMeshVoxelizer::FillRule fillRule,
+	Array3D< int >* closestFaces )
+{
+	// the sign, which also checks the grid
+	Array3D< uint32 > inside;
+	if( !TriangleMeshVoxelizer::voxelizeSolid( positions, faces, origin, voxelSize, resolution, fillRule, inside ) )
+	{
+		return false;
+	}
+
+	Array3D< int > localClosestFaces;
+	Array3D< int >& faceIndices = ( closestFaces != nullptr ) ? *closestFaces : localClosestFaces;
+
+	// squared distances until the end
+	bool isNarrowBand = ( narrowBand > 0 );
+	float band = isNarrowBand ? narrowBand / voxelSize : EXACT_BAND;
+	std::vector< Vector3f > closestPoints;
+	computeBand( positions, faces, origin, voxelSize, resolution, band, distances, faceIndices, closestPoints );
+
+	if( !isNarrowBand )
+	{
+		for( int i = 0; i < NUM_SWEEPS; ++i )
+		{
+			for( int axis = 0; axis < 3; ++axis )
+			{
+				sweep( origin, voxelSize, axis, distances, faceIndices, closestPoints );
+			}
+		}
+	}
+	closestPoints.clear();
+
+	float maxDistance = isNarrowBand ? narrowBand : std::numeric_limits< float >::infinity();
+	Concurrency::parallel_for( 0, resolution.z, [&]( int z )
+	{
+		for( int y = 0; y < resolution.y; ++y )
+		{
+			float* row = distances.rowPointer( y, z );
+			const int* rowFaces = faceIndices.rowPointer( y, z );
+			for( int x = 0; x < resolution.x; ++x )
+			{
+				// propagated samples were compared with another sample's closest point:
+				// the exact distance to its face is no farther
+				if( !isNarrowBand && rowFaces[ x ] >= 0 )
+				{
+					Vector3f p = origin + voxelSize * Vector3f( x + 0.5f, y + 0.5f, z + 0.5f );
+					row[ x ] = ( closestPoint( positions, faces, rowFaces[ x ], p ) - p ).normSquared();
+				}
+
+				float distance = std::min( std::sqrt( row[ x ] ), maxDistance );
+				row[ x ] = TriangleMeshVoxelizer::isOccupied( inside, x, y, z ) ? -distance : distance;
+			}
+		}
+	} );
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+Vector3f TriangleMeshDistanceField::closestPoint( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+	int f, const Vector3f& p )
+{
+	const Vector3i& face = faces[ f ];
+	return GeometryUtils::closestPointOnTriangle( p,
+		positions[ face.x ], positions[ face.y ], positions[ face.z ] );
+}
+
+// static
+void TriangleMeshDistanceField::computeBand( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+	const Vector3f& origin, float voxelSize, const Vector3i& resolution, float band,
+	Array3D< float >& distancesSquared, Array3D< int >& closestFaces, std::vector< Vector3f >& closestPoints )
+{
+	distancesSquared.resize( resolution );
+	closestFaces.resize( resolution );
+	distancesSquared.fill( std::numeric_limits< float >::infinity() );
+	closestFaces.fill( -1 );
+	closestPoints.resize( distancesSquared.numElements() );
+
+	float inverseVoxelSize = 1.f / voxelSize;
+	Vector3i nBricks
+	(
+		( resolution.x + BRICK_SIZE - 1 ) / BRICK_SIZE,
+		( resolution.y + BRICK_SIZE - 1 ) / BRICK_SIZE,
+		( resolution.z + BRICK_SIZE - 1 ) / BRICK_SIZE
+	);
+	int nBricksTotal = nBricks.x * nBricks.y * nBricks.z;
+
+	// the samples within band of each face's bounding box:
+	// x + 0.5 in [ min - band, max + band ]
+	// or empty if there are none
+	int nFaces = static_cast< int >( faces.size() );
+	std::vector< int > sampleBounds( 6 * nFaces );
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
+	{
+		int* bounds = &( sampleBounds[ 6 * f ] );
+		bounds[ 0 ] = 0;
+		bounds[ 3 ] = -1;
+		Vector3f v[ 3 ];
+		for( int i = 0; i < 3; ++i )
+		{
+			v[ i ] = ( positions[ faces[ f ][ i ] ] - origin ) * inverseVoxelSize;
+		}
+		for( int k = 0; k < 3; ++k )
+		{
+			float lo = std::min( v[ 0 ][ k ], std::min( v[ 1 ][ k ], v[ 2 ][ k ] ) ) - band - 0.5f;
+			float hi = std::max( v[ 0 ][ k ], std::max( v[ 1 ][ k ], v[ 2 ][ k ] ) ) + band - 0.5f;
+			if( !( hi >= 0 && lo <= resolution[ k ] - 1 ) )
+			{
+				bounds[ 0 ] = 0;
+				bounds[ 3 ] = -1;
+				return;
+			}
+			bounds[ k ] = static_cast< int >( std::ceil( std::max( lo, 0.f ) ) );
+			bounds[ 3 + k ] = static_cast< int >( std::floor( std::min( hi, resolution[ k ] - 1.f ) ) );
+			if( bounds[ k ] > bounds[ 3 + k ] )
+			{
+				bounds[ 0 ] = 0;
+				bounds[ 3 ] = -1;
+				return;
+			}
+		}
+	} );
+
+	// bin the faces to bricks with a counting sort
+	std::vector< int > brickStarts( nBricksTotal + 1, 0 );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		const int* bounds = &( sampleBounds[ 6 * f ] );
+		if( bounds[ 0 ] > bounds[ 3 ] )
+		{
+			continue;
+		}
+		for( int bz = bounds[ 2 ] / BRICK_SIZE; bz <= bounds[ 5 ] / BRICK_SIZE; ++bz )
+		{
+			for( int by = bounds[ 1 ] / BRICK_SIZE; by <= bounds[ 4 ] / BRICK_SIZE; ++by )
+			{
+				for( int bx = bounds[ 0 ] / BRICK_SIZE; bx <= bounds[ 3 ] / BRICK_SIZE; ++bx )
+				{
+					++brickStarts[ ( bz * nBricks.y + by ) * nBricks.x + bx + 1 ];
+				}
+			}
+		}
+	}
+	for( int b = 0; b < nBricksTotal; ++b )
+	{
+		brickStarts[ b + 1 ] += brickStarts[ b ];
+	}
+
+	std::vector< int > brickFaces( brickStarts[ nBricksTotal ] );
+	std::vector< int > cursors( brickStarts.begin(), brickStarts.end() - 1 );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		const int* bounds = &( sampleBounds[ 6 * f ] );
+		if( bounds[ 0 ] > bounds[ 3 ] )
+		{
+			continue;
+		}
+		for( int bz = bounds[ 2 ] / BRICK_SIZE; bz <= bounds[ 5 ] / BRICK_SIZE; ++bz )
+		{
+			for( int by = bounds[ 1 ] / BRICK_SIZE; by <= bounds[ 4 ] / BRICK_SIZE; ++by )
+			{
+				for( int bx = bounds[ 0 ] / BRICK_SIZE; bx <= bounds[ 3 ] / BRICK_SIZE; ++bx )
+				{
+					brickFaces[ cursors[ ( bz * nBricks.y + by ) * nBricks.x + bx ]++ ] = f;
+				}
+			}
+		}
+	}
+
+	// each brick owns its samples
+	Concurrency::parallel_for( 0, nBricksTotal, [&]( int b )
+	{
+		int brickLo[ 3 ];
+		brickLo[ 0 ] = ( b % nBricks.x ) * BRICK_SIZE;
+		brickLo[ 1 ] = ( ( b / nBricks.x ) % nBricks.y ) * BRICK_SIZE;
+		brickLo[ 2 ] = ( b / ( nBricks.x * nBricks.y ) ) * BRICK_SIZE;
+
+		for( int i = brickStarts[ b ]; i < brickStarts[ b + 1 ]; ++i )
+		{
+			int f = brickFaces[ i ];
+			const int* bounds = &( sampleBounds[ 6 * f ] );
+			int lo[ 3 ];
+			int hi[ 3 ];
+			for( int k = 0; k < 3; ++k )
+			{
+				lo[ k ] = std::max( bounds[ k ], brickLo[ k ] );
+				hi[ k ] = std::min( bounds[ 3 + k ], brickLo[ k ] + BRICK_SIZE - 1 );
+			}
+
+			for( int z = lo[ 2 ]; z <= hi[ 2 ]; ++z )
+			{
+				for( int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+				{
+					int rowStart = distancesSquared.subscriptToIndex( 0, y, z );
+					for( int x = lo[ 0 ]; x <= hi[ 0 ]; ++x )
+					{
+						Vector3f p = origin + voxelSize * Vector3f( x + 0.5f, y + 0.5f, z + 0.5f );
+						Vector3f q = closestPoint( positions, faces, f, p );
+						float d2 = ( q - p ).normSquared();
+						if( d2 < distancesSquared( rowStart + x ) )
+						{
+							distancesSquared( rowStart + x ) = d2;
+							closestFaces( rowStart + x ) = f;
+							closestPoints[ rowStart + x ] = q;
+						}
+					}
+				}
+			}
+		}
+	} );
+}
+
+// static
+void TriangleMeshDistanceField::sweep( const Vector3f& origin, float voxelSize, int axis,
+	Array3D< float >& distancesSquared, Array3D< int >& closestFaces, std::vector< Vector3f >& closestPoints )
+{
+	// the sweep is along axis u, a slice at a time
+	// the slices are rows along v, stacked along w (v is x unless u is)
+	int u = axis;
+	int v = ( axis == 0 ) ? 1 : 0;
+	int w = ( axis == 2 ) ? 1 : 2;
+
+	int size[ 3 ] = { distancesSquared.width(), distancesSquared.height(), distancesSquared.depth() };
+	int strides[ 3 ] = { 1, size[ 0 ], size[ 0 ] * size[ 1 ] };
+
+	float* d2s = distancesSquared;
+	int* faceIndices = closestFaces;
+	Vector3f* points = &( closestPoints[ 0 ] );
+
+	for( int direction = 1; direction >= -1; direction -= 2 )
+	{
+		int first = ( direction > 0 ) ? 1 : size[ u ] - 2;
+		for( int s = first; s >= 0 && s < size[ u ]; s += direction )
+		{
+			// each sample tries the closest points of its 9 neighbors in the previous slice,
+			// which is done, so the rows are independent
+			Concurrency::parallel_for( 0, size[ w ], [&]( int j )
+			{
+				float p[ 3 ];
+				p[ u ] = origin[ u ] + voxelSize * ( s + 0.5f );
+				p[ w ] = origin[ w ] + voxelSize * ( j + 0.5f );
+
+				int jBegin = std::max( j - 1, 0 );
+				int jEnd = std::min( j + 1, size[ w ] - 1 );
+				int rowStart = s * strides[ u ] + j * strides[ w ];
+				int previousRowStart = ( s - direction ) * strides[ u ];
+				for( int i = 0; i < size[ v ]; ++i )
+				{
+					int index = rowStart + i * strides[ v ];
+					p[ v ] = origin[ v ] + voxelSize * ( i + 0.5f );
+
+					float d2 = d2s[ index ];
+					int closest = -1;
+					int iBegin = std::max( i - 1, 0 );
+					int iEnd = std::min( i + 1, size[ v ] - 1 );
+					for( int nj = jBegin; nj <= jEnd; ++nj )
+					{
+						for( int ni = iBegin; ni <= iEnd; ++ni )
+						{
+							int n = previousRowStart + nj * strides[ w ] + ni * strides[ v ];
+							if( faceIndices[ n ] >= 0 )
+							{
+								const Vector3f& q = points[ n ];
+								float dx = q.x - p[ 0 ];
+								float dy = q.y - p[ 1 ];
+								float dz = q.z - p[ 2 ];
+								float nd2 = dx * dx + dy * dy + dz * dz;
+								if( nd2 < d2 )
+								{
+									d2 = nd2;
+									closest = n;
+								}
+							}
+						}
+					}
+
+					if( closest >= 0 )
+					{
+						d2s[ index ] = d2;
+						faceIndices[ index ] = faceIndices[ closest ];
+						points[ index ] = points[ closest ];
+					}
+				}
+			} );
+		}
+	}
+}
@@ -0,0 +1,506 @@
+#include "geometry/TriangleMeshOptimizer.h"
+
+#include <algorithm>
+
+#include <ppl.h>
+
+#include "geometry/TriangleMesh.h"
+
+namespace
+{
+	// a FIFO post-transform cache:
+	// each vertex remembers when it was inserted,
+	// and is in the cache while fewer than size vertices were inserted after it
+	class FifoCache
+	{
+	public:
+
+		FifoCache( int nVertices, int size ) :
+
+			m_insertions( nVertices, -size - 1 ),
+			m_nInsertions( 0 ),
+			m_size( size )
+
+		{
+
+		}
+
+		// returns true on a miss
+		bool access( int v )
+		{
+			if( m_nInsertions - m_insertions[ v ] > m_size )
+			{
+				m_insertions[ v ] = m_nInsertions;
+				++m_nInsertions;
+				return true;
+			}
+			return false;
+		}
+
+		// empties the cache in constant time
+		void flush()
+		{
+			m_nInsertions += m_size;
+		}
+
+	private:
+
+		std::vector< int > m_insertions;
+		int m_nInsertions;
+		int m_size;
+	};
+
+	// the number of cache misses of faces[ order[ begin, end ) ]
+	// starting from an empty cache
+	int countMisses( FifoCache& cache, const std::vector< Vector3i >& faces,
+		const std::vector< int >& order, int begin, int end )
+	{
+		cache.flush();
+		int nMisses = 0;
+		for( int i = begin; i < end; ++i )
+		{
+			const Vector3i& face = faces[ order[ i ] ];
+			for( int k = 0; k < 3; ++k )
+			{
+				if( cache.access( face[ k ] ) )
+				{
+					++nMisses;
+				}
+			}
+		}
+		return nMisses;
+	}
+}
+
+// static
+const int TriangleMeshOptimizer::DEFAULT_CACHE_SIZE = 16;
+
+// static
+const float TriangleMeshOptimizer::OVERDRAW_THRESHOLD = 1.05f;
+
+// static
+const int TriangleMeshOptimizer::MIN_CLUSTER_SIZE = 32;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+TriangleMeshOptimizer::CacheStatistics::CacheStatistics() :
+
+	acmr( 0 ),
+	atvr( 0 ),
+	nMisses( 0 )
+
+{
+
+}
+
+// static
+void TriangleMeshOptimizer::optimize( TriangleMesh& mesh, int cacheSize, bool reduceOverdraw )
+{
+	if( reduceOverdraw )
+	{
+		optimizeVertexCacheAndOverdraw( mesh.m_faces, mesh.m_positions, cacheSize );
+	}
+	else
+	{
+		optimizeVertexCache( mesh.m_faces, mesh.numVertices(), cacheSize );
+	}
+	optimizeVertexOrder( mesh );
+}
+
+// static
+void TriangleMeshOptimizer::optimizeVertexCache( std::vector< Vector3i >& faces, int nVertices,
+	int cacheSize )
+{
+	std::vector< int > order;
+	std::vector< int > clusterStarts;
+	tipsify( faces, nVertices, cacheSize, order, clusterStarts );
+	permuteFaces( faces, order );
+}
+
+// static
+void TriangleMeshOptimizer::optimizeVertexCacheAndOverdraw( std::vector< Vector3i >& faces,
+	const std::vector< Vector3f >& positions,
+	int cacheSize )
+{
+	int nFaces = static_cast< int >( faces.size() );
+	int nVertices = static_cast< int >( positions.size() );
+
+	std::vector< int > order;
+	std::vector< int > clusterStarts;
+	tipsify( faces, nVertices, cacheSize, order, clusterStarts );
+	splitClusters( faces, nVertices, cacheSize, order, clusterStarts );
+
+	int nClusters = static_cast< int >( clusterStarts.size() );
+	if( nClusters < 2 )
+	{
+		permuteFaces( faces, order );
+		return;
+	}
+
+	// each cluster's area weighted centroid and normal
+	// (a face's cross product has twice its area as length)
+	std::vector< Vector3f > clusterCentroids( nClusters );
+	std::vector< Vector3f > clusterNormals( nClusters );
+	std::vector< float > clusterAreas( nClusters );
+	Concurrency::parallel_for( 0, nClusters, [&]( int c )
+	{
+		int end = ( c + 1 < nClusters ) ? clusterStarts[ c + 1 ] : nFaces;
+
+		Vector3f centroid( 0, 0, 0 );
+		Vector3f normal( 0, 0, 0 );
+		float area = 0;
+		for( int i = clusterStarts[ c ]; i < end; ++i )
+		{
+			const Vector3i& face = faces[ order[ i ] ];
+			const Vector3f& p0 = positions[ face.x ];
+			const Vector3f& p1 = positions[ face.y ];
+			const Vector3f& p2 = positions[ face.z ];
+
+			Vector3f n = Vector3f::cross( p1 - p0, p2 - p0 );
+			float faceArea = n.abs();
+			centroid += faceArea * ( p0 + p1 + p2 );
+			normal += n;
+			area += faceArea;
+		}
+
+		if( area > 0 )
+		{
+			centroid /= ( 3 * area );
+		}
+		clusterCentroids[ c ] = centroid;
+		clusterNormals[ c ] = normal.normalized();
+		clusterAreas[ c ] = area;
+	} );
+
+	Vector3f meshCentroid( 0, 0, 0 );
+	float meshArea = 0;
+	for( int c = 0; c < nClusters; ++c )
+	{
+		meshCentroid += clusterAreas[ c ] * clusterCentroids[ c ];
+		meshArea += clusterAreas[ c ];
+	}
+	if( meshArea > 0 )
+	{
+		meshCentroid /= meshArea;
+	}
+
+	// clusters that face away from the center are likely to occlude the rest,
+	// from any direction they're seen: draw them first
+	std::vector< float > occlusion( nClusters );
+	std::vector< int > clusterOrder( nClusters );
+	for( int c = 0; c < nClusters; ++c )
+	{
+		occlusion[ c ] = Vector3f::dot( clusterCentroids[ c ] - meshCentroid, clusterNormals[ c ] );
+		clusterOrder[ c ] = c;
+	}
+	std::stable_sort( clusterOrder.begin(), clusterOrder.end(), [&]( int c0, int c1 )
+	{
+		return occlusion[ c0 ] > occlusion[ c1 ];
+	} );
+
+	std::vector< int > sortedOrder;
+	sortedOrder.reserve( nFaces );
+	for( int i = 0; i < nClusters; ++i )
+	{
+		int c = clusterOrder[ i ];
+		int end = ( c + 1 < nClusters ) ? clusterStarts[ c + 1 ] : nFaces;
+		sortedOrder.insert( sortedOrder.end(), order.begin() + clusterStarts[ c ], order.begin() + end );
+	}
+	permuteFaces( faces, sortedOrder );
+}
+
+// static
+void TriangleMeshOptimizer::optimizeVertexOrder( TriangleMesh& mesh )
+{
+	int nVertices = mesh.numVertices();
+	bool hasNormals = ( mesh.m_normals.size() == mesh.m_positions.size() );
+
+	std::vector< int > newIndices( nVertices, -1 );
+	std::vector< Vector3f > positions;
+	std::vector< Vector3f > normals;
+	positions.reserve( nVertices );
+	if( hasNormals )
+	{
+		normals.reserve( nVertices );
+	}
+
+	for( int f = 0; f < mesh.numFaces(); ++f )
+	{
+		Vector3i& face = mesh.m_faces[ f ];
+		for( int k = 0; k < 3; ++k )
+		{
+			int v = face[ k ];
+			if( newIndices[ v ] == -1 )
+			{
+				newIndices[ v ] = static_cast< int >( positions.size() );
+				positions.push_back( mesh.m_positions[ v ] );
+				if( hasNormals )
+				{
+					normals.push_back( mesh.m_normals[ v ] );
+				}
+			}
+			face[ k ] = newIndices[ v ];
+		}
+	}
+
+	mesh.m_positions.swap( positions );
+	if( hasNormals )
+	{
+		mesh.m_normals.swap( normals );
+	}
+	mesh.invalidateDerivedData();
+}
+
+// static
+TriangleMeshOptimizer::CacheStatistics TriangleMeshOptimizer::cacheStatistics(
+	const std::vector< Vector3i >& faces, int nVertices, int cacheSize )
+{
+	CacheStatistics statistics;
+
+	int nFaces = static_cast< int >( faces.size() );
+	if( nFaces == 0 )
+	{
+		return statistics;
+	}
+
+	FifoCache cache( nVertices, cacheSize );
+	std::vector< bool > isReferenced( nVertices, false );
+	int nReferenced = 0;
+	for( int f = 0; f < nFaces; ++f )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			int v = faces[ f ][ k ];
+			if( cache.access( v ) )
+			{
+				++statistics.nMisses;
+			}
+			if( !isReferenced[ v ] )
+			{
+				isReferenced[ v ] = true;
+				++nReferenced;
+			}
+		}
+	}
+
+	statistics.acmr = static_cast< float >( statistics.nMisses ) / nFaces;
+	statistics.atvr = static_cast< float >( statistics.nMisses ) / nReferenced;
+	return statistics;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+void TriangleMeshOptimizer::tipsify( const std::vector< Vector3i >& faces, int nVertices, int cacheSize,
+	std::vector< int >& order, std::vector< int >& clusterStarts )
+{
+	int nFaces = static_cast< int >( faces.size() );
+	order.clear();
+	order.reserve( nFaces );
+	clusterStarts.clear();
+
+	// the faces around each vertex, by counting
+	std::vector< int > offsets( nVertices + 1, 0 );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			++offsets[ faces[ f ][ k ] + 1 ];
+		}
+	}
+	for( int v = 0; v < nVertices; ++v )
+	{
+		offsets[ v + 1 ] += offsets[ v ];
+	}
+
+	std::vector< int > vertexFaces( offsets[ nVertices ] );
+	std::vector< int > cursors( offsets.begin(), offsets.end() - 1 );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			vertexFaces[ cursors[ faces[ f ][ k ] ] ] = f;
+			++cursors[ faces[ f ][ k ] ];
+		}
+	}
+
+	// the number of faces around each vertex not emitted yet
+	std::vector< int > liveCounts( nVertices );
+	for( int v = 0; v < nVertices; ++v )
+	{
+		liveCounts[ v ] = offsets[ v + 1 ] - offsets[ v ];
+	}
+
+	// when each vertex entered the cache
+	// a vertex is in the cache while time - cacheTimes[ v ] <= cacheSize
+	std::vector< int > cacheTimes( nVertices, 0 );
+	int time = cacheSize + 1;
+
+	std::vector< uint8 > isEmitted( nFaces, 0 );
+
+	// recently used vertices, to continue from at a dead end
+	std::vector< int > deadEndStack;
+	int nextUnvisited = 0;
+
+	// the vertices of the faces emitted around the current fanning vertex
+	std::vector< int > candidates;
+
+	// returns the next vertex with live faces:
+	// from the dead end stack, or else in input order
+	auto skipDeadEnd = [&]() -> int
+	{
+		while( !deadEndStack.empty() )
+		{
+			int v = deadEndStack.back();
+			deadEndStack.pop_back();
+			if( liveCounts[ v ] > 0 )
+			{
+				return v;
+			}
+		}
+		while( nextUnvisited < nVertices )
+		{
+			int v = nextUnvisited;
+			++nextUnvisited;
+			if( liveCounts[ v ] > 0 )
+			{
+				return v;
+			}
+		}
+		return -1;
+	};
+
+	int fanningVertex = skipDeadEnd();
+	if( fanningVertex != -1 )
+	{
+		clusterStarts.push_back( 0 );
+	}
+
+	while( fanningVertex != -1 )
+	{
+		candidates.clear();
+
+		// emit all of the fanning vertex's live faces
+		for( int i = offsets[ fanningVertex ]; i < offsets[ fanningVertex + 1 ]; ++i )
+		{
+			int f = vertexFaces[ i ];
+			if( isEmitted[ f ] )
+			{
+				continue;
+			}
+
+			for( int k = 0; k < 3; ++k )
+			{
+				int v = faces[ f ][ k ];
+				deadEndStack.push_back( v );
+				candidates.push_back( v );
+				--liveCounts[ v ];
+				if( time - cacheTimes[ v ] > cacheSize )
+				{
+					cacheTimes[ v ] = time;
+					++time;
+				}
+			}
+			isEmitted[ f ] = 1;
+			order.push_back( f );
+		}
+
+		// continue from the candidate that will still be in the cache
+		// after its remaining faces are emitted, and has been in it longest
+		int next = -1;
+		int bestPriority = -1;
+		for( int i = 0; i < static_cast< int >( candidates.size() ); ++i )
+		{
+			int v = candidates[ i ];
+			if( liveCounts[ v ] > 0 )
+			{
+				int priority = 0;
+				if( time - cacheTimes[ v ] + 2 * liveCounts[ v ] <= cacheSize )
+				{
+					priority = time - cacheTimes[ v ];
+				}
+				if( priority > bestPriority )
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+		}
+
+		if( next == -1 )
+		{
+			next = skipDeadEnd();
+			if( next != -1 )
+			{
+				clusterStarts.push_back( static_cast< int >( order.size() ) );
+			}
+		}
+		fanningVertex = next;
+	}
+}
+
+// static
+void TriangleMeshOptimizer::splitClusters( const std::vector< Vector3i >& faces, int nVertices, int cacheSize,
+	const std::vector< int >& order, std::vector< int >& clusterStarts )
+{
+	int nFaces = static_cast< int >( order.size() );
+	int nClusters = static_cast< int >( clusterStarts.size() );
+
+	FifoCache cache( nVertices, cacheSize );
+	std::vector< int > splitStarts;
+	splitStarts.reserve( nClusters );
+
+	for( int c = 0; c < nClusters; ++c )
+	{
+		int begin = clusterStarts[ c ];
+		int end = ( c + 1 < nClusters ) ? clusterStarts[ c + 1 ] : nFaces;
+		float clusterAcmr = static_cast< float >( countMisses( cache, faces, order, begin, end ) ) / ( end - begin );
+		float maxMisses = OVERDRAW_THRESHOLD * clusterAcmr;
+
+		// starting each piece with an empty cache,
+		// cut it once its misses per face come down to near the cluster's
+		splitStarts.push_back( begin );
+		cache.flush();
+		int pieceStart = begin;
+		int nPieceMisses = 0;
+		for( int i = begin; i < end; ++i )
+		{
+			const Vector3i& face = faces[ order[ i ] ];
+			for( int k = 0; k < 3; ++k )
+			{
+				if( cache.access( face[ k ] ) )
+				{
+					++nPieceMisses;
+				}
+			}
+
+			int nPieceFaces = i + 1 - pieceStart;
+			if( nPieceFaces >= MIN_CLUSTER_SIZE &&
+				end - ( i + 1 ) >= MIN_CLUSTER_SIZE &&
+				nPieceMisses <= maxMisses * nPieceFaces )
+			{
+				pieceStart = i + 1;
+				nPieceMisses = 0;
+				splitStarts.push_back( pieceStart );
+				cache.flush();
+			}
+		}
+	}
+
+	clusterStarts.swap( splitStarts );
+}
+
+// static
+void TriangleMeshOptimizer::permuteFaces( std::vector< Vector3i >& faces, const std::vector< int >& order )
+{
+	std::vector< Vector3i > permuted( order.size() );
+	for( int i = 0; i < static_cast< int >( order.size() ); ++i )
+	{
+		permuted[ i ] = faces[ order[ i ] ];
+	}
+	faces.swap( permuted );
+}
@@ -0,0 +1,904 @@
+#include "geometry/TriangleMeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+#include <ppl.h>
+
+#include "geometry/TriangleMesh.h"
+#include "geometry/TriangleMeshAdjacency.h"
+
+namespace
+{
+	// a symmetric 4x4 matrix Q:
+	// the error at point p is [ p 1 ] Q [ p 1 ]^T
+	// stored as its upper triangle: xx xy xz xw yy yz yw zz zw ww
+	struct Quadric
+	{
+		Quadric()
+		{
+			std::fill( m, m + 10, 0.0 );
+		}
+
+		// weight times the squared distance to the plane dot( normal, p ) + d = 0
+		// (normal has unit length)
+		Quadric( const Vector3f& normal, float d, double weight )
+		{
+			double a = normal.x;
+			double b = normal.y;
+			double c = normal.z;
+
+			m[ 0 ] = weight * a * a;
+			m[ 1 ] = weight * a * b;
+			m[ 2 ] = weight * a * c;
+			m[ 3 ] = weight * a * d;
+			m[ 4 ] = weight * b * b;
+			m[ 5 ] = weight * b * c;
+			m[ 6 ] = weight * b * d;
+			m[ 7 ] = weight * c * c;
+			m[ 8 ] = weight * c * d;
+			m[ 9 ] = weight * d * d;
+		}
+
+		void add( const Quadric& q )
+		{
+			for( int i = 0; i < 10; ++i )
+			{
+				m[ i ] += q.m[ i ];
+			}
+		}
+
+		double error( const Vector3f& p ) const
+		{
+			double x = p.x;
+			double y = p.y;
+			double z = p.z;
+
+			return x * ( m[ 0 ] * x + 2 * ( m[ 1 ] * y + m[ 2 ] * z + m[ 3 ] ) ) +
+				y * ( m[ 4 ] * y + 2 * ( m[ 5 ] * z + m[ 6 ] ) ) +
+				z * ( m[ 7 ] * z + 2 * m[ 8 ] ) +
+				m[ 9 ];
+		}
+
+		// the point with the least error
+		// returns false if it's not well defined (the planes are nearly parallel)
+		bool minimize( Vector3f& p ) const
+		{
+			// the cofactors of the upper left 3x3
+			double c00 = m[ 4 ] * m[ 7 ] - m[ 5 ] * m[ 5 ];
+			double c01 = m[ 2 ] * m[ 5 ] - m[ 1 ] * m[ 7 ];
+			double c02 = m[ 1 ] * m[ 5 ] - m[ 2 ] * m[ 4 ];
+			double c11 = m[ 0 ] * m[ 7 ] - m[ 2 ] * m[ 2 ];
+			double c12 = m[ 1 ] * m[ 2 ] - m[ 0 ] * m[ 5 ];
+			double c22 = m[ 0 ] * m[ 4 ] - m[ 1 ] * m[ 1 ];
+
+			double det = m[ 0 ] * c00 + m[ 1 ] * c01 + m[ 2 ] * c02;
+			double scale = std::max( m[ 0 ], std::max( m[ 4 ], m[ 7 ] ) );
+			if( !( fabs( det ) > 1e-6 * scale * scale * scale ) )
+			{
+				return false;
+			}
+
+			double bx = -m[ 3 ];
+			double by = -m[ 6 ];
+			double bz = -m[ 8 ];
+			p = Vector3f
+			(
+				static_cast< float >( ( c00 * bx + c01 * by + c02 * bz ) / det ),
+				static_cast< float >( ( c01 * bx + c11 * by + c12 * bz ) / det ),
+				static_cast< float >( ( c02 * bx + c12 * by + c22 * bz ) / det )
+			);
+			return true;
+		}
+
+		double m[ 10 ];
+	};
+
+	// collapsing v1 into v0, which moves to position
+	struct EdgeCollapse
+	{
+		float cost;
+		int v0;
+		int v1;
+
+		// the endpoints' versions when this was computed
+		int version0;
+		int version1;
+
+		Vector3f position;
+	};
+
+	struct CostGreater
+	{
+		bool operator () ( const EdgeCollapse& a, const EdgeCollapse& b ) const
+		{
+			return( a.cost > b.cost );
+		}
+	};
+
+	inline bool faceContains( const Vector3i& face, int v )
+	{
+		return( face.x == v || face.y == v || face.z == v );
+	}
+
+	inline Vector3f faceNormal( const Vector3f& p0, const Vector3f& p1, const Vector3f& p2 )
+	{
+		return Vector3f::cross( p1 - p0, p2 - p0 );
+	}
+}
+
+struct TriangleMeshSimplifier::Simplification
+{
+	Simplification( std::vector< Vector3f >& positions, std::vector< Vector3f >& normals,
+		std::vector< Vector3i >& faces, const std::vector< uint8 >& isFixed );
+
+	// collapses edges until there are at most targetFaces faces
+	void run( int targetFaces, float maxError );
+
+	// removes the deleted faces and the unused vertices
+	void compact( std::vector< int >& vertexSources );
+
+	bool isFixed( int v ) const;
+
+	// the cheapest way to collapse the edge between v0 and v1
+	// returns false if both are fixed
+	bool evaluate( int v0, int v1, EdgeCollapse& collapse ) const;
+
+	// collapses if the mesh stays manifold and no face turns too far
+	bool tryCollapse( const EdgeCollapse& collapse );
+
+	// whether moving vertex v of face f to position turns it too far
+	bool flips( int f, int v, const Vector3f& position ) const;
+
+	// the live faces around v
+	// (unlinking the deleted ones from its list)
+	void gatherFaces( int v, std::vector< int >& vertexFaces );
+
+	// the vertices of vertexFaces other than v, sorted
+	void gatherNeighbors( const std::vector< int >& vertexFaces, int v, std::vector< int >& neighbors ) const;
+
+	std::vector< Vector3f >& positions;
+	std::vector< Vector3f >& normals;
+	std::vector< Vector3i >& faces;
+	const std::vector< uint8 >& fixedVertices;
+	bool hasNormals;
+
+	// per vertex
+	std::vector< Quadric > quadrics;
+	std::vector< uint8 > isBoundary;
+	std::vector< int > versions; // -1 once collapsed away
+
+	// per face
+	std::vector< uint8 > isFaceDeleted;
+	int nLiveFaces;
+
+	// each vertex's faces as a linked list of nodes:
+	// node 3 * f + k starts in the list of faces[ f ][ k ]
+	std::vector< int > listHeads;
+	std::vector< int > listTails;
+	std::vector< int > nodeNext;
+
+	std::priority_queue< EdgeCollapse, std::vector< EdgeCollapse >, CostGreater > queue;
+
+	// scratch space for tryCollapse
+	std::vector< int > faces0;
+	std::vector< int > faces1;
+	std::vector< int > neighbors0;
+	std::vector< int > neighbors1;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+const float TriangleMeshSimplifier::BOUNDARY_WEIGHT = 100.f;
+
+// static
+const float TriangleMeshSimplifier::MIN_NORMAL_COSINE = 0.2f;
+
+// static
+int TriangleMeshSimplifier::simplify( TriangleMesh& mesh, int targetFaces, float maxError )
+{
+	std::vector< int > vertexSources;
+	simplify( mesh.m_positions, mesh.m_normals, mesh.m_faces, std::vector< uint8 >(),
+		targetFaces, maxError, vertexSources );
+	mesh.invalidateDerivedData();
+	return mesh.numFaces();
+}
+
+// static
+int TriangleMeshSimplifier::simplifyPartitioned( TriangleMesh& mesh, int targetFaces, float maxError,
+	int gridResolution )
+{
+	int nFaces = mesh.numFaces();
+	int nVertices = mesh.numVertices();
+
+	// nothing to partition (the centroid bounds below need a face)
+	if( nFaces == 0 || nFaces <= targetFaces || gridResolution <= 1 )
+	{
+		return simplify( mesh, targetFaces, maxError );
+	}
+
+	const std::vector< Vector3f >& positions = mesh.m_positions;
+	const std::vector< Vector3f >& normals = mesh.m_normals;
+	const std::vector< Vector3i >& faces = mesh.m_faces;
+	bool hasNormals = ( normals.size() == positions.size() );
+
+	// assign faces to grid cells by their centroids
+	std::vector< Vector3f > centroids( nFaces );
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
+	{
+		centroids[ f ] = ( positions[ faces[ f ].x ] + positions[ faces[ f ].y ] + positions[ faces[ f ].z ] ) / 3.f;
+	} );
+
+	Vector3f boundsMin = centroids[ 0 ];
+	Vector3f boundsMax = centroids[ 0 ];
+	for( int f = 1; f < nFaces; ++f )
+	{
+		boundsMin = Vector3f::minimum( boundsMin, centroids[ f ] );
+		boundsMax = Vector3f::maximum( boundsMax, centroids[ f ] );
+	}
+
+	int nClusters = gridResolution * gridResolution * gridResolution;
+	std::vector< int > faceClusters( nFaces );
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
+	{
+		int cell[ 3 ];
+		for( int a = 0; a < 3; ++a )
+		{
+			float extent = boundsMax[ a ] - boundsMin[ a ];
+			float x = ( extent > 0 ) ? ( ( centroids[ f ][ a ] - boundsMin[ a ] ) / extent ) : 0;
+			cell[ a ] = std::min( static_cast< int >( x * gridResolution ), gridResolution - 1 );
+		}
+		faceClusters[ f ] = cell[ 0 ] + gridResolution * ( cell[ 1 ] + gridResolution * cell[ 2 ] );
+	} );
+
+	// bucket the faces by cluster
+	std::vector< int > clusterOffsets( nClusters + 1, 0 );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		++( clusterOffsets[ faceClusters[ f ] + 1 ] );
+	}
+	for( int c = 0; c < nClusters; ++c )
+	{
+		clusterOffsets[ c + 1 ] += clusterOffsets[ c ];
+	}
+	std::vector< int > clusterEnds( clusterOffsets.begin(), clusterOffsets.end() - 1 );
+	std::vector< int > clusterFaces( nFaces );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		int& end = clusterEnds[ faceClusters[ f ] ];
+		clusterFaces[ end ] = f;
+		++end;
+	}
+
+	// vertices used by more than one cluster stay fixed
+	std::vector< int > vertexClusters( nVertices, -1 );
+	std::vector< uint8 > isShared( nVertices, 0 );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			int& vertexCluster = vertexClusters[ faces[ f ][ k ] ];
+			if( vertexCluster == -1 )
+			{
+				vertexCluster = faceClusters[ f ];
+			}
+			else if( vertexCluster != faceClusters[ f ] )
+			{
+				isShared[ faces[ f ][ k ] ] = 1;
+			}
+		}
+	}
+
+	// simplify each cluster on its own
+	std::vector< TriangleMesh > clusters( nClusters );
+	std::vector< std::vector< int > > clusterVertexSources( nClusters );
+	Concurrency::parallel_for( 0, nClusters, [&]( int c )
+	{
+		int begin = clusterOffsets[ c ];
+		int nClusterFaces = clusterOffsets[ c + 1 ] - begin;
+		if( nClusterFaces == 0 )
+		{
+			return;
+		}
+
+		// the cluster's vertices, in increasing order
+		std::vector< int > globalVertices( 3 * nClusterFaces );
+		for( int i = 0; i < nClusterFaces; ++i )
+		{
+			for( int k = 0; k < 3; ++k )
+			{
+				globalVertices[ 3 * i + k ] = faces[ clusterFaces[ begin + i ] ][ k ];
+			}
+		}
+		std::sort( globalVertices.begin(), globalVertices.end() );
+		globalVertices.erase( std::unique( globalVertices.begin(), globalVertices.end() ), globalVertices.end() );
+		int nClusterVertices = static_cast< int >( globalVertices.size() );
+
+		TriangleMesh& cluster = clusters[ c ];
+		std::vector< uint8 > isFixed( nClusterVertices );
+		cluster.m_positions.resize( nClusterVertices );
+		cluster.m_normals.resize( hasNormals ? nClusterVertices : 0 );
+		for( int j = 0; j < nClusterVertices; ++j )
+		{
+			cluster.m_positions[ j ] = positions[ globalVertices[ j ] ];
+			if( hasNormals )
+			{
+				cluster.m_normals[ j ] = normals[ globalVertices[ j ] ];
+			}
+			isFixed[ j ] = isShared[ globalVertices[ j ] ];
+		}
+
+		cluster.m_faces.resize( nClusterFaces );
+		for( int i = 0; i < nClusterFaces; ++i )
+		{
+			for( int k = 0; k < 3; ++k )
+			{
+				cluster.m_faces[ i ][ k ] = static_cast< int >( std::lower_bound( globalVertices.begin(), globalVertices.end(),
+					faces[ clusterFaces[ begin + i ] ][ k ] ) - globalVertices.begin() );
+			}
+		}
+
+		int clusterTarget = static_cast< int >( static_cast< int64 >( nClusterFaces ) * targetFaces / nFaces );
+		std::vector< int >& vertexSources = clusterVertexSources[ c ];
+		simplify( cluster.m_positions, cluster.m_normals, cluster.m_faces, isFixed,
+			clusterTarget, maxError, vertexSources );
+
+		// back to mesh indices
+		for( int j = 0; j < static_cast< int >( vertexSources.size() ); ++j )
+		{
+			vertexSources[ j ] = globalVertices[ vertexSources[ j ] ];
+		}
+	} );
+
+	// stitch the clusters back together: shared vertices are merged
+	std::vector< int > sharedVertexIndices( nVertices, -1 );
+	std::vector< Vector3f > stitchedPositions;
+	std::vector< Vector3f > stitchedNormals;
+	std::vector< Vector3i > stitchedFaces;
+	std::vector< int > localToStitched;
+	for( int c = 0; c < nClusters; ++c )
+	{
+		const TriangleMesh& cluster = clusters[ c ];
+		const std::vector< int >& vertexSources = clusterVertexSources[ c ];
+
+		int nClusterVertices = cluster.numVertices();
+		localToStitched.resize( nClusterVertices );
+		for( int j = 0; j < nClusterVertices; ++j )
+		{
+			int source = vertexSources[ j ];
+			if( isShared[ source ] && sharedVertexIndices[ source ] != -1 )
+			{
+				localToStitched[ j ] = sharedVertexIndices[ source ];
+				continue;
+			}
+
+			localToStitched[ j ] = static_cast< int >( stitchedPositions.size() );
+			if( isShared[ source ] )
+			{
+				sharedVertexIndices[ source ] = localToStitched[ j ];
+			}
+			stitchedPositions.push_back( cluster.m_positions[ j ] );
+			if( hasNormals )
+			{
+				stitchedNormals.push_back( cluster.m_normals[ j ] );
+			}
+		}
+
+		for( int i = 0; i < cluster.numFaces(); ++i )
+		{
+			const Vector3i& face = cluster.m_faces[ i ];
+			stitchedFaces.push_back( Vector3i( localToStitched[ face.x ], localToStitched[ face.y ], localToStitched[ face.z ] ) );
+		}
+	}
+	clusters.clear();
+
+	mesh.m_positions.swap( stitchedPositions );
+	mesh.m_normals.swap( stitchedNormals );
+	mesh.m_faces.swap( stitchedFaces );
+	mesh.invalidateDerivedData();
+
+	// collapse across the seams
+	return simplify( mesh, targetFaces, maxError );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+void TriangleMeshSimplifier::simplify( std::vector< Vector3f >& positions, std::vector< Vector3f >& normals,
+	std::vector< Vector3i >& faces, const std::vector< uint8 >& isFixed,
+	int targetFaces, float maxError,
+	std::vector< int >& vertexSources )
+{
+	Simplification simplification( positions, normals, faces, isFixed );
+	simplification.run( targetFaces, maxError );
+	simplification.compact( vertexSources );
+}
+
+TriangleMeshSimplifier::Simplification::Simplification( std::vector< Vector3f >& positions, std::vector< Vector3f >& normals,
+	std::vector< Vector3i >& faces, const std::vector< uint8 >& isFixed ) :
+
+	positions( positions ),
+	normals( normals ),
+	faces( faces ),
+	fixedVertices( isFixed ),
+	hasNormals( normals.size() == positions.size() ),
+	nLiveFaces( static_cast< int >( faces.size() ) )
+
+{
+	int nVertices = static_cast< int >( positions.size() );
+	int nFaces = static_cast< int >( faces.size() );
+
+	quadrics.resize( nVertices );
+	isBoundary.assign( nVertices, 0 );
+	versions.assign( nVertices, 0 );
+	isFaceDeleted.assign( nFaces, 0 );
+
+	TriangleMeshAdjacency adjacency( faces, nVertices );
+
+	std::vector< Vector3f > unitNormals( nFaces );
+	std::vector< Quadric > faceQuadrics( nFaces );
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
+	{
+		const Vector3f& p0 = positions[ faces[ f ].x ];
+		Vector3f n = faceNormal( p0, positions[ faces[ f ].y ], positions[ faces[ f ].z ] );
+		float length = n.norm();
+		if( length > 0 )
+		{
+			n = n / length;
+			unitNormals[ f ] = n;
+			faceQuadrics[ f ] = Quadric( n, -Vector3f::dot( n, p0 ), 1.0 );
+		}
+		else
+		{
+			unitNormals[ f ] = Vector3f( 0, 0, 0 );
+		}
+	} );
+
+	// each vertex sums the planes of its faces
+	// and of the planes through its boundary edges, perpendicular to their face
+	auto boundaryQuadric = [&]( int h ) -> Quadric
+	{
+		const Vector3f& p0 = positions[ adjacency.origin( h ) ];
+		Vector3f n = Vector3f::cross( positions[ adjacency.target( h ) ] - p0,
+			unitNormals[ TriangleMeshAdjacency::face( h ) ] );
+		float length = n.norm();
+		if( length == 0 )
+		{
+			return Quadric();
+		}
+		n = n / length;
+		return Quadric( n, -Vector3f::dot( n, p0 ), BOUNDARY_WEIGHT );
+	};
+
+	Concurrency::parallel_for( 0, nVertices, [&]( int v )
+	{
+		const int* end = adjacency.oneRingEnd( v );
+		for( const int* itr = adjacency.oneRingBegin( v ); itr != end; ++itr )
+		{
+			int h = *itr;
+			quadrics[ v ].add( faceQuadrics[ TriangleMeshAdjacency::face( h ) ] );
+
+			// the outgoing and incoming half edges of v in this face
+			int hIn = TriangleMeshAdjacency::prev( h );
+			if( adjacency.isBoundary( h ) )
+			{
+				quadrics[ v ].add( boundaryQuadric( h ) );
+				isBoundary[ v ] = 1;
+			}
+			if( adjacency.isBoundary( hIn ) )
+			{
+				quadrics[ v ].add( boundaryQuadric( hIn ) );
+				isBoundary[ v ] = 1;
+			}
+		}
+	} );
+
+	// the face lists
+	listHeads.assign( nVertices, -1 );
+	listTails.assign( nVertices, -1 );
+	nodeNext.assign( 3 * nFaces, -1 );
+	for( int node = 0; node < 3 * nFaces; ++node )
+	{
+		int v = faces[ node / 3 ][ node % 3 ];
+		if( listHeads[ v ] == -1 )
+		{
+			listHeads[ v ] = node;
+		}
+		else
+		{
+			nodeNext[ listTails[ v ] ] = node;
+		}
+		listTails[ v ] = node;
+	}
+
+	// every edge once: boundary half edges and the first of each pair
+	std::vector< EdgeCollapse > collapses( 3 * nFaces );
+	std::vector< uint8 > isValid( 3 * nFaces, 0 );
+	Concurrency::parallel_for( 0, 3 * nFaces, [&]( int h )
+	{
+		int o = adjacency.opposite( h );
+		if( o == -1 || h < o )
+		{
+			isValid[ h ] = evaluate( adjacency.origin( h ), adjacency.target( h ), collapses[ h ] );
+		}
+	} );
+
+	int nValid = 0;
+	for( int h = 0; h < 3 * nFaces; ++h )
+	{
+		if( isValid[ h ] )
+		{
+			collapses[ nValid ] = collapses[ h ];
+			++nValid;
+		}
+	}
+	collapses.resize( nValid );
+	queue = std::priority_queue< EdgeCollapse, std::vector< EdgeCollapse >, CostGreater >(
+		CostGreater(), collapses );
+}
+
+void TriangleMeshSimplifier::Simplification::run( int targetFaces, float maxError )
+{
+	while( nLiveFaces > targetFaces && !( queue.empty() ) )
+	{
+		EdgeCollapse collapse = queue.top();
+		queue.pop();
+
+		// skip entries from before an endpoint changed
+		if( versions[ collapse.v0 ] != collapse.version0 ||
+			versions[ collapse.v1 ] != collapse.version1 )
+		{
+			continue;
+		}
+		if( collapse.cost > maxError )
+		{
+			break;
+		}
+		tryCollapse( collapse );
+	}
+}
+
+void TriangleMeshSimplifier::Simplification::compact( std::vector< int >& vertexSources )
+{
+	int nVertices = static_cast< int >( positions.size() );
+	int nFaces = static_cast< int >( faces.size() );
+
+	std::vector< int > newIndices( nVertices, -1 );
+	std::vector< Vector3i > liveFaces;
+	liveFaces.reserve( nLiveFaces );
+	for( int f = 0; f < nFaces; ++f )
+	{
+		if( !isFaceDeleted[ f ] )
+		{
+			liveFaces.push_back( faces[ f ] );
+			newIndices[ faces[ f ].x ] = 0;
+			newIndices[ faces[ f ].y ] = 0;
+			newIndices[ faces[ f ].z ] = 0;
+		}
+	}
+
+	vertexSources.clear();
+	std::vector< Vector3f > usedPositions;
+	std::vector< Vector3f > usedNormals;
+	for( int v = 0; v < nVertices; ++v )
+	{
+		if( newIndices[ v ] == 0 )
+		{
+			newIndices[ v ] = static_cast< int >( vertexSources.size() );
+			vertexSources.push_back( v );
+			usedPositions.push_back( positions[ v ] );
+			if( hasNormals )
+			{
+				usedNormals.push_back( normals[ v ] );
+			}
+		}
+	}
+
+	for( int f = 0; f < static_cast< int >( liveFaces.size() ); ++f )
+	{
+		Vector3i& face = liveFaces[ f ];
+		face = Vector3i( newIndices[ face.x ], newIndices[ face.y ], newIndices[ face.z ] );
+	}
+
+	positions.swap( usedPositions );
+	faces.swap( liveFaces );
+	if( hasNormals )
+	{
+		normals.swap( usedNormals );
+	}
+}
+
+bool TriangleMeshSimplifier::Simplification::isFixed( int v ) const
+{
+	return( !( fixedVertices.empty() ) && fixedVertices[ v ] != 0 );
+}
+
+bool TriangleMeshSimplifier::Simplification::evaluate( int v0, int v1, EdgeCollapse& collapse ) const
+{
+	// v1 goes away: keep the fixed one
+	if( isFixed( v1 ) )
+	{
+		if( isFixed( v0 ) )
+		{
+			return false;
+		}
+		std::swap( v0, v1 );
+	}
+
+	Quadric q = quadrics[ v0 ];
+	q.add( quadrics[ v1 ] );
+
+	Vector3f position;
+	if( isFixed( v0 ) )
+	{
+		position = positions[ v0 ];
+	}
+	else if( !q.minimize( position ) )
+	{
+		// the best of the endpoints and the midpoint
+		Vector3f candidates[ 3 ] =
+		{
+			positions[ v0 ],
+			positions[ v1 ],
+			0.5f * ( positions[ v0 ] + positions[ v1 ] )
+		};
+		position = candidates[ 0 ];
+		double minError = q.error( candidates[ 0 ] );
+		for( int i = 1; i < 3; ++i )
+		{
+			double error = q.error( candidates[ i ] );
+			if( error < minError )
+			{
+				minError = error;
+				position = candidates[ i ];
+			}
+		}
+	}
+
+	collapse.cost = static_cast< float >( std::max( 0.0, q.error( position ) ) );
+	collapse.v0 = v0;
+	collapse.v1 = v1;
+	collapse.version0 = versions[ v0 ];
+	collapse.version1 = versions[ v1 ];
+	collapse.position = position;
+	return true;
+}
+
+bool TriangleMeshSimplifier::Simplification::tryCollapse( const EdgeCollapse& collapse )
+{
+	int v0 = collapse.v0;
+	int v1 = collapse.v1;
+	const Vector3f& position = collapse.position;
+
+	gatherFaces( v0, faces0 );
+	gatherFaces( v1, faces1 );
+
+	int nShared = 0;
+	for( int i = 0; i < static_cast< int >( faces0.size() ); ++i )
+	{
+		if( faceContains( faces[ faces0[ i ] ], v1 ) )
+		{
+			++nShared;
+		}
+	}
+	if( nShared == 0 )
+	{
+		return false;
+	}
+
+	// the link condition: the endpoints' only common neighbors
+	// are the opposite vertices of the faces on the edge
+	gatherNeighbors( faces0, v0, neighbors0 );
+	gatherNeighbors( faces1, v1, neighbors1 );
+	int nCommon = 0;
+	int i0 = 0;
+	int i1 = 0;
+	while( i0 < static_cast< int >( neighbors0.size() ) && i1 < static_cast< int >( neighbors1.size() ) )
+	{
+		if( neighbors0[ i0 ] < neighbors1[ i1 ] )
+		{
+			++i0;
+		}
+		else if( neighbors1[ i1 ] < neighbors0[ i0 ] )
+		{
+			++i1;
+		}
+		else
+		{
+			++nCommon;
+			++i0;
+			++i1;
+		}
+	}
+	if( nCommon != nShared )
+	{
+		return false;
+	}
+
+	// an interior edge between two boundary vertices would pinch the mesh
+	if( nShared > 1 && isBoundary[ v0 ] && isBoundary[ v1 ] )
+	{
+		return false;
+	}
+
+	for( int i = 0; i < static_cast< int >( faces0.size() ); ++i )
+	{
+		if( !faceContains( faces[ faces0[ i ] ], v1 ) && flips( faces0[ i ], v0, position ) )
+		{
+			return false;
+		}
+	}
+	for( int i = 0; i < static_cast< int >( faces1.size() ); ++i )
+	{
+		if( !faceContains( faces[ faces1[ i ] ], v0 ) && flips( faces1[ i ], v1, position ) )
+		{
+			return false;
+		}
+	}
+
+	// collapse: the faces on the edge go away, v1's other faces move to v0
+	for( int i = 0; i < static_cast< int >( faces1.size() ); ++i )
+	{
+		int f = faces1[ i ];
+		Vector3i& face = faces[ f ];
+		if( faceContains( face, v0 ) )
+		{
+			isFaceDeleted[ f ] = 1;
+			--nLiveFaces;
+		}
+		else
+		{
+			for( int k = 0; k < 3; ++k )
+			{
+				if( face[ k ] == v1 )
+				{
+					face[ k ] = v0;
+				}
+			}
+		}
+	}
+
+	positions[ v0 ] = position;
+	quadrics[ v0 ].add( quadrics[ v1 ] );
+	isBoundary[ v0 ] = isBoundary[ v0 ] | isBoundary[ v1 ];
+	if( hasNormals )
+	{
+		Vector3f n = normals[ v0 ] + normals[ v1 ];
+		float length = n.norm();
+		if( length > 0 )
+		{
+			normals[ v0 ] = n / length;
+		}
+	}
+
+	// append v1's faces to v0's
+	if( listHeads[ v1 ] != -1 )
+	{
+		if( listHeads[ v0 ] == -1 )
+		{
+			listHeads[ v0 ] = listHeads[ v1 ];
+		}
+		else
+		{
+			nodeNext[ listTails[ v0 ] ] = listHeads[ v1 ];
+		}
+		listTails[ v0 ] = listTails[ v1 ];
+		listHeads[ v1 ] = -1;
+		listTails[ v1 ] = -1;
+	}
+
+	versions[ v1 ] = -1;
+	++( versions[ v0 ] );
+
+	// v0's edges have new costs
+	for( int pass = 0; pass < 2; ++pass )
+	{
+		const std::vector< int >& neighbors = ( pass == 0 ) ? neighbors0 : neighbors1;
+		for( int i = 0; i < static_cast< int >( neighbors.size() ); ++i )
+		{
+			int n = neighbors[ i ];
+			if( n == v0 || n == v1 ||
+				( pass == 1 && std::binary_search( neighbors0.begin(), neighbors0.end(), n ) ) )
+			{
+				continue;
+			}
+
+			EdgeCollapse next;
+			if( evaluate( v0, n, next ) )
+			{
+				queue.push( next );
+			}
+		}
+	}
+
+	return true;
+}
+
+bool TriangleMeshSimplifier::Simplification::flips( int f, int v, const Vector3f& position ) const
+{
+	const Vector3i& face = faces[ f ];
+	Vector3f p[ 3 ];
+	for( int k = 0; k < 3; ++k )
+	{
+		p[ k ] = positions[ face[ k ] ];
+	}
+	Vector3f before = faceNormal( p[ 0 ], p[ 1 ], p[ 2 ] );
+
+	for( int k = 0; k < 3; ++k )
+	{
+		if( face[ k ] == v )
+		{
+			p[ k ] = position;
+		}
+	}
+	Vector3f after = faceNormal( p[ 0 ], p[ 1 ], p[ 2 ] );
+
+	float afterLength = after.norm();
+	if( afterLength == 0 )
+	{
+		return true;
+	}
+	float beforeLength = before.norm();
+	if( beforeLength == 0 )
+	{
+		return false;
+	}
+	return( Vector3f::dot( before, after ) < MIN_NORMAL_COSINE * beforeLength * afterLength );
+}
+
+void TriangleMeshSimplifier::Simplification::gatherFaces( int v, std::vector< int >& vertexFaces )
+{
+	vertexFaces.clear();
+
+	int previous = -1;
+	for( int node = listHeads[ v ]; node != -1; node = nodeNext[ node ] )
+	{
+		int f = node / 3;
+		if( isFaceDeleted[ f ] )
+		{
+			// unlink it
+			if( previous == -1 )
+			{
+				listHeads[ v ] = nodeNext[ node ];
+			}
+			else
+			{
+				nodeNext[ previous ] = nodeNext[ node ];
+			}
+			if( listTails[ v ] == node )
+			{
+				listTails[ v ] = previous;
+			}
+		}
+		else
+		{
+			vertexFaces.push_back( f );
+			previous = node;
+		}
+	}
+}
+
+void TriangleMeshSimplifier::Simplification::gatherNeighbors( const std::vector< int >& vertexFaces, int v,
+	std::vector< int >& neighbors ) const
+{
+	neighbors.clear();
+	for( int i = 0; i < static_cast< int >( vertexFaces.size() ); ++i )
+	{
+		const Vector3i& face = faces[ vertexFaces[ i ] ];
+		for( int k = 0; k < 3; ++k )
+		{
+			if( face[ k ] != v )
+			{
+				neighbors.push_back( face[ k ] );
+			}
+		}
+	}
+	std::sort( neighbors.begin(), neighbors.end() );
+	neighbors.erase( std::unique( neighbors.begin(), neighbors.end() ), neighbors.end() );
+}
@@ -0,0 +1,696 @@
+#include "geometry/TriangleMeshVoxelizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <emmintrin.h>
+#include <ppl.h>
+
+#include "math/Arithmetic.h"
+
+// static
+const int TriangleMeshVoxelizer::BRICK_SIZE = 32;
+
+// static
+const int TriangleMeshVoxelizer::MAX_BIN_CHUNKS = 64;
+
+// static
+const int TriangleMeshVoxelizer::MIN_BIN_CHUNK_SIZE = 4096;
+
+// static
+const float TriangleMeshVoxelizer::GUARD_BAND = 1048576.f;
+
+// The separating axis tests of a face against unit voxels (Schwarz and Seidel 2010)
+// In voxels, voxel p = ( x, y, z ) overlaps the face if it overlaps its bounding box and:
+//   dot( normal, p ) + d1 >= 0 and dot( normal, p ) + d2 <= 0 (the face's plane)
+//   xyX[ i ] * x + xyY[ i ] * y + xyD[ i ] >= 0 for each edge i (the projection onto xy)
+//   and likewise for the projections onto yz and zx
+// which are the tests of GeometryUtils::triangleAABBOverlap
+struct TriangleMeshVoxelizer::SurfaceFace
+{
+	Vector3f normal;
+	float d1;
+	float d2;
+
+	// dot( normal, v0 )
+	float offset;
+
+	float xyX[ 3 ];
+	float xyY[ 3 ];
+	float xyD[ 3 ];
+
+	float yzY[ 3 ];
+	float yzZ[ 3 ];
+	float yzD[ 3 ];
+
+	float zxZ[ 3 ];
+	float zxX[ 3 ];
+	float zxD[ 3 ];
+
+	// the voxels in its bounding box, clipped to the grid
+	int lo[ 3 ];
+	int hi[ 3 ];
+};
+
+// A ray along +z from column ( x, y ) of a tile crossing a face below the center of voxel z
+// sign is +1 if the face faces -z, -1 if +z
+struct TriangleMeshVoxelizer::Crossing
+{
+	int column;
+	int z;
+	int sign;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool TriangleMeshVoxelizer::voxelizeSurface( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+	const Vector3f& origin, float voxelSize, const Vector3i& resolution,
+	Array3D< uint32 >& bits )
+{
+	if( !checkGrid( voxelSize, resolution ) )
+	{
+		return false;
+	}
+
+	float inverseVoxelSize = 1.f / voxelSize;
+	Vector3i nBricks
+	(
+		( resolution.x + BRICK_SIZE - 1 ) / BRICK_SIZE,
+		( resolution.y + BRICK_SIZE - 1 ) / BRICK_SIZE,
+		( resolution.z + BRICK_SIZE - 1 ) / BRICK_SIZE
+	);
+	bits.resize( nBricks.x, resolution.y, resolution.z );
+
+	int nFaces = static_cast< int >( faces.size() );
+	std::vector< int > faceBins( 6 * nFaces );
+	Concurrency::parallel_for( 0, nFaces, MIN_BIN_CHUNK_SIZE, [&]( int begin )
+	{
+		int end = std::min( begin + MIN_BIN_CHUNK_SIZE, nFaces );
+		for( int f = begin; f < end; ++f )
+		{
+			int* bins = &( faceBins[ 6 * f ] );
+			SurfaceFace surfaceFace;
+			if( setUpSurfaceFace( positions, faces[ f ], origin, inverseVoxelSize, resolution, surfaceFace ) )
+			{
+				for( int k = 0; k < 3; ++k )
+				{
+					bins[ k ] = surfaceFace.lo[ k ] / BRICK_SIZE;
+					bins[ 3 + k ] = surfaceFace.hi[ k ] / BRICK_SIZE;
+				}
+			}
+			else
+			{
+				bins[ 0 ] = 0;
+				bins[ 3 ] = -1;
+			}
+		}
+	} );
+
+	std::vector< int > brickStarts;
+	std::vector< int > brickFaces;
+	binFaces( faceBins, nBricks, brickStarts, brickFaces );
+
+	int nBricksTotal = nBricks.x * nBricks.y * nBricks.z;
+	Concurrency::parallel_for( 0, nBricksTotal, [&]( int b )
+	{
+		int brickLo[ 3 ];
+		int brickHi[ 3 ];
+		brickLo[ 0 ] = ( b % nBricks.x ) * BRICK_SIZE;
+		brickLo[ 1 ] = ( ( b / nBricks.x ) % nBricks.y ) * BRICK_SIZE;
+		brickLo[ 2 ] = ( b / ( nBricks.x * nBricks.y ) ) * BRICK_SIZE;
+		for( int k = 0; k < 3; ++k )
+		{
+			brickHi[ k ] = std::min( brickLo[ k ] + BRICK_SIZE, resolution[ k ] ) - 1;
+		}
+
+		// one word per row of the brick, indexed by ( y, z ) in the brick
+		std::vector< uint32 > words( BRICK_SIZE * BRICK_SIZE, 0 );
+
+		__m128 laneOffsets = _mm_set_ps( 3, 2, 1, 0 );
+		__m128 zero = _mm_setzero_ps();
+
+		for( int i = brickStarts[ b ]; i < brickStarts[ b + 1 ]; ++i )
+		{
+			SurfaceFace face;
+			setUpSurfaceFace( positions, faces[ brickFaces[ i ] ], origin, inverseVoxelSize, resolution, face );
+
+			// skip the brick if it doesn't overlap the face's plane
+			float brickDot = 0;
+			float brickMin = 0;
+			float brickMax = 0;
+			for( int k = 0; k < 3; ++k )
+			{
+				brickDot += face.normal[ k ] * brickLo[ k ];
+				float extent = face.normal[ k ] * BRICK_SIZE;
+				brickMin += std::min( extent, 0.f );
+				brickMax += std::max( extent, 0.f );
+			}
+			// with some slack for roundoff, so that the test is never stricter than the voxels'
+			float slack = 1e-5f * ( brickMax - brickMin + std::abs( brickDot ) + std::abs( face.offset ) );
+			if( face.offset < brickDot + brickMin - slack || face.offset > brickDot + brickMax + slack )
+			{
+				continue;
+			}
+
+			int lo[ 3 ];
+			int hi[ 3 ];
+			for( int k = 0; k < 3; ++k )
+			{
+				lo[ k ] = std::max( face.lo[ k ], brickLo[ k ] );
+				hi[ k ] = std::min( face.hi[ k ], brickHi[ k ] );
+			}
+
+			__m128 normalX = _mm_set1_ps( face.normal.x );
+			__m128 xyX[ 3 ];
+			__m128 zxX[ 3 ];
+			for( int e = 0; e < 3; ++e )
+			{
+				xyX[ e ] = _mm_set1_ps( face.xyX[ e ] );
+				zxX[ e ] = _mm_set1_ps( face.zxX[ e ] );
+			}
+
+			for( int z = lo[ 2 ]; z <= hi[ 2 ]; ++z )
+			{
+				float fz = static_cast< float >( z );
+				for( int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+				{
+					float fy = static_cast< float >( y );
+
+					// the projection onto yz is the same along the row
+					bool isInside = true;
+					for( int e = 0; e < 3; ++e )
+					{
+						isInside = isInside && ( face.yzY[ e ] * fy + face.yzZ[ e ] * fz + face.yzD[ e ] >= 0 );
+					}
+					if( !isInside )
+					{
+						continue;
+					}
+
+					// the rest are linear in x
+					float planeRow = face.normal.y * fy + face.normal.z * fz;
+					__m128 planeRow1 = _mm_set1_ps( planeRow + face.d1 );
+					__m128 planeRow2 = _mm_set1_ps( planeRow + face.d2 );
+					__m128 xyRow[ 3 ];
+					__m128 zxRow[ 3 ];
+					for( int e = 0; e < 3; ++e )
+					{
+						xyRow[ e ] = _mm_set1_ps( face.xyY[ e ] * fy + face.xyD[ e ] );
+						zxRow[ e ] = _mm_set1_ps( face.zxZ[ e ] * fz + face.zxD[ e ] );
+					}
+
+					uint32 rowBits = 0;
+					for( int x = lo[ 0 ]; x <= hi[ 0 ]; x += 4 )
+					{
+						__m128 px = _mm_add_ps( _mm_set1_ps( static_cast< float >( x ) ), laneOffsets );
+						__m128 planeDot = _mm_mul_ps( normalX, px );
+						__m128 overlaps = _mm_and_ps(
+							_mm_cmpge_ps( _mm_add_ps( planeDot, planeRow1 ), zero ),
+							_mm_cmple_ps( _mm_add_ps( planeDot, planeRow2 ), zero ) );
+						for( int e = 0; e < 3; ++e )
+						{
+							overlaps = _mm_and_ps( overlaps,
+								_mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( xyX[ e ], px ), xyRow[ e ] ), zero ) );
+							overlaps = _mm_and_ps( overlaps,
+								_mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( zxX[ e ], px ), zxRow[ e ] ), zero ) );
+						}
+
+						uint32 mask = static_cast< uint32 >( _mm_movemask_ps( overlaps ) );
+						int nLanes = hi[ 0 ] - x + 1;
+						if( nLanes < 4 )
+						{
+							mask &= ( 1u << nLanes ) - 1;
+						}
+						rowBits |= mask << ( x - brickLo[ 0 ] );
+					}
+					words[ ( z - brickLo[ 2 ] ) * BRICK_SIZE + ( y - brickLo[ 1 ] ) ] |= rowBits;
+				}
+			}
+		}
+
+		// the brick owns its words, including the empty ones
+		int wordX = brickLo[ 0 ] / BRICK_SIZE;
+		for( int z = brickLo[ 2 ]; z <= brickHi[ 2 ]; ++z )
+		{
+			for( int y = brickLo[ 1 ]; y <= brickHi[ 1 ]; ++y )
+			{
+				bits( wordX, y, z ) = words[ ( z - brickLo[ 2 ] ) * BRICK_SIZE + ( y - brickLo[ 1 ] ) ];
+			}
+		}
+	} );
+
+	return true;
+}
+
+// static
+bool TriangleMeshVoxelizer::voxelizeSurface( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+	const Vector3f& origin, float voxelSize, const Vector3i& resolution,
+	Array3D< ubyte >& voxels )
+{
+	Array3D< uint32 > bits;
+	if( !voxelizeSurface( positions, faces, origin, voxelSize, resolution, bits ) )
+	{
+		return false;
+	}
+	unpack( bits, resolution, voxels );
+	return true;
+}
+
+// static
+bool TriangleMeshVoxelizer::voxelizeSolid( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+	const Vector3f& origin, float voxelSize, const Vector3i& resolution, FillRule fillRule,
+	Array3D< uint32 >& bits )
+{
+	if( !checkGrid( voxelSize, resolution ) )
+	{
+		return false;
+	}
+
+	// the columns are split into tiles of BRICK_SIZE^2, each spanning z
+	float inverseVoxelSize = 1.f / voxelSize;
+	Vector3i nTiles
+	(
+		( resolution.x + BRICK_SIZE - 1 ) / BRICK_SIZE,
+		( resolution.y + BRICK_SIZE - 1 ) / BRICK_SIZE,
+		1
+	);
+	bits.resize( nTiles.x, resolution.y, resolution.z );
+
+	// faces are snapped to 1 / 2^SUBPIXEL_BITS of a voxel in x and y
+	// so that the edge functions are exact in 64 bit integers
+	const int SUBPIXEL_BITS = 8;
+	const int subpixels = 1 << SUBPIXEL_BITS;
+	const int halfPixel = subpixels / 2;
+
+	// snaps face f and finds the columns whose centers are in its bounding box
+	// returns false if it's degenerate, outside the guard band, or covers no columns
+	auto setUpFace = [&]( int f, int64 x[ 3 ], int64 y[ 3 ], double z[ 3 ], int64& sum, bool& swapped,
+		int& x0, int& y0, int& x1, int& y1 ) -> bool
+	{
+		for( int i = 0; i < 3; ++i )
+		{
+			Vector3f v = ( positions[ faces[ f ][ i ] ] - origin ) * inverseVoxelSize;
+			if( !( std::abs( v.x ) <= GUARD_BAND && std::abs( v.y ) <= GUARD_BAND ) )
+			{
+				return false;
+			}
+			x[ i ] = Arithmetic::roundToInt( static_cast< double >( v.x ) * subpixels );
+			y[ i ] = Arithmetic::roundToInt( static_cast< double >( v.y ) * subpixels );
+			z[ i ] = v.z;
+		}
+
+		sum = ( x[ 1 ] - x[ 0 ] ) * ( y[ 2 ] - y[ 0 ] ) - ( x[ 2 ] - x[ 0 ] ) * ( y[ 1 ] - y[ 0 ] );
+		if( sum == 0 )
+		{
+			return false;
+		}
+		swapped = ( sum < 0 );
+		if( swapped )
+		{
+			std::swap( x[ 1 ], x[ 2 ] );
+			std::swap( y[ 1 ], y[ 2 ] );
+			std::swap( z[ 1 ], z[ 2 ] );
+			sum = -sum;
+		}
+
+		int64 minX = std::min( x[ 0 ], std::min( x[ 1 ], x[ 2 ] ) );
+		int64 minY = std::min( y[ 0 ], std::min( y[ 1 ], y[ 2 ] ) );
+		int64 maxX = std::max( x[ 0 ], std::max( x[ 1 ], x[ 2 ] ) );
+		int64 maxY = std::max( y[ 0 ], std::max( y[ 1 ], y[ 2 ] ) );
+		x0 = static_cast< int >( std::max( ( minX - halfPixel + subpixels - 1 ) >> SUBPIXEL_BITS, 0LL ) );
+		y0 = static_cast< int >( std::max( ( minY - halfPixel + subpixels - 1 ) >> SUBPIXEL_BITS, 0LL ) );
+		x1 = static_cast< int >( std::min( ( maxX - halfPixel ) >> SUBPIXEL_BITS, resolution.x - 1LL ) );
+		y1 = static_cast< int >( std::min( ( maxY - halfPixel ) >> SUBPIXEL_BITS, resolution.y - 1LL ) );
+		return( x0 <= x1 && y0 <= y1 );
+	};
+
+	int nFaces = static_cast< int >( faces.size() );
+	std::vector< int > faceBins( 6 * nFaces );
+	Concurrency::parallel_for( 0, nFaces, MIN_BIN_CHUNK_SIZE, [&]( int begin )
+	{
+		int end = std::min( begin + MIN_BIN_CHUNK_SIZE, nFaces );
+		for( int f = begin; f < end; ++f )
+		{
+			int* bins = &( faceBins[ 6 * f ] );
+			int64 x[ 3 ];
+			int64 y[ 3 ];
+			double z[ 3 ];
+			int64 sum;
+			bool swapped;
+			int x0;
+			int y0;
+			int x1;
+			int y1;
+			if( setUpFace( f, x, y, z, sum, swapped, x0, y0, x1, y1 ) )
+			{
+				bins[ 0 ] = x0 / BRICK_SIZE;
+				bins[ 1 ] = y0 / BRICK_SIZE;
+				bins[ 2 ] = 0;
+				bins[ 3 ] = x1 / BRICK_SIZE;
+				bins[ 4 ] = y1 / BRICK_SIZE;
+				bins[ 5 ] = 0;
+			}
+			else
+			{
+				bins[ 0 ] = 0;
+				bins[ 3 ] = -1;
+			}
+		}
+	} );
+
+	std::vector< int > tileStarts;
+	std::vector< int > tileFaces;
+	binFaces( faceBins, nTiles, tileStarts, tileFaces );
+
+	int nTilesTotal = nTiles.x * nTiles.y;
+	Concurrency::parallel_for( 0, nTilesTotal, [&]( int t )
+	{
+		int tileX0 = ( t % nTiles.x ) * BRICK_SIZE;
+		int tileY0 = ( t / nTiles.x ) * BRICK_SIZE;
+		int tileX1 = std::min( tileX0 + BRICK_SIZE, resolution.x ) - 1;
+		int tileY1 = std::min( tileY0 + BRICK_SIZE, resolution.y ) - 1;
+		int wordX = tileX0 / BRICK_SIZE;
+
+		// find where each column's ray crosses the faces
+		std::vector< Crossing > crossings;
+		for( int i = tileStarts[ t ]; i < tileStarts[ t + 1 ]; ++i )
+		{
+			int64 x[ 3 ];
+			int64 y[ 3 ];
+			double z[ 3 ];
+			int64 sum;
+			bool swapped;
+			int x0;
+			int y0;
+			int x1;
+			int y1;
+			setUpFace( tileFaces[ i ], x, y, z, sum, swapped, x0, y0, x1, y1 );
+			x0 = std::max( x0, tileX0 );
+			y0 = std::max( y0, tileY0 );
+			x1 = std::min( x1, tileX1 );
+			y1 = std::min( y1, tileY1 );
+
+			// the edge functions, with the top-left rule so that a ray through
+			// an edge shared by faces on either side of it crosses exactly one
+			int64 a[ 3 ];
+			int64 b[ 3 ];
+			int64 c[ 3 ];
+			int64 threshold[ 3 ];
+			for( int e = 0; e < 3; ++e )
+			{
+				int j = ( e == 2 ) ? 0 : e + 1;
+				int k = ( e == 0 ) ? 2 : e - 1;
+				a[ e ] = y[ j ] - y[ k ];
+				b[ e ] = x[ k ] - x[ j ];
+				c[ e ] = x[ j ] * y[ k ] - y[ j ] * x[ k ];
+				bool isInclusive = ( a[ e ] > 0 ) || ( a[ e ] == 0 && b[ e ] > 0 );
+				threshold[ e ] = isInclusive ? 0 : 1;
+			}
+
+			int sign = swapped ? 1 : -1;
+			double inverseSum = 1.0 / static_cast< double >( sum );
+			for( int py = y0; py <= y1; ++py )
+			{
+				int64 cy = static_cast< int64 >( py ) * subpixels + halfPixel;
+				for( int px = x0; px <= x1; ++px )
+				{
+					int64 cx = static_cast< int64 >( px ) * subpixels + halfPixel;
+					int64 e0 = a[ 0 ] * cx + b[ 0 ] * cy + c[ 0 ];
+					int64 e1 = a[ 1 ] * cx + b[ 1 ] * cy + c[ 1 ];
+					int64 e2 = a[ 2 ] * cx + b[ 2 ] * cy + c[ 2 ];
+					if( e0 < threshold[ 0 ] || e1 < threshold[ 1 ] || e2 < threshold[ 2 ] )
+					{
+						continue;
+					}
+
+					// the first voxel whose center is above the crossing
+					double hitZ = z[ 0 ] +
+						( e1 * inverseSum ) * ( z[ 1 ] - z[ 0 ] ) +
+						( e2 * inverseSum ) * ( z[ 2 ] - z[ 0 ] );
+					double firstAbove = std::floor( hitZ - 0.5 ) + 1;
+					if( firstAbove >= resolution.z )
+					{
+						continue;
+					}
+
+					Crossing crossing;
+					crossing.column = ( py - tileY0 ) * BRICK_SIZE + ( px - tileX0 );
+					crossing.z = static_cast< int >( std::max( firstAbove, 0.0 ) );
+					crossing.sign = sign;
+					crossings.push_back( crossing );
+				}
+			}
+		}
+		std::sort( crossings.begin(), crossings.end(), []( const Crossing& c0, const Crossing& c1 ) -> bool
+		{
+			if( c0.column != c1.column )
+			{
+				return c0.column < c1.column;
+			}
+			return c0.z < c1.z;
+		} );
+
+		// the tile owns its words, including the empty ones
+		for( int z = 0; z < resolution.z; ++z )
+		{
+			for( int y = tileY0; y <= tileY1; ++y )
+			{
+				bits( wordX, y, z ) = 0;
+			}
+		}
+
+		// sweep each column's crossings up z
+		int nCrossings = static_cast< int >( crossings.size() );
+		int i = 0;
+		while( i < nCrossings )
+		{
+			int column = crossings[ i ].column;
+			int y = tileY0 + column / BRICK_SIZE;
+			uint32 bit = 1u << ( column % BRICK_SIZE );
+
+			int winding = 0;
+			int parity = 0;
+			while( i < nCrossings && crossings[ i ].column == column )
+			{
+				int zBegin = crossings[ i ].z;
+				while( i < nCrossings && crossings[ i ].column == column && crossings[ i ].z == zBegin )
+				{
+					winding += crossings[ i ].sign;
+					parity ^= 1;
+					++i;
+				}
+				int zEnd = ( i < nCrossings && crossings[ i ].column == column ) ?
+					crossings[ i ].z : resolution.z;
+
+				bool isInside = ( fillRule == PARITY ) ? ( parity != 0 ) : ( winding != 0 );
+				if( isInside )
+				{
+					for( int z = zBegin; z < zEnd; ++z )
+					{
+						bits( wordX, y, z ) |= bit;
+					}
+				}
+			}
+		}
+	} );
+
+	return true;
+}
+
+// static
+bool TriangleMeshVoxelizer::voxelizeSolid( const std::vector< Vector3f >& positions, const std::vector< Vector3i >& faces,
+	const Vector3f& origin, float voxelSize, const Vector3i& resolution, FillRule fillRule,
+	Array3D< ubyte >& voxels )
+{
+	Array3D< uint32 > bits;
+	if( !voxelizeSolid( positions, faces, origin, voxelSize, resolution, fillRule, bits ) )
+	{
+		return false;
+	}
+	unpack( bits, resolution, voxels );
+	return true;
+}
+
+// static
+bool TriangleMeshVoxelizer::isOccupied( const Array3D< uint32 >& bits, int x, int y, int z )
+{
+	return( ( bits( x / BRICK_SIZE, y, z ) >> ( x % BRICK_SIZE ) ) & 1 ) != 0;
+}
+
+// static
+void TriangleMeshVoxelizer::unpack( const Array3D< uint32 >& bits, const Vector3i& resolution,
+	Array3D< ubyte >& voxels )
+{
+	voxels.resize( resolution );
+	Concurrency::parallel_for( 0, resolution.z, [&]( int z )
+	{
+		for( int y = 0; y < resolution.y; ++y )
+		{
+			const uint32* words = bits.rowPointer( y, z );
+			ubyte* row = voxels.rowPointer( y, z );
+			for( int x = 0; x < resolution.x; ++x )
+			{
+				row[ x ] = static_cast< ubyte >( ( words[ x / BRICK_SIZE ] >> ( x % BRICK_SIZE ) ) & 1 );
+			}
+		}
+	} );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool TriangleMeshVoxelizer::checkGrid( float voxelSize, const Vector3i& resolution )
+{
+	if( !( voxelSize > 0 ) )
+	{
+		fprintf( stderr, "TriangleMeshVoxelizer: voxel size must be positive, got %f\n", voxelSize );
+		return false;
+	}
+	if( resolution.x <= 0 || resolution.y <= 0 || resolution.z <= 0 )
+	{
+		fprintf( stderr, "TriangleMeshVoxelizer: resolution must be positive, got %d x %d x %d\n",
+			resolution.x, resolution.y, resolution.z );
+		return false;
+	}
+	return true;
+}
+
+// static
+void TriangleMeshVoxelizer::binFaces( const std::vector< int >& faceBins, const Vector3i& nBins,
+	std::vector< int >& binStarts, std::vector< int >& binFaces )
+{
+	int nFaces = static_cast< int >( faceBins.size() / 6 );
+	int nBinsTotal = nBins.x * nBins.y * nBins.z;
+
+	int nChunks = std::max( 1, std::min( MAX_BIN_CHUNKS, nFaces / MIN_BIN_CHUNK_SIZE ) );
+	std::vector< int > chunkStarts( nChunks + 1 );
+	for( int c = 0; c <= nChunks; ++c )
+	{
+		chunkStarts[ c ] = static_cast< int >( static_cast< int64 >( nFaces ) * c / nChunks );
+	}
+
+	std::vector< int > histograms( nChunks * nBinsTotal, 0 );
+	Concurrency::parallel_for( 0, nChunks, [&]( int c )
+	{
+		int* histogram = &( histograms[ c * nBinsTotal ] );
+		for( int f = chunkStarts[ c ]; f < chunkStarts[ c + 1 ]; ++f )
+		{
+			const int* bins = &( faceBins[ 6 * f ] );
+			for( int z = bins[ 2 ]; z <= bins[ 5 ]; ++z )
+			{
+				for( int y = bins[ 1 ]; y <= bins[ 4 ]; ++y )
+				{
+					for( int x = bins[ 0 ]; x <= bins[ 3 ]; ++x )
+					{
+						++histogram[ ( z * nBins.y + y ) * nBins.x + x ];
+					}
+				}
+			}
+		}
+	} );
+
+	// each chunk writes each bin after the chunks before it
+	binStarts.resize( nBinsTotal + 1 );
+	int sum = 0;
+	for( int b = 0; b < nBinsTotal; ++b )
+	{
+		binStarts[ b ] = sum;
+		for( int c = 0; c < nChunks; ++c )
+		{
+			int count = histograms[ c * nBinsTotal + b ];
+			histograms[ c * nBinsTotal + b ] = sum;
+			sum += count;
+		}
+	}
+	binStarts[ nBinsTotal ] = sum;
+
+	binFaces.resize( sum );
+	Concurrency::parallel_for( 0, nChunks, [&]( int c )
+	{
+		int* cursors = &( histograms[ c * nBinsTotal ] );
+		for( int f = chunkStarts[ c ]; f < chunkStarts[ c + 1 ]; ++f )
+		{
+			const int* bins = &( faceBins[ 6 * f ] );
+			for( int z = bins[ 2 ]; z <= bins[ 5 ]; ++z )
+			{
+				for( int y = bins[ 1 ]; y <= bins[ 4 ]; ++y )
+				{
+					for( int x = bins[ 0 ]; x <= bins[ 3 ]; ++x )
+					{
+						binFaces[ cursors[ ( z * nBins.y + y ) * nBins.x + x ]++ ] = f;
+					}
+				}
+			}
+		}
+	} );
+}
+
+// static
+bool TriangleMeshVoxelizer::setUpSurfaceFace( const std::vector< Vector3f >& positions, const Vector3i& face,
+	const Vector3f& origin, float inverseVoxelSize, const Vector3i& resolution,
+	SurfaceFace& surfaceFace )
+{
+	Vector3f v[ 3 ];
+	for( int i = 0; i < 3; ++i )
+	{
+		v[ i ] = ( positions[ face[ i ] ] - origin ) * inverseVoxelSize;
+	}
+
+	// the voxels whose closed boxes overlap the face's bounding box
+	for( int k = 0; k < 3; ++k )
+	{
+		float minK = std::min( v[ 0 ][ k ], std::min( v[ 1 ][ k ], v[ 2 ][ k ] ) );
+		float maxK = std::max( v[ 0 ][ k ], std::max( v[ 1 ][ k ], v[ 2 ][ k ] ) );
+		if( !( maxK >= 0 && minK <= resolution[ k ] ) )
+		{
+			return false;
+		}
+		surfaceFace.lo[ k ] = std::max( static_cast< int >( std::ceil( std::max( minK, 0.f ) ) ) - 1, 0 );
+		surfaceFace.hi[ k ] = std::min( static_cast< int >( std::floor( std::min( maxK, static_cast< float >( resolution[ k ] ) ) ) ),
+			resolution[ k ] - 1 );
+	}
+
+	Vector3f edges[ 3 ] = { v[ 1 ] - v[ 0 ], v[ 2 ] - v[ 1 ], v[ 0 ] - v[ 2 ] };
+	Vector3f n = Vector3f::cross( edges[ 0 ], edges[ 1 ] );
+	surfaceFace.normal = n;
+
+	// the plane through the voxel's corners nearest and farthest along the normal
+	Vector3f critical( n.x > 0 ? 1.f : 0.f, n.y > 0 ? 1.f : 0.f, n.z > 0 ? 1.f : 0.f );
+	surfaceFace.offset = Vector3f::dot( n, v[ 0 ] );
+	surfaceFace.d1 = Vector3f::dot( n, critical ) - surfaceFace.offset;
+	surfaceFace.d2 = Vector3f::dot( n, Vector3f( 1, 1, 1 ) - critical ) - surfaceFace.offset;
+
+	// the edge normals in each projection, pointing inward,
+	// offset to the voxel's corner farthest along them
+	float signXY = n.z >= 0 ? 1.f : -1.f;
+	float signYZ = n.x >= 0 ? 1.f : -1.f;
+	float signZX = n.y >= 0 ? 1.f : -1.f;
+	for( int i = 0; i < 3; ++i )
+	{
+		const Vector3f& e = edges[ i ];
+
+		surfaceFace.xyX[ i ] = -e.y * signXY;
+		surfaceFace.xyY[ i ] = e.x * signXY;
+		surfaceFace.xyD[ i ] = -( surfaceFace.xyX[ i ] * v[ i ].x + surfaceFace.xyY[ i ] * v[ i ].y ) +
+			std::max( 0.f, surfaceFace.xyX[ i ] ) + std::max( 0.f, surfaceFace.xyY[ i ] );
+
+		surfaceFace.yzY[ i ] = -e.z * signYZ;
+		surfaceFace.yzZ[ i ] = e.y * signYZ;
+		surfaceFace.yzD[ i ] = -( surfaceFace.yzY[ i ] * v[ i ].y + surfaceFace.yzZ[ i ] * v[ i ].z ) +
+			std::max( 0.f, surfaceFace.yzY[ i ] ) + std::max( 0.f, surfaceFace.yzZ[ i ] );
+
+		surfaceFace.zxZ[ i ] = -e.x * signZX;
+		surfaceFace.zxX[ i ] = e.z * signZX;
+		surfaceFace.zxD[ i ] = -( surfaceFace.zxZ[ i ] * v[ i ].z + surfaceFace.zxX[ i ] * v[ i ].x ) +
+			std::max( 0.f, surfaceFace.zxZ[ i ] ) + std::max( 0.f, surfaceFace.zxX[ i ] );
+	}
+
+	return true;
+}
+
@@ -0,0 +1,464 @@
+#include "geometry/TriangleRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <emmintrin.h>
+#include <ppl.h>
+
+#include "common/BasicTypes.h"
+#include "math/Arithmetic.h"
+
+#include "imageproc/Image1f.h"
+#include "imageproc/Image1i.h"
+
+// static
+const int TriangleRasterizer::TILE_SIZE = 64;
+
+// static
+const int TriangleRasterizer::SUBPIXEL_BITS = 8;
+
+// static
+const float TriangleRasterizer::GUARD_BAND = 16384.f;
+
+// static
+const int TriangleRasterizer::MAX_BIN_CHUNKS = 64;
+
+// static
+const int TriangleRasterizer::MIN_BIN_CHUNK_SIZE = 4096;
+
+// A triangle, wound so that its edge functions are positive inside
+// Edge i is opposite vertex i: E_i( x, y ) = a[ i ] * x + b[ i ] * y + c[ i ],
+// and a pixel is covered if E_i > threshold[ i ] at its center for all i
+struct TriangleRasterizer::Triangle
+{
+	double a[ 3 ];
+	double b[ 3 ];
+	double c[ 3 ];
+	double threshold[ 3 ];
+
+	// 1 / ( E_0 + E_1 + E_2 ), which is the same everywhere
+	double inverseSum;
+
+	// z at vertex 0, and its differences to vertices 1 and 2
+	float z0;
+	float dz1;
+	float dz2;
+
+	// the range z is clamped to, for conservative coverage
+	float zMin;
+	float zMax;
+	bool clampZ;
+
+	// whether vertices 1 and 2 were swapped to wind it
+	bool swapped;
+
+	// the pixels it may cover, clipped to the target
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool TriangleRasterizer::rasterize( const std::vector< Vector3f >& vertices, const std::vector< Vector3i >& faces,
+	Array2D< float >& depth, Array2D< int >* faceIds,
+	Array2D< Vector2f >* barycentrics,
+	Coverage coverage )
+{
+	int width = depth.width();
+	int height = depth.height();
+	if( ( faceIds != nullptr && ( faceIds->width() != width || faceIds->height() != height ) ) ||
+		( barycentrics != nullptr && ( barycentrics->width() != width || barycentrics->height() != height ) ) )
+	{
+		fprintf( stderr, "TriangleRasterizer: targets must be the same size as depth (%d x %d)\n",
+			width, height );
+		return false;
+	}
+
+	rasterize( vertices, faces, coverage, width, height,
+		depth,
+		faceIds != nullptr ? static_cast< int* >( *faceIds ) : nullptr,
+		barycentrics != nullptr ? static_cast< Vector2f* >( *barycentrics ) : nullptr );
+	return true;
+}
+
+// static
+bool TriangleRasterizer::rasterize( const std::vector< Vector3f >& vertices, const std::vector< Vector3i >& faces,
+	Image1f& depth, Image1i* faceIds,
+	Coverage coverage )
+{
+	int width = depth.width();
+	int height = depth.height();
+	if( faceIds != nullptr && ( faceIds->width() != width || faceIds->height() != height ) )
+	{
+		fprintf( stderr, "TriangleRasterizer: targets must be the same size as depth (%d x %d)\n",
+			width, height );
+		return false;
+	}
+
+	rasterize( vertices, faces, coverage, width, height,
+		depth.pixels(),
+		faceIds != nullptr ? faceIds->pixels() : nullptr,
+		nullptr );
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+void TriangleRasterizer::rasterize( const std::vector< Vector3f >& vertices, const std::vector< Vector3i >& faces,
+	Coverage coverage, int width, int height,
+	float* depth, int* faceIds, Vector2f* barycentrics )
+{
+	int nFaces = static_cast< int >( faces.size() );
+	if( nFaces == 0 || width <= 0 || height <= 0 )
+	{
+		return;
+	}
+
+	int nTilesX = ( width + TILE_SIZE - 1 ) / TILE_SIZE;
+	int nTilesY = ( height + TILE_SIZE - 1 ) / TILE_SIZE;
+	int nTiles = nTilesX * nTilesY;
+
+	int nChunks = std::max( 1, std::min( MAX_BIN_CHUNKS, nFaces / MIN_BIN_CHUNK_SIZE ) );
+	std::vector< int > chunkStarts( nChunks + 1 );
+	for( int c = 0; c <= nChunks; ++c )
+	{
+		chunkStarts[ c ] = static_cast< int >( static_cast< int64 >( nFaces ) * c / nChunks );
+	}
+
+	// the tiles each face overlaps, [ tx0, tx1 ] x [ ty0, ty1 ], empty if it's culled
+	// and a histogram of faces per tile for each chunk
+	std::vector< int > tileBounds( 4 * nFaces );
+	std::vector< int > histograms( nChunks * nTiles, 0 );
+	Concurrency::parallel_for( 0, nChunks, [&]( int c )
+	{
+		int* histogram = &( histograms[ c * nTiles ] );
+		for( int f = chunkStarts[ c ]; f < chunkStarts[ c + 1 ]; ++f )
+		{
+			int* bounds = &( tileBounds[ 4 * f ] );
+			Triangle triangle;
+			if( !setUpTriangle( vertices, faces[ f ], coverage, width, height, triangle ) )
+			{
+				bounds[ 0 ] = 0;
+				bounds[ 1 ] = 0;
+				bounds[ 2 ] = -1;
+				bounds[ 3 ] = -1;
+				continue;
+			}
+
+			bounds[ 0 ] = triangle.x0 / TILE_SIZE;
+			bounds[ 1 ] = triangle.y0 / TILE_SIZE;
+			bounds[ 2 ] = triangle.x1 / TILE_SIZE;
+			bounds[ 3 ] = triangle.y1 / TILE_SIZE;
+			for( int ty = bounds[ 1 ]; ty <= bounds[ 3 ]; ++ty )
+			{
+				for( int tx = bounds[ 0 ]; tx <= bounds[ 2 ]; ++tx )
+				{
+					++histogram[ ty * nTilesX + tx ];
+				}
+			}
+		}
+	} );
+
+	// each chunk writes each tile's list after the chunks before it,
+	// so each list is in submission order
+	std::vector< int > tileStarts( nTiles + 1 );
+	int sum = 0;
+	for( int t = 0; t < nTiles; ++t )
+	{
+		tileStarts[ t ] = sum;
+		for( int c = 0; c < nChunks; ++c )
+		{
+			int count = histograms[ c * nTiles + t ];
+			histograms[ c * nTiles + t ] = sum;
+			sum += count;
+		}
+	}
+	tileStarts[ nTiles ] = sum;
+
+	std::vector< int > tileFaces( sum );
+	Concurrency::parallel_for( 0, nChunks, [&]( int c )
+	{
+		int* cursors = &( histograms[ c * nTiles ] );
+		for( int f = chunkStarts[ c ]; f < chunkStarts[ c + 1 ]; ++f )
+		{
+			const int* bounds = &( tileBounds[ 4 * f ] );
+			for( int ty = bounds[ 1 ]; ty <= bounds[ 3 ]; ++ty )
+			{
+				for( int tx = bounds[ 0 ]; tx <= bounds[ 2 ]; ++tx )
+				{
+					tileFaces[ cursors[ ty * nTilesX + tx ]++ ] = f;
+				}
+			}
+		}
+	} );
+
+	// each tile is drawn by one thread, so there are no races on the targets
+	// the faces are set up again for each tile they touch,
+	// which is cheap next to drawing them and saves storing them all
+	Concurrency::parallel_for( 0, nTiles, [&]( int t )
+	{
+		int tileX0 = ( t % nTilesX ) * TILE_SIZE;
+		int tileY0 = ( t / nTilesX ) * TILE_SIZE;
+		int tileX1 = std::min( tileX0 + TILE_SIZE, width ) - 1;
+		int tileY1 = std::min( tileY0 + TILE_SIZE, height ) - 1;
+
+		for( int i = tileStarts[ t ]; i < tileStarts[ t + 1 ]; ++i )
+		{
+			int f = tileFaces[ i ];
+			Triangle triangle;
+			setUpTriangle( vertices, faces[ f ], coverage, width, height, triangle );
+			rasterizeTriangle( triangle, f,
+				std::max( triangle.x0, tileX0 ), std::max( triangle.y0, tileY0 ),
+				std::min( triangle.x1, tileX1 ), std::min( triangle.y1, tileY1 ),
+				width, depth, faceIds, barycentrics );
+		}
+	} );
+}
+
+// static
+bool TriangleRasterizer::setUpTriangle( const std::vector< Vector3f >& vertices, const Vector3i& face,
+	Coverage coverage, int width, int height, Triangle& triangle )
+{
+	// snap to the subpixel grid
+	// the coordinates are then integers of at most 14 + SUBPIXEL_BITS bits,
+	// and the edge functions at pixel centers are exact in double precision
+	int subpixels = 1 << SUBPIXEL_BITS;
+	int halfPixel = subpixels / 2;
+	int x[ 3 ];
+	int y[ 3 ];
+	float z[ 3 ];
+	const int* indices = &( face.x );
+	for( int i = 0; i < 3; ++i )
+	{
+		const Vector3f& v = vertices[ indices[ i ] ];
+		if( !( std::abs( v.x ) <= GUARD_BAND && std::abs( v.y ) <= GUARD_BAND ) )
+		{
+			return false;
+		}
+		x[ i ] = Arithmetic::roundToInt( static_cast< double >( v.x ) * subpixels );
+		y[ i ] = Arithmetic::roundToInt( static_cast< double >( v.y ) * subpixels );
+		z[ i ] = v.z;
+	}
+
+	int64 sum = static_cast< int64 >( x[ 1 ] - x[ 0 ] ) * ( y[ 2 ] - y[ 0 ] ) -
+		static_cast< int64 >( x[ 2 ] - x[ 0 ] ) * ( y[ 1 ] - y[ 0 ] );
+	if( sum == 0 )
+	{
+		return false;
+	}
+	triangle.swapped = ( sum < 0 );
+	if( triangle.swapped )
+	{
+		std::swap( x[ 1 ], x[ 2 ] );
+		std::swap( y[ 1 ], y[ 2 ] );
+		std::swap( z[ 1 ], z[ 2 ] );
+		sum = -sum;
+	}
+
+	// the bounds, with >> as floor
+	int minX = std::min( x[ 0 ], std::min( x[ 1 ], x[ 2 ] ) );
+	int minY = std::min( y[ 0 ], std::min( y[ 1 ], y[ 2 ] ) );
+	int maxX = std::max( x[ 0 ], std::max( x[ 1 ], x[ 2 ] ) );
+	int maxY = std::max( y[ 0 ], std::max( y[ 1 ], y[ 2 ] ) );
+	if( coverage == CONSERVATIVE )
+	{
+		// pixels whose squares overlap the bounding box
+		triangle.x0 = minX >> SUBPIXEL_BITS;
+		triangle.y0 = minY >> SUBPIXEL_BITS;
+		triangle.x1 = ( ( maxX + subpixels - 1 ) >> SUBPIXEL_BITS ) - 1;
+		triangle.y1 = ( ( maxY + subpixels - 1 ) >> SUBPIXEL_BITS ) - 1;
+	}
+	else
+	{
+		// pixels whose centers are in the bounding box
+		triangle.x0 = ( minX - halfPixel + subpixels - 1 ) >> SUBPIXEL_BITS;
+		triangle.y0 = ( minY - halfPixel + subpixels - 1 ) >> SUBPIXEL_BITS;
+		triangle.x1 = ( maxX - halfPixel ) >> SUBPIXEL_BITS;
+		triangle.y1 = ( maxY - halfPixel ) >> SUBPIXEL_BITS;
+	}
+	triangle.x0 = std::max( triangle.x0, 0 );
+	triangle.y0 = std::max( triangle.y0, 0 );
+	triangle.x1 = std::min( triangle.x1, width - 1 );
+	triangle.y1 = std::min( triangle.y1, height - 1 );
+	if( triangle.x0 > triangle.x1 || triangle.y0 > triangle.y1 )
+	{
+		return false;
+	}
+
+	// the edge functions, in pixels
+	// they are multiples of 2^( -2 * SUBPIXEL_BITS ) at pixel centers,
+	// so E >= 0 is the same as E > -2^( -2 * SUBPIXEL_BITS - 1 )
+	double scale = 1.0 / subpixels;
+	double scaleSquared = scale * scale;
+	triangle.inverseSum = 1.0 / ( sum * scaleSquared );
+	for( int i = 0; i < 3; ++i )
+	{
+		int j = ( i == 2 ) ? 0 : i + 1;
+		int k = ( i == 0 ) ? 2 : i - 1;
+		triangle.a[ i ] = ( y[ j ] - y[ k ] ) * scale;
+		triangle.b[ i ] = ( x[ k ] - x[ j ] ) * scale;
+		triangle.c[ i ] = ( static_cast< int64 >( x[ j ] ) * y[ k ] - static_cast< int64 >( y[ j ] ) * x[ k ] ) * scaleSquared;
+
+		if( coverage == CONSERVATIVE )
+		{
+			// the edge moved out by half a pixel along each axis,
+			// so it passes through the pixel's farthest corner
+			triangle.threshold[ i ] = -0.5 * ( std::abs( triangle.a[ i ] ) + std::abs( triangle.b[ i ] ) );
+		}
+		else
+		{
+			// the top-left rule: a pixel center exactly on a shared edge is
+			// covered by exactly one of the two triangles, which see the edge
+			// with opposite signs
+			bool isInclusive = ( triangle.a[ i ] > 0 ) || ( triangle.a[ i ] == 0 && triangle.b[ i ] > 0 );
+			triangle.threshold[ i ] = isInclusive ? -0.5 * scaleSquared : 0;
+		}
+	}
+
+	triangle.z0 = z[ 0 ];
+	triangle.dz1 = z[ 1 ] - z[ 0 ];
+	triangle.dz2 = z[ 2 ] - z[ 0 ];
+	triangle.zMin = std::min( z[ 0 ], std::min( z[ 1 ], z[ 2 ] ) );
+	triangle.zMax = std::max( z[ 0 ], std::max( z[ 1 ], z[ 2 ] ) );
+	triangle.clampZ = ( coverage == CONSERVATIVE );
+
+	return true;
+}
+
+// static
+void TriangleRasterizer::rasterizeTriangle( const Triangle& triangle, int faceId,
+	int x0, int y0, int x1, int y1, int width,
+	float* depth, int* faceIds, Vector2f* barycentrics )
+{
+	if( x0 > x1 || y0 > y1 )
+	{
+		return;
+	}
+
+	// skip the rectangle if it's entirely outside an edge
+	for( int i = 0; i < 3; ++i )
+	{
+		double px = ( triangle.a[ i ] > 0 ? x1 : x0 ) + 0.5;
+		double py = ( triangle.b[ i ] > 0 ? y1 : y0 ) + 0.5;
+		if( triangle.a[ i ] * px + triangle.b[ i ] * py + triangle.c[ i ] <= triangle.threshold[ i ] )
+		{
+			return;
+		}
+	}
+
+	// walk 2x2 quads aligned to even pixels
+	// each edge function is a pair of registers: the quad's top row and its bottom row
+	__m128d threshold[ 3 ];
+	__m128d stepX[ 3 ];
+	__m128d stepY[ 3 ];
+	for( int i = 0; i < 3; ++i )
+	{
+		threshold[ i ] = _mm_set1_pd( triangle.threshold[ i ] );
+		stepX[ i ] = _mm_set1_pd( 2 * triangle.a[ i ] );
+		stepY[ i ] = _mm_set1_pd( triangle.b[ i ] );
+	}
+
+	int qx0 = x0 & ~1;
+	int qy0 = y0 & ~1;
+
+	// bit 0 is the top left pixel, 1 top right, 2 bottom left, 3 bottom right
+	int columnMask = ( qx0 < x0 ) ? 0xa : 0xf;
+
+	for( int qy = qy0; qy <= y1; qy += 2 )
+	{
+		int rowMask = 0xf;
+		if( qy < y0 )
+		{
+			rowMask &= 0xc;
+		}
+		if( qy + 1 > y1 )
+		{
+			rowMask &= 0x3;
+		}
+
+		__m128d top[ 3 ];
+		__m128d bottom[ 3 ];
+		for( int i = 0; i < 3; ++i )
+		{
+			double e = triangle.a[ i ] * ( qx0 + 0.5 ) + triangle.b[ i ] * ( qy + 0.5 ) + triangle.c[ i ];
+			top[ i ] = _mm_set_pd( e + triangle.a[ i ], e );
+			bottom[ i ] = _mm_add_pd( top[ i ], stepY[ i ] );
+		}
+
+		int mask = rowMask & columnMask;
+		for( int qx = qx0; qx <= x1; qx += 2 )
+		{
+			if( qx + 1 > x1 )
+			{
+				mask &= 0x5;
+			}
+
+			__m128d insideTop = _mm_and_pd( _mm_and_pd(
+				_mm_cmpgt_pd( top[ 0 ], threshold[ 0 ] ),
+				_mm_cmpgt_pd( top[ 1 ], threshold[ 1 ] ) ),
+				_mm_cmpgt_pd( top[ 2 ], threshold[ 2 ] ) );
+			__m128d insideBottom = _mm_and_pd( _mm_and_pd(
+				_mm_cmpgt_pd( bottom[ 0 ], threshold[ 0 ] ),
+				_mm_cmpgt_pd( bottom[ 1 ], threshold[ 1 ] ) ),
+				_mm_cmpgt_pd( bottom[ 2 ], threshold[ 2 ] ) );
+			int covered = mask & ( _mm_movemask_pd( insideTop ) | ( _mm_movemask_pd( insideBottom ) << 2 ) );
+
+			if( covered != 0 )
+			{
+				double e1[ 4 ];
+				double e2[ 4 ];
+				_mm_storeu_pd( e1, top[ 1 ] );
+				_mm_storeu_pd( e1 + 2, bottom[ 1 ] );
+				_mm_storeu_pd( e2, top[ 2 ] );
+				_mm_storeu_pd( e2 + 2, bottom[ 2 ] );
+
+				for( int p = 0; p < 4; ++p )
+				{
+					if( ( covered & ( 1 << p ) ) == 0 )
+					{
+						continue;
+					}
+
+					float b1 = static_cast< float >( e1[ p ] * triangle.inverseSum );
+					float b2 = static_cast< float >( e2[ p ] * triangle.inverseSum );
+					float z = triangle.z0 + b1 * triangle.dz1 + b2 * triangle.dz2;
+					if( triangle.clampZ )
+					{
+						z = std::min( std::max( z, triangle.zMin ), triangle.zMax );
+					}
+
+					int index = ( qy + ( p >> 1 ) ) * width + qx + ( p & 1 );
+					if( z < depth[ index ] )
+					{
+						depth[ index ] = z;
+						if( faceIds != nullptr )
+						{
+							faceIds[ index ] = faceId;
+						}
+						if( barycentrics != nullptr )
+						{
+							barycentrics[ index ] = triangle.swapped ? Vector2f( b2, b1 ) : Vector2f( b1, b2 );
+						}
+					}
+				}
+			}
+
+			for( int i = 0; i < 3; ++i )
+			{
+				top[ i ] = _mm_add_pd( top[ i ], stepX[ i ] );
+				bottom[ i ] = _mm_add_pd( bottom[ i ], stepX[ i ] );
+			}
+			mask = rowMask;
+		}
+	}
+}
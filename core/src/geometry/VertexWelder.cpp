@@ -0,0 +1,137 @@
+#include "geometry/VertexWelder.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <ppl.h>
+
+#include "common/BasicTypes.h"
+#include "common/ConcurrentUnionFind.h"
+#include "geometry/BoundingBox3f.h"
+#include "geometry/SpatialHashGrid.h"
+
+// static
+const int VertexWelder::MAX_GRID_RESOLUTION = 1 << 20;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool VertexWelder::weld( const std::vector< Vector3f >& positions, float tolerance,
+	std::vector< int >& vertexMap, int& nWeldedVertices )
+{
+	if( !( tolerance >= 0 ) )
+	{
+		fprintf( stderr, "VertexWelder: tolerance must be nonnegative, got %f\n", tolerance );
+		return false;
+	}
+
+	int n = static_cast< int >( positions.size() );
+	if( n == 0 )
+	{
+		vertexMap.clear();
+		nWeldedVertices = 0;
+		return true;
+	}
+
+	// cells at least twice the tolerance wide, so each query visits at most 8 of them
+	BoundingBox3f bounds( positions );
+	float cellSize = std::max( 2 * tolerance, bounds.longestSideLength() / MAX_GRID_RESOLUTION );
+	if( !( cellSize > 0 ) )
+	{
+		// all the points are the same
+		cellSize = 1;
+	}
+
+	SpatialHashGrid grid;
+	grid.build( positions, cellSize );
+
+	// visit the vertices in the grid's order, for locality,
+	// and unite each pair once, by its later vertex
+	const std::vector< int >& order = grid.sortedIndices();
+	ConcurrentUnionFind sets( n );
+	Concurrency::parallel_for( 0, n, SpatialHashGrid::BLOCK_SIZE, [&]( int begin )
+	{
+		int end = std::min( begin + SpatialHashGrid::BLOCK_SIZE, n );
+		for( int k = begin; k < end; ++k )
+		{
+			int i = order[ k ];
+			grid.forEachNeighbor( positions[ i ], tolerance, [&]( int j, float )
+			{
+				if( j < i )
+				{
+					sets.unite( i, j );
+				}
+			} );
+		}
+	} );
+
+	nWeldedVertices = sets.labelSets( vertexMap );
+	return true;
+}
+
+// static
+void VertexWelder::weldPositions( const std::vector< Vector3f >& positions,
+	const std::vector< int >& vertexMap, int nWeldedVertices,
+	std::vector< Vector3f >& weldedPositions )
+{
+	// welded vertices are numbered in the order of their first vertex
+	weldedPositions.resize( nWeldedVertices );
+	int nextWelded = 0;
+	for( int i = 0; i < static_cast< int >( positions.size() ); ++i )
+	{
+		if( vertexMap[ i ] == nextWelded )
+		{
+			weldedPositions[ nextWelded ] = positions[ i ];
+			++nextWelded;
+		}
+	}
+}
+
+// static
+void VertexWelder::weldNormals( const std::vector< Vector3f >& normals,
+	const std::vector< int >& vertexMap, int nWeldedVertices,
+	std::vector< Vector3f >& weldedNormals )
+{
+	weldedNormals.assign( nWeldedVertices, Vector3f( 0, 0, 0 ) );
+	for( int i = 0; i < static_cast< int >( normals.size() ); ++i )
+	{
+		weldedNormals[ vertexMap[ i ] ] += normals[ i ];
+	}
+
+	Concurrency::parallel_for( 0, nWeldedVertices, [&]( int i )
+	{
+		float norm = weldedNormals[ i ].norm();
+		if( norm > 0 )
+		{
+			weldedNormals[ i ] /= norm;
+		}
+	} );
+}
+
+// static
+int VertexWelder::remapFaces( const std::vector< int >& vertexMap, std::vector< Vector3i >& faces )
+{
+	int nFaces = static_cast< int >( faces.size() );
+	std::vector< ubyte > isDegenerate( nFaces );
+	Concurrency::parallel_for( 0, nFaces, [&]( int f )
+	{
+		Vector3i& face = faces[ f ];
+		face = Vector3i( vertexMap[ face.x ], vertexMap[ face.y ], vertexMap[ face.z ] );
+		isDegenerate[ f ] = ( face.x == face.y || face.y == face.z || face.z == face.x ) ? 1 : 0;
+	} );
+
+	int nKept = 0;
+	for( int f = 0; f < nFaces; ++f )
+	{
+		if( isDegenerate[ f ] == 0 )
+		{
+			faces[ nKept ] = faces[ f ];
+			++nKept;
+		}
+	}
+	faces.resize( nKept );
+
+	return nFaces - nKept;
+}
@@ -0,0 +1,344 @@
+#include "imageproc/BilateralGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <ppl.h>
+
+#include "color/ColorUtils.h"
+#include "math/Arithmetic.h"
+#include "math/MathUtils.h"
+
+// static
+const int BilateralGrid::PADDING = 2;
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+Image1f BilateralGrid::filter( const Image1f& input, float spatialSigma, float rangeSigma )
+{
+	return filter( input, input, spatialSigma, rangeSigma );
+}
+
+// static
+Image1f BilateralGrid::filter( const Image1f& input, const Image1f& edgeImage,
+	float spatialSigma, float rangeSigma )
+{
+	if( input.size() != edgeImage.size() )
+	{
+		fprintf( stderr, "BilateralGrid::filter: input is %d x %d but edgeImage is %d x %d\n",
+			input.width(), input.height(), edgeImage.width(), edgeImage.height() );
+		return Image1f();
+	}
+
+	int nPixels = edgeImage.width() * edgeImage.height();
+	if( nPixels == 0 )
+	{
+		return Image1f( edgeImage.size() );
+	}
+
+	const float* edgePixels = edgeImage.pixels();
+	auto minMax = std::minmax_element( edgePixels, edgePixels + nPixels );
+
+	BilateralGrid grid( edgeImage.size(), *( minMax.first ), *( minMax.second ),
+		spatialSigma, rangeSigma );
+	grid.splat( input, edgeImage );
+	grid.blur();
+
+	Image1f output( edgeImage.size() );
+	grid.slice( edgeImage, output );
+	return output;
+}
+
+// static
+Image4f BilateralGrid::filter( const Image4f& input, float spatialSigma, float rangeSigma )
+{
+	int width = input.width();
+	int height = input.height();
+	const float* pixels = input.pixels();
+
+	Image1f luminance( input.size() );
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		const float* row = pixels + 4 * y * width;
+		float* luminanceRow = luminance.rowPointer( y );
+		for( int x = 0; x < width; ++x )
+		{
+			float rgb[ 3 ] = { row[ 4 * x ], row[ 4 * x + 1 ], row[ 4 * x + 2 ] };
+			luminanceRow[ x ] = ColorUtils::rgbToLuminance( rgb );
+		}
+	} );
+
+	return filter( input, luminance, spatialSigma, rangeSigma );
+}
+
+// static
+Image4f BilateralGrid::filter( const Image4f& input, const Image1f& edgeImage,
+	float spatialSigma, float rangeSigma )
+{
+	if( input.size() != edgeImage.size() )
+	{
+		fprintf( stderr, "BilateralGrid::filter: input is %d x %d but edgeImage is %d x %d\n",
+			input.width(), input.height(), edgeImage.width(), edgeImage.height() );
+		return Image4f();
+	}
+
+	int nPixels = edgeImage.width() * edgeImage.height();
+	if( nPixels == 0 )
+	{
+		return input;
+	}
+
+	const float* edgePixels = edgeImage.pixels();
+	auto minMax = std::minmax_element( edgePixels, edgePixels + nPixels );
+
+	// start from a copy so that alpha passes through
+	Image4f output( input );
+
+	// the grid is reused for each channel
+	BilateralGrid grid( edgeImage.size(), *( minMax.first ), *( minMax.second ),
+		spatialSigma, rangeSigma );
+	for( int c = 0; c < 3; ++c )
+	{
+		if( c > 0 )
+		{
+			grid.clear();
+		}
+		grid.splat( input, c, edgeImage );
+		grid.blur();
+		grid.slice( edgeImage, c, output );
+	}
+	return output;
+}
+
+BilateralGrid::BilateralGrid( const Vector2i& imageSize, float edgeMin, float edgeMax,
+	float spatialSigma, float rangeSigma ) :
+
+	m_imageSize( imageSize ),
+	m_edgeMin( edgeMin ),
+	m_spatialSigma( spatialSigma ),
+	m_rangeSigma( rangeSigma )
+
+{
+	int nx = Arithmetic::ceilToInt( ( imageSize.x - 1 ) / spatialSigma ) + 1 + 2 * PADDING;
+	int ny = Arithmetic::ceilToInt( ( imageSize.y - 1 ) / spatialSigma ) + 1 + 2 * PADDING;
+	int nz = Arithmetic::ceilToInt( ( edgeMax - edgeMin ) / rangeSigma ) + 1 + 2 * PADDING;
+
+	m_grid.resize( nx, ny, nz );
+	clear();
+}
+
+Vector3i BilateralGrid::gridSize() const
+{
+	return m_grid.size();
+}
+
+const Array3D< Vector2f >& BilateralGrid::grid() const
+{
+	return m_grid;
+}
+
+Array3D< Vector2f >& BilateralGrid::grid()
+{
+	return m_grid;
+}
+
+void BilateralGrid::clear()
+{
+	m_grid.fill( Vector2f( 0, 0 ) );
+}
+
+void BilateralGrid::splat( const Image1f& input, const Image1f& edgeImage )
+{
+	splat( input.pixels(), 1, edgeImage.pixels() );
+}
+
+void BilateralGrid::splat( const Image4f& input, int c, const Image1f& edgeImage )
+{
+	splat( input.pixels() + c, 4, edgeImage.pixels() );
+}
+
+void BilateralGrid::blur()
+{
+	blurAxis( 0 );
+	blurAxis( 1 );
+	blurAxis( 2 );
+}
+
+void BilateralGrid::slice( const Image1f& edgeImage, Image1f& output ) const
+{
+	slice( edgeImage.pixels(), output.pixels(), 1 );
+}
+
+void BilateralGrid::slice( const Image1f& edgeImage, int c, Image4f& output ) const
+{
+	slice( edgeImage.pixels(), output.pixels() + c, 4 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+void BilateralGrid::splat( const float* values, int valueStride, const float* edgePixels )
+{
+	int width = m_imageSize.x;
+	int height = m_imageSize.y;
+	int ny = m_grid.height();
+
+	// gridY() is monotonic, so the pixel rows that splat into grid row gy
+	// are the contiguous range [ firstRow[ gy ], firstRow[ gy + 1 ] )
+	// parallelizing over grid rows then never has two threads writing the same cell
+	std::vector< int > firstRow( ny + 1, 0 );
+	for( int y = 0; y < height; ++y )
+	{
+		++firstRow[ gridY( y ) + 1 ];
+	}
+	for( int gy = 0; gy < ny; ++gy )
+	{
+		firstRow[ gy + 1 ] += firstRow[ gy ];
+	}
+
+	std::vector< int > gx( width );
+	for( int x = 0; x < width; ++x )
+	{
+		gx[ x ] = gridX( x );
+	}
+
+	Concurrency::parallel_for( 0, ny, [&]( int gy )
+	{
+		for( int y = firstRow[ gy ]; y < firstRow[ gy + 1 ]; ++y )
+		{
+			const float* valueRow = values + y * width * valueStride;
+			const float* edgeRow = edgePixels + y * width;
+
+			for( int x = 0; x < width; ++x )
+			{
+				Vector2f& cell = m_grid( gx[ x ], gy, gridZ( edgeRow[ x ] ) );
+				cell.x += valueRow[ x * valueStride ];
+				cell.y += 1.f;
+			}
+		}
+	} );
+}
+
+void BilateralGrid::slice( const float* edgePixels, float* output, int outputStride ) const
+{
+	int width = m_imageSize.x;
+	int height = m_imageSize.y;
+	Vector3i size = m_grid.size();
+	int strideY = size.x;
+	int strideZ = size.x * size.y;
+	float zMax = static_cast< float >( size.z - 1 - PADDING );
+
+	const Vector2f* cells = m_grid;
+
+	// the x interpolation weights are the same on every row
+	std::vector< int > x0s( width );
+	std::vector< float > xfs( width );
+	for( int x = 0; x < width; ++x )
+	{
+		float fx = x / m_spatialSigma + PADDING;
+		x0s[ x ] = Arithmetic::floorToInt( fx );
+		xfs[ x ] = fx - x0s[ x ];
+	}
+
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		float fy = y / m_spatialSigma + PADDING;
+		int y0 = Arithmetic::floorToInt( fy );
+		float yf = fy - y0;
+
+		const float* edgeRow = edgePixels + y * width;
+		float* outputRow = output + y * width * outputStride;
+
+		for( int x = 0; x < width; ++x )
+		{
+			float fz = MathUtils::clampToRange( ( edgeRow[ x ] - m_edgeMin ) / m_rangeSigma + PADDING,
+				static_cast< float >( PADDING ), zMax );
+			int z0 = Arithmetic::floorToInt( fz );
+			float zf = fz - z0;
+			int x0 = x0s[ x ];
+			float xf = xfs[ x ];
+
+			const Vector2f* c000 = cells + z0 * strideZ + y0 * strideY + x0;
+			const Vector2f* c001 = c000 + strideZ;
+
+			Vector2f v00 = ( 1 - xf ) * c000[ 0 ] + xf * c000[ 1 ];
+			Vector2f v10 = ( 1 - xf ) * c000[ strideY ] + xf * c000[ strideY + 1 ];
+			Vector2f v01 = ( 1 - xf ) * c001[ 0 ] + xf * c001[ 1 ];
+			Vector2f v11 = ( 1 - xf ) * c001[ strideY ] + xf * c001[ strideY + 1 ];
+
+			Vector2f v0 = ( 1 - yf ) * v00 + yf * v10;
+			Vector2f v1 = ( 1 - yf ) * v01 + yf * v11;
+			Vector2f v = ( 1 - zf ) * v0 + zf * v1;
+
+			outputRow[ x * outputStride ] = ( v.y > 0 ) ? ( v.x / v.y ) : 0.f;
+		}
+	} );
+}
+
+void BilateralGrid::blurAxis( int axis )
+{
+	Vector3i size = m_grid.size();
+	int strides[ 3 ] = { 1, size.x, size.x * size.y };
+
+	// walk every line parallel to axis:
+	// u and v are the other two axes
+	int u = ( axis == 0 ) ? 1 : 0;
+	int v = ( axis == 2 ) ? 1 : 2;
+
+	int n = size[ axis ];
+	int nu = size[ u ];
+	int nv = size[ v ];
+	int stride = strides[ axis ];
+	int strideU = strides[ u ];
+	int strideV = strides[ v ];
+
+	Vector2f* cells = m_grid;
+
+	Concurrency::parallel_for( 0, nv, [&]( int j )
+	{
+		// the line, with 2 zeros on each end
+		std::vector< Vector2f > line( n + 4 );
+
+		for( int i = 0; i < nu; ++i )
+		{
+			Vector2f* first = cells + i * strideU + j * strideV;
+			for( int k = 0; k < n; ++k )
+			{
+				line[ k + 2 ] = first[ k * stride ];
+			}
+
+			// 5-tap binomial: [ 1 4 6 4 1 ] / 16, sigma = 1
+			for( int k = 0; k < n; ++k )
+			{
+				first[ k * stride ] = ( 1.f / 16.f ) *
+				(
+					line[ k ] + line[ k + 4 ] +
+					4.f * ( line[ k + 1 ] + line[ k + 3 ] ) +
+					6.f * line[ k + 2 ]
+				);
+			}
+		}
+	} );
+}
+
+int BilateralGrid::gridX( int x ) const
+{
+	return Arithmetic::roundToInt( x / m_spatialSigma ) + PADDING;
+}
+
+int BilateralGrid::gridY( int y ) const
+{
+	return Arithmetic::roundToInt( y / m_spatialSigma ) + PADDING;
+}
+
+int BilateralGrid::gridZ( float edge ) const
+{
+	int gz = Arithmetic::roundToInt( ( edge - m_edgeMin ) / m_rangeSigma ) + PADDING;
+	return MathUtils::clampToRangeInclusive( gz, PADDING, m_grid.depth() - 1 - PADDING );
+}
@@ -0,0 +1,297 @@
+#include "imageproc/GuidedFilter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <ppl.h>
+
+namespace
+{
+	// columns per task in the vertical box filter pass
+	const int COLUMN_STRIP_WIDTH = 64;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+Image1f GuidedFilter::boxFilter( const Image1f& input, int radius )
+{
+	Image1f output( input.size() );
+	boxFilter( input.pixels(), output.pixels(), input.width(), input.height(), radius );
+	return output;
+}
+
+// static
+Image1f GuidedFilter::filter( const Image1f& input, const Image1f& guide,
+	int radius, float epsilon )
+{
+	if( input.size() != guide.size() )
+	{
+		fprintf( stderr, "GuidedFilter::filter: input is %d x %d but guide is %d x %d\n",
+			input.width(), input.height(), guide.width(), guide.height() );
+		return Image1f();
+	}
+
+	int width = guide.width();
+	int height = guide.height();
+	int nPixels = width * height;
+
+	std::vector< float > meanGuide( nPixels );
+	std::vector< float > varianceGuide( nPixels );
+	guideStatistics( guide.pixels(), width, height, radius,
+		meanGuide.data(), varianceGuide.data() );
+
+	Image1f output( guide.size() );
+	filterChannel( guide.pixels(), meanGuide.data(), varianceGuide.data(),
+		input.pixels(), 1, output.pixels(), 1,
+		width, height, radius, epsilon );
+	return output;
+}
+
+// static
+Image1f GuidedFilter::filter( const Image1f& input, int radius, float epsilon )
+{
+	return filter( input, input, radius, epsilon );
+}
+
+// static
+Image4f GuidedFilter::filter( const Image4f& input, const Image1f& guide,
+	int radius, float epsilon )
+{
+	if( input.size() != guide.size() )
+	{
+		fprintf( stderr, "GuidedFilter::filter: input is %d x %d but guide is %d x %d\n",
+			input.width(), input.height(), guide.width(), guide.height() );
+		return Image4f();
+	}
+
+	int width = guide.width();
+	int height = guide.height();
+	int nPixels = width * height;
+
+	// the guide statistics are shared by all channels
+	std::vector< float > meanGuide( nPixels );
+	std::vector< float > varianceGuide( nPixels );
+	guideStatistics( guide.pixels(), width, height, radius,
+		meanGuide.data(), varianceGuide.data() );
+
+	// start from a copy so that alpha passes through
+	Image4f output( input );
+	for( int c = 0; c < 3; ++c )
+	{
+		filterChannel( guide.pixels(), meanGuide.data(), varianceGuide.data(),
+			input.pixels() + c, 4, output.pixels() + c, 4,
+			width, height, radius, epsilon );
+	}
+	return output;
+}
+
+// static
+Image4f GuidedFilter::filter( const Image4f& input, int radius, float epsilon )
+{
+	int width = input.width();
+	int height = input.height();
+	int nPixels = width * height;
+	const float* pixels = input.pixels();
+
+	std::vector< float > channel( nPixels );
+	std::vector< float > meanGuide( nPixels );
+	std::vector< float > varianceGuide( nPixels );
+
+	Image4f output( input );
+	for( int c = 0; c < 3; ++c )
+	{
+		Concurrency::parallel_for( 0, height, [&]( int y )
+		{
+			const float* row = pixels + 4 * y * width;
+			float* channelRow = channel.data() + y * width;
+			for( int x = 0; x < width; ++x )
+			{
+				channelRow[ x ] = row[ 4 * x + c ];
+			}
+		} );
+
+		guideStatistics( channel.data(), width, height, radius,
+			meanGuide.data(), varianceGuide.data() );
+		filterChannel( channel.data(), meanGuide.data(), varianceGuide.data(),
+			channel.data(), 1, output.pixels() + c, 4,
+			width, height, radius, epsilon );
+	}
+	return output;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+void GuidedFilter::boxFilter( const float* input, float* output,
+	int width, int height, int radius )
+{
+	std::vector< float > horizontal( width * height );
+
+	// horizontal pass: running sum along each row
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		const float* inputRow = input + y * width;
+		float* outputRow = horizontal.data() + y * width;
+
+		// sums are accumulated in double so that adding and subtracting
+		// doesn't drift across long rows
+		double sum = 0;
+		for( int x = 0; x <= std::min( radius, width - 1 ); ++x )
+		{
+			sum += inputRow[ x ];
+		}
+
+		for( int x = 0; x < width; ++x )
+		{
+			int x0 = std::max( x - radius, 0 );
+			int x1 = std::min( x + radius, width - 1 );
+			outputRow[ x ] = static_cast< float >( sum / ( x1 - x0 + 1 ) );
+
+			if( x + radius + 1 < width )
+			{
+				sum += inputRow[ x + radius + 1 ];
+			}
+			if( x - radius >= 0 )
+			{
+				sum -= inputRow[ x - radius ];
+			}
+		}
+	} );
+
+	// vertical pass: running sums over a strip of columns at a time,
+	// so that each row is read contiguously
+	int nStrips = ( width + COLUMN_STRIP_WIDTH - 1 ) / COLUMN_STRIP_WIDTH;
+	Concurrency::parallel_for( 0, nStrips, [&]( int strip )
+	{
+		int xStart = strip * COLUMN_STRIP_WIDTH;
+		int stripWidth = std::min( COLUMN_STRIP_WIDTH, width - xStart );
+		const float* columns = horizontal.data() + xStart;
+
+		std::vector< double > sums( stripWidth, 0.0 );
+		for( int y = 0; y <= std::min( radius, height - 1 ); ++y )
+		{
+			for( int i = 0; i < stripWidth; ++i )
+			{
+				sums[ i ] += columns[ y * width + i ];
+			}
+		}
+
+		for( int y = 0; y < height; ++y )
+		{
+			int y0 = std::max( y - radius, 0 );
+			int y1 = std::min( y + radius, height - 1 );
+			double invCount = 1.0 / ( y1 - y0 + 1 );
+
+			float* outputRow = output + y * width + xStart;
+			for( int i = 0; i < stripWidth; ++i )
+			{
+				outputRow[ i ] = static_cast< float >( sums[ i ] * invCount );
+			}
+
+			if( y + radius + 1 < height )
+			{
+				const float* addRow = columns + ( y + radius + 1 ) * width;
+				for( int i = 0; i < stripWidth; ++i )
+				{
+					sums[ i ] += addRow[ i ];
+				}
+			}
+			if( y - radius >= 0 )
+			{
+				const float* subtractRow = columns + ( y - radius ) * width;
+				for( int i = 0; i < stripWidth; ++i )
+				{
+					sums[ i ] -= subtractRow[ i ];
+				}
+			}
+		}
+	} );
+}
+
+// static
+void GuidedFilter::filterChannel( const float* guide,
+	const float* meanGuide, const float* varianceGuide,
+	const float* input, int inputStride,
+	float* output, int outputStride,
+	int width, int height, int radius, float epsilon )
+{
+	int nPixels = width * height;
+	std::vector< float > meanInput( nPixels );
+	std::vector< float > meanProduct( nPixels );
+
+	// gather the channel and the guide * input product
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		for( int x = 0; x < width; ++x )
+		{
+			int k = y * width + x;
+			float p = input[ k * inputStride ];
+			meanInput[ k ] = p;
+			meanProduct[ k ] = guide[ k ] * p;
+		}
+	} );
+
+	boxFilter( meanInput.data(), meanInput.data(), width, height, radius );
+	boxFilter( meanProduct.data(), meanProduct.data(), width, height, radius );
+
+	// the per-window linear coefficients, stored in place:
+	// a = cov( I, p ) / ( var( I ) + epsilon ), b = mean( p ) - a * mean( I )
+	std::vector< float >& a = meanProduct;
+	std::vector< float >& b = meanInput;
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		for( int x = 0; x < width; ++x )
+		{
+			int k = y * width + x;
+			float covariance = meanProduct[ k ] - meanGuide[ k ] * meanInput[ k ];
+			float ak = covariance / ( varianceGuide[ k ] + epsilon );
+			a[ k ] = ak;
+			b[ k ] = meanInput[ k ] - ak * meanGuide[ k ];
+		}
+	} );
+
+	boxFilter( a.data(), a.data(), width, height, radius );
+	boxFilter( b.data(), b.data(), width, height, radius );
+
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		for( int x = 0; x < width; ++x )
+		{
+			int k = y * width + x;
+			output[ k * outputStride ] = a[ k ] * guide[ k ] + b[ k ];
+		}
+	} );
+}
+
+// static
+void GuidedFilter::guideStatistics( const float* guide, int width, int height, int radius,
+	float* meanGuide, float* varianceGuide )
+{
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		for( int x = 0; x < width; ++x )
+		{
+			int k = y * width + x;
+			varianceGuide[ k ] = guide[ k ] * guide[ k ];
+		}
+	} );
+
+	boxFilter( guide, meanGuide, width, height, radius );
+	boxFilter( varianceGuide, varianceGuide, width, height, radius );
+
+	// var( I ) = mean( I^2 ) - mean( I )^2
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		for( int x = 0; x < width; ++x )
+		{
+			int k = y * width + x;
+			varianceGuide[ k ] = std::max( varianceGuide[ k ] - meanGuide[ k ] * meanGuide[ k ], 0.f );
+		}
+	} );
+}
@@ -1,12 +1,13 @@
 #include "imageproc/Image1f.h"
 
 #include <QFile>
-#include <QDataStream>
 #include <QTextStream>
 #include <QImage>
 #include <QString>
 
 #include "color/ColorUtils.h"
+#include "io/OpenEXRIO.h"
+#include "io/PortablePixelMapIO.h"
 #include "math/Arithmetic.h"
 #include "math/MathUtils.h"
 #include "vecmath/Vector2f.h"
@@ -203,9 +204,14 @@ QImage Image1f::toQImage()
 
 bool Image1f::load( QString filename )
 {
-	if( filename.endsWith( ".pfm", Qt::CaseInsensitive ) )
+	if( filename.endsWith( ".pfm", Qt::CaseInsensitive ) ||
+		filename.endsWith( ".pgm", Qt::CaseInsensitive ) )
+	{
+		return PortablePixelMapIO::read( filename, *this );
+	}
+	else if( filename.endsWith( ".exr", Qt::CaseInsensitive ) )
 	{
-		return loadPFM( filename );
+		return OpenEXRIO::read( filename, "Y", *this );
 	}
 	else
 	{
@@ -217,7 +223,15 @@ bool Image1f::save( QString filename )
 {
 	if( filename.endsWith( ".pfm", Qt::CaseInsensitive ) )
 	{
-		return savePFM( filename );
+		return PortablePixelMapIO::writePFM( filename, *this );
+	}
+	else if( filename.endsWith( ".pgm", Qt::CaseInsensitive ) )
+	{
+		return PortablePixelMapIO::writePGM( filename, *this );
+	}
+	else if( filename.endsWith( ".exr", Qt::CaseInsensitive ) )
+	{
+		return OpenEXRIO::write( filename, *this );
 	}
 	else if( filename.endsWith( ".txt", Qt::CaseInsensitive ) )
 	{
@@ -233,73 +247,6 @@ bool Image1f::save( QString filename )
 	}
 }
 
-bool Image1f::loadPFM( QString filename )
-{
-	QFile inputFile( filename );
-
-	// try to open the file in read only mode
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
-	{		
-		return false;
-	}
-
-	QTextStream inputTextStream( &inputFile );
-	inputTextStream.setCodec( "ISO-8859-1" );
-
-	// read header
-	QString qsType;
-	QString qsWidth;
-	QString qsHeight;
-	QString qsScale;	
-
-	inputTextStream >> qsType;
-	if( qsType != "Pf" )
-	{
-		inputFile.close();
-		return NULL;
-	}
-
-	inputTextStream >> qsWidth >> qsHeight >> qsScale;
-
-	int width = qsWidth.toInt();
-	int height = qsHeight.toInt();
-	int scale = qsScale.toFloat();
-
-	if( width < 0 || height < 0 || scale >= 0 )
-	{
-		inputFile.close();
-		return false;
-	}
-
-	// close the text stream
-	inputTextStream.setDevice( NULL );
-	inputFile.close();
-
-	// now reopen it again in binary mode
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
-	{
-		return NULL;
-	}
-
-	int headerLength = qsType.length() + qsWidth.length() + qsHeight.length() + qsScale.length() + 4;	
-
-	QDataStream inputDataStream( &inputFile );
-	inputDataStream.skipRawData( headerLength );
-
-	Array2D< float > data( width, height );
-	int status;
-	
-	status = inputDataStream.readRawData( reinterpret_cast< char* >( data.rowPointer( 0 ) ), width * height * sizeof( float ) );
-	// TOD: check status
-
-	inputFile.close();
-
-	m_width = width;
-	m_height = height;
-	m_data = data;
-	return true;
-}
-
 bool Image1f::savePNG( QString filename )
 {
 	return toQImage().save( filename, "PNG" );
@@ -338,31 +285,4 @@ bool Image1f::saveTXT( QString filename )
 
 	outputFile.close();
 	return true;
-}
-
-bool Image1f::savePFM( QString filename )
-{
-	int w = width();
-	int h = height();
-
-	// use "wb" binary mode to ensure that on Windows,
-	// newlines in the header are written out as '\n'
-	FILE* fp = fopen( qPrintable( filename ), "wb" );
-	if( fp == NULL )
-	{
-		return false;
-	}
-
-	// write header
-	fprintf( fp, "Pf\n%d %d\n-1\n", w, h );
-
-	// write data
-	for( int y = 0; y < h; ++y )
-	{
-		float* row = &( m_data[ y * w ] );
-		fwrite( row, w * sizeof( float ), 1, fp );
-	}
-
-	fclose( fp );
-	return true;
 }
\ No newline at end of file
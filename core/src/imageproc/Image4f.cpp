@@ -1,12 +1,13 @@
 #include "imageproc/Image4f.h"
 
 #include <QFile>
-#include <QDataStream>
 #include <QTextStream>
 #include <QImage>
 #include <QString>
 
 #include "color/ColorUtils.h"
+#include "io/OpenEXRIO.h"
+#include "io/PortablePixelMapIO.h"
 #include "math/Arithmetic.h"
 #include "math/MathUtils.h"
 #include "vecmath/Vector4i.h"
@@ -315,13 +316,16 @@ QImage Image4f::toQImage()
 
 bool Image4f::load( QString filename )
 {
-	if( filename.endsWith( ".pfm", Qt::CaseInsensitive ) )
+	if( filename.endsWith( ".pfm", Qt::CaseInsensitive ) ||
+		filename.endsWith( ".pfm4", Qt::CaseInsensitive ) ||
+		filename.endsWith( ".ppm", Qt::CaseInsensitive ) ||
+		filename.endsWith( ".pgm", Qt::CaseInsensitive ) )
 	{
-		return loadPFM( filename );
+		return PortablePixelMapIO::read( filename, *this );
 	}
-	else if( filename.endsWith( ".pfm4", Qt::CaseInsensitive ) )
+	else if( filename.endsWith( ".exr", Qt::CaseInsensitive ) )
 	{
-		return loadPFM4( filename );
+		return OpenEXRIO::read( filename, *this );
 	}
 	else
 	{
@@ -333,11 +337,19 @@ bool Image4f::save( QString filename )
 {
 	if( filename.endsWith( ".pfm", Qt::CaseInsensitive ) )
 	{
-		return savePFM( filename );
+		return PortablePixelMapIO::writePFM( filename, *this );
 	}
 	else if( filename.endsWith( ".pfm4", Qt::CaseInsensitive ) )
 	{
-		return savePFM4( filename );
+		return PortablePixelMapIO::writePFM( filename, *this, true );
+	}
+	else if( filename.endsWith( ".ppm", Qt::CaseInsensitive ) )
+	{
+		return PortablePixelMapIO::writePPM( filename, *this );
+	}
+	else if( filename.endsWith( ".exr", Qt::CaseInsensitive ) )
+	{
+		return OpenEXRIO::write( filename, *this );
 	}
 	else if( filename.endsWith( ".txt", Qt::CaseInsensitive ) )
 	{
@@ -379,149 +391,6 @@ bool Image4f::loadQImage( QString filename )
 	return true;
 }
 
-bool Image4f::loadPFM( QString filename )
-{
-	QFile inputFile( filename );
-
-	// try to open the file in read only mode
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
-	{		
-		return false;
-	}
-
-	QTextStream inputTextStream( &inputFile );
-	inputTextStream.setCodec( "ISO-8859-1" );
-
-	// read header
-	QString qsType;
-	QString qsWidth;
-	QString qsHeight;
-	QString qsScale;	
-
-	inputTextStream >> qsType;
-	if( qsType != "PF" )
-	{
-		inputFile.close();
-		return false;
-	}
-
-	inputTextStream >> qsWidth >> qsHeight >> qsScale;
-
-	int width = qsWidth.toInt();
-	int height = qsHeight.toInt();
-	float scale = qsScale.toFloat();
-
-	if( width < 0 || height < 0 || scale >= 0 )
-	{
-		inputFile.close();
-		return false;
-	}
-
-	// close the text stream
-	inputTextStream.setDevice( NULL );
-	inputFile.close();
-
-	// now reopen it again in binary mode
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
-	{
-		return false;
-	}
-
-	int headerLength = qsType.length() + qsWidth.length() + qsHeight.length() + qsScale.length() + 4;	
-
-	QDataStream inputDataStream( &inputFile );
-	inputDataStream.skipRawData( headerLength );
-
-	Array2D< float > data( 4 * width, height );
-	int status;
-
-	for( int y = 0; y < height; ++y )
-	{
-		for( int x = 0; x < width; ++x )
-		{
-			char* bufferPointer = reinterpret_cast< char* >( &( data[ 4 * ( y * width + x ) ] ) );
-			status = inputDataStream.readRawData( bufferPointer, 3 * sizeof( float ) );
-		}
-	}
-
-	inputFile.close();
-
-	m_width = width;
-	m_height = height;
-	m_data = data;
-	return true;
-}
-
-// static
-bool Image4f::loadPFM4( QString filename )
-{
-	QFile inputFile( filename );
-
-	// try to open the file in read only mode
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
-	{		
-		return false;
-	}
-
-	QTextStream inputTextStream( &inputFile );
-	inputTextStream.setCodec( "ISO-8859-1" );
-
-	// read header
-	QString qsType;
-	QString qsWidth;
-	QString qsHeight;
-	QString qsScale;	
-
-	inputTextStream >> qsType;
-	if( qsType != "PF4" )
-	{
-		inputFile.close();
-		return false;
-	}
-
-	inputTextStream >> qsWidth >> qsHeight >> qsScale;
-
-	int width = qsWidth.toInt();
-	int height = qsHeight.toInt();
-	float scale = qsScale.toFloat();
-
-	if( width < 0 || height < 0 || scale >= 0 )
-	{
-		inputFile.close();
-		return false;
-	}
-
-	// close the text stream
-	inputTextStream.setDevice( NULL );
-	inputFile.close();
-
-	// now reopen it again in binary mode
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
-	{
-		return false;
-	}
-
-	int headerLength = qsType.length() + qsWidth.length() + qsHeight.length() + qsScale.length() + 4;	
-
-	QDataStream inputDataStream( &inputFile );
-	inputDataStream.skipRawData( headerLength );
-
-	Array2D< float > data( 4 * width, height );
-	int status;
-
-	for( int y = 0; y < height; ++y )
-	{
-		char* rowPointer = reinterpret_cast< char* >( &( data[ 4 * y * width ] ) );
-		status = inputDataStream.readRawData( rowPointer, 4 * width * sizeof( float ) );
-	}
-
-	inputFile.close();
-	m_width = width;
-	m_height = height;
-	m_data = data;
-	return true;
-}
-
 bool Image4f::savePNG( QString filename )
 {
 	return toQImage().save( filename, "PNG" );
@@ -565,63 +434,3 @@ bool Image4f::saveTXT( QString filename )
 	outputFile.close();
 	return true;
 }
-
-bool Image4f::savePFM( QString filename )
-{
-	int w = width();
-	int h = height();
-
-	// use "wb" binary mode to ensure that on Windows,
-	// newlines in the header are written out as '\n'
-	FILE* fp = fopen( qPrintable( filename ), "wb" );
-	if( fp == NULL )
-	{
-		return false;
-	}
-
-	// write header
-	fprintf( fp, "PF\n%d %d\n-1\n", w, h );
-
-	// write data
-	for( int y = 0; y < h; ++y )
-	{
-		for( int x = 0; x < w; ++x )
-		{
-			Vector4f rgba = pixel( x, y );
-			fwrite( &rgba, sizeof( float ), 3, fp );
-		}
-	}
-
-	fclose( fp );
-	return true;
-}
-
-bool Image4f::savePFM4( QString filename )
-{
-	int w = width();
-	int h = height();
-
-	// use "wb" binary mode to ensure that on Windows,
-	// newlines in the header are written out as '\n'
-	FILE* fp = fopen( qPrintable( filename ), "wb" );
-	if( fp == NULL )
-	{
-		return false;
-	}
-
-	// write header
-	fprintf( fp, "PF4\n%d %d\n-1\n", w, h );
-
-	// write data
-	for( int y = 0; y < h; ++y )
-	{
-		for( int x = 0; x < w; ++x )
-		{
-			Vector4f rgba = pixel( x, y );
-			fwrite( &rgba, sizeof( float ), 4, fp );
-		}
-	}
-
-	fclose( fp );
-	return true;
-}
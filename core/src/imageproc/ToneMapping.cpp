@@ -0,0 +1,491 @@
+#include "imageproc/ToneMapping.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <ppl.h>
+#include <emmintrin.h>
+
+#include "color/ColorUtils.h"
+#include "imageproc/BilateralGrid.h"
+
+namespace
+{
+	// Rec. 709 luminance weights (the input is linear radiance)
+	const float LUMINANCE_R = 0.2126f;
+	const float LUMINANCE_G = 0.7152f;
+	const float LUMINANCE_B = 0.0722f;
+
+	// number of rows per block in parallel reductions
+	const int ROWS_PER_BLOCK = 16;
+
+	// linear [0,1] --> 8-bit sRGB, indexed by round( x * ( SIZE - 1 ) )
+	// 2^14 entries keeps the quantization error well under half an 8-bit step
+	// even where the sRGB curve is steepest (near black)
+	// and still fits in L1
+	class SRGBEncodeTable
+	{
+	public:
+
+		static const int SIZE = 1 << 14;
+
+		SRGBEncodeTable()
+		{
+			for( int i = 0; i < SIZE; ++i )
+			{
+				float x = static_cast< float >( i ) / ( SIZE - 1 );
+				m_table[ i ] = ColorUtils::floatToUnsignedByte( ToneMapping::linearToSRGB( x ) );
+			}
+		}
+
+		ubyte operator [] ( int i ) const
+		{
+			return m_table[ i ];
+		}
+
+	private:
+
+		ubyte m_table[ SIZE ];
+	};
+
+	const SRGBEncodeTable s_srgbEncodeTable;
+
+	// log2 for positive, normal x
+	// Fonseca's minimax polynomial on the mantissa, max error ~1e-5
+	inline __m128 log2SSE( __m128 x )
+	{
+		const __m128 one = _mm_set1_ps( 1.f );
+
+		__m128i bits = _mm_castps_si128( x );
+		__m128 e = _mm_cvtepi32_ps( _mm_sub_epi32( _mm_srli_epi32( bits, 23 ), _mm_set1_epi32( 127 ) ) );
+		__m128 m = _mm_or_ps( _mm_castsi128_ps( _mm_and_si128( bits, _mm_set1_epi32( 0x007fffff ) ) ), one );
+
+		__m128 p = _mm_set1_ps( -3.4436006e-2f );
+		p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps( 3.1821337e-1f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps( -1.2315303f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps( 2.5988452f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps( -3.3241990f ) );
+		p = _mm_add_ps( _mm_mul_ps( p, m ), _mm_set1_ps( 3.1157899f ) );
+		p = _mm_mul_ps( p, _mm_sub_ps( m, one ) );
+
+		return _mm_add_ps( p, e );
+	}
+
+	inline __m128 luminanceSSE( __m128 r, __m128 g, __m128 b )
+	{
+		return _mm_add_ps
+		(
+			_mm_add_ps( _mm_mul_ps( r, _mm_set1_ps( LUMINANCE_R ) ), _mm_mul_ps( g, _mm_set1_ps( LUMINANCE_G ) ) ),
+			_mm_mul_ps( b, _mm_set1_ps( LUMINANCE_B ) )
+		);
+	}
+
+	inline float luminance( const float* rgb )
+	{
+		return LUMINANCE_R * rgb[ 0 ] + LUMINANCE_G * rgb[ 1 ] + LUMINANCE_B * rgb[ 2 ];
+	}
+
+	// L_d = L * ( 1 + L / L_white^2 ) / ( 1 + L ), color scaled by L_d / L
+	inline void reinhardSSE( __m128& r, __m128& g, __m128& b, __m128 invWhiteSquared )
+	{
+		const __m128 one = _mm_set1_ps( 1.f );
+
+		__m128 l = _mm_max_ps( luminanceSSE( r, g, b ), _mm_set1_ps( 1e-8f ) );
+		__m128 ld = _mm_div_ps
+		(
+			_mm_mul_ps( l, _mm_add_ps( one, _mm_mul_ps( l, invWhiteSquared ) ) ),
+			_mm_add_ps( one, l )
+		);
+		__m128 ratio = _mm_div_ps( ld, l );
+
+		r = _mm_mul_ps( r, ratio );
+		g = _mm_mul_ps( g, ratio );
+		b = _mm_mul_ps( b, ratio );
+	}
+
+	// x * ( 2.51 x + 0.03 ) / ( x * ( 2.43 x + 0.59 ) + 0.14 )
+	inline __m128 acesSSE( __m128 x )
+	{
+		__m128 numerator = _mm_mul_ps( x, _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( 2.51f ) ), _mm_set1_ps( 0.03f ) ) );
+		__m128 denominator = _mm_add_ps
+		(
+			_mm_mul_ps( x, _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( 2.43f ) ), _mm_set1_ps( 0.59f ) ) ),
+			_mm_set1_ps( 0.14f )
+		);
+		return _mm_div_ps( numerator, denominator );
+	}
+
+	inline __m128 saturateSSE( __m128 x )
+	{
+		return _mm_min_ps( _mm_max_ps( x, _mm_setzero_ps() ), _mm_set1_ps( 1.f ) );
+	}
+
+	// scalar saturateSSE(): clamps x to [0,1] and NaN to 0
+	// (ColorUtils::saturate() lets NaN through)
+	inline float saturateScalar( float x )
+	{
+		return( x > 0 ? std::min( x, 1.f ) : 0.f );
+	}
+
+	// x in [0,1] --> int in [0, scale], rounded like ColorUtils::floatToInt()
+	inline __m128i quantizeSSE( __m128 x, float scale )
+	{
+		return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( scale ) ), _mm_set1_ps( 0.5f ) ) );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+ToneMapping::Parameters::Parameters() :
+
+	toneOperator( REINHARD_GLOBAL ),
+	exposureStops( 0.f ),
+	keyValue( 0.18f ),
+	whitePoint( 4.f ),
+	spatialSigma( 16.f ),
+	rangeSigma( 0.4f ),
+	baseContrast( 5.f ),
+	srgbEncode( true )
+
+{
+
+}
+
+// static
+float ToneMapping::logAverageLuminance( const Image4f& input, float delta )
+{
+	int width = input.width();
+	int height = input.height();
+	if( width <= 0 || height <= 0 )
+	{
+		return 0.f;
+	}
+
+	const float* pixels = input.pixels();
+	int nBlocks = ( height + ROWS_PER_BLOCK - 1 ) / ROWS_PER_BLOCK;
+
+	// one partial sum of log2( delta + L ) per block of rows,
+	// added up in order afterwards so that the result is deterministic
+	std::vector< double > blockSums( nBlocks, 0.0 );
+
+	Concurrency::parallel_for( 0, nBlocks, [&]( int block )
+	{
+		const __m128 deltaSSE = _mm_set1_ps( delta );
+
+		int y0 = block * ROWS_PER_BLOCK;
+		int y1 = std::min( y0 + ROWS_PER_BLOCK, height );
+
+		double blockSum = 0;
+		for( int y = y0; y < y1; ++y )
+		{
+			const float* row = pixels + 4 * y * width;
+			__m128 rowSum = _mm_setzero_ps();
+
+			int x = 0;
+			for( ; x + 4 <= width; x += 4 )
+			{
+				__m128 r = _mm_loadu_ps( row + 4 * x );
+				__m128 g = _mm_loadu_ps( row + 4 * x + 4 );
+				__m128 b = _mm_loadu_ps( row + 4 * x + 8 );
+				__m128 a = _mm_loadu_ps( row + 4 * x + 12 );
+				_MM_TRANSPOSE4_PS( r, g, b, a );
+
+				__m128 l = _mm_add_ps( _mm_max_ps( luminanceSSE( r, g, b ), _mm_setzero_ps() ), deltaSSE );
+				rowSum = _mm_add_ps( rowSum, log2SSE( l ) );
+			}
+
+			float lanes[ 4 ];
+			_mm_storeu_ps( lanes, rowSum );
+			blockSum += static_cast< double >( lanes[ 0 ] ) + lanes[ 1 ] + lanes[ 2 ] + lanes[ 3 ];
+
+			for( ; x < width; ++x )
+			{
+				float l = std::max( luminance( row + 4 * x ), 0.f ) + delta;
+				blockSum += log( l ) / log( 2.0 );
+			}
+		}
+		blockSums[ block ] = blockSum;
+	} );
+
+	double sum = 0;
+	for( int i = 0; i < nBlocks; ++i )
+	{
+		sum += blockSums[ i ];
+	}
+
+	double meanLog2 = sum / ( static_cast< double >( width ) * height );
+	return static_cast< float >( pow( 2.0, meanLog2 ) );
+}
+
+// static
+void ToneMapping::toneMap( const Image4f& input, Image4ub& output,
+	const Parameters& parameters )
+{
+	if( input.isNull() )
+	{
+		output = Image4ub();
+		return;
+	}
+
+	if( output.size() != input.size() )
+	{
+		output = Image4ub( input.size() );
+	}
+
+	float exposure = pow( 2.f, parameters.exposureStops );
+	if( parameters.keyValue > 0 )
+	{
+		float lAvg = logAverageLuminance( input );
+		if( lAvg > 0 )
+		{
+			exposure *= parameters.keyValue / lAvg;
+		}
+	}
+
+	if( parameters.toneOperator == LOCAL_BILATERAL )
+	{
+		Image1f scale = localBilateralScale( input, exposure, parameters );
+		toneMapPass( input, exposure, &scale, parameters, output );
+	}
+	else
+	{
+		toneMapPass( input, exposure, nullptr, parameters, output );
+	}
+}
+
+// static
+Image4ub ToneMapping::toneMap( const Image4f& input, const Parameters& parameters )
+{
+	Image4ub output;
+	toneMap( input, output, parameters );
+	return output;
+}
+
+// static
+float ToneMapping::linearToSRGB( float x )
+{
+	if( x <= 0.0031308f )
+	{
+		return 12.92f * x;
+	}
+	return 1.055f * pow( x, 1.f / 2.4f ) - 0.055f;
+}
+
+// static
+float ToneMapping::srgbToLinear( float x )
+{
+	if( x <= 0.04045f )
+	{
+		return x / 12.92f;
+	}
+	return pow( ( x + 0.055f ) / 1.055f, 2.4f );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+Image1f ToneMapping::localBilateralScale( const Image4f& input, float exposure,
+	const Parameters& parameters )
+{
+	int width = input.width();
+	int height = input.height();
+	if( width * height == 0 )
+	{
+		return Image1f( input.size() );
+	}
+	const float* pixels = input.pixels();
+
+	// log10 of the exposed luminance
+	Image1f logLuminance( input.size() );
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		const float* row = pixels + 4 * y * width;
+		float* logRow = logLuminance.rowPointer( y );
+		for( int x = 0; x < width; ++x )
+		{
+			float l = exposure * luminance( row + 4 * x );
+			// written so that NaN luminance maps to 1e-6 too
+			logRow[ x ] = log10( l > 1e-6f ? l : 1e-6f );
+		}
+	} );
+
+	Image1f base = BilateralGrid::filter( logLuminance,
+		parameters.spatialSigma, parameters.rangeSigma );
+
+	int nPixels = width * height;
+	const float* basePixels = base.pixels();
+	auto minMax = std::minmax_element( basePixels, basePixels + nPixels );
+	float baseMin = *( minMax.first );
+	float baseMax = *( minMax.second );
+
+	// compress the base layer so that it spans log10( baseContrast )
+	// with its maximum at 0 (luminance 1), and add back the detail
+	float compression = 1.f;
+	if( baseMax > baseMin )
+	{
+		compression = std::min< float >( 1.f, log10( parameters.baseContrast ) / ( baseMax - baseMin ) );
+	}
+
+	Image1f scale( input.size() );
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		const float* row = pixels + 4 * y * width;
+		const float* logRow = logLuminance.pixels() + y * width;
+		const float* baseRow = basePixels + y * width;
+		float* scaleRow = scale.rowPointer( y );
+
+		for( int x = 0; x < width; ++x )
+		{
+			float l = exposure * luminance( row + 4 * x );
+			if( l > 1e-6f )
+			{
+				float logOut = compression * ( baseRow[ x ] - baseMax ) + ( logRow[ x ] - baseRow[ x ] );
+				scaleRow[ x ] = pow( 10.f, logOut ) / l;
+			}
+			else
+			{
+				scaleRow[ x ] = 0.f;
+			}
+		}
+	} );
+
+	return scale;
+}
+
+// static
+void ToneMapping::toneMapPass( const Image4f& input, float exposure, const Image1f* perPixelScale,
+	const Parameters& parameters, Image4ub& output )
+{
+	int width = input.width();
+	int height = input.height();
+	const float* pixels = input.pixels();
+	Operator op = parameters.toneOperator;
+	bool srgbEncode = parameters.srgbEncode;
+	float invWhiteSquared = 1.f / ( parameters.whitePoint * parameters.whitePoint );
+
+	Concurrency::parallel_for( 0, height, [&]( int y )
+	{
+		const __m128 invWhiteSquaredSSE = _mm_set1_ps( invWhiteSquared );
+		const float lutScale = static_cast< float >( SRGBEncodeTable::SIZE - 1 );
+
+		const float* row = pixels + 4 * y * width;
+		const float* scaleRow = ( perPixelScale != nullptr ) ? ( perPixelScale->pixels() + y * width ) : nullptr;
+		ubyte* outputRow = output.rowPointer( y );
+
+		// 4 pixels at a time, transposed to SoA:
+		// r = ( r0, r1, r2, r3 ), etc.
+		int x = 0;
+		for( ; x + 4 <= width; x += 4 )
+		{
+			__m128 r = _mm_loadu_ps( row + 4 * x );
+			__m128 g = _mm_loadu_ps( row + 4 * x + 4 );
+			__m128 b = _mm_loadu_ps( row + 4 * x + 8 );
+			__m128 a = _mm_loadu_ps( row + 4 * x + 12 );
+			_MM_TRANSPOSE4_PS( r, g, b, a );
+
+			__m128 s = _mm_set1_ps( exposure );
+			if( scaleRow != nullptr )
+			{
+				s = _mm_mul_ps( s, _mm_loadu_ps( scaleRow + x ) );
+			}
+			r = _mm_mul_ps( r, s );
+			g = _mm_mul_ps( g, s );
+			b = _mm_mul_ps( b, s );
+
+			if( op == REINHARD_GLOBAL )
+			{
+				reinhardSSE( r, g, b, invWhiteSquaredSSE );
+			}
+			else if( op == FILMIC_ACES )
+			{
+				r = acesSSE( r );
+				g = acesSSE( g );
+				b = acesSSE( b );
+			}
+
+			r = saturateSSE( r );
+			g = saturateSSE( g );
+			b = saturateSSE( b );
+			__m128i ai = quantizeSSE( saturateSSE( a ), 255.f );
+
+			__m128i ri;
+			__m128i gi;
+			__m128i bi;
+			if( srgbEncode )
+			{
+				int ir[ 4 ];
+				int ig[ 4 ];
+				int ib[ 4 ];
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( ir ), quantizeSSE( r, lutScale ) );
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( ig ), quantizeSSE( g, lutScale ) );
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( ib ), quantizeSSE( b, lutScale ) );
+
+				ri = _mm_setr_epi32( s_srgbEncodeTable[ ir[ 0 ] ], s_srgbEncodeTable[ ir[ 1 ] ],
+					s_srgbEncodeTable[ ir[ 2 ] ], s_srgbEncodeTable[ ir[ 3 ] ] );
+				gi = _mm_setr_epi32( s_srgbEncodeTable[ ig[ 0 ] ], s_srgbEncodeTable[ ig[ 1 ] ],
+					s_srgbEncodeTable[ ig[ 2 ] ], s_srgbEncodeTable[ ig[ 3 ] ] );
+				bi = _mm_setr_epi32( s_srgbEncodeTable[ ib[ 0 ] ], s_srgbEncodeTable[ ib[ 1 ] ],
+					s_srgbEncodeTable[ ib[ 2 ] ], s_srgbEncodeTable[ ib[ 3 ] ] );
+			}
+			else
+			{
+				ri = quantizeSSE( r, 255.f );
+				gi = quantizeSSE( g, 255.f );
+				bi = quantizeSSE( b, 255.f );
+			}
+
+			// pack each pixel into one little-endian RGBA word
+			__m128i rgba = _mm_or_si128
+			(
+				_mm_or_si128( ri, _mm_slli_epi32( gi, 8 ) ),
+				_mm_or_si128( _mm_slli_epi32( bi, 16 ), _mm_slli_epi32( ai, 24 ) )
+			);
+			_mm_storeu_si128( reinterpret_cast< __m128i* >( outputRow + 4 * x ), rgba );
+		}
+
+		// leftover pixels
+		for( ; x < width; ++x )
+		{
+			const float* pixel = row + 4 * x;
+			float s = exposure;
+			if( scaleRow != nullptr )
+			{
+				s *= scaleRow[ x ];
+			}
+
+			float rgb[ 3 ] = { s * pixel[ 0 ], s * pixel[ 1 ], s * pixel[ 2 ] };
+
+			if( op == REINHARD_GLOBAL )
+			{
+				float l = std::max( luminance( rgb ), 1e-8f );
+				float ld = l * ( 1 + l * invWhiteSquared ) / ( 1 + l );
+				for( int c = 0; c < 3; ++c )
+				{
+					rgb[ c ] *= ld / l;
+				}
+			}
+			else if( op == FILMIC_ACES )
+			{
+				for( int c = 0; c < 3; ++c )
+				{
+					float v = rgb[ c ];
+					rgb[ c ] = ( v * ( 2.51f * v + 0.03f ) ) / ( v * ( 2.43f * v + 0.59f ) + 0.14f );
+				}
+			}
+
+			for( int c = 0; c < 3; ++c )
+			{
+				float v = saturateScalar( rgb[ c ] );
+				outputRow[ 4 * x + c ] = srgbEncode ?
+					s_srgbEncodeTable[ static_cast< int >( v * lutScale + 0.5f ) ] :
+					ColorUtils::floatToUnsignedByte( v );
+			}
+			outputRow[ 4 * x + 3 ] = ColorUtils::floatToUnsignedByte( saturateScalar( pixel[ 3 ] ) );
+		}
+	} );
+}
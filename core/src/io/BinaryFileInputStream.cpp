@@ -1,21 +1,41 @@
 #include "io/BinaryFileInputStream.h"
 
+#include <algorithm>
+#include <cstring>
+
 // ==============================================================
 // Public
 // ==============================================================
 
 // static
-BinaryFileInputStream* BinaryFileInputStream::open( const char* filename )
+const int BinaryFileInputStream::BUFFER_SIZE = 1 << 20;
+
+// static
+BinaryFileInputStream* BinaryFileInputStream::open( const char* filename,
+	ByteOrder::Order byteOrder, Mode mode )
 {
-	FILE* fp = fopen( filename, "rb" );
-	if( fp != NULL )
+	BinaryFileInputStream* pStream = new BinaryFileInputStream( byteOrder );
+	pStream->m_mode = mode;
+
+	if( mode == MEMORY_MAPPED )
 	{
-		return new BinaryFileInputStream( fp );
+		if( pStream->m_mappedFile.open( filename ) )
+		{
+			return pStream;
+		}
 	}
 	else
 	{
-		return NULL;
+		pStream->m_pFilePointer = fopen( filename, "rb" );
+		if( pStream->m_pFilePointer != NULL )
+		{
+			pStream->m_buffer.resize( BUFFER_SIZE );
+			return pStream;
+		}
 	}
+
+	delete pStream;
+	return NULL;
 }
 
 // virtual
@@ -26,39 +46,182 @@ BinaryFileInputStream::~BinaryFileInputStream()
 
 void BinaryFileInputStream::close()
 {
-	fclose( m_pFilePointer );
+	if( m_pFilePointer != NULL )
+	{
+		fclose( m_pFilePointer );
+		m_pFilePointer = NULL;
+	}
+	m_mappedFile.close();
+	m_bufferPosition = 0;
+	m_bufferEnd = 0;
 }
 
 bool BinaryFileInputStream::readInt( int* i )
 {	
-	size_t itemsRead = fread( i, sizeof( int ), 1, m_pFilePointer );
-	return( itemsRead == 1 );
+	return readValue( i );
 }
 
 bool BinaryFileInputStream::readIntArray( int i[], int nCount )
 {
-	size_t itemsRead = fread( i, sizeof( int ), nCount, m_pFilePointer );
-	return( itemsRead == nCount );
+	return readArray( i, nCount );
 }
 
 bool BinaryFileInputStream::readFloat( float* f )
 {
-	size_t itemsRead = fread( f, sizeof( float ), 1, m_pFilePointer );
-	return( itemsRead == 1 );
+	return readValue( f );
 }
 
 bool BinaryFileInputStream::readFloatArray( float f[], int nCount )
 {
-	size_t itemsRead = fread( f, sizeof( float ), nCount, m_pFilePointer );
-	return( itemsRead == nCount );
+	return readArray( f, nCount );
+}
+
+bool BinaryFileInputStream::readBytes( void* data, int64 nBytes, int componentSize )
+{
+	ubyte* output = reinterpret_cast< ubyte* >( data );
+
+	if( m_mode == MEMORY_MAPPED )
+	{
+		if( nBytes > m_mappedFile.size() - m_position )
+		{
+			return false;
+		}
+		memcpy( output, m_mappedFile.data() + m_position, static_cast< size_t >( nBytes ) );
+		m_position += nBytes;
+	}
+	else
+	{
+		if( m_pFilePointer == NULL )
+		{
+			return false;
+		}
+
+		// drain what's buffered
+		int64 nRemaining = nBytes;
+		int64 nBuffered = std::min( m_bufferEnd - m_bufferPosition, nRemaining );
+		if( nBuffered > 0 )
+		{
+			memcpy( output, &( m_buffer[ 0 ] ) + m_bufferPosition, static_cast< size_t >( nBuffered ) );
+			m_bufferPosition += nBuffered;
+			output += nBuffered;
+			nRemaining -= nBuffered;
+		}
+
+		if( nRemaining >= BUFFER_SIZE )
+		{
+			// large reads bypass the buffer
+			size_t nRead = fread( output, 1, static_cast< size_t >( nRemaining ), m_pFilePointer );
+			m_position += nBuffered + static_cast< int64 >( nRead );
+			if( static_cast< int64 >( nRead ) != nRemaining )
+			{
+				return false;
+			}
+		}
+		else
+		{
+			while( nRemaining > 0 )
+			{
+				if( refill() == 0 )
+				{
+					m_position += nBytes - nRemaining;
+					return false;
+				}
+
+				int64 nCopied = std::min( m_bufferEnd, nRemaining );
+				memcpy( output, &( m_buffer[ 0 ] ), static_cast< size_t >( nCopied ) );
+				m_bufferPosition = nCopied;
+				output += nCopied;
+				nRemaining -= nCopied;
+			}
+			m_position += nBytes;
+		}
+	}
+
+	if( m_swapBytes && componentSize > 1 )
+	{
+		ByteOrder::swap( data, componentSize, nBytes / componentSize );
+	}
+	return true;
+}
+
+const void* BinaryFileInputStream::readInPlace( int64 nBytes )
+{
+	if( m_mode != MEMORY_MAPPED || nBytes > m_mappedFile.size() - m_position )
+	{
+		return NULL;
+	}
+
+	const ubyte* p = m_mappedFile.data() + m_position;
+	m_position += nBytes;
+	return p;
+}
+
+bool BinaryFileInputStream::skip( int64 nBytes )
+{
+	if( m_mode == MEMORY_MAPPED )
+	{
+		if( nBytes > m_mappedFile.size() - m_position )
+		{
+			return false;
+		}
+		m_position += nBytes;
+		return true;
+	}
+
+	if( m_pFilePointer == NULL )
+	{
+		return false;
+	}
+
+	int64 nBuffered = m_bufferEnd - m_bufferPosition;
+	if( nBytes <= nBuffered )
+	{
+		m_bufferPosition += nBytes;
+		m_position += nBytes;
+		return true;
+	}
+
+	// discard the buffer and seek past the rest
+	int64 nSeek = nBytes - nBuffered;
+	m_bufferPosition = 0;
+	m_bufferEnd = 0;
+#ifdef _WIN32
+	bool succeeded = ( _fseeki64( m_pFilePointer, nSeek, SEEK_CUR ) == 0 );
+#else
+	bool succeeded = ( fseeko( m_pFilePointer, nSeek, SEEK_CUR ) == 0 );
+#endif
+	if( succeeded )
+	{
+		m_position += nBytes;
+	}
+	return succeeded;
+}
+
+int64 BinaryFileInputStream::position() const
+{
+	return m_position;
 }
 
 // ==============================================================
 // Private
 // ==============================================================
 
-BinaryFileInputStream::BinaryFileInputStream( FILE* pFilePointer ) :
-	m_pFilePointer( pFilePointer )
+BinaryFileInputStream::BinaryFileInputStream( ByteOrder::Order byteOrder ) :
+
+	m_pFilePointer( NULL ),
+	m_mode( BUFFERED ),
+	m_swapBytes( byteOrder != ByteOrder::nativeOrder() ),
+	m_bufferPosition( 0 ),
+	m_bufferEnd( 0 ),
+	m_position( 0 )
+
 {
 
 }
+
+int64 BinaryFileInputStream::refill()
+{
+	m_bufferPosition = 0;
+	m_bufferEnd = fread( &( m_buffer[ 0 ] ), 1, m_buffer.size(), m_pFilePointer );
+	return m_bufferEnd;
+}
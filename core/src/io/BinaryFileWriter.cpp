@@ -1,16 +1,23 @@
 #include "io/BinaryFileWriter.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
 // ==============================================================
 // Public
 // ==============================================================
 
 // static
-BinaryFileWriter* BinaryFileWriter::open( const char* filename )
+const int BinaryFileWriter::BUFFER_SIZE = 1 << 20;
+
+// static
+BinaryFileWriter* BinaryFileWriter::open( const char* filename, ByteOrder::Order byteOrder )
 {
 	FILE* fp = fopen( filename, "wb" );
 	if( fp != NULL )
 	{
-		return new BinaryFileWriter( fp );
+		return new BinaryFileWriter( fp, byteOrder );
 	}
 	else
 	{
@@ -24,35 +31,136 @@ BinaryFileWriter::~BinaryFileWriter()
 	close();
 }
 
-void BinaryFileWriter::close()
+bool BinaryFileWriter::close()
 {
-	fclose( m_pFilePointer );
+	if( m_pFilePointer == NULL )
+	{
+		return !m_failed;
+	}
+
+	flush();
+	if( fclose( m_pFilePointer ) != 0 )
+	{
+		m_failed = true;
+	}
+	m_pFilePointer = NULL;
+	return !m_failed;
 }
 
 bool BinaryFileWriter::writeInt( int i )
 {
-	size_t itemsWritten = fwrite( &i, sizeof( int ), 1, m_pFilePointer );
-	return( itemsWritten == 1 );
+	return writeValue( i );
+}
+
+bool BinaryFileWriter::writeIntArray( const int i[], int nCount )
+{
+	return writeArray( i, nCount );
 }
 
 bool BinaryFileWriter::writeFloat( float f )
 {
-	size_t itemsWritten = fwrite( &f, sizeof( float ), 1, m_pFilePointer );
-	return( itemsWritten == 1 );
+	return writeValue( f );
 }
 
-bool BinaryFileWriter::writeFloatArray( float f[], int nCount )
+bool BinaryFileWriter::writeFloatArray( const float f[], int nCount )
 {
-	size_t itemsWritten = fwrite( f, sizeof( float ), nCount, m_pFilePointer );
-	return( itemsWritten == nCount );
+	return writeArray( f, nCount );
+}
+
+bool BinaryFileWriter::writeBytes( const void* data, int64 nBytes, int componentSize )
+{
+	if( m_pFilePointer == NULL )
+	{
+		return false;
+	}
+
+	// the buffer is filled a whole number of components at a time
+	assert( nBytes % componentSize == 0 );
+	if( nBytes % componentSize != 0 )
+	{
+		return false;
+	}
+
+	const ubyte* input = reinterpret_cast< const ubyte* >( data );
+	bool swap = ( m_swapBytes && componentSize > 1 );
+
+	// large writes that need no swapping bypass the buffer
+	if( !swap && nBytes >= BUFFER_SIZE )
+	{
+		flush();
+		size_t nWritten = fwrite( input, 1, static_cast< size_t >( nBytes ), m_pFilePointer );
+		m_position += static_cast< int64 >( nWritten );
+		if( static_cast< int64 >( nWritten ) != nBytes )
+		{
+			m_failed = true;
+		}
+		return !m_failed;
+	}
+
+	// otherwise, copy (and swap) through the buffer
+	// in pieces that are a whole number of components
+	int64 nRemaining = nBytes;
+	while( nRemaining > 0 )
+	{
+		if( m_bufferEnd + componentSize > BUFFER_SIZE )
+		{
+			flush();
+		}
+
+		int64 nCopied = std::min( nRemaining, BUFFER_SIZE - m_bufferEnd );
+		if( swap )
+		{
+			nCopied -= nCopied % componentSize;
+		}
+
+		ubyte* output = &( m_buffer[ 0 ] ) + m_bufferEnd;
+		memcpy( output, input, static_cast< size_t >( nCopied ) );
+		if( swap )
+		{
+			ByteOrder::swap( output, componentSize, nCopied / componentSize );
+		}
+
+		m_bufferEnd += nCopied;
+		m_position += nCopied;
+		input += nCopied;
+		nRemaining -= nCopied;
+	}
+
+	return !m_failed;
+}
+
+bool BinaryFileWriter::flush()
+{
+	if( m_pFilePointer != NULL && m_bufferEnd > 0 )
+	{
+		size_t nWritten = fwrite( &( m_buffer[ 0 ] ), 1, static_cast< size_t >( m_bufferEnd ), m_pFilePointer );
+		if( static_cast< int64 >( nWritten ) != m_bufferEnd )
+		{
+			m_failed = true;
+		}
+		m_bufferEnd = 0;
+	}
+	return !m_failed;
+}
+
+int64 BinaryFileWriter::position() const
+{
+	return m_position;
 }
 
 // ==============================================================
 // Private
 // ==============================================================
 
-BinaryFileWriter::BinaryFileWriter( FILE* pFilePointer ) :
-	m_pFilePointer( pFilePointer )
+BinaryFileWriter::BinaryFileWriter( FILE* pFilePointer, ByteOrder::Order byteOrder ) :
+
+	m_pFilePointer( pFilePointer ),
+	m_swapBytes( byteOrder != ByteOrder::nativeOrder() ),
+	m_failed( false ),
+	m_buffer( BUFFER_SIZE ),
+	m_bufferEnd( 0 ),
+	m_position( 0 )
+
 {
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,176 @@
+#include "io/ByteOrder.h"
+
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+	// SSE2 has no byte shuffle
+	// so bytes are swapped within 16-bit words with shifts
+	inline __m128i swapBytesIn16( __m128i x )
+	{
+		return _mm_or_si128( _mm_slli_epi16( x, 8 ), _mm_srli_epi16( x, 8 ) );
+	}
+
+	// and words are reordered with the word shuffles
+	inline __m128i swapWordsIn32( __m128i x )
+	{
+		x = _mm_shufflelo_epi16( x, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+		return _mm_shufflehi_epi16( x, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+	}
+
+	inline __m128i swapWordsIn64( __m128i x )
+	{
+		x = _mm_shufflelo_epi16( x, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+		return _mm_shufflehi_epi16( x, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool ByteOrder::isLittleEndian()
+{
+	const uint16 one = 1;
+	ubyte firstByte;
+	memcpy( &firstByte, &one, 1 );
+	return( firstByte == 1 );
+}
+
+// static
+ByteOrder::Order ByteOrder::nativeOrder()
+{
+	return isLittleEndian() ? LITTLE : BIG;
+}
+
+// static
+uint16 ByteOrder::swap( uint16 x )
+{
+	return static_cast< uint16 >( ( x << 8 ) | ( x >> 8 ) );
+}
+
+// static
+uint32 ByteOrder::swap( uint32 x )
+{
+	return
+	(
+		( x << 24 ) |
+		( ( x << 8 ) & 0x00ff0000 ) |
+		( ( x >> 8 ) & 0x0000ff00 ) |
+		( x >> 24 )
+	);
+}
+
+// static
+uint64 ByteOrder::swap( uint64 x )
+{
+	uint32 lo = static_cast< uint32 >( x );
+	uint32 hi = static_cast< uint32 >( x >> 32 );
+	return( ( static_cast< uint64 >( swap( lo ) ) << 32 ) | swap( hi ) );
+}
+
+// static
+float ByteOrder::swap( float x )
+{
+	uint32 bits;
+	memcpy( &bits, &x, sizeof( float ) );
+	bits = swap( bits );
+	memcpy( &x, &bits, sizeof( float ) );
+	return x;
+}
+
+// static
+double ByteOrder::swap( double x )
+{
+	uint64 bits;
+	memcpy( &bits, &x, sizeof( double ) );
+	bits = swap( bits );
+	memcpy( &x, &bits, sizeof( double ) );
+	return x;
+}
+
+// static
+void ByteOrder::swap16( void* data, int64 nElements )
+{
+	ubyte* p = reinterpret_cast< ubyte* >( data );
+	int64 nVectors = nElements / 8;
+	for( int64 i = 0; i < nVectors; ++i )
+	{
+		__m128i x = _mm_loadu_si128( reinterpret_cast< __m128i* >( p ) );
+		_mm_storeu_si128( reinterpret_cast< __m128i* >( p ), swapBytesIn16( x ) );
+		p += 16;
+	}
+
+	for( int64 i = 8 * nVectors; i < nElements; ++i )
+	{
+		uint16 x;
+		memcpy( &x, p, 2 );
+		x = swap( x );
+		memcpy( p, &x, 2 );
+		p += 2;
+	}
+}
+
+// static
+void ByteOrder::swap32( void* data, int64 nElements )
+{
+	ubyte* p = reinterpret_cast< ubyte* >( data );
+	int64 nVectors = nElements / 4;
+	for( int64 i = 0; i < nVectors; ++i )
+	{
+		__m128i x = _mm_loadu_si128( reinterpret_cast< __m128i* >( p ) );
+		_mm_storeu_si128( reinterpret_cast< __m128i* >( p ), swapBytesIn16( swapWordsIn32( x ) ) );
+		p += 16;
+	}
+
+	for( int64 i = 4 * nVectors; i < nElements; ++i )
+	{
+		uint32 x;
+		memcpy( &x, p, 4 );
+		x = swap( x );
+		memcpy( p, &x, 4 );
+		p += 4;
+	}
+}
+
+// static
+void ByteOrder::swap64( void* data, int64 nElements )
+{
+	ubyte* p = reinterpret_cast< ubyte* >( data );
+	int64 nVectors = nElements / 2;
+	for( int64 i = 0; i < nVectors; ++i )
+	{
+		__m128i x = _mm_loadu_si128( reinterpret_cast< __m128i* >( p ) );
+		_mm_storeu_si128( reinterpret_cast< __m128i* >( p ), swapBytesIn16( swapWordsIn64( x ) ) );
+		p += 16;
+	}
+
+	if( 2 * nVectors < nElements )
+	{
+		uint64 x;
+		memcpy( &x, p, 8 );
+		x = swap( x );
+		memcpy( p, &x, 8 );
+	}
+}
+
+// static
+void ByteOrder::swap( void* data, int elementSize, int64 nElements )
+{
+	switch( elementSize )
+	{
+	case 2:
+		swap16( data, nElements );
+		break;
+	case 4:
+		swap32( data, nElements );
+		break;
+	case 8:
+		swap64( data, nElements );
+		break;
+	default:
+		break;
+	}
+}
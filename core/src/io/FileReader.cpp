@@ -1,59 +1,59 @@
 #include "io/FileReader.h"
 
-#include <cstdio>
+#include <climits>
+#include <cstring>
+
+#include "io/MappedFile.h"
 
 // static
 bool FileReader::readTextFile( const char* filename, char** ppBuffer, long* length )
 {
-	FILE* filePointer = fopen( filename, "r" );
-	bool succeeded = false;
-	if( filePointer != NULL )
+	MappedFile file( filename, MappedFile::SEQUENTIAL );
+	if( !( file.isOpen() ) || file.size() >= LONG_MAX )
+	{
+		return false;
+	}
+
+	char* buffer = new char[ static_cast< size_t >( file.size() ) + 1 ];
+
+	// copy a line at a time, dropping the '\r' of "\r\n"
+	char* output = buffer;
+	for( MappedFile::LineIterator itr( file ); !itr.atEnd(); itr.next() )
 	{
-		// get the file size
-		int fSeekResult = fseek( filePointer, 0L, SEEK_END );
-		if( fSeekResult == 0 )
+		MappedFile::Span line = itr.line();
+		memcpy( output, line.begin, static_cast< size_t >( line.size() ) );
+		output += line.size();
+
+		// every line but a final unterminated one ends with '\n'
+		if( line.end < file.charData() + file.size() )
 		{
-			long fileSize = ftell( filePointer );
-			char* buffer = new char[ fileSize + 1 ];
-			if( buffer != NULL )
-			{
-				fseek( filePointer, 0L, SEEK_SET );
-				*length = ( long )( fread( buffer, 1, fileSize, filePointer ) ); // 1 = 1 byte = item size
-
-				succeeded = true;
-				buffer[ *length ] = '\0';
-				*ppBuffer = buffer;				
-			}						
+			*output = '\n';
+			++output;
 		}
-		fclose( filePointer );
 	}
 
-	return succeeded;
+	*output = '\0';
+	*length = static_cast< long >( output - buffer );
+	*ppBuffer = buffer;
+	return true;
 }
 
 // static
 bool FileReader::readBinaryFile( const char* filename, ubyte** ppBuffer, long* size )
 {
-	FILE* filePointer = fopen( filename, "rb" );
-	bool succeeded = false;
-	if( filePointer != NULL )
+	MappedFile file( filename, MappedFile::SEQUENTIAL );
+	if( !( file.isOpen() ) || file.size() > LONG_MAX )
 	{
-		// get the file size
-		int fSeekResult = fseek( filePointer, 0L, SEEK_END );
-		if( fSeekResult == 0 )
-		{
-			long fileSize = ftell( filePointer );
-			ubyte* buffer = new ubyte[ fileSize  ];
-			if( buffer != NULL )
-			{
-				fseek( filePointer, 0L, SEEK_SET );
-				*size = ( long )( fread( buffer, 1, fileSize, filePointer ) ); // 1 = 1 byte = item size
-				succeeded = true;
-				*ppBuffer = buffer;
-			}						
-		}
-		fclose( filePointer );
+		return false;
+	}
+
+	ubyte* buffer = new ubyte[ static_cast< size_t >( file.size() ) ];
+	if( file.size() > 0 )
+	{
+		memcpy( buffer, file.data(), static_cast< size_t >( file.size() ) );
 	}
 
-	return succeeded;
+	*size = static_cast< long >( file.size() );
+	*ppBuffer = buffer;
+	return true;
 }
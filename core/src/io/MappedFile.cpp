@@ -0,0 +1,365 @@
+#include "io/MappedFile.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <QFile>
+#endif
+
+#ifndef _WIN32
+namespace
+{
+	int toMadvise( MappedFile::AccessPattern accessPattern )
+	{
+		switch( accessPattern )
+		{
+		case MappedFile::SEQUENTIAL:
+			return MADV_SEQUENTIAL;
+		case MappedFile::RANDOM:
+			return MADV_RANDOM;
+		default:
+			return MADV_NORMAL;
+		}
+	}
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+MappedFile::Span::Span() :
+
+	begin( nullptr ),
+	end( nullptr )
+
+{
+
+}
+
+MappedFile::Span::Span( const char* begin, const char* end ) :
+
+	begin( begin ),
+	end( end )
+
+{
+
+}
+
+int64 MappedFile::Span::size() const
+{
+	return end - begin;
+}
+
+bool MappedFile::Span::isEmpty() const
+{
+	return( begin == end );
+}
+
+const ubyte* MappedFile::Span::data() const
+{
+	return reinterpret_cast< const ubyte* >( begin );
+}
+
+QByteArray MappedFile::Span::toByteArray() const
+{
+	return QByteArray( begin, static_cast< int >( size() ) );
+}
+
+QString MappedFile::Span::toString() const
+{
+	return QString::fromUtf8( begin, static_cast< int >( size() ) );
+}
+
+MappedFile::LineIterator::LineIterator( const MappedFile& file ) :
+
+	m_next( file.charData() ),
+	m_end( file.charData() + file.size() ),
+	m_lineNumber( -1 ),
+	m_atEnd( false )
+
+{
+	next();
+}
+
+MappedFile::LineIterator::LineIterator( const Span& span ) :
+
+	m_next( span.begin ),
+	m_end( span.end ),
+	m_lineNumber( -1 ),
+	m_atEnd( false )
+
+{
+	next();
+}
+
+bool MappedFile::LineIterator::atEnd() const
+{
+	return m_atEnd;
+}
+
+void MappedFile::LineIterator::next()
+{
+	if( m_next >= m_end )
+	{
+		m_atEnd = true;
+		m_line = Span();
+		return;
+	}
+
+	const char* lineEnd = reinterpret_cast< const char* >( memchr( m_next, '\n', m_end - m_next ) );
+	const char* nextLine;
+	if( lineEnd == nullptr )
+	{
+		lineEnd = m_end;
+		nextLine = m_end;
+	}
+	else
+	{
+		nextLine = lineEnd + 1;
+	}
+
+	if( lineEnd > m_next && lineEnd[ -1 ] == '\r' )
+	{
+		--lineEnd;
+	}
+
+	m_line = Span( m_next, lineEnd );
+	m_next = nextLine;
+	++m_lineNumber;
+}
+
+MappedFile::Span MappedFile::LineIterator::line() const
+{
+	return m_line;
+}
+
+int MappedFile::LineIterator::lineNumber() const
+{
+	return m_lineNumber;
+}
+
+MappedFile::MappedFile() :
+
+	m_isOpen( false ),
+	m_data( nullptr ),
+	m_size( 0 )
+#ifdef _WIN32
+	,
+	m_fileHandle( INVALID_HANDLE_VALUE ),
+	m_mappingHandle( nullptr )
+#endif
+
+{
+
+}
+
+MappedFile::MappedFile( QString filename, AccessPattern accessPattern ) :
+
+	m_isOpen( false ),
+	m_data( nullptr ),
+	m_size( 0 )
+#ifdef _WIN32
+	,
+	m_fileHandle( INVALID_HANDLE_VALUE ),
+	m_mappingHandle( nullptr )
+#endif
+
+{
+	open( filename, accessPattern );
+}
+
+// virtual
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open( QString filename, AccessPattern accessPattern )
+{
+	close();
+
+#ifdef _WIN32
+
+	// the cache manager's read-ahead hints
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+	if( accessPattern == SEQUENTIAL )
+	{
+		flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+	}
+	else if( accessPattern == RANDOM )
+	{
+		flags |= FILE_FLAG_RANDOM_ACCESS;
+	}
+
+	HANDLE fileHandle = CreateFileW( reinterpret_cast< LPCWSTR >( filename.utf16() ),
+		GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr );
+	if( fileHandle == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( fileHandle, &fileSize ) )
+	{
+		CloseHandle( fileHandle );
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	m_size = fileSize.QuadPart;
+
+	// CreateFileMapping fails on empty files
+	if( m_size > 0 )
+	{
+		m_mappingHandle = CreateFileMappingW( fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if( m_mappingHandle == nullptr )
+		{
+			close();
+			return false;
+		}
+
+		m_data = reinterpret_cast< const ubyte* >( MapViewOfFile( m_mappingHandle, FILE_MAP_READ, 0, 0, 0 ) );
+		if( m_data == nullptr )
+		{
+			close();
+			return false;
+		}
+	}
+
+#else
+
+	int fd = ::open( QFile::encodeName( filename ).constData(), O_RDONLY );
+	if( fd == -1 )
+	{
+		return false;
+	}
+
+	struct stat fileStatus;
+	if( fstat( fd, &fileStatus ) != 0 )
+	{
+		::close( fd );
+		return false;
+	}
+
+	m_size = fileStatus.st_size;
+	if( m_size > 0 )
+	{
+		void* pData = mmap( nullptr, static_cast< size_t >( m_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+		if( pData == MAP_FAILED )
+		{
+			::close( fd );
+			m_size = 0;
+			return false;
+		}
+		m_data = reinterpret_cast< const ubyte* >( pData );
+	}
+
+	// the mapping keeps its own reference to the file
+	::close( fd );
+
+#endif
+
+	m_isOpen = true;
+	advise( accessPattern );
+	return true;
+}
+
+void MappedFile::advise( AccessPattern accessPattern )
+{
+#ifdef _WIN32
+	// given to CreateFile in open()
+	(void)accessPattern;
+#else
+	if( m_data != nullptr )
+	{
+		madvise( const_cast< ubyte* >( m_data ), static_cast< size_t >( m_size ), toMadvise( accessPattern ) );
+	}
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+
+	if( m_data != nullptr )
+	{
+		UnmapViewOfFile( m_data );
+	}
+	if( m_mappingHandle != nullptr )
+	{
+		CloseHandle( m_mappingHandle );
+		m_mappingHandle = nullptr;
+	}
+	if( m_fileHandle != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle( m_fileHandle );
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+
+#else
+
+	if( m_data != nullptr )
+	{
+		munmap( const_cast< ubyte* >( m_data ), static_cast< size_t >( m_size ) );
+	}
+
+#endif
+
+	m_isOpen = false;
+	m_data = nullptr;
+	m_size = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return m_isOpen;
+}
+
+const ubyte* MappedFile::data() const
+{
+	return m_data;
+}
+
+const char* MappedFile::charData() const
+{
+	return reinterpret_cast< const char* >( m_data );
+}
+
+int64 MappedFile::size() const
+{
+	return m_size;
+}
+
+MappedFile::Span MappedFile::span() const
+{
+	return Span( charData(), charData() + m_size );
+}
+
+MappedFile::Span MappedFile::span( int64 offset, int64 size ) const
+{
+	if( offset < 0 )
+	{
+		size += offset;
+		offset = 0;
+	}
+	if( offset > m_size )
+	{
+		offset = m_size;
+	}
+	if( size < 0 )
+	{
+		size = 0;
+	}
+	if( size > m_size - offset )
+	{
+		size = m_size - offset;
+	}
+	return Span( charData() + offset, charData() + offset + size );
+}
@@ -0,0 +1,974 @@
+#include "io/MeshCacheFile.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <ppl.h>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+
+#include "geometry/TriangleMesh.h"
+#include "io/OBJData.h"
+#include "io/OBJLoader.h"
+
+namespace
+{
+	const char MAGIC[ 8 ] = { 'L', 'C', 'G', 'T', 'M', 'E', 'S', 'H' };
+
+	// written as a uint32: reads back differently on a machine of the other endianness
+	const uint32 BYTE_ORDER_MARK = 0x01020304;
+
+	// every block starts at a multiple of this many bytes
+	const int64 BLOCK_ALIGNMENT = 64;
+
+	// the content hash is computed over blocks of this size, in parallel
+	const int64 HASH_BLOCK_SIZE = 16 * 1024 * 1024;
+
+	enum BlockType
+	{
+		BLOCK_POSITIONS = 1,
+		BLOCK_TEXTURE_COORDINATES = 2,
+		BLOCK_NORMALS = 3,
+		BLOCK_TRIANGLE_POSITION_INDICES = 4,
+		BLOCK_TRIANGLE_TEXTURE_COORDINATE_INDICES = 5,
+		BLOCK_TRIANGLE_NORMAL_INDICES = 6,
+		BLOCK_GROUPS = 7,
+		BLOCK_MATERIAL_RUNS = 8,
+		BLOCK_MATERIALS = 9,
+		BLOCK_STRINGS = 10
+	};
+
+	struct FileHeader
+	{
+		char magic[ 8 ];
+		uint32 version;
+		uint32 byteOrderMark;
+		uint32 nBlocks;
+		uint32 reserved;
+		int64 sourceSize;
+		int64 sourceModifiedTime;
+		uint64 sourceContentHash;
+	};
+
+	struct BlockHeader
+	{
+		uint32 type;
+		uint32 elementSize;
+		int64 offset;
+		int64 count;
+	};
+
+	// a block to be written
+	struct OutputBlock
+	{
+		OutputBlock( uint32 type, uint32 elementSize, const void* data, int64 count ) :
+
+			type( type ),
+			elementSize( elementSize ),
+			data( data ),
+			count( count )
+
+		{
+
+		}
+
+		uint32 type;
+		uint32 elementSize;
+		const void* data;
+		int64 count;
+	};
+
+	static_assert( sizeof( Vector2f ) == 2 * sizeof( float ), "Vector2f must be tightly packed" );
+	static_assert( sizeof( Vector3f ) == 3 * sizeof( float ), "Vector3f must be tightly packed" );
+	static_assert( sizeof( Vector3i ) == 3 * sizeof( int ), "Vector3i must be tightly packed" );
+
+	int64 roundUpToAlignment( int64 offset )
+	{
+		return ( ( offset + BLOCK_ALIGNMENT - 1 ) / BLOCK_ALIGNMENT ) * BLOCK_ALIGNMENT;
+	}
+
+	// MurmurHash64A, by Austin Appleby (public domain)
+	uint64 murmurHash64A( const void* key, int64 length, uint64 seed )
+	{
+		const uint64 m = 0xc6a4a7935bd1e995ULL;
+		const int r = 47;
+
+		uint64 h = seed ^ ( static_cast< uint64 >( length ) * m );
+
+		const ubyte* data = reinterpret_cast< const ubyte* >( key );
+		const ubyte* end = data + ( length / 8 ) * 8;
+		while( data != end )
+		{
+			uint64 k;
+			memcpy( &k, data, sizeof( uint64 ) );
+			data += sizeof( uint64 );
+
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+
+			h ^= k;
+			h *= m;
+		}
+
+		int remaining = static_cast< int >( length & 7 );
+		if( remaining > 0 )
+		{
+			for( int i = remaining - 1; i >= 0; --i )
+			{
+				h ^= static_cast< uint64 >( data[ i ] ) << ( 8 * i );
+			}
+			h *= m;
+		}
+
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+
+		return h;
+	}
+
+	// whether every index of triangles [ firstTriangle, firstTriangle + nTriangles )
+	// of indices is in [ minIndex, nElements )
+	// checked in parallel, over chunks of this many triangles
+	const int INDEX_CHECK_CHUNK_SIZE = 65536;
+
+	bool indicesInRange( const Vector3i* indices, int firstTriangle, int nTriangles, int minIndex, int nElements )
+	{
+		indices += firstTriangle;
+		int nChunks = ( nTriangles + INDEX_CHECK_CHUNK_SIZE - 1 ) / INDEX_CHECK_CHUNK_SIZE;
+		std::vector< ubyte > chunkInRange( nChunks );
+		Concurrency::parallel_for( 0, nChunks, [&]( int c )
+		{
+			const int* begin = reinterpret_cast< const int* >( indices + c * INDEX_CHECK_CHUNK_SIZE );
+			const int* end = reinterpret_cast< const int* >( indices + std::min( ( c + 1 ) * INDEX_CHECK_CHUNK_SIZE, nTriangles ) );
+			bool inRange = true;
+			for( const int* i = begin; i != end; ++i )
+			{
+				inRange &= ( *i >= minIndex && *i < nElements );
+			}
+			chunkInRange[ c ] = inRange ? 1 : 0;
+		} );
+		return std::find( chunkInRange.begin(), chunkInRange.end(), 0 ) == chunkInRange.end();
+	}
+
+	// appends s (as UTF-8) to strings
+	// and sets *pOffset and *pLength to where it is
+	void appendString( QString s, QByteArray& strings, uint32* pOffset, uint32* pLength )
+	{
+		QByteArray utf8 = s.toUtf8();
+		*pOffset = static_cast< uint32 >( strings.size() );
+		*pLength = static_cast< uint32 >( utf8.size() );
+		strings.append( utf8 );
+	}
+
+	// writes the header, block table and blocks to filename
+	// via a temporary file that's renamed when complete
+	bool writeBlocks( QString filename, const MeshCacheFile::SourceInfo& sourceInfo,
+		const std::vector< OutputBlock >& blocks )
+	{
+		int nBlocks = static_cast< int >( blocks.size() );
+
+		FileHeader header;
+		memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+		header.version = MeshCacheFile::VERSION;
+		header.byteOrderMark = BYTE_ORDER_MARK;
+		header.nBlocks = nBlocks;
+		header.reserved = 0;
+		header.sourceSize = sourceInfo.size;
+		header.sourceModifiedTime = sourceInfo.modifiedTime;
+		header.sourceContentHash = sourceInfo.contentHash;
+
+		std::vector< BlockHeader > blockHeaders( nBlocks );
+		int64 offset = sizeof( FileHeader ) + nBlocks * sizeof( BlockHeader );
+		for( int i = 0; i < nBlocks; ++i )
+		{
+			offset = roundUpToAlignment( offset );
+			blockHeaders[ i ].type = blocks[ i ].type;
+			blockHeaders[ i ].elementSize = blocks[ i ].elementSize;
+			blockHeaders[ i ].offset = offset;
+			blockHeaders[ i ].count = blocks[ i ].count;
+			offset += blocks[ i ].elementSize * blocks[ i ].count;
+		}
+
+		QString temporaryFilename = filename + ".tmp";
+		QFile outputFile( temporaryFilename );
+		if( !( outputFile.open( QIODevice::WriteOnly ) ) )
+		{
+			fprintf( stderr, "Unable to open %s for writing\n", qPrintable( temporaryFilename ) );
+			return false;
+		}
+
+		bool succeeded = true;
+		succeeded &= ( outputFile.write( reinterpret_cast< const char* >( &header ), sizeof( header ) ) == sizeof( header ) );
+		if( nBlocks > 0 )
+		{
+			int64 tableSize = nBlocks * sizeof( BlockHeader );
+			succeeded &= ( outputFile.write( reinterpret_cast< const char* >( &( blockHeaders[ 0 ] ) ), tableSize ) == tableSize );
+		}
+
+		const char padding[ BLOCK_ALIGNMENT ] = { 0 };
+		int64 position = sizeof( FileHeader ) + nBlocks * sizeof( BlockHeader );
+		for( int i = 0; i < nBlocks && succeeded; ++i )
+		{
+			int64 nPaddingBytes = blockHeaders[ i ].offset - position;
+			succeeded &= ( outputFile.write( padding, nPaddingBytes ) == nPaddingBytes );
+
+			int64 nBytes = blocks[ i ].elementSize * blocks[ i ].count;
+			if( nBytes > 0 )
+			{
+				succeeded &= ( outputFile.write( reinterpret_cast< const char* >( blocks[ i ].data ), nBytes ) == nBytes );
+			}
+			position = blockHeaders[ i ].offset + nBytes;
+		}
+		outputFile.close();
+
+		if( succeeded )
+		{
+			QFile::remove( filename );
+			succeeded = QFile::rename( temporaryFilename, filename );
+		}
+		if( !succeeded )
+		{
+			fprintf( stderr, "Error writing %s\n", qPrintable( filename ) );
+			QFile::remove( temporaryFilename );
+		}
+		return succeeded;
+	}
+}
+
+// static
+const uint32 MeshCacheFile::VERSION = 1;
+
+// static
+const char* MeshCacheFile::CACHE_EXTENSION = ".meshcache";
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+MeshCacheFile::SourceInfo::SourceInfo() :
+
+	size( 0 ),
+	modifiedTime( 0 ),
+	contentHash( 0 )
+
+{
+
+}
+
+// static
+std::shared_ptr< OBJData > MeshCacheFile::loadOBJ( QString objFilename, bool removeEmptyGroups )
+{
+	{
+		MeshCacheFile cache;
+		if( openSideCar( objFilename, cache ) )
+		{
+			std::shared_ptr< OBJData > pData = cache.toOBJData();
+			if( removeEmptyGroups )
+			{
+				pData->removeEmptyGroups();
+			}
+			return pData;
+		}
+	}
+
+	return parseAndCache( objFilename, removeEmptyGroups );
+}
+
+// static
+bool MeshCacheFile::loadTriangleMesh( QString objFilename, TriangleMesh& mesh )
+{
+	{
+		MeshCacheFile cache;
+		if( openSideCar( objFilename, cache ) )
+		{
+			mesh = cache.toTriangleMesh();
+			return true;
+		}
+	}
+
+	std::shared_ptr< OBJData > pData = parseAndCache( objFilename, true );
+	if( pData.get() == nullptr )
+	{
+		return false;
+	}
+	mesh = TriangleMesh( pData );
+	return true;
+}
+
+// static
+bool MeshCacheFile::getSourceInfo( QString filename, SourceInfo* pInfo )
+{
+	QFileInfo fileInfo( filename );
+	if( !( fileInfo.exists() ) )
+	{
+		return false;
+	}
+
+	pInfo->size = fileInfo.size();
+	pInfo->modifiedTime = fileInfo.lastModified().toMSecsSinceEpoch();
+	return hashFile( filename, &( pInfo->contentHash ) );
+}
+
+// static
+bool MeshCacheFile::hashFile( QString filename, uint64* pHash )
+{
+	MappedFile file( filename );
+	if( !( file.isOpen() ) )
+	{
+		return false;
+	}
+
+	int64 size = file.size();
+	int nHashBlocks = static_cast< int >( ( size + HASH_BLOCK_SIZE - 1 ) / HASH_BLOCK_SIZE );
+	std::vector< uint64 > blockHashes( nHashBlocks );
+
+	const ubyte* data = file.data();
+	Concurrency::parallel_for( 0, nHashBlocks, [&]( int i )
+	{
+		int64 begin = i * HASH_BLOCK_SIZE;
+		int64 length = std::min( HASH_BLOCK_SIZE, size - begin );
+		blockHashes[ i ] = murmurHash64A( data + begin, length, i );
+	} );
+
+	// the block size is fixed, so the result doesn't depend on the number of threads
+	*pHash = murmurHash64A( blockHashes.data(), nHashBlocks * sizeof( uint64 ), size );
+	return true;
+}
+
+// static
+bool MeshCacheFile::write( QString filename, std::shared_ptr< OBJData > pData,
+	const SourceInfo& sourceInfo )
+{
+	std::vector< Vector3i > positionIndices;
+	std::vector< Vector3i > textureCoordinateIndices;
+	std::vector< Vector3i > normalIndices;
+	std::vector< Group > groups;
+	std::vector< MaterialRun > materialRuns;
+	std::vector< Material > materials;
+	QByteArray strings;
+
+	bool anyTextureCoordinates = false;
+	bool anyNormals = false;
+
+	std::vector< OBJGroup >& objGroups = pData->groups();
+	for( int g = 0; g < static_cast< int >( objGroups.size() ); ++g )
+	{
+		OBJGroup& objGroup = objGroups[ g ];
+		const std::vector< OBJFace >& faces = objGroup.faces();
+		int nFaces = objGroup.numFaces();
+
+		// which material each face was added under
+		// a name can appear more than once in materialNames(), but owns a single face list
+		std::vector< int > faceMaterials( nFaces, 0 );
+		QHash< QString, bool > visited;
+		const std::vector< QString >& materialNames = objGroup.materialNames();
+		for( int m = 0; m < static_cast< int >( materialNames.size() ); ++m )
+		{
+			if( !( visited.contains( materialNames[ m ] ) ) )
+			{
+				visited.insert( materialNames[ m ], true );
+				const std::vector< int >& faceIndices = objGroup.facesForMaterial( m );
+				for( int i = 0; i < static_cast< int >( faceIndices.size() ); ++i )
+				{
+					faceMaterials[ faceIndices[ i ] ] = m;
+				}
+			}
+		}
+
+		Group group;
+		appendString( objGroup.name(), strings, &( group.nameOffset ), &( group.nameLength ) );
+		group.firstTriangle = static_cast< int32 >( positionIndices.size() );
+		group.firstMaterialRun = static_cast< int32 >( materialRuns.size() );
+		group.hasTextureCoordinates = objGroup.hasTextureCoordinates() ? 1 : 0;
+		group.hasNormals = objGroup.hasNormals() ? 1 : 0;
+		anyTextureCoordinates |= objGroup.hasTextureCoordinates();
+		anyNormals |= objGroup.hasNormals();
+
+		int currentMaterial = -1;
+		for( int f = 0; f < nFaces; ++f )
+		{
+			const OBJFace& face = faces[ f ];
+			int nVertices = face.numVertices();
+			if( nVertices < 3 )
+			{
+				continue;
+			}
+
+			if( faceMaterials[ f ] != currentMaterial )
+			{
+				currentMaterial = faceMaterials[ f ];
+
+				MaterialRun run;
+				appendString( materialNames[ currentMaterial ], strings, &( run.nameOffset ), &( run.nameLength ) );
+				run.firstTriangle = static_cast< int32 >( positionIndices.size() );
+				run.nTriangles = 0;
+				materialRuns.push_back( run );
+			}
+
+			// fan triangulate
+			const std::vector< int >& pis = face.positionIndices();
+			const std::vector< int >& tis = face.textureCoordinateIndices();
+			const std::vector< int >& nis = face.normalIndices();
+			for( int i = 2; i < nVertices; ++i )
+			{
+				positionIndices.push_back( Vector3i( pis[ 0 ], pis[ i - 1 ], pis[ i ] ) );
+				textureCoordinateIndices.push_back( face.hasTextureCoordinates() ?
+					Vector3i( tis[ 0 ], tis[ i - 1 ], tis[ i ] ) : Vector3i( -1 ) );
+				normalIndices.push_back( face.hasNormals() ?
+					Vector3i( nis[ 0 ], nis[ i - 1 ], nis[ i ] ) : Vector3i( -1 ) );
+				++( materialRuns.back().nTriangles );
+			}
+		}
+
+		group.nTriangles = static_cast< int32 >( positionIndices.size() ) - group.firstTriangle;
+		group.nMaterialRuns = static_cast< int32 >( materialRuns.size() ) - group.firstMaterialRun;
+		groups.push_back( group );
+	}
+
+	std::vector< OBJMaterial >& objMaterials = pData->materials();
+	for( int m = 0; m < static_cast< int >( objMaterials.size() ); ++m )
+	{
+		const OBJMaterial& objMaterial = objMaterials[ m ];
+
+		Material material;
+		appendString( objMaterial.name(), strings, &( material.nameOffset ), &( material.nameLength ) );
+		appendString( objMaterial.ambientTexture(), strings, &( material.ambientTextureOffset ), &( material.ambientTextureLength ) );
+		appendString( objMaterial.diffuseTexture(), strings, &( material.diffuseTextureOffset ), &( material.diffuseTextureLength ) );
+		material.illuminationModel = objMaterial.illuminationModel();
+		material.alpha = objMaterial.alpha();
+		material.shininess = objMaterial.shininess();
+		material.ambientColor = objMaterial.ambientColor();
+		material.diffuseColor = objMaterial.diffuseColor();
+		material.specularColor = objMaterial.specularColor();
+		materials.push_back( material );
+	}
+
+	std::vector< OutputBlock > blocks;
+	blocks.push_back( OutputBlock( BLOCK_POSITIONS, sizeof( Vector3f ),
+		pData->positions().data(), pData->positions().size() ) );
+	blocks.push_back( OutputBlock( BLOCK_TEXTURE_COORDINATES, sizeof( Vector2f ),
+		pData->textureCoordinates().data(), pData->textureCoordinates().size() ) );
+	blocks.push_back( OutputBlock( BLOCK_NORMALS, sizeof( Vector3f ),
+		pData->normals().data(), pData->normals().size() ) );
+	blocks.push_back( OutputBlock( BLOCK_TRIANGLE_POSITION_INDICES, sizeof( Vector3i ),
+		positionIndices.data(), positionIndices.size() ) );
+	if( anyTextureCoordinates )
+	{
+		blocks.push_back( OutputBlock( BLOCK_TRIANGLE_TEXTURE_COORDINATE_INDICES, sizeof( Vector3i ),
+			textureCoordinateIndices.data(), textureCoordinateIndices.size() ) );
+	}
+	if( anyNormals )
+	{
+		blocks.push_back( OutputBlock( BLOCK_TRIANGLE_NORMAL_INDICES, sizeof( Vector3i ),
+			normalIndices.data(), normalIndices.size() ) );
+	}
+	blocks.push_back( OutputBlock( BLOCK_GROUPS, sizeof( Group ), groups.data(), groups.size() ) );
+	blocks.push_back( OutputBlock( BLOCK_MATERIAL_RUNS, sizeof( MaterialRun ), materialRuns.data(), materialRuns.size() ) );
+	blocks.push_back( OutputBlock( BLOCK_MATERIALS, sizeof( Material ), materials.data(), materials.size() ) );
+	blocks.push_back( OutputBlock( BLOCK_STRINGS, 1, strings.constData(), strings.size() ) );
+
+	return writeBlocks( filename, sourceInfo, blocks );
+}
+
+// static
+bool MeshCacheFile::write( QString filename, const TriangleMesh& mesh,
+	const SourceInfo& sourceInfo )
+{
+	std::vector< OutputBlock > blocks;
+	blocks.push_back( OutputBlock( BLOCK_POSITIONS, sizeof( Vector3f ),
+		mesh.positions().data(), mesh.positions().size() ) );
+	blocks.push_back( OutputBlock( BLOCK_NORMALS, sizeof( Vector3f ),
+		mesh.normals().data(), mesh.normals().size() ) );
+	blocks.push_back( OutputBlock( BLOCK_TRIANGLE_POSITION_INDICES, sizeof( Vector3i ),
+		mesh.faces().data(), mesh.faces().size() ) );
+
+	return writeBlocks( filename, sourceInfo, blocks );
+}
+
+MeshCacheFile::MeshCacheFile()
+{
+	close();
+}
+
+bool MeshCacheFile::open( QString filename )
+{
+	close();
+
+	if( !( m_file.open( filename ) ) )
+	{
+		return false;
+	}
+
+	int64 fileSize = m_file.size();
+	if( fileSize < static_cast< int64 >( sizeof( FileHeader ) ) )
+	{
+		close();
+		return false;
+	}
+
+	const FileHeader* header = reinterpret_cast< const FileHeader* >( m_file.data() );
+	if( memcmp( header->magic, MAGIC, sizeof( MAGIC ) ) != 0 ||
+		header->version != VERSION ||
+		header->byteOrderMark != BYTE_ORDER_MARK ||
+		fileSize < static_cast< int64 >( sizeof( FileHeader ) + header->nBlocks * sizeof( BlockHeader ) ) )
+	{
+		close();
+		return false;
+	}
+
+	m_nBlocks = header->nBlocks;
+	m_sourceInfo.size = header->sourceSize;
+	m_sourceInfo.modifiedTime = header->sourceModifiedTime;
+	m_sourceInfo.contentHash = header->sourceContentHash;
+
+	// every block must lie within the file
+	const BlockHeader* blockHeaders = reinterpret_cast< const BlockHeader* >( header + 1 );
+	for( int i = 0; i < m_nBlocks; ++i )
+	{
+		const BlockHeader& block = blockHeaders[ i ];
+		if( block.offset < 0 || block.offset > fileSize || block.count < 0 || block.count > INT_MAX ||
+			block.offset % BLOCK_ALIGNMENT != 0 ||
+			block.offset + block.elementSize * block.count > fileSize )
+		{
+			close();
+			return false;
+		}
+	}
+
+	m_positions = reinterpret_cast< const Vector3f* >( findBlock( BLOCK_POSITIONS, sizeof( Vector3f ), &m_nPositions ) );
+	m_textureCoordinates = reinterpret_cast< const Vector2f* >( findBlock( BLOCK_TEXTURE_COORDINATES, sizeof( Vector2f ), &m_nTextureCoordinates ) );
+	m_normals = reinterpret_cast< const Vector3f* >( findBlock( BLOCK_NORMALS, sizeof( Vector3f ), &m_nNormals ) );
+
+	int nTextureCoordinateTriangles;
+	int nNormalTriangles;
+	m_trianglePositionIndices = reinterpret_cast< const Vector3i* >( findBlock( BLOCK_TRIANGLE_POSITION_INDICES, sizeof( Vector3i ), &m_nTriangles ) );
+	m_triangleTextureCoordinateIndices = reinterpret_cast< const Vector3i* >( findBlock( BLOCK_TRIANGLE_TEXTURE_COORDINATE_INDICES, sizeof( Vector3i ), &nTextureCoordinateTriangles ) );
+	m_triangleNormalIndices = reinterpret_cast< const Vector3i* >( findBlock( BLOCK_TRIANGLE_NORMAL_INDICES, sizeof( Vector3i ), &nNormalTriangles ) );
+
+	m_groups = reinterpret_cast< const Group* >( findBlock( BLOCK_GROUPS, sizeof( Group ), &m_nGroups ) );
+	m_materialRuns = reinterpret_cast< const MaterialRun* >( findBlock( BLOCK_MATERIAL_RUNS, sizeof( MaterialRun ), &m_nMaterialRuns ) );
+	m_materials = reinterpret_cast< const Material* >( findBlock( BLOCK_MATERIALS, sizeof( Material ), &m_nMaterials ) );
+	m_strings = reinterpret_cast< const char* >( findBlock( BLOCK_STRINGS, 1, &m_nStringBytes ) );
+
+	// the per-triangle arrays must agree, the groups and material runs must reference valid ranges,
+	// the strings must lie within the string table, and the indices within their arrays
+	// (texture coordinate and normal indices are -1 where absent,
+	// but not in the triangles of groups that have them)
+	// so that a corrupt cache is rejected here rather than read out of bounds later
+	bool isConsistent =
+		( m_triangleTextureCoordinateIndices == nullptr || nTextureCoordinateTriangles == m_nTriangles ) &&
+		( m_triangleNormalIndices == nullptr || nNormalTriangles == m_nTriangles );
+	for( int g = 0; g < m_nGroups && isConsistent; ++g )
+	{
+		const Group& group = m_groups[ g ];
+		isConsistent =
+			group.firstTriangle >= 0 && group.nTriangles >= 0 &&
+			static_cast< int64 >( group.firstTriangle ) + group.nTriangles <= m_nTriangles &&
+			group.firstMaterialRun >= 0 && group.nMaterialRuns >= 0 &&
+			static_cast< int64 >( group.firstMaterialRun ) + group.nMaterialRuns <= m_nMaterialRuns &&
+			isValidString( group.nameOffset, group.nameLength );
+	}
+	for( int r = 0; r < m_nMaterialRuns && isConsistent; ++r )
+	{
+		const MaterialRun& run = m_materialRuns[ r ];
+		isConsistent =
+			run.firstTriangle >= 0 && run.nTriangles >= 0 &&
+			static_cast< int64 >( run.firstTriangle ) + run.nTriangles <= m_nTriangles &&
+			isValidString( run.nameOffset, run.nameLength );
+	}
+	for( int m = 0; m < m_nMaterials && isConsistent; ++m )
+	{
+		const Material& material = m_materials[ m ];
+		isConsistent =
+			isValidString( material.nameOffset, material.nameLength ) &&
+			isValidString( material.ambientTextureOffset, material.ambientTextureLength ) &&
+			isValidString( material.diffuseTextureOffset, material.diffuseTextureLength );
+	}
+	isConsistent = isConsistent &&
+		indicesInRange( m_trianglePositionIndices, 0, m_nTriangles, 0, m_nPositions ) &&
+		( m_triangleTextureCoordinateIndices == nullptr ||
+			indicesInRange( m_triangleTextureCoordinateIndices, 0, m_nTriangles, -1, m_nTextureCoordinates ) ) &&
+		( m_triangleNormalIndices == nullptr ||
+			indicesInRange( m_triangleNormalIndices, 0, m_nTriangles, -1, m_nNormals ) );
+	for( int g = 0; g < m_nGroups && isConsistent; ++g )
+	{
+		const Group& group = m_groups[ g ];
+		isConsistent =
+			( group.hasTextureCoordinates == 0 || m_triangleTextureCoordinateIndices == nullptr ||
+				indicesInRange( m_triangleTextureCoordinateIndices, group.firstTriangle, group.nTriangles, 0, m_nTextureCoordinates ) ) &&
+			( group.hasNormals == 0 || m_triangleNormalIndices == nullptr ||
+				indicesInRange( m_triangleNormalIndices, group.firstTriangle, group.nTriangles, 0, m_nNormals ) );
+	}
+	if( !isConsistent )
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshCacheFile::close()
+{
+	m_file.close();
+	m_sourceInfo = SourceInfo();
+	m_nBlocks = 0;
+
+	m_positions = nullptr;
+	m_nPositions = 0;
+	m_textureCoordinates = nullptr;
+	m_nTextureCoordinates = 0;
+	m_normals = nullptr;
+	m_nNormals = 0;
+
+	m_trianglePositionIndices = nullptr;
+	m_triangleTextureCoordinateIndices = nullptr;
+	m_triangleNormalIndices = nullptr;
+	m_nTriangles = 0;
+
+	m_groups = nullptr;
+	m_nGroups = 0;
+	m_materialRuns = nullptr;
+	m_nMaterialRuns = 0;
+	m_materials = nullptr;
+	m_nMaterials = 0;
+
+	m_strings = nullptr;
+	m_nStringBytes = 0;
+}
+
+bool MeshCacheFile::isOpen() const
+{
+	return m_file.isOpen();
+}
+
+const MeshCacheFile::SourceInfo& MeshCacheFile::sourceInfo() const
+{
+	return m_sourceInfo;
+}
+
+int MeshCacheFile::numPositions() const
+{
+	return m_nPositions;
+}
+
+const Vector3f* MeshCacheFile::positions() const
+{
+	return m_positions;
+}
+
+int MeshCacheFile::numTextureCoordinates() const
+{
+	return m_nTextureCoordinates;
+}
+
+const Vector2f* MeshCacheFile::textureCoordinates() const
+{
+	return m_textureCoordinates;
+}
+
+int MeshCacheFile::numNormals() const
+{
+	return m_nNormals;
+}
+
+const Vector3f* MeshCacheFile::normals() const
+{
+	return m_normals;
+}
+
+int MeshCacheFile::numTriangles() const
+{
+	return m_nTriangles;
+}
+
+const Vector3i* MeshCacheFile::trianglePositionIndices() const
+{
+	return m_trianglePositionIndices;
+}
+
+const Vector3i* MeshCacheFile::triangleTextureCoordinateIndices() const
+{
+	return m_triangleTextureCoordinateIndices;
+}
+
+const Vector3i* MeshCacheFile::triangleNormalIndices() const
+{
+	return m_triangleNormalIndices;
+}
+
+int MeshCacheFile::numGroups() const
+{
+	return m_nGroups;
+}
+
+const MeshCacheFile::Group* MeshCacheFile::groups() const
+{
+	return m_groups;
+}
+
+QString MeshCacheFile::groupName( int groupIndex ) const
+{
+	return string( m_groups[ groupIndex ].nameOffset, m_groups[ groupIndex ].nameLength );
+}
+
+int MeshCacheFile::numMaterialRuns() const
+{
+	return m_nMaterialRuns;
+}
+
+const MeshCacheFile::MaterialRun* MeshCacheFile::materialRuns() const
+{
+	return m_materialRuns;
+}
+
+QString MeshCacheFile::materialRunName( int runIndex ) const
+{
+	return string( m_materialRuns[ runIndex ].nameOffset, m_materialRuns[ runIndex ].nameLength );
+}
+
+int MeshCacheFile::numMaterials() const
+{
+	return m_nMaterials;
+}
+
+const MeshCacheFile::Material* MeshCacheFile::materials() const
+{
+	return m_materials;
+}
+
+QString MeshCacheFile::materialName( int materialIndex ) const
+{
+	return string( m_materials[ materialIndex ].nameOffset, m_materials[ materialIndex ].nameLength );
+}
+
+std::shared_ptr< OBJData > MeshCacheFile::toOBJData() const
+{
+	std::shared_ptr< OBJData > pData( new OBJData );
+
+	pData->positions().assign( m_positions, m_positions + m_nPositions );
+	pData->textureCoordinates().assign( m_textureCoordinates, m_textureCoordinates + m_nTextureCoordinates );
+	pData->normals().assign( m_normals, m_normals + m_nNormals );
+
+	for( int m = 0; m < m_nMaterials; ++m )
+	{
+		const Material& material = m_materials[ m ];
+		OBJMaterial& objMaterial = pData->addMaterial( materialName( m ) );
+		objMaterial.setAmbientTexture( string( material.ambientTextureOffset, material.ambientTextureLength ) );
+		objMaterial.setDiffuseTexture( string( material.diffuseTextureOffset, material.diffuseTextureLength ) );
+		objMaterial.setIlluminationModel( static_cast< OBJMaterial::ILLUMINATION_MODEL >( material.illuminationModel ) );
+		objMaterial.setAlpha( material.alpha );
+		objMaterial.setShininess( material.shininess );
+		objMaterial.setAmbientColor( material.ambientColor );
+		objMaterial.setDiffuseColor( material.diffuseColor );
+		objMaterial.setSpecularColor( material.specularColor );
+	}
+
+	for( int g = 0; g < m_nGroups; ++g )
+	{
+		const Group& group = m_groups[ g ];
+		bool hasTextureCoordinates = ( group.hasTextureCoordinates != 0 ) && ( m_triangleTextureCoordinateIndices != nullptr );
+		bool hasNormals = ( group.hasNormals != 0 ) && ( m_triangleNormalIndices != nullptr );
+
+		OBJGroup& objGroup = pData->addGroup( groupName( g ) );
+		objGroup.setHasTextureCoordinates( hasTextureCoordinates );
+		objGroup.setHasNormals( hasNormals );
+		objGroup.reserveFaces( objGroup.numFaces() + group.nTriangles );
+
+		// a new group starts with the default material ""
+		QString currentMaterialName = "";
+		for( int r = group.firstMaterialRun; r < group.firstMaterialRun + group.nMaterialRuns; ++r )
+		{
+			const MaterialRun& run = m_materialRuns[ r ];
+			QString runMaterialName = materialRunName( r );
+			if( runMaterialName != currentMaterialName )
+			{
+				objGroup.addMaterial( runMaterialName );
+				currentMaterialName = runMaterialName;
+			}
+
+			for( int t = run.firstTriangle; t < run.firstTriangle + run.nTriangles; ++t )
+			{
+				OBJFace face( hasTextureCoordinates, hasNormals );
+				for( int i = 0; i < 3; ++i )
+				{
+					face.positionIndices().push_back( m_trianglePositionIndices[ t ][ i ] );
+					if( hasTextureCoordinates )
+					{
+						face.textureCoordinateIndices().push_back( m_triangleTextureCoordinateIndices[ t ][ i ] );
+					}
+					if( hasNormals )
+					{
+						face.normalIndices().push_back( m_triangleNormalIndices[ t ][ i ] );
+					}
+				}
+				objGroup.addFace( std::move( face ) );
+			}
+		}
+	}
+
+	return pData;
+}
+
+TriangleMesh MeshCacheFile::toTriangleMesh() const
+{
+	TriangleMesh mesh;
+	mesh.positions().assign( m_positions, m_positions + m_nPositions );
+	mesh.faces().assign( m_trianglePositionIndices, m_trianglePositionIndices + m_nTriangles );
+
+	// written from an OBJData, with normal indices:
+	// each position takes the normal of the last corner that references it,
+	// as in TriangleMesh::consolidateNormalsWithPositions()
+	bool anyNormals = false;
+	for( int g = 0; g < m_nGroups && m_triangleNormalIndices != nullptr; ++g )
+	{
+		anyNormals |= ( m_groups[ g ].hasNormals != 0 );
+	}
+
+	if( anyNormals )
+	{
+		std::vector< Vector3f >& normals = mesh.normals();
+		normals.assign( m_nPositions, Vector3f( 0, 0, 0 ) );
+		for( int g = 0; g < m_nGroups; ++g )
+		{
+			const Group& group = m_groups[ g ];
+			if( group.hasNormals == 0 )
+			{
+				continue;
+			}
+
+			for( int t = group.firstTriangle; t < group.firstTriangle + group.nTriangles; ++t )
+			{
+				for( int i = 0; i < 3; ++i )
+				{
+					normals[ m_trianglePositionIndices[ t ][ i ] ] = m_normals[ m_triangleNormalIndices[ t ][ i ] ];
+				}
+			}
+		}
+	}
+	else if( m_nNormals > 0 )
+	{
+		mesh.normals().assign( m_normals, m_normals + m_nNormals );
+	}
+	else
+	{
+		mesh.normals().assign( m_nPositions, Vector3f( 0, 0, 0 ) );
+	}
+
+	return mesh;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+const void* MeshCacheFile::findBlock( uint32 type, uint32 elementSize, int* pCount ) const
+{
+	const FileHeader* header = reinterpret_cast< const FileHeader* >( m_file.data() );
+	const BlockHeader* blockHeaders = reinterpret_cast< const BlockHeader* >( header + 1 );
+
+	for( int i = 0; i < m_nBlocks; ++i )
+	{
+		if( blockHeaders[ i ].type == type && blockHeaders[ i ].elementSize == elementSize )
+		{
+			*pCount = static_cast< int >( blockHeaders[ i ].count );
+			return m_file.data() + blockHeaders[ i ].offset;
+		}
+	}
+
+	*pCount = 0;
+	return nullptr;
+}
+
+bool MeshCacheFile::isValidString( uint32 offset, uint32 length ) const
+{
+	return ( length == 0 ) ||
+		( m_strings != nullptr && static_cast< int64 >( offset ) + length <= m_nStringBytes );
+}
+
+QString MeshCacheFile::string( uint32 offset, uint32 length ) const
+{
+	if( !isValidString( offset, length ) || length == 0 )
+	{
+		return "";
+	}
+	return QString::fromUtf8( m_strings + offset, length );
+}
+
+// static
+bool MeshCacheFile::openSideCar( QString objFilename, MeshCacheFile& cache )
+{
+	QString cacheFilename = objFilename + CACHE_EXTENSION;
+
+	QFileInfo sourceFileInfo( objFilename );
+	if( !( sourceFileInfo.exists() ) )
+	{
+		return false;
+	}
+	int64 sourceSize = sourceFileInfo.size();
+	int64 sourceModifiedTime = sourceFileInfo.lastModified().toMSecsSinceEpoch();
+
+	if( !( cache.open( cacheFilename ) ) || cache.sourceInfo().size != sourceSize )
+	{
+		cache.close();
+		return false;
+	}
+
+	// the cheap check is the modification time
+	// if only that differs (e.g., the file was copied), compare the contents
+	if( cache.sourceInfo().modifiedTime == sourceModifiedTime )
+	{
+		return true;
+	}
+
+	uint64 contentHash;
+	if( !( hashFile( objFilename, &contentHash ) ) || contentHash != cache.sourceInfo().contentHash )
+	{
+		cache.close();
+		return false;
+	}
+
+	cache.close();
+	updateSourceModifiedTime( cacheFilename, sourceModifiedTime );
+	return cache.open( cacheFilename );
+}
+
+// static
+std::shared_ptr< OBJData > MeshCacheFile::parseAndCache( QString objFilename, bool removeEmptyGroups )
+{
+	// stamp the cache with the source as it was before parsing,
+	// so that an edit during the parse makes it stale rather than fresh
+	SourceInfo sourceInfo;
+	bool hasSourceInfo = getSourceInfo( objFilename, &sourceInfo );
+
+	std::shared_ptr< OBJData > pData = OBJLoader::loadFile( objFilename, removeEmptyGroups );
+	if( pData.get() != nullptr && hasSourceInfo )
+	{
+		write( objFilename + CACHE_EXTENSION, pData, sourceInfo );
+	}
+	return pData;
+}
+
+// static
+bool MeshCacheFile::updateSourceModifiedTime( QString filename, int64 modifiedTime )
+{
+	QFile file( filename );
+	if( !( file.open( QIODevice::ReadWrite ) ) )
+	{
+		return false;
+	}
+
+	bool succeeded = file.seek( offsetof( FileHeader, sourceModifiedTime ) ) &&
+		( file.write( reinterpret_cast< const char* >( &modifiedTime ), sizeof( int64 ) ) == sizeof( int64 ) );
+	file.close();
+	return succeeded;
+}
@@ -0,0 +1,310 @@
+#include "io/NumberFormatter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+	// exact powers of 10 in double: 5^22 < 2^53
+	const double POWERS_OF_10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22
+	};
+	const int MAX_EXACT_POWER = 22;
+
+	// float needs at most 9 significant digits to round trip
+	const int MAX_SIGNIFICANT_DIGITS = 9;
+
+	// the range of decimal exponents (of the leading digit) where
+	// every candidate's power of 10 is exact
+	const int MIN_SHORTEST_EXPONENT = MAX_SIGNIFICANT_DIGITS - MAX_EXACT_POWER;
+	const int MAX_SHORTEST_EXPONENT = MAX_EXACT_POWER;
+
+	// x * 10^exponent for |exponent| <= MAX_EXACT_POWER, correctly rounded
+	inline double scaleByPowerOf10( double x, int exponent )
+	{
+		return( ( exponent < 0 ) ? ( x / POWERS_OF_10[ -exponent ] ) : ( x * POWERS_OF_10[ exponent ] ) );
+	}
+
+	// returns true if d lies exactly halfway between two consecutive floats
+	// (see NumberParser)
+	inline bool isFloatMidpoint( double d )
+	{
+		uint64 bits;
+		memcpy( &bits, &d, sizeof( double ) );
+
+		const uint64 lowMask = ( 1ULL << 29 ) - 1;
+		return( ( bits & lowMask ) == ( 1ULL << 28 ) );
+	}
+
+	// writes the sign of f, and "nan" or "inf" if it's not finite
+	// returns nullptr if f is finite
+	char* formatSpecial( float f, char* buffer, char** pAfterSign )
+	{
+		char* p = buffer;
+		if( f != f )
+		{
+			memcpy( p, "nan", 3 );
+			return p + 3;
+		}
+
+		// the sign bit, so that -0 keeps its sign
+		uint32 bits;
+		memcpy( &bits, &f, sizeof( float ) );
+		if( ( bits >> 31 ) != 0 )
+		{
+			*p = '-';
+			++p;
+		}
+
+		if( f == std::numeric_limits< float >::infinity() || f == -std::numeric_limits< float >::infinity() )
+		{
+			memcpy( p, "inf", 3 );
+			return p + 3;
+		}
+
+		*pAfterSign = p;
+		return nullptr;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+char* NumberFormatter::formatFloat( float f, char* buffer )
+{
+	char* p;
+	char* specialEnd = formatSpecial( f, buffer, &p );
+	if( specialEnd != nullptr )
+	{
+		return specialEnd;
+	}
+
+	float af = fabs( f );
+	if( af == 0 )
+	{
+		*p = '0';
+		return p + 1;
+	}
+
+	// the decimal exponent of the leading digit:
+	// estimated from the binary exponent and corrected by at most one
+	double x = af;
+	int binaryExponent;
+	frexp( x, &binaryExponent );
+	int leadingExponent = static_cast< int >( floor( ( binaryExponent - 1 ) * 0.30102999566398120 ) );
+
+	if( leadingExponent >= MIN_SHORTEST_EXPONENT - 1 && leadingExponent < MAX_SHORTEST_EXPONENT &&
+		scaleByPowerOf10( x, -( leadingExponent + 1 ) ) >= 1 )
+	{
+		++leadingExponent;
+	}
+
+	if( leadingExponent < MIN_SHORTEST_EXPONENT || leadingExponent >= MAX_SHORTEST_EXPONENT )
+	{
+		int length = sprintf( p, "%.9g", af );
+		return p + length;
+	}
+
+	// try 1, 2, ... significant digits: x ~= digits * 10^exponent
+	// the nearest candidate is checked first, then its other neighbor,
+	// which can be the only one inside the rounding interval when it's lopsided
+	// (at powers of 2)
+	uint32 digits = 0;
+	int exponent = 0;
+	bool found = false;
+	for( int nDigits = 1; nDigits <= MAX_SIGNIFICANT_DIGITS && !found; ++nDigits )
+	{
+		exponent = leadingExponent - nDigits + 1;
+		double scaled = scaleByPowerOf10( x, -exponent );
+		double nearest = floor( scaled + 0.5 );
+		digits = static_cast< uint32 >( nearest );
+		if( roundTrips( digits, exponent, af ) )
+		{
+			found = true;
+		}
+		else
+		{
+			digits = ( scaled > nearest ) ? ( digits + 1 ) : ( digits - 1 );
+			found = ( digits > 0 && roundTrips( digits, exponent, af ) );
+		}
+	}
+
+	if( !found )
+	{
+		int length = sprintf( p, "%.9g", af );
+		return p + length;
+	}
+
+	while( digits % 10 == 0 )
+	{
+		digits /= 10;
+		++exponent;
+	}
+
+	char text[ 16 ];
+	int nDigits = static_cast< int >( formatUnsigned( digits, text ) - text );
+
+	// the number of digits before the decimal point
+	int pointPosition = nDigits + exponent;
+
+	if( exponent >= 0 && pointPosition <= MAX_SIGNIFICANT_DIGITS )
+	{
+		// an integer: digits followed by zeros
+		memcpy( p, text, nDigits );
+		p += nDigits;
+		memset( p, '0', exponent );
+		return p + exponent;
+	}
+	else if( exponent < 0 && pointPosition > 0 )
+	{
+		memcpy( p, text, pointPosition );
+		p += pointPosition;
+		*p = '.';
+		++p;
+		memcpy( p, text + pointPosition, nDigits - pointPosition );
+		return p + nDigits - pointPosition;
+	}
+	else if( exponent < 0 && pointPosition > -5 )
+	{
+		// leading zeros after the decimal point
+		p[ 0 ] = '0';
+		p[ 1 ] = '.';
+		p += 2;
+		memset( p, '0', -pointPosition );
+		p += -pointPosition;
+		memcpy( p, text, nDigits );
+		return p + nDigits;
+	}
+	else
+	{
+		// d[.ddd]e[-]x
+		*p = text[ 0 ];
+		++p;
+		if( nDigits > 1 )
+		{
+			*p = '.';
+			++p;
+			memcpy( p, text + 1, nDigits - 1 );
+			p += nDigits - 1;
+		}
+		*p = 'e';
+		++p;
+		return formatInt( pointPosition - 1, p );
+	}
+}
+
+// static
+char* NumberFormatter::formatFloat( float f, int precision, char* buffer )
+{
+	char* p;
+	char* specialEnd = formatSpecial( f, buffer, &p );
+	if( specialEnd != nullptr )
+	{
+		return specialEnd;
+	}
+
+	if( precision < 0 )
+	{
+		precision = 0;
+	}
+	if( precision > MAX_SIGNIFICANT_DIGITS )
+	{
+		precision = MAX_SIGNIFICANT_DIGITS;
+	}
+
+	// fits in an int64 with every digit exact
+	double scaled = fabs( static_cast< double >( f ) ) * POWERS_OF_10[ precision ];
+	if( scaled >= 9e15 )
+	{
+		int length = sprintf( p, "%.*f", precision, fabs( f ) );
+		return p + length;
+	}
+
+	uint64 rounded = static_cast< uint64 >( floor( scaled + 0.5 ) );
+	uint64 unit = static_cast< uint64 >( POWERS_OF_10[ precision ] );
+	p = formatUnsigned( rounded / unit, p );
+
+	if( precision > 0 )
+	{
+		*p = '.';
+		++p;
+
+		// the fraction, zero padded to precision digits
+		uint64 fraction = rounded % unit;
+		for( int i = precision - 1; i >= 0; --i )
+		{
+			p[ i ] = static_cast< char >( '0' + fraction % 10 );
+			fraction /= 10;
+		}
+		p += precision;
+	}
+	return p;
+}
+
+// static
+char* NumberFormatter::formatInt( int i, char* buffer )
+{
+	// negate in 64 bits so that INT_MIN is representable
+	int64 value = i;
+	if( value < 0 )
+	{
+		*buffer = '-';
+		++buffer;
+		value = -value;
+	}
+	return formatUnsigned( static_cast< uint64 >( value ), buffer );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+char* NumberFormatter::formatUnsigned( uint64 value, char* buffer )
+{
+	// digits come out least significant first
+	char reversed[ 20 ];
+	int nDigits = 0;
+	do
+	{
+		reversed[ nDigits ] = static_cast< char >( '0' + value % 10 );
+		++nDigits;
+		value /= 10;
+	}
+	while( value > 0 );
+
+	for( int i = nDigits - 1; i >= 0; --i )
+	{
+		*buffer = reversed[ i ];
+		++buffer;
+	}
+	return buffer;
+}
+
+// static
+bool NumberFormatter::roundTrips( uint32 digits, int exponent, float f )
+{
+	if( exponent < -MAX_EXACT_POWER || exponent > MAX_EXACT_POWER )
+	{
+		return false;
+	}
+
+	// digits and the power of 10 are exact doubles:
+	// one multiply or divide is correctly rounded to double,
+	// and rounding that to float is correct unless it landed on a float midpoint
+	// (an integer product below 2^53 is exact, so a midpoint is genuine)
+	double d = scaleByPowerOf10( static_cast< double >( digits ), exponent );
+	bool isExact = ( exponent >= 0 && d < 9007199254740992.0 );
+	if( !isExact && isFloatMidpoint( d ) )
+	{
+		return false;
+	}
+	return( static_cast< float >( d ) == f );
+}
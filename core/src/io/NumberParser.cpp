@@ -0,0 +1,337 @@
+#include "io/NumberParser.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <locale.h>
+
+#include "common/BasicTypes.h"
+
+namespace
+{
+	// exact powers of 10 in float: 10^10 = 2^10 * 5^10 and 5^10 < 2^24
+	const float POWERS_OF_10_FLOAT[] =
+	{
+		1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+	};
+
+	// exact powers of 10 in double: 5^22 < 2^53
+	const double POWERS_OF_10_DOUBLE[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22
+	};
+
+	// significant digits that always fit in a uint64 mantissa
+	const int MAX_MANTISSA_DIGITS = 19;
+
+	// the slow path parses with the "C" locale, whatever the current one is:
+	// files always use '.' as the decimal point
+	// created once, before any parsing threads start
+	const _locale_t C_LOCALE = _create_locale( LC_NUMERIC, "C" );
+
+	inline bool isDigit( char c )
+	{
+		return( c >= '0' && c <= '9' );
+	}
+
+	inline char toLower( char c )
+	{
+		return( ( c >= 'A' && c <= 'Z' ) ? ( c - 'A' + 'a' ) : c );
+	}
+
+	// returns true if [begin, end) starts with the lowercase word
+	// (case insensitive)
+	bool startsWith( const char* begin, const char* end, const char* word )
+	{
+		int length = static_cast< int >( strlen( word ) );
+		if( end - begin < length )
+		{
+			return false;
+		}
+		for( int i = 0; i < length; ++i )
+		{
+			if( toLower( begin[ i ] ) != word[ i ] )
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// returns true if d lies exactly halfway between two consecutive floats
+	// (only valid for d in the normal float range)
+	// in that case, rounding d to float may round differently than the
+	// original decimal number would have
+	inline bool isFloatMidpoint( double d )
+	{
+		uint64 bits;
+		memcpy( &bits, &d, sizeof( double ) );
+
+		// double has 29 more mantissa bits than float:
+		// the midpoint has exactly the top one of them set
+		const uint64 lowMask = ( 1ULL << 29 ) - 1;
+		return( ( bits & lowMask ) == ( 1ULL << 28 ) );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+const char* NumberParser::parseFloat( const char* begin, const char* end, float* value )
+{
+	const char* p = begin;
+
+	bool negative = false;
+	if( p < end && ( *p == '-' || *p == '+' ) )
+	{
+		negative = ( *p == '-' );
+		++p;
+	}
+
+	// accumulate up to 19 significant digits into mantissa
+	// and track the decimal exponent
+	uint64 mantissa = 0;
+	int nMantissaDigits = 0;
+	int exponent = 0;
+	bool hasDigits = false;
+	bool truncated = false;
+
+	while( p < end && isDigit( *p ) )
+	{
+		int digit = *p - '0';
+		hasDigits = true;
+		if( nMantissaDigits < MAX_MANTISSA_DIGITS )
+		{
+			mantissa = 10 * mantissa + digit;
+			if( mantissa > 0 )
+			{
+				++nMantissaDigits;
+			}
+		}
+		else
+		{
+			++exponent;
+			truncated |= ( digit != 0 );
+		}
+		++p;
+	}
+
+	if( p < end && *p == '.' )
+	{
+		++p;
+		while( p < end && isDigit( *p ) )
+		{
+			int digit = *p - '0';
+			hasDigits = true;
+			if( nMantissaDigits < MAX_MANTISSA_DIGITS )
+			{
+				mantissa = 10 * mantissa + digit;
+				if( mantissa > 0 )
+				{
+					++nMantissaDigits;
+				}
+				--exponent;
+			}
+			else
+			{
+				truncated |= ( digit != 0 );
+			}
+			++p;
+		}
+	}
+
+	if( !hasDigits )
+	{
+		if( startsWith( p, end, "inf" ) )
+		{
+			p += startsWith( p, end, "infinity" ) ? 8 : 3;
+			*value = negative ? -std::numeric_limits< float >::infinity() : std::numeric_limits< float >::infinity();
+			return p;
+		}
+		if( startsWith( p, end, "nan" ) )
+		{
+			*value = std::numeric_limits< float >::quiet_NaN();
+			return p + 3;
+		}
+		return nullptr;
+	}
+
+	// the exponent is only consumed if it has digits
+	if( p < end && ( *p == 'e' || *p == 'E' ) )
+	{
+		const char* q = p + 1;
+		bool negativeExponent = false;
+		if( q < end && ( *q == '-' || *q == '+' ) )
+		{
+			negativeExponent = ( *q == '-' );
+			++q;
+		}
+
+		if( q < end && isDigit( *q ) )
+		{
+			int explicitExponent = 0;
+			while( q < end && isDigit( *q ) )
+			{
+				// saturate: anything this large over- or underflows anyway
+				if( explicitExponent < 100000 )
+				{
+					explicitExponent = 10 * explicitExponent + ( *q - '0' );
+				}
+				++q;
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = q;
+		}
+	}
+
+	if( mantissa == 0 && !truncated )
+	{
+		*value = negative ? -0.f : 0.f;
+		return p;
+	}
+
+	if( !truncated )
+	{
+		// the mantissa and the power of 10 are both exact floats:
+		// one multiply or divide is correctly rounded
+		if( mantissa <= ( 1ULL << 24 ) && exponent >= -10 && exponent <= 10 )
+		{
+			float f = static_cast< float >( mantissa );
+			f = ( exponent < 0 ) ? ( f / POWERS_OF_10_FLOAT[ -exponent ] ) : ( f * POWERS_OF_10_FLOAT[ exponent ] );
+			*value = negative ? -f : f;
+			return p;
+		}
+
+		// the same in double, which is correctly rounded to double
+		// rounding that to float is also correct unless it landed on a float midpoint
+		if( mantissa <= ( 1ULL << 53 ) && exponent >= -22 && exponent <= 22 )
+		{
+			double d = static_cast< double >( mantissa );
+			d = ( exponent < 0 ) ? ( d / POWERS_OF_10_DOUBLE[ -exponent ] ) : ( d * POWERS_OF_10_DOUBLE[ exponent ] );
+			if( !isFloatMidpoint( d ) )
+			{
+				float f = static_cast< float >( d );
+				*value = negative ? -f : f;
+				return p;
+			}
+		}
+	}
+
+	if( !parseFloatSlow( begin, p, value ) )
+	{
+		return nullptr;
+	}
+	return p;
+}
+
+// static
+const char* NumberParser::parseInt( const char* begin, const char* end, int* value )
+{
+	const char* p = begin;
+
+	bool negative = false;
+	if( p < end && ( *p == '-' || *p == '+' ) )
+	{
+		negative = ( *p == '-' );
+		++p;
+	}
+
+	if( p == end || !isDigit( *p ) )
+	{
+		return nullptr;
+	}
+
+	// accumulate negatively so that INT_MIN is representable
+	int64 n = 0;
+	while( p < end && isDigit( *p ) )
+	{
+		n = 10 * n + ( *p - '0' );
+		if( n > static_cast< int64 >( INT_MAX ) + 1 )
+		{
+			return nullptr;
+		}
+		++p;
+	}
+
+	if( negative )
+	{
+		n = -n;
+	}
+	else if( n > INT_MAX )
+	{
+		return nullptr;
+	}
+
+	*value = static_cast< int >( n );
+	return p;
+}
+
+// static
+bool NumberParser::isSpace( char c )
+{
+	return( c == ' ' || c == '\t' || c == '\r' );
+}
+
+// static
+const char* NumberParser::skipSpaces( const char* begin, const char* end )
+{
+	while( begin < end && isSpace( *begin ) )
+	{
+		++begin;
+	}
+	return begin;
+}
+
+// static
+const char* NumberParser::skipToSpace( const char* begin, const char* end )
+{
+	while( begin < end && !isSpace( *begin ) && *begin != '\n' )
+	{
+		++begin;
+	}
+	return begin;
+}
+
+// static
+const char* NumberParser::findLineEnd( const char* begin, const char* end )
+{
+	const void* lineEnd = memchr( begin, '\n', end - begin );
+	return ( lineEnd != nullptr ) ? reinterpret_cast< const char* >( lineEnd ) : end;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool NumberParser::parseFloatSlow( const char* begin, const char* end, float* value )
+{
+	// _strtof_l() needs a '\0' terminated copy
+	// anything longer than this is not a reasonable number
+	const int MAX_LENGTH = 256;
+	char buffer[ MAX_LENGTH ];
+
+	int length = static_cast< int >( end - begin );
+	if( length >= MAX_LENGTH )
+	{
+		return false;
+	}
+	memcpy( buffer, begin, length );
+	buffer[ length ] = '\0';
+
+	// rounds straight to float: going through double would round twice
+	char* parseEnd;
+	float f = _strtof_l( buffer, &parseEnd, C_LOCALE );
+	if( parseEnd == buffer )
+	{
+		return false;
+	}
+
+	*value = f;
+	return true;
+}
@@ -1,5 +1,7 @@
 #include "io/OBJData.h"
 
+#include "io/OBJWriter.h"
+
 //////////////////////////////////////////////////////////////////////////
 // Public
 //////////////////////////////////////////////////////////////////////////
@@ -42,25 +44,25 @@ std::vector< OBJGroup >& OBJData::groups()
 
 OBJGroup& OBJData::addGroup( QString name )
 {
-	if( !( m_groupsByName.contains( name ) ) )
+	if( !( m_groupIndicesByName.contains( name ) ) )
 	{
+		m_groupIndicesByName.insert( name, numGroups() );
 		m_groups.push_back( OBJGroup( name ) );
-		m_groupsByName.insert( name, &( m_groups.back() ) );
 	}
 
-	return m_groups.back();
+	return m_groups[ m_groupIndicesByName[ name ] ];
 }
 
 bool OBJData::containsGroup( QString name )
 {
-	return m_groupsByName.contains( name );
+	return m_groupIndicesByName.contains( name );
 }
 
 OBJGroup* OBJData::getGroupByName( QString name )
 {
 	if( containsGroup( name ) )
 	{
-		return m_groupsByName[ name ];
+		return &( m_groups[ m_groupIndicesByName[ name ] ] );
 	}
 	else
 	{
@@ -82,23 +84,23 @@ OBJMaterial& OBJData::addMaterial( QString name )
 {
 	if( !containsMaterial( name ) )
 	{
+		m_materialIndicesByName.insert( name, numMaterials() );
 		m_materials.push_back( OBJMaterial( name ) );
-		m_materialsByName.insert( name, &( m_materials.back() ) );
 	}
 
-	return m_materials.back();
+	return m_materials[ m_materialIndicesByName[ name ] ];
 }
 
 bool OBJData::containsMaterial( QString name )
 {
-	return m_materialsByName.contains( name );
+	return m_materialIndicesByName.contains( name );
 }
 
 OBJMaterial* OBJData::getMaterialByName( QString name )
 {
 	if( containsMaterial( name ) )
 	{
-		return m_materialsByName[ name ];
+		return &( m_materials[ m_materialIndicesByName[ name ] ] );
 	}
 	else
 	{
@@ -108,110 +110,28 @@ OBJMaterial* OBJData::getMaterialByName( QString name )
 
 void OBJData::removeEmptyGroups()
 {
-	std::vector< int > removeList;
-
+	std::vector< OBJGroup > nonEmptyGroups;
 	for( int i = 0; i < numGroups(); ++i )
 	{
-		if( m_groups[i].numFaces() == 0 )
+		if( m_groups[ i ].numFaces() > 0 )
 		{
-			removeList.push_back( i );
+			nonEmptyGroups.push_back( m_groups[ i ] );
 		}
 	}
 
-	// count how many were shifted over
-	int nRemoved = 0;
-	for( int i = 0; i < static_cast< int >( removeList.size() ); ++i )
-	{
-		int groupIndex = removeList[i];
-		int offsetGroupIndex = groupIndex - nRemoved;
-		
-		QString groupName = m_groups[i].name();
-		m_groups.erase( m_groups.begin() + offsetGroupIndex );
-		m_groupsByName.remove( groupName );
-	}
-
 	// stuff moved in memory, re-index
-	if( removeList.size() > 0 )
+	if( nonEmptyGroups.size() != m_groups.size() )
 	{
+		m_groups.swap( nonEmptyGroups );
+		m_groupIndicesByName.clear();
 		for( int i = 0; i < numGroups(); ++i )
 		{
-			QString groupName = m_groups[i].name();
-			m_groupsByName[ groupName ] = &( m_groups[i] );
+			m_groupIndicesByName.insert( m_groups[ i ].name(), i );
 		}
 	}
 }
 
-bool OBJData::save( QString filename )
+bool OBJData::save( QString filename, int precision )
 {
-	FILE* fp = fopen( filename.toAscii().constData(), "w" );
-
-	for( int i = 0; i < m_positions.size(); ++i )
-	{
-		Vector3f v = m_positions[ i ];
-		fprintf( fp, "v %f %f %f\n", v.x, v.y, v.z );
-	}
-
-	for( int i = 0; i < m_textureCoordinates.size(); ++i )
-	{
-		Vector2f t = m_textureCoordinates[ i ];
-		fprintf( fp, "vt %f %f\n", t.x, t.y );
-	}
-
-	for( int i = 0; i < m_normals.size(); ++i )
-	{
-		Vector3f n = m_normals[ i ];
-		fprintf( fp, "vn %f %f %f\n", n.x, n.y, n.z );
-	}
-
-	for( int g = 0; g < numGroups(); ++g )
-	{
-		OBJGroup& group = m_groups[ g ];
-		const auto& groupFaces = group.faces();
-
-		for( int m = 0; m < group.numMaterials(); ++m )
-		{
-			const auto& faceIndices = group.facesForMaterial( m );
-			for( int i = 0; i < static_cast< int >( faceIndices.size() ); ++i )
-			{
-				const OBJFace& face = groupFaces[ faceIndices[ i ] ];
-
-				const auto& pis = face.positionIndices();
-				const auto& tis = face.textureCoordinateIndices();
-				const auto& nis = face.normalIndices();
-
-				int nIndices = static_cast< int >( pis.size() );
-				fprintf( fp, "f" );
-				for( int j = 0; j < nIndices; ++j )
-				{
-					int pi = pis[ j ] + 1;
-					fprintf( fp, " %d", pi );
-
-					if( group.hasTextureCoordinates() )
-					{
-						int ti = tis[ j ] + 1;
-						if( group.hasNormals() )
-						{
-							int ni = nis[ j ] + 1;
-							fprintf( fp, "/%d/%d", ti, ni );
-						}
-						else
-						{
-							fprintf( fp, "/%d", ti );
-						}
-					}					
-					else if( group.hasNormals() )
-					{
-						int ni = nis[ j ] + 1;
-						fprintf( fp, "//%d", ni );
-					}
-				}
-				fprintf( fp, "\n" );
-			}
-		}		
-	}
-
-	fclose( fp );
-
-	// TODO: handle errors in writing
-	return true;
+	return OBJWriter::write( filename, *this, precision );
 }
@@ -22,6 +22,56 @@ OBJFace::OBJFace( bool hasTextureCoordinates, bool hasNormals ) :
 
 }
 
+OBJFace::OBJFace( const OBJFace& copy ) :
+
+	m_positionIndices( copy.m_positionIndices ),
+	m_textureCoordinateIndices( copy.m_textureCoordinateIndices ),
+	m_normalIndices( copy.m_normalIndices ),
+	m_bHasTextureCoordinates( copy.m_bHasTextureCoordinates ),
+	m_bHasNormals( copy.m_bHasNormals )
+
+{
+
+}
+
+OBJFace::OBJFace( OBJFace&& move ) :
+
+	m_positionIndices( std::move( move.m_positionIndices ) ),
+	m_textureCoordinateIndices( std::move( move.m_textureCoordinateIndices ) ),
+	m_normalIndices( std::move( move.m_normalIndices ) ),
+	m_bHasTextureCoordinates( move.m_bHasTextureCoordinates ),
+	m_bHasNormals( move.m_bHasNormals )
+
+{
+
+}
+
+OBJFace& OBJFace::operator = ( const OBJFace& copy )
+{
+	if( this != &copy )
+	{
+		m_positionIndices = copy.m_positionIndices;
+		m_textureCoordinateIndices = copy.m_textureCoordinateIndices;
+		m_normalIndices = copy.m_normalIndices;
+		m_bHasTextureCoordinates = copy.m_bHasTextureCoordinates;
+		m_bHasNormals = copy.m_bHasNormals;
+	}
+	return *this;
+}
+
+OBJFace& OBJFace::operator = ( OBJFace&& move )
+{
+	if( this != &move )
+	{
+		m_positionIndices = std::move( move.m_positionIndices );
+		m_textureCoordinateIndices = std::move( move.m_textureCoordinateIndices );
+		m_normalIndices = std::move( move.m_normalIndices );
+		m_bHasTextureCoordinates = move.m_bHasTextureCoordinates;
+		m_bHasNormals = move.m_bHasNormals;
+	}
+	return *this;
+}
+
 bool OBJFace::hasTextureCoordinates() const
 {
 	return m_bHasTextureCoordinates;
@@ -10,7 +10,8 @@ OBJGroup::OBJGroup( QString name ) :
 
 	m_name( name ),
 	m_hasNormals( true ),
-	m_hasTextureCoordinates( false )
+	m_hasTextureCoordinates( false ),
+	m_currentFaceList( -1 )
 
 {
 	addMaterial( "" );
@@ -59,9 +60,18 @@ std::vector< OBJFace >& OBJGroup::faces()
 void OBJGroup::addFace( const OBJFace& face )
 {
 	m_faces.push_back( face );
+	m_faceLists[ m_currentFaceList ].push_back( numFaces() - 1 );
+}
 
-	QString lastMaterial = m_materialNames.back();
-	m_facesByMaterial[ lastMaterial ].push_back( numFaces() - 1 );
+void OBJGroup::addFace( OBJFace&& face )
+{
+	m_faces.push_back( std::move( face ) );
+	m_faceLists[ m_currentFaceList ].push_back( numFaces() - 1 );
+}
+
+void OBJGroup::reserveFaces( int nFaces )
+{
+	m_faces.reserve( nFaces );
 }
 
 int OBJGroup::numMaterials() const
@@ -83,17 +93,22 @@ void OBJGroup::addMaterial( QString materialName )
 {
 	m_materialNames.push_back( materialName );
 
-	if( !( m_facesByMaterial.contains( materialName ) ) )
+	if( m_faceListIndexByMaterial.contains( materialName ) )
+	{
+		m_currentFaceList = m_faceListIndexByMaterial[ materialName ];
+	}
+	else
 	{
-		m_facesByMaterial.insert( materialName, std::vector< int >() );
+		m_currentFaceList = static_cast< int >( m_faceLists.size() );
+		m_faceListIndexByMaterial.insert( materialName, m_currentFaceList );
+		m_faceLists.push_back( std::vector< int >() );
 	}
 }
 
 std::vector< int >& OBJGroup::facesForMaterial( QString materialName )
 {
-	assert( m_facesByMaterial.contains( materialName ) );
-	std::vector< int >& output = m_facesByMaterial[ materialName ];
-	return output;
+	assert( m_faceListIndexByMaterial.contains( materialName ) );
+	return m_faceLists[ m_faceListIndexByMaterial[ materialName ] ];
 }
 
 std::vector< int >& OBJGroup::facesForMaterial( int materialIndex )
@@ -1,12 +1,16 @@
 #include "io/OBJLoader.h"
 
+#include <cstring>
+
+#include <ppl.h>
+
 #include <QDir>
-#include <QFile>
 #include <QFileInfo>
 #include <QStringList>
-#include <QTextStream>
 //#include <QRegExp>
 
+#include "io/MappedFile.h"
+#include "io/NumberParser.h"
 #include "io/OBJData.h"
 #include "io/OBJGroup.h"
 
@@ -24,8 +28,7 @@ std::shared_ptr< OBJData > OBJLoader::loadFile( QString objFilename, bool remove
 		// return null
 		pOBJData.reset();
 	}
-
-	if( removeEmptyGroups )
+	else if( removeEmptyGroups )
 	{
 		pOBJData->removeEmptyGroups();
 	}
@@ -38,100 +41,126 @@ std::shared_ptr< OBJData > OBJLoader::loadFile( QString objFilename, bool remove
 // Private
 //////////////////////////////////////////////////////////////////////////
 
+struct OBJLoader::ElementCounts
+{
+	ElementCounts();
+
+	int nLines;
+	int nPositions;
+	int nTextureCoordinates;
+	int nNormals;
+};
+
+OBJLoader::ElementCounts::ElementCounts() :
+
+	nLines( 0 ),
+	nPositions( 0 ),
+	nTextureCoordinates( 0 ),
+	nNormals( 0 )
+
+{
+
+}
+
+// a group or material change, or a run of faces,
+// recorded by a chunk to be replayed in order when stitching
+struct OBJLoader::ChunkCommand
+{
+	enum Type
+	{
+		GROUP,
+		MATERIAL,
+		MATERIAL_LIBRARY,
+		FACES
+	};
+
+	ChunkCommand( Type type, int lineNumber, QString name );
+
+	Type type;
+	int lineNumber;
+	QString name;
+
+	// FACES only: the number of consecutive faces in the chunk
+	int nFaces;
+};
+
+OBJLoader::ChunkCommand::ChunkCommand( Type type, int lineNumber, QString name ) :
+
+	type( type ),
+	lineNumber( lineNumber ),
+	name( name ),
+	nFaces( 0 )
+
+{
+
+}
+
+struct OBJLoader::Chunk
+{
+	// the characters [begin, end) of this chunk
+	const char* begin;
+	const char* end;
+
+	// the number of lines and elements in this chunk
+	ElementCounts counts;
+
+	// the number of lines and elements before this chunk
+	ElementCounts offsets;
+
+	std::vector< ChunkCommand > commands;
+	std::vector< OBJFace > faces;
+};
+
+namespace
+{
+	// a chunk is at least this many bytes (rounded up to the next line)
+	const int64 CHUNK_SIZE = 4 * 1024 * 1024;
+}
+
 // static
 bool OBJLoader::parseOBJ( QString objFilename, std::shared_ptr< OBJData > pOBJData )
 {
-	// attempt to read the file
-	QFile inputFile( objFilename );
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
+	// attempt to map the file
+	MappedFile inputFile( objFilename, MappedFile::SEQUENTIAL );
+	if( !( inputFile.isOpen() ) )
 	{
 		return false;
 	}
 
-	int lineNumber = 0;
-	QString line = "";	
-	OBJGroup* pCurrentGroup = &( pOBJData->addGroup( "" ) ); // default group name is the empty string
-	pOBJData->addMaterial( "" ); // default material name is the empty string
+	const char* begin = inputFile.charData();
+	const char* end = begin + inputFile.size();
 
-	QTextStream inputTextStream( &inputFile );
+	std::vector< Chunk > chunks;
+	splitIntoChunks( begin, end, CHUNK_SIZE, chunks );
+	int nChunks = static_cast< int >( chunks.size() );
 
-	QString delim( " " );
-
-	line = inputTextStream.readLine();
-	while( !( line.isNull() ) )
+	Concurrency::parallel_for( 0, nChunks, [&]( int i )
 	{
-		if( line != "" )
-		{
-			QStringList tokens = line.split( delim, QString::SkipEmptyParts );
-
-			if( tokens.size() > 0 )
-			{
-				QString commandToken = tokens[ 0 ];
-
-				if( commandToken == "mtllib" )
-				{
-					QString mtlRelativeFilename = tokens[ 1 ];
-					QFileInfo objFileInfo( objFilename );
-					QDir objDir = objFileInfo.dir();
-					QString mtlAbsoluteFilename = objDir.absolutePath() + "/" + mtlRelativeFilename;
-					parseMTL( mtlAbsoluteFilename, pOBJData );
-				}
-				else if( commandToken == "g" )
-				{
-					QString newGroupName;
+		countElements( chunks[ i ] );
+	} );
 
-					if( tokens.size() < 2 )
-					{
-						fprintf( stderr, "Warning: group has no name, defaulting to ""\nline: %d\n%s",
-							lineNumber, qPrintable( line ) );
+	// exclusive prefix sum of the counts
+	ElementCounts total;
+	for( int i = 0; i < nChunks; ++i )
+	{
+		chunks[ i ].offsets = total;
+		total.nLines += chunks[ i ].counts.nLines;
+		total.nPositions += chunks[ i ].counts.nPositions;
+		total.nTextureCoordinates += chunks[ i ].counts.nTextureCoordinates;
+		total.nNormals += chunks[ i ].counts.nNormals;
+	}
 
-						newGroupName = "";
-					}
-					else
-					{
-						newGroupName = line.mid( 2 );
-					}
+	pOBJData->positions().resize( total.nPositions );
+	pOBJData->textureCoordinates().resize( total.nTextureCoordinates );
+	pOBJData->normals().resize( total.nNormals );
 
-					if( newGroupName != pCurrentGroup->name() )
-					{
-						if( pOBJData->containsGroup( newGroupName ) )
-						{
-							pCurrentGroup = pOBJData->getGroupByName( newGroupName );
-						}
-						else
-						{
-							pCurrentGroup = &( pOBJData->addGroup( newGroupName ) );
-						}
-					}
-				}
-				else if( commandToken == "v" )
-				{
-					// TODO: error checking on all of these and tear down pOBJData
-					OBJLoader::parsePosition( lineNumber, line, tokens, pOBJData );
-				}
-				else if( commandToken == "vt" )
-				{
-					OBJLoader::parseTextureCoordinate( lineNumber, line, tokens, pOBJData );
-				}
-				else if( commandToken == "vn" )
-				{
-					OBJLoader::parseNormal( lineNumber, line, tokens, pOBJData );
-				}
-				else if( commandToken == "usemtl" )
-				{
-					pCurrentGroup->addMaterial( tokens[ 1 ] );
-				}
-				else if( commandToken == "f" || commandToken == "fo" )
-				{
-					OBJLoader::parseFace( lineNumber, line,
-						tokens, pCurrentGroup );
-				}
-			}
-		}
+	OBJData* pData = pOBJData.get();
+	Concurrency::parallel_for( 0, nChunks, [&]( int i )
+	{
+		parseChunk( chunks[ i ], pData );
+	} );
 
-		++lineNumber;
-		line = inputTextStream.readLine();
-	}	
+	stitchChunks( objFilename, chunks, pOBJData );
 
 	return true;
 }
@@ -139,23 +168,21 @@ bool OBJLoader::parseOBJ( QString objFilename, std::shared_ptr< OBJData > pOBJDa
 // static
 bool OBJLoader::parseMTL( QString mtlFilename, std::shared_ptr< OBJData > pOBJData )
 {
-	// attempt to read the file
-	QFile inputFile( mtlFilename );
-	if( !( inputFile.open( QIODevice::ReadOnly ) ) )
+	// attempt to map the file
+	MappedFile inputFile( mtlFilename, MappedFile::SEQUENTIAL );
+	if( !( inputFile.isOpen() ) )
 	{
 		return false;
 	}
 
-	int lineNumber = 0;
-	QString line;
 	OBJMaterial* pCurrentMaterial = pOBJData->getMaterialByName( "" );
 
 	QRegExp splitExp( "\\s+" );
 
-	QTextStream inputTextStream( &inputFile );
-	line = inputTextStream.readLine();
-	while( !( line.isNull() ) )
+	for( MappedFile::LineIterator itr( inputFile ); !itr.atEnd(); itr.next() )
 	{
+		int lineNumber = itr.lineNumber();
+		QString line = itr.line().toString();
 		if( line != "" )
 		{
 			QStringList tokens = line.split( splitExp, QString::SkipEmptyParts );
@@ -248,362 +275,452 @@ bool OBJLoader::parseMTL( QString mtlFilename, std::shared_ptr< OBJData > pOBJDa
 				}
 			}
 		}
-
-		++lineNumber;
-		line = inputTextStream.readLine();
 	}
 
 	return true;
 }
 
+
 // static
-bool OBJLoader::parsePosition( int lineNumber, QString line,
-							  QStringList tokens, std::shared_ptr< OBJData > pOBJData )
+void OBJLoader::splitIntoChunks( const char* begin, const char* end, int64 chunkSize,
+	std::vector< Chunk >& chunks )
 {
-	if( tokens.size() < 4 )
-	{
-		fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-			lineNumber, qPrintable( line ) );
-		return false;
-	}
-	else
+	const char* chunkBegin = begin;
+	while( chunkBegin < end )
 	{
-		bool succeeded;
-
-		float x = tokens[ 1 ].toFloat( &succeeded );
-		if( !succeeded )
-		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
-		}
-
-		float y = tokens[ 2 ].toFloat( &succeeded );
-		if( !succeeded )
+		const char* chunkEnd = end;
+		if( end - chunkBegin > chunkSize )
 		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
-		}
-
-		float z = tokens[ 3 ].toFloat( &succeeded );
-		if( !succeeded )
-		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
+			chunkEnd = NumberParser::findLineEnd( chunkBegin + chunkSize, end );
+			if( chunkEnd < end )
+			{
+				++chunkEnd;
+			}
 		}
 
-		pOBJData->positions().push_back( Vector3f( x, y, z ) );
+		chunks.push_back( Chunk() );
+		chunks.back().begin = chunkBegin;
+		chunks.back().end = chunkEnd;
 
-		return true;
+		chunkBegin = chunkEnd;
 	}
 }
 
 // static
-bool OBJLoader::parseTextureCoordinate( int lineNumber, QString line,
-									   QStringList tokens, std::shared_ptr< OBJData > pOBJData )
+void OBJLoader::countElements( Chunk& chunk )
 {
-	if( tokens.size() < 3 )
-	{
-		fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-			lineNumber, qPrintable( line ) );
-		return false;
-	}
-	else
+	ElementCounts& counts = chunk.counts;
+
+	const char* lineBegin = chunk.begin;
+	while( lineBegin < chunk.end )
 	{
-		bool succeeded;
+		const char* lineEnd = NumberParser::findLineEnd( lineBegin, chunk.end );
+		const char* commandBegin = NumberParser::skipSpaces( lineBegin, lineEnd );
+		const char* commandEnd = NumberParser::skipToSpace( commandBegin, lineEnd );
 
-		float s = tokens[ 1 ].toFloat( &succeeded );
-		if( !succeeded )
+		if( isCommand( commandBegin, commandEnd, "v" ) )
 		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
+			++( counts.nPositions );
 		}
-
-		float t = tokens[ 2 ].toFloat( &succeeded );
-		if( !succeeded )
+		else if( isCommand( commandBegin, commandEnd, "vt" ) )
 		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
-		}		
-
-		pOBJData->textureCoordinates().push_back( Vector2f( s, t ) );
+			++( counts.nTextureCoordinates );
+		}
+		else if( isCommand( commandBegin, commandEnd, "vn" ) )
+		{
+			++( counts.nNormals );
+		}
 
-		return true;
+		++( counts.nLines );
+		lineBegin = lineEnd + 1;
 	}
 }
 
 // static
-bool OBJLoader::parseNormal( int lineNumber, QString line,
-							QStringList tokens, std::shared_ptr< OBJData > pOBJData )
+void OBJLoader::parseChunk( Chunk& chunk, OBJData* pOBJData )
 {
-	if( tokens.size() < 4 )
-	{
-		fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-			lineNumber, qPrintable( line ) );
-		return false;
-	}
-	else
+	Vector3f* positions = pOBJData->positions().data();
+	Vector2f* textureCoordinates = pOBJData->textureCoordinates().data();
+	Vector3f* normals = pOBJData->normals().data();
+
+	// global counts so far
+	int lineNumber = chunk.offsets.nLines;
+	int nPositions = chunk.offsets.nPositions;
+	int nTextureCoordinates = chunk.offsets.nTextureCoordinates;
+	int nNormals = chunk.offsets.nNormals;
+
+	const char* lineBegin = chunk.begin;
+	while( lineBegin < chunk.end )
 	{
-		bool succeeded;
+		const char* lineEnd = NumberParser::findLineEnd( lineBegin, chunk.end );
+
+		const char* commandBegin = NumberParser::skipSpaces( lineBegin, lineEnd );
+		const char* commandEnd = NumberParser::skipToSpace( commandBegin, lineEnd );
+		const char* argumentsBegin = NumberParser::skipSpaces( commandEnd, lineEnd );
 
-		float nx = tokens[ 1 ].toFloat( &succeeded );
-		if( !succeeded )
+		// malformed vertices still take up their slot (as 0)
+		// so that the indices of the following ones match the counting pass
+		if( isCommand( commandBegin, commandEnd, "v" ) )
 		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
+			float xyz[ 3 ] = { 0, 0, 0 };
+			if( !parseFloats( argumentsBegin, lineEnd, 3, xyz ) )
+			{
+				fprintf( stderr, "Invalid position at line number: %d\n%.*s\n",
+					lineNumber, static_cast< int >( lineEnd - lineBegin ), lineBegin );
+			}
+			positions[ nPositions ] = Vector3f( xyz[ 0 ], xyz[ 1 ], xyz[ 2 ] );
+			++nPositions;
 		}
-
-		float ny = tokens[ 2 ].toFloat( &succeeded );
-		if( !succeeded )
+		else if( isCommand( commandBegin, commandEnd, "vt" ) )
 		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
+			float st[ 2 ] = { 0, 0 };
+			if( !parseFloats( argumentsBegin, lineEnd, 2, st ) )
+			{
+				fprintf( stderr, "Invalid texture coordinate at line number: %d\n%.*s\n",
+					lineNumber, static_cast< int >( lineEnd - lineBegin ), lineBegin );
+			}
+			textureCoordinates[ nTextureCoordinates ] = Vector2f( st[ 0 ], st[ 1 ] );
+			++nTextureCoordinates;
 		}
-
-		float nz = tokens[ 3 ].toFloat( &succeeded );
-		if( !succeeded )
+		else if( isCommand( commandBegin, commandEnd, "vn" ) )
 		{
-			fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
+			float nxyz[ 3 ] = { 0, 0, 0 };
+			if( !parseFloats( argumentsBegin, lineEnd, 3, nxyz ) )
+			{
+				fprintf( stderr, "Invalid normal at line number: %d\n%.*s\n",
+					lineNumber, static_cast< int >( lineEnd - lineBegin ), lineBegin );
+			}
+			normals[ nNormals ] = Vector3f( nxyz[ 0 ], nxyz[ 1 ], nxyz[ 2 ] );
+			++nNormals;
+		}
+		else if( isCommand( commandBegin, commandEnd, "f" ) || isCommand( commandBegin, commandEnd, "fo" ) )
+		{
+			if( parseFace( lineNumber, argumentsBegin, lineEnd,
+				nPositions, nTextureCoordinates, nNormals, chunk ) )
+			{
+				if( chunk.commands.empty() || chunk.commands.back().type != ChunkCommand::FACES )
+				{
+					chunk.commands.push_back( ChunkCommand( ChunkCommand::FACES, lineNumber, "" ) );
+				}
+				++( chunk.commands.back().nFaces );
+			}
+		}
+		else if( isCommand( commandBegin, commandEnd, "g" ) )
+		{
+			chunk.commands.push_back( ChunkCommand( ChunkCommand::GROUP, lineNumber,
+				trimmedString( argumentsBegin, lineEnd ) ) );
+		}
+		else if( isCommand( commandBegin, commandEnd, "usemtl" ) )
+		{
+			const char* nameEnd = NumberParser::skipToSpace( argumentsBegin, lineEnd );
+			chunk.commands.push_back( ChunkCommand( ChunkCommand::MATERIAL, lineNumber,
+				trimmedString( argumentsBegin, nameEnd ) ) );
+		}
+		else if( isCommand( commandBegin, commandEnd, "mtllib" ) )
+		{
+			const char* nameEnd = NumberParser::skipToSpace( argumentsBegin, lineEnd );
+			chunk.commands.push_back( ChunkCommand( ChunkCommand::MATERIAL_LIBRARY, lineNumber,
+				trimmedString( argumentsBegin, nameEnd ) ) );
 		}
 
-		pOBJData->normals().push_back( Vector3f( nx, ny, nz ) );
-
-		return true;
+		++lineNumber;
+		lineBegin = lineEnd + 1;
 	}
 }
 
 // static
-bool OBJLoader::parseFace( int lineNumber, QString line,
-						  QStringList tokens, OBJGroup* pCurrentGroup )
+void OBJLoader::stitchChunks( QString objFilename, std::vector< Chunk >& chunks,
+	std::shared_ptr< OBJData > pOBJData )
 {
-	// HACK
-	/*
-	if( tokens.size() < 4 )
-	{
-		fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-			lineNumber, qPrintable( line ) );
-		return false;
-	}
-	else
-	*/
-	{
-		// first check line consistency - each vertex in the face
-		// should have the same number of attributes
-		bool faceIsValid;
-		bool faceHasTextureCoordinates;
-		bool faceHasNormals;
-
-		faceIsValid = OBJLoader::isFaceLineAttributesConsistent( tokens,
-			&faceHasTextureCoordinates, &faceHasNormals );
-
-		if( !faceIsValid )
-		{
-			fprintf( stderr, "Face attributes inconsistent at line number: %d\n%s\n",
-				lineNumber, qPrintable( line ) );
-			return false;
-		}
-
-		// ensure that all faces in a group are consistent:
-		// they either all have texture coordinates or they don't
-		// they either all have normals or they don't
-		// 
-		// check how many faces the current group has
-		// if the group has no faces, then the first face sets the group attributes
+	int nChunks = static_cast< int >( chunks.size() );
 
-		if( pCurrentGroup->numFaces() == 0 )
+	// count the faces in each group so that each is allocated once
+	QHash< QString, int > nFacesByGroup;
+	QString currentGroupName = "";
+	for( int i = 0; i < nChunks; ++i )
+	{
+		const std::vector< ChunkCommand >& commands = chunks[ i ].commands;
+		for( int c = 0; c < static_cast< int >( commands.size() ); ++c )
 		{
-			pCurrentGroup->setHasTextureCoordinates( faceHasTextureCoordinates );
-			pCurrentGroup->setHasNormals( faceHasNormals );
+			if( commands[ c ].type == ChunkCommand::GROUP )
+			{
+				currentGroupName = commands[ c ].name;
+			}
+			else if( commands[ c ].type == ChunkCommand::FACES )
+			{
+				nFacesByGroup[ currentGroupName ] += commands[ c ].nFaces;
+			}
 		}
+	}
 
-		bool faceIsConsistentWithGroup = ( pCurrentGroup->hasTextureCoordinates() == faceHasTextureCoordinates ) &&
-			( pCurrentGroup->hasNormals() == faceHasNormals );
-
-		if( !faceIsConsistentWithGroup )
-		{
-			fprintf( stderr, "Face attributes inconsistent with group: %s at line: %d\n%s\n",
-				qPrintable( pCurrentGroup->name() ), lineNumber, qPrintable( line ) );
-			fprintf( stderr, "group.hasTextureCoordinates() = %d\n", pCurrentGroup->hasTextureCoordinates() );
-			fprintf( stderr, "face.hasTextureCoordinates() = %d\n", faceHasTextureCoordinates );
-			fprintf( stderr, "group.hasNormals() = %d\n", pCurrentGroup->hasNormals() );
-			fprintf( stderr, "face.hasNormals() = %d\n", faceHasNormals );
-			
-			return false;
-		}
+	OBJGroup* pCurrentGroup = &( pOBJData->addGroup( "" ) ); // default group name is the empty string
+	pCurrentGroup->reserveFaces( nFacesByGroup.value( "" ) );
+	pOBJData->addMaterial( "" ); // default material name is the empty string
 
-		OBJFace face( faceHasTextureCoordinates, faceHasNormals );
+	for( int i = 0; i < nChunks; ++i )
+	{
+		Chunk& chunk = chunks[ i ];
+		int faceIndex = 0;
 
-		// for each vertex
-		for( int i = 1; i < tokens.size(); ++i )
+		for( int c = 0; c < static_cast< int >( chunk.commands.size() ); ++c )
 		{
-			int vertexPositionIndex;
-			int vertexTextureCoordinateIndex;
-			int vertexNormalIndex;
-
-			OBJLoader::getVertexAttributes( tokens[ i ],
-				&vertexPositionIndex, &vertexTextureCoordinateIndex, &vertexNormalIndex );
+			const ChunkCommand& command = chunk.commands[ c ];
 
-			face.positionIndices().push_back( vertexPositionIndex );
+			if( command.type == ChunkCommand::GROUP )
+			{
+				QString newGroupName = command.name;
+				if( newGroupName.isEmpty() )
+				{
+					fprintf( stderr, "Warning: group has no name, defaulting to \"\"\nline: %d\n",
+						command.lineNumber );
+				}
 
-			if( faceHasTextureCoordinates )
+				if( newGroupName != pCurrentGroup->name() )
+				{
+					if( pOBJData->containsGroup( newGroupName ) )
+					{
+						pCurrentGroup = pOBJData->getGroupByName( newGroupName );
+					}
+					else
+					{
+						pCurrentGroup = &( pOBJData->addGroup( newGroupName ) );
+						pCurrentGroup->reserveFaces( nFacesByGroup.value( newGroupName ) );
+					}
+				}
+			}
+			else if( command.type == ChunkCommand::MATERIAL )
+			{
+				pCurrentGroup->addMaterial( command.name );
+			}
+			else if( command.type == ChunkCommand::MATERIAL_LIBRARY )
 			{
-				face.textureCoordinateIndices().push_back( vertexTextureCoordinateIndex );
+				QFileInfo objFileInfo( objFilename );
+				QDir objDir = objFileInfo.dir();
+				QString mtlAbsoluteFilename = objDir.absolutePath() + "/" + command.name;
+				parseMTL( mtlAbsoluteFilename, pOBJData );
 			}
-			if( faceHasNormals )
+			else if( command.type == ChunkCommand::FACES )
 			{
-				face.normalIndices().push_back( vertexNormalIndex );
+				for( int f = 0; f < command.nFaces; ++f )
+				{
+					OBJFace& face = chunk.faces[ faceIndex ];
+					++faceIndex;
+
+					// ensure that all faces in a group are consistent:
+					// they either all have texture coordinates or they don't
+					// they either all have normals or they don't
+					//
+					// if the group has no faces, then the first face sets the group attributes
+					if( pCurrentGroup->numFaces() == 0 )
+					{
+						pCurrentGroup->setHasTextureCoordinates( face.hasTextureCoordinates() );
+						pCurrentGroup->setHasNormals( face.hasNormals() );
+					}
+
+					bool faceIsConsistentWithGroup =
+						( pCurrentGroup->hasTextureCoordinates() == face.hasTextureCoordinates() ) &&
+						( pCurrentGroup->hasNormals() == face.hasNormals() );
+
+					if( faceIsConsistentWithGroup )
+					{
+						pCurrentGroup->addFace( std::move( face ) );
+					}
+					else
+					{
+						fprintf( stderr, "Face attributes inconsistent with group: %s in the faces starting at line: %d\n",
+							qPrintable( pCurrentGroup->name() ), command.lineNumber );
+						fprintf( stderr, "group.hasTextureCoordinates() = %d\n", pCurrentGroup->hasTextureCoordinates() );
+						fprintf( stderr, "face.hasTextureCoordinates() = %d\n", face.hasTextureCoordinates() );
+						fprintf( stderr, "group.hasNormals() = %d\n", pCurrentGroup->hasNormals() );
+						fprintf( stderr, "face.hasNormals() = %d\n", face.hasNormals() );
+					}
+				}
 			}
 		}
 
-		pCurrentGroup->addFace( face );
-		return true;
+		// the faces have been moved out, release the rest
+		std::vector< OBJFace >().swap( chunk.faces );
 	}
 }
 
 // static
-bool OBJLoader::isFaceLineAttributesConsistent( QStringList tokens,
-											   bool* pHasTextureCoordinates, bool* pHasNormals )
+bool OBJLoader::parseFloats( const char* begin, const char* end,
+	int nComponents, float* values )
 {
-	if( tokens.size() < 2 )
+	const char* p = begin;
+	for( int i = 0; i < nComponents; ++i )
 	{
-		*pHasTextureCoordinates = false;
-		*pHasNormals = false;
-		return true;
-	}
-
-	int firstVertexPositionIndex;
-	int firstVertexTextureCoordinateIndex;
-	int firstVertexNormalIndex;
+		p = NumberParser::skipSpaces( p, end );
+		p = NumberParser::parseFloat( p, end, &( values[ i ] ) );
 
-	bool firstVertexIsValid;
-	bool firstVertexHasTextureCoordinates;
-	bool firstVertexHasNormals;	
+		// the number must be followed by a space or the end of the line
+		if( p == nullptr || ( p < end && !NumberParser::isSpace( *p ) ) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
-	firstVertexIsValid = OBJLoader::getVertexAttributes( tokens[1],
-		&firstVertexPositionIndex, &firstVertexTextureCoordinateIndex, &firstVertexNormalIndex );
-	firstVertexHasTextureCoordinates = ( firstVertexTextureCoordinateIndex != -1 );
-	firstVertexHasNormals = ( firstVertexNormalIndex != -1 );
+// static
+bool OBJLoader::parseFace( int lineNumber, const char* begin, const char* end,
+	int nPositions, int nTextureCoordinates, int nNormals,
+	Chunk& chunk )
+{
+	OBJFace face;
+	bool faceHasTextureCoordinates = false;
+	bool faceHasNormals = false;
 
-	if( !firstVertexIsValid )
+	// for each vertex
+	const char* tokenBegin = NumberParser::skipSpaces( begin, end );
+	while( tokenBegin < end )
 	{
-		*pHasTextureCoordinates = false;
-		*pHasNormals = false;
-		return false;
-	}
+		const char* tokenEnd = NumberParser::skipToSpace( tokenBegin, end );
 
-	for( int i = 2; i < tokens.size(); ++i )
-	{
 		int vertexPositionIndex;
 		int vertexTextureCoordinateIndex;
 		int vertexNormalIndex;
 
-		bool vertexIsValid;
-		bool vertexHasTextureCoordinates;
-		bool vertexHasNormals;
-
-		vertexIsValid = OBJLoader::getVertexAttributes( tokens[i],
+		bool vertexIsValid = getVertexAttributes( tokenBegin, tokenEnd,
+			nPositions, nTextureCoordinates, nNormals,
 			&vertexPositionIndex, &vertexTextureCoordinateIndex, &vertexNormalIndex );
-		vertexHasTextureCoordinates = ( vertexTextureCoordinateIndex != -1 );
-		vertexHasNormals = ( vertexNormalIndex != -1 );
-
 		if( !vertexIsValid )
 		{
-			*pHasTextureCoordinates = false;
-			*pHasNormals = false;
+			fprintf( stderr, "Invalid face vertex at line number: %d\n%.*s\n",
+				lineNumber, static_cast< int >( end - begin ), begin );
 			return false;
 		}
 
-		if( firstVertexHasTextureCoordinates != vertexHasTextureCoordinates )
+		bool vertexHasTextureCoordinates = ( vertexTextureCoordinateIndex != -1 );
+		bool vertexHasNormals = ( vertexNormalIndex != -1 );
+
+		// the first vertex sets the face attributes
+		// each vertex in the face should have the same attributes
+		if( face.numVertices() == 0 )
+		{
+			faceHasTextureCoordinates = vertexHasTextureCoordinates;
+			faceHasNormals = vertexHasNormals;
+			face = OBJFace( faceHasTextureCoordinates, faceHasNormals );
+		}
+		else if( vertexHasTextureCoordinates != faceHasTextureCoordinates ||
+			vertexHasNormals != faceHasNormals )
 		{
-			*pHasTextureCoordinates = false;
-			*pHasNormals = false;
+			fprintf( stderr, "Face attributes inconsistent at line number: %d\n%.*s\n",
+				lineNumber, static_cast< int >( end - begin ), begin );
 			return false;
 		}
 
-		if( firstVertexHasNormals != vertexHasNormals )
+		face.positionIndices().push_back( vertexPositionIndex );
+		if( faceHasTextureCoordinates )
 		{
-			*pHasTextureCoordinates = false;
-			*pHasNormals = false;
-			return false;
+			face.textureCoordinateIndices().push_back( vertexTextureCoordinateIndex );
+		}
+		if( faceHasNormals )
+		{
+			face.normalIndices().push_back( vertexNormalIndex );
 		}
+
+		tokenBegin = NumberParser::skipSpaces( tokenEnd, end );
 	}
 
-	*pHasTextureCoordinates = firstVertexHasTextureCoordinates;
-	*pHasNormals = firstVertexHasNormals;
+	chunk.faces.push_back( std::move( face ) );
 	return true;
 }
 
 // static
-bool OBJLoader::getVertexAttributes( QString objFaceVertexToken,
-									int* pPositionIndex, int* pTextureCoordinateIndex, int* pNormalIndex )
+bool OBJLoader::getVertexAttributes( const char* begin, const char* end,
+	int nPositions, int nTextureCoordinates, int nNormals,
+	int* pPositionIndex, int* pTextureCoordinateIndex, int* pNormalIndex )
 {
-	QStringList vertexAttributes = objFaceVertexToken.split( "/", QString::KeepEmptyParts );
-	int vertexNumAttributes = vertexAttributes.size();
-
-	// check if it has position
-	if( vertexNumAttributes < 1 )
+	*pPositionIndex = -1;
+	*pTextureCoordinateIndex = -1;
+	*pNormalIndex = -1;
+
+	// position is required
+	int objIndex;
+	const char* p = NumberParser::parseInt( begin, end, &objIndex );
+	if( p == nullptr )
 	{
-		*pPositionIndex = -1;
-		*pTextureCoordinateIndex = -1;
-		*pNormalIndex = -1;
 		return false;
 	}
-	else
+	*pPositionIndex = resolveIndex( objIndex, nPositions );
+	if( *pPositionIndex == -1 )
+	{
+		return false;
+	}
+
+	// texture coordinate is optional, and may be empty
+	if( p < end && *p == '/' )
 	{
-		if( vertexAttributes[0] == "" )
+		++p;
+		if( p < end && *p != '/' )
 		{
-			*pPositionIndex = -1;
-			*pTextureCoordinateIndex = -1;
-			*pNormalIndex = -1;
-			return false;
+			p = NumberParser::parseInt( p, end, &objIndex );
+			if( p == nullptr )
+			{
+				return false;
+			}
+			*pTextureCoordinateIndex = resolveIndex( objIndex, nTextureCoordinates );
+			if( *pTextureCoordinateIndex == -1 )
+			{
+				return false;
+			}
 		}
-		else
-		{
-			// TODO: error checking on parsing the ints?
-			*pPositionIndex = vertexAttributes[ 0 ].toInt() - 1;
 
-			if( vertexNumAttributes > 1 )
+		// normal is optional
+		if( p < end && *p == '/' )
+		{
+			++p;
+			p = NumberParser::parseInt( p, end, &objIndex );
+			if( p == nullptr )
 			{
-				if( vertexAttributes[1] == "" )
-				{
-					*pTextureCoordinateIndex = -1;
-				}
-				else
-				{
-					*pTextureCoordinateIndex = vertexAttributes[ 1 ].toInt() - 1;
-				}
-
-				if( vertexNumAttributes > 2 )
-				{
-					if( vertexAttributes[2] == "" )
-					{
-						*pNormalIndex = -1;
-					}
-					else
-					{
-						*pNormalIndex = vertexAttributes[ 2 ].toInt() - 1;
-					}
-				}
-				else
-				{
-					*pNormalIndex = -1;
-				}				
+				return false;
 			}
-			else
+			*pNormalIndex = resolveIndex( objIndex, nNormals );
+			if( *pNormalIndex == -1 )
 			{
-				*pTextureCoordinateIndex = -1;
-				*pNormalIndex = -1;
+				return false;
 			}
 		}
+	}
+
+	// the whole token must have been consumed
+	return( p == end );
+}
+
+// static
+int OBJLoader::resolveIndex( int objIndex, int nElements )
+{
+	if( objIndex > 0 && objIndex <= nElements )
+	{
+		return objIndex - 1;
+	}
+	else if( objIndex < 0 && nElements + objIndex >= 0 )
+	{
+		return nElements + objIndex;
+	}
+	else
+	{
+		return -1;
+	}
+}
 
-		return true;
+// static
+bool OBJLoader::isCommand( const char* begin, const char* end, const char* command )
+{
+	size_t length = strlen( command );
+	return( static_cast< size_t >( end - begin ) == length &&
+		memcmp( begin, command, length ) == 0 );
+}
+
+// static
+QString OBJLoader::trimmedString( const char* begin, const char* end )
+{
+	begin = NumberParser::skipSpaces( begin, end );
+	while( end > begin && NumberParser::isSpace( end[ -1 ] ) )
+	{
+		--end;
 	}
+	return QString::fromUtf8( begin, static_cast< int >( end - begin ) );
 }
+
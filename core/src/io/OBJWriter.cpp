@@ -0,0 +1,284 @@
+#include "io/OBJWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <ppl.h>
+
+#include <QFile>
+
+#include "geometry/TriangleMesh.h"
+#include "io/NumberFormatter.h"
+#include "io/OBJData.h"
+
+namespace
+{
+	// the longest index: "-2147483648"
+	const int MAX_INT_LENGTH = 11;
+
+	inline char* formatFloat( float f, int precision, char* p )
+	{
+		return( ( precision < 0 ) ? NumberFormatter::formatFloat( f, p ) : NumberFormatter::formatFloat( f, precision, p ) );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+// static
+const int OBJWriter::CHUNK_SIZE = 16384;
+
+// static
+const int OBJWriter::CHUNKS_PER_ROUND = 64;
+
+// static
+bool OBJWriter::write( QString filename, OBJData& data, int precision )
+{
+	// binary mode: lines end in '\n' on every platform
+	FILE* fp = fopen( QFile::encodeName( filename ).constData(), "wb" );
+	if( fp == nullptr )
+	{
+		fprintf( stderr, "Unable to open %s for writing\n", qPrintable( filename ) );
+		return false;
+	}
+
+	const std::vector< Vector3f >& positions = data.positions();
+	const std::vector< Vector2f >& textureCoordinates = data.textureCoordinates();
+	const std::vector< Vector3f >& normals = data.normals();
+
+	bool succeeded =
+		writeVectors( fp, "v", positions.empty() ? nullptr : &( positions[ 0 ].x ),
+			3, static_cast< int >( positions.size() ), precision ) &&
+		writeVectors( fp, "vt", textureCoordinates.empty() ? nullptr : &( textureCoordinates[ 0 ].x ),
+			2, static_cast< int >( textureCoordinates.size() ), precision ) &&
+		writeVectors( fp, "vn", normals.empty() ? nullptr : &( normals[ 0 ].x ),
+			3, static_cast< int >( normals.size() ), precision );
+
+	for( int g = 0; g < data.numGroups() && succeeded; ++g )
+	{
+		OBJGroup& group = data.groups()[ g ];
+		const std::vector< OBJFace >& groupFaces = group.faces();
+		bool hasTextureCoordinates = group.hasTextureCoordinates();
+		bool hasNormals = group.hasNormals();
+
+		// the default group is unnamed
+		if( !( group.name().isEmpty() ) )
+		{
+			succeeded = writeText( fp, ( "g " + group.name() + "\n" ).toUtf8() );
+		}
+
+		// a material can be switched to more than once,
+		// but all of its faces are in one list
+		const std::vector< QString >& materialNames = group.materialNames();
+		for( int m = 0; m < group.numMaterials() && succeeded; ++m )
+		{
+			const QString& materialName = materialNames[ m ];
+			if( std::find( materialNames.begin(), materialNames.begin() + m, materialName ) != materialNames.begin() + m )
+			{
+				continue;
+			}
+
+			const std::vector< int >& faceIndices = group.facesForMaterial( m );
+			if( faceIndices.empty() )
+			{
+				continue;
+			}
+
+			if( !( materialName.isEmpty() ) )
+			{
+				succeeded = writeText( fp, ( "usemtl " + materialName + "\n" ).toUtf8() );
+			}
+
+			succeeded = succeeded && writeLines( fp, static_cast< int >( faceIndices.size() ),
+				[&]( int i )
+				{
+					int nVertices = static_cast< int >( groupFaces[ faceIndices[ i ] ].positionIndices().size() );
+					return 2 + nVertices * ( 3 + 3 * MAX_INT_LENGTH );
+				},
+				[&]( int i, char* p ) -> char*
+				{
+					const OBJFace& face = groupFaces[ faceIndices[ i ] ];
+					const std::vector< int >& pis = face.positionIndices();
+					const std::vector< int >& tis = face.textureCoordinateIndices();
+					const std::vector< int >& nis = face.normalIndices();
+
+					*p = 'f';
+					++p;
+					int nVertices = static_cast< int >( pis.size() );
+					for( int j = 0; j < nVertices; ++j )
+					{
+						*p = ' ';
+						p = NumberFormatter::formatInt( pis[ j ] + 1, p + 1 );
+						if( hasTextureCoordinates )
+						{
+							*p = '/';
+							p = NumberFormatter::formatInt( tis[ j ] + 1, p + 1 );
+						}
+						if( hasNormals )
+						{
+							*p = '/';
+							++p;
+							if( !hasTextureCoordinates )
+							{
+								*p = '/';
+								++p;
+							}
+							p = NumberFormatter::formatInt( nis[ j ] + 1, p );
+						}
+					}
+					*p = '\n';
+					return p + 1;
+				} );
+		}
+	}
+
+	if( fclose( fp ) != 0 )
+	{
+		succeeded = false;
+	}
+	if( !succeeded )
+	{
+		fprintf( stderr, "Unable to write %s\n", qPrintable( filename ) );
+	}
+	return succeeded;
+}
+
+// static
+bool OBJWriter::write( QString filename, const TriangleMesh& mesh, int precision )
+{
+	FILE* fp = fopen( QFile::encodeName( filename ).constData(), "wb" );
+	if( fp == nullptr )
+	{
+		fprintf( stderr, "Unable to open %s for writing\n", qPrintable( filename ) );
+		return false;
+	}
+
+	const std::vector< Vector3f >& positions = mesh.positions();
+	const std::vector< Vector3f >& normals = mesh.normals();
+	const std::vector< Vector3i >& faces = mesh.faces();
+	bool hasNormals = !( normals.empty() );
+
+	bool succeeded =
+		writeVectors( fp, "v", positions.empty() ? nullptr : &( positions[ 0 ].x ),
+			3, static_cast< int >( positions.size() ), precision ) &&
+		writeVectors( fp, "vn", normals.empty() ? nullptr : &( normals[ 0 ].x ),
+			3, static_cast< int >( normals.size() ), precision ) &&
+		writeLines( fp, static_cast< int >( faces.size() ),
+			[&]( int )
+			{
+				return 2 + 3 * ( 3 + 2 * MAX_INT_LENGTH );
+			},
+			[&]( int i, char* p ) -> char*
+			{
+				const Vector3i& face = faces[ i ];
+
+				*p = 'f';
+				++p;
+				for( int j = 0; j < 3; ++j )
+				{
+					*p = ' ';
+					p = NumberFormatter::formatInt( face[ j ] + 1, p + 1 );
+					if( hasNormals )
+					{
+						p[ 0 ] = '/';
+						p[ 1 ] = '/';
+						p = NumberFormatter::formatInt( face[ j ] + 1, p + 2 );
+					}
+				}
+				*p = '\n';
+				return p + 1;
+			} );
+
+	if( fclose( fp ) != 0 )
+	{
+		succeeded = false;
+	}
+	if( !succeeded )
+	{
+		fprintf( stderr, "Unable to write %s\n", qPrintable( filename ) );
+	}
+	return succeeded;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+template< typename MaxLineSize, typename FormatLine >
+bool OBJWriter::writeLines( FILE* fp, int nLines, MaxLineSize maxLineSize, FormatLine formatLine )
+{
+	// the chunk buffers are reused from round to round
+	std::vector< std::vector< char > > chunks( CHUNKS_PER_ROUND );
+	std::vector< size_t > chunkSizes( CHUNKS_PER_ROUND );
+
+	int linesPerRound = CHUNK_SIZE * CHUNKS_PER_ROUND;
+	for( int roundStart = 0; roundStart < nLines; roundStart += linesPerRound )
+	{
+		int nRoundLines = std::min( linesPerRound, nLines - roundStart );
+		int nChunks = ( nRoundLines + CHUNK_SIZE - 1 ) / CHUNK_SIZE;
+
+		Concurrency::parallel_for( 0, nChunks, [&]( int c )
+		{
+			int lineStart = roundStart + c * CHUNK_SIZE;
+			int lineEnd = std::min( lineStart + CHUNK_SIZE, nLines );
+
+			std::vector< char >& text = chunks[ c ];
+			size_t size = 0;
+			for( int i = lineStart; i < lineEnd; ++i )
+			{
+				size_t required = size + maxLineSize( i );
+				if( required > text.size() )
+				{
+					text.resize( std::max( required, 2 * text.size() ) );
+				}
+				size = formatLine( i, &( text[ size ] ) ) - &( text[ 0 ] );
+			}
+			chunkSizes[ c ] = size;
+		} );
+
+		for( int c = 0; c < nChunks; ++c )
+		{
+			if( fwrite( &( chunks[ c ][ 0 ] ), 1, chunkSizes[ c ], fp ) != chunkSizes[ c ] )
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// static
+bool OBJWriter::writeVectors( FILE* fp, const char* command,
+	const float* components, int nComponents, int nVectors, int precision )
+{
+	int commandLength = static_cast< int >( strlen( command ) );
+	return writeLines( fp, nVectors,
+		[&]( int )
+		{
+			return commandLength + 1 + nComponents * ( 1 + NumberFormatter::MAX_LENGTH );
+		},
+		[&]( int i, char* p ) -> char*
+		{
+			memcpy( p, command, commandLength );
+			p += commandLength;
+
+			const float* vector = components + i * nComponents;
+			for( int k = 0; k < nComponents; ++k )
+			{
+				*p = ' ';
+				p = formatFloat( vector[ k ], precision, p + 1 );
+			}
+			*p = '\n';
+			return p + 1;
+		} );
+}
+
+// static
+bool OBJWriter::writeText( FILE* fp, const QByteArray& text )
+{
+	return( fwrite( text.constData(), 1, text.size(), fp ) == static_cast< size_t >( text.size() ) );
+}
@@ -1,128 +1,1015 @@
 #include "io/OpenEXRIO.h"
 
-#if 0
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
 
-#include <OpenEXR/ImfArray.h>
-#include <OpenEXR/ImfChannelList.h>
-#include <OpenEXR/ImfInputFile.h>
-#include <OpenEXR/ImathBox.h>
-#include <OpenEXR/ImfPixelType.h>
+#include <intrin.h>
+#include <ppl.h>
 
-using namespace Imf;
-using namespace Imath;
+#include <QByteArray>
+#include <QFile>
+
+#include "imageproc/Image1f.h"
+#include "imageproc/Image4f.h"
+#include "io/ByteOrder.h"
+#include "io/MappedFile.h"
+
+namespace
+{
+	const int32 MAGIC = 20000630;
+
+	// version field: the format version in the low byte, then flags
+	const int32 VERSION = 2;
+	const int32 TILED_FLAG = 0x200;
+	const int32 LONG_NAMES_FLAG = 0x400;
+	const int32 DEEP_FLAG = 0x800;
+	const int32 MULTIPART_FLAG = 0x1000;
+
+	// the pixel types of the file format
+	const int32 PIXEL_TYPE_UINT = 0;
+	const int32 PIXEL_TYPE_HALF = 1;
+	const int32 PIXEL_TYPE_FLOAT = 2;
+
+	// tiled levels
+	const int ONE_LEVEL = 0;
+
+	const int ZIP_LINES_PER_BLOCK = 16;
+
+	int pixelTypeSize( int32 pixelType )
+	{
+		return ( pixelType == PIXEL_TYPE_HALF ) ? 2 : 4;
+	}
+
+	// the file is little endian
+	template< typename T >
+	T loadLE( const ubyte* p )
+	{
+		T value;
+		memcpy( &value, p, sizeof( T ) );
+		if( !ByteOrder::isLittleEndian() )
+		{
+			ByteOrder::swap( &value, sizeof( T ), 1 );
+		}
+		return value;
+	}
+
+	template< typename T >
+	void appendLE( T value, QByteArray& bytes )
+	{
+		if( !ByteOrder::isLittleEndian() )
+		{
+			ByteOrder::swap( &value, sizeof( T ), 1 );
+		}
+		bytes.append( reinterpret_cast< const char* >( &value ), sizeof( T ) );
+	}
+
+	void appendString( const char* s, QByteArray& bytes )
+	{
+		bytes.append( s, static_cast< int >( strlen( s ) ) + 1 );
+	}
+
+	// appends an attribute: name, type name, size, then the value
+	void appendAttribute( const char* name, const char* typeName, const QByteArray& value, QByteArray& bytes )
+	{
+		appendString( name, bytes );
+		appendString( typeName, bytes );
+		appendLE< int32 >( value.size(), bytes );
+		bytes.append( value );
+	}
+
+	float halfToFloat( uint16 h )
+	{
+		uint32 sign = static_cast< uint32 >( h & 0x8000 ) << 16;
+		uint32 exponent = ( h >> 10 ) & 0x1f;
+		uint32 mantissa = h & 0x3ff;
+
+		uint32 bits;
+		if( exponent == 0 )
+		{
+			// zero or subnormal: mantissa * 2^-24
+			float f = mantissa * ( 1.f / 16777216.f );
+			return sign ? -f : f;
+		}
+		else if( exponent == 31 )
+		{
+			// infinity or nan
+			bits = sign | 0x7f800000 | ( mantissa << 13 );
+		}
+		else
+		{
+			bits = sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 );
+		}
+
+		float f;
+		memcpy( &f, &bits, sizeof( float ) );
+		return f;
+	}
+
+	// rounds to the nearest half, ties to even
+	uint16 floatToHalf( float f )
+	{
+		uint32 bits;
+		memcpy( &bits, &f, sizeof( float ) );
+
+		uint32 sign = ( bits >> 16 ) & 0x8000;
+		int exponent = ( bits >> 23 ) & 0xff;
+		uint32 mantissa = bits & 0x7fffff;
+
+		if( exponent == 255 )
+		{
+			// infinity stays infinity, nan stays nan
+			return static_cast< uint16 >( sign | 0x7c00 | ( mantissa != 0 ? ( 0x200 | ( mantissa >> 13 ) ) : 0 ) );
+		}
+
+		int halfExponent = exponent - 112;
+		if( halfExponent >= 31 )
+		{
+			return static_cast< uint16 >( sign | 0x7c00 );
+		}
+
+		if( halfExponent <= 0 )
+		{
+			// subnormal half (or zero)
+			if( halfExponent < -10 )
+			{
+				return static_cast< uint16 >( sign );
+			}
+
+			mantissa |= 0x800000;
+			int shift = 14 - halfExponent;
+			uint32 halfMantissa = mantissa >> shift;
+			uint32 remainder = mantissa & ( ( 1u << shift ) - 1 );
+			uint32 halfway = 1u << ( shift - 1 );
+			if( remainder > halfway || ( remainder == halfway && ( halfMantissa & 1 ) ) )
+			{
+				++halfMantissa;
+			}
+			return static_cast< uint16 >( sign | halfMantissa );
+		}
+
+		// a carry out of the mantissa correctly rounds up the exponent (or to infinity)
+		uint32 halfBits = ( halfExponent << 10 ) | ( mantissa >> 13 );
+		uint32 remainder = mantissa & 0x1fff;
+		if( remainder > 0x1000 || ( remainder == 0x1000 && ( halfBits & 1 ) ) )
+		{
+			++halfBits;
+		}
+		return static_cast< uint16 >( sign | halfBits );
+	}
+
+	// ZIP and ZIPS: bytes are split into even and odd halves,
+	// delta encoded, then deflated
+	QByteArray compressZIP( const ubyte* raw, int nBytes )
+	{
+		std::vector< ubyte > reordered( nBytes );
+		ubyte* t1 = &( reordered[ 0 ] );
+		ubyte* t2 = t1 + ( nBytes + 1 ) / 2;
+		for( int i = 0; i < nBytes; ++i )
+		{
+			if( i % 2 == 0 )
+			{
+				*( t1++ ) = raw[ i ];
+			}
+			else
+			{
+				*( t2++ ) = raw[ i ];
+			}
+		}
+
+		int previous = reordered[ 0 ];
+		for( int i = 1; i < nBytes; ++i )
+		{
+			int current = reordered[ i ];
+			reordered[ i ] = static_cast< ubyte >( current - previous + 128 );
+			previous = current;
+		}
+
+		// qCompress prepends the uncompressed size as 4 big endian bytes
+		QByteArray compressed = qCompress( &( reordered[ 0 ] ), nBytes );
+		return compressed.mid( 4 );
+	}
+
+	bool uncompressZIP( const ubyte* compressed, int nCompressedBytes, ubyte* raw, int nRawBytes )
+	{
+		// qUncompress expects the uncompressed size as 4 big endian bytes
+		QByteArray input( 4 + nCompressedBytes, 0 );
+		input.data()[ 0 ] = static_cast< char >( nRawBytes >> 24 );
+		input.data()[ 1 ] = static_cast< char >( nRawBytes >> 16 );
+		input.data()[ 2 ] = static_cast< char >( nRawBytes >> 8 );
+		input.data()[ 3 ] = static_cast< char >( nRawBytes );
+		memcpy( input.data() + 4, compressed, nCompressedBytes );
+
+		QByteArray reordered = qUncompress( input );
+		if( reordered.size() != nRawBytes )
+		{
+			return false;
+		}
+
+		ubyte* t = reinterpret_cast< ubyte* >( reordered.data() );
+		for( int i = 1; i < nRawBytes; ++i )
+		{
+			t[ i ] = static_cast< ubyte >( t[ i - 1 ] + t[ i ] - 128 );
+		}
+
+		const ubyte* t1 = t;
+		const ubyte* t2 = t + ( nRawBytes + 1 ) / 2;
+		for( int i = 0; i < nRawBytes; ++i )
+		{
+			raw[ i ] = ( i % 2 == 0 ) ? *( t1++ ) : *( t2++ );
+		}
+		return true;
+	}
+
+	// converts n values of pixelType at input to floats at output[ i * stride ]
+	void decodeValues( const ubyte* input, int32 pixelType, int n, float* output, int stride )
+	{
+		for( int i = 0; i < n; ++i )
+		{
+			float value;
+			if( pixelType == PIXEL_TYPE_HALF )
+			{
+				value = halfToFloat( loadLE< uint16 >( input + 2 * i ) );
+			}
+			else if( pixelType == PIXEL_TYPE_FLOAT )
+			{
+				value = loadLE< float >( input + 4 * i );
+			}
+			else
+			{
+				value = static_cast< float >( loadLE< uint32 >( input + 4 * i ) );
+			}
+			output[ i * stride ] = value;
+		}
+	}
+
+	// converts n floats at input[ i * stride ] to pixelType (HALF or FLOAT) at output
+	void encodeValues( const float* input, int stride, int32 pixelType, int n, ubyte* output )
+	{
+		bool swap = !ByteOrder::isLittleEndian();
+		for( int i = 0; i < n; ++i )
+		{
+			if( pixelType == PIXEL_TYPE_HALF )
+			{
+				uint16 h = floatToHalf( input[ i * stride ] );
+				if( swap )
+				{
+					h = ByteOrder::swap( h );
+				}
+				memcpy( output + 2 * i, &h, 2 );
+			}
+			else
+			{
+				float f = input[ i * stride ];
+				if( swap )
+				{
+					f = ByteOrder::swap( f );
+				}
+				memcpy( output + 4 * i, &f, 4 );
+			}
+		}
+	}
+}
+
+struct OpenEXRIO::Channel
+{
+	QString name;
+	int32 pixelType;
+	int32 xSampling;
+	int32 ySampling;
+};
+
+struct OpenEXRIO::Header
+{
+	Header() :
+
+		compression( -1 ),
+		xMin( 0 ),
+		yMin( 0 ),
+		xMax( -1 ),
+		yMax( -1 ),
+		tiled( false ),
+		tileWidth( 0 ),
+		tileHeight( 0 ),
+		levelMode( ONE_LEVEL )
+
+	{
+
+	}
+
+	int width() const
+	{
+		return xMax - xMin + 1;
+	}
+
+	int height() const
+	{
+		return yMax - yMin + 1;
+	}
+
+	// lines per scanline block
+	int linesPerBlock() const
+	{
+		return ( compression == ZIP_COMPRESSION ) ? ZIP_LINES_PER_BLOCK : 1;
+	}
+
+	// bytes per pixel, summed over channels
+	int pixelSize() const
+	{
+		int size = 0;
+		for( int c = 0; c < static_cast< int >( channels.size() ); ++c )
+		{
+			size += pixelTypeSize( channels[ c ].pixelType );
+		}
+		return size;
+	}
+
+	std::vector< Channel > channels;
+	int compression;
+	int xMin;
+	int yMin;
+	int xMax;
+	int yMax;
+	bool tiled;
+	int tileWidth;
+	int tileHeight;
+	int levelMode;
+};
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
 
 // static
 QVector< QPair< QString, OpenEXRIO::ChannelType > >
-	OpenEXRIO::getChannelNamesAndTypes( const char* filename )
+	OpenEXRIO::getChannelNamesAndTypes( QString filename )
 {
 	QVector< QPair< QString, OpenEXRIO::ChannelType > > channelNamesAndTypesOut;
 
-	InputFile inputFile( filename );
-	const ChannelList& channels = inputFile.header().channels();
+	MappedFile file( filename );
+	Header header;
+	int64 offsetTable;
+	if( !file.isOpen() || !parseHeader( file.data(), file.size(), header, &offsetTable ) )
+	{
+		return channelNamesAndTypesOut;
+	}
 
-	for( ChannelList::ConstIterator itr = channels.begin(); itr != channels.end(); ++itr )
+	for( int c = 0; c < static_cast< int >( header.channels.size() ); ++c )
 	{
-		const char* channelName = itr.name();
-		const Channel& channel = itr.channel();
-		
 		QPair< QString, OpenEXRIO::ChannelType > nameTypePair;
-		nameTypePair.first = channelName;
+		nameTypePair.first = header.channels[ c ].name;
+		nameTypePair.second = static_cast< ChannelType >( header.channels[ c ].pixelType );
+		channelNamesAndTypesOut.append( nameTypePair );
+	}
 
-		switch( channel.type )
+	return channelNamesAndTypesOut;
+}
+
+// static
+bool OpenEXRIO::read( QString filename, Image4f& image )
+{
+	MappedFile file( filename );
+	if( !file.isOpen() )
+	{
+		fprintf( stderr, "Unable to open %s\n", qPrintable( filename ) );
+		return false;
+	}
+
+	Header header;
+	int64 offsetTable;
+	if( !parseHeader( file.data(), file.size(), header, &offsetTable ) )
+	{
+		fprintf( stderr, "Unable to read %s\n", qPrintable( filename ) );
+		return false;
+	}
+
+	int nChannels = static_cast< int >( header.channels.size() );
+	std::vector< int > channelComponents( nChannels, -1 );
+	bool hasColor = false;
+	int luminanceChannel = -1;
+	for( int c = 0; c < nChannels; ++c )
+	{
+		const QString& name = header.channels[ c ].name;
+		if( name == "R" )
 		{
-		case Imf::UINT:
-			nameTypePair.second = OpenEXRIO::UNSIGNED_INT;
-			break;
-		case Imf::HALF:
-			nameTypePair.second = OpenEXRIO::HALF;
-			break;
-		case Imf::FLOAT:
-			nameTypePair.second = OpenEXRIO::FLOAT;
+			channelComponents[ c ] = 0;
+			hasColor = true;
+		}
+		else if( name == "G" )
+		{
+			channelComponents[ c ] = 1;
+			hasColor = true;
+		}
+		else if( name == "B" )
+		{
+			channelComponents[ c ] = 2;
+			hasColor = true;
+		}
+		else if( name == "A" )
+		{
+			channelComponents[ c ] = 3;
+		}
+		else if( name == "Y" )
+		{
+			luminanceChannel = c;
 		}
-		
-		channelNamesAndTypesOut.append( nameTypePair );
 	}
 
-	return channelNamesAndTypesOut;
+	bool luminanceOnly = ( !hasColor && luminanceChannel != -1 );
+	if( luminanceOnly )
+	{
+		channelComponents[ luminanceChannel ] = 0;
+	}
+
+	Image4f result( header.width(), header.height(), Vector4f( 0, 0, 0, 1 ) );
+	if( !readPixels( file.data(), file.size(), header, offsetTable,
+		channelComponents.empty() ? nullptr : &( channelComponents[ 0 ] ), result.pixels(), 4 ) )
+	{
+		fprintf( stderr, "Unable to read the pixels of %s\n", qPrintable( filename ) );
+		return false;
+	}
+
+	if( luminanceOnly )
+	{
+		float* pixels = result.pixels();
+		int nPixels = result.numPixels();
+		for( int i = 0; i < nPixels; ++i )
+		{
+			pixels[ 4 * i + 1 ] = pixels[ 4 * i ];
+			pixels[ 4 * i + 2 ] = pixels[ 4 * i ];
+		}
+	}
+
+	image = std::move( result );
+	return true;
 }
 
 // static
-FloatMatrix OpenEXRIO::getFloatBufferByName( const char* filename,
-											const char* channelName )
+bool OpenEXRIO::read( QString filename, QString channelName, Image1f& image )
 {
-#if 0
-	InputFile inputFile( filename );
-	Box2i dataWindow = inputFile.header().dataWindow();
-	int width = dataWindow.max.x - dataWindow.min.x + 1;
-	int height = dataWindow.max.y - dataWindow.min.y + 1;
+	MappedFile file( filename );
+	if( !file.isOpen() )
+	{
+		fprintf( stderr, "Unable to open %s\n", qPrintable( filename ) );
+		return false;
+	}
 
-	Array2D< float > arr;
-	arr.resizeErase( height, width );
+	Header header;
+	int64 offsetTable;
+	if( !parseHeader( file.data(), file.size(), header, &offsetTable ) )
+	{
+		fprintf( stderr, "Unable to read %s\n", qPrintable( filename ) );
+		return false;
+	}
 
-	Slice slice
-	(
-		Imf::FLOAT,																// type
-		( char* )( &arr[0][0] - dataWindow.min.x - dataWindow.min.y * width ),	// base
-		sizeof( arr[0][0] ) * 1,												// xStride
-		sizeof( arr[0][0] ) * width,											// yStride
-		1, 1,																	// x/y sampling
-		FLT_MAX																	// fillValue
-	);
+	int nChannels = static_cast< int >( header.channels.size() );
+	std::vector< int > channelComponents( nChannels, -1 );
+	bool found = false;
+	for( int c = 0; c < nChannels; ++c )
+	{
+		if( header.channels[ c ].name == channelName )
+		{
+			channelComponents[ c ] = 0;
+			found = true;
+		}
+	}
 
-	FrameBuffer frameBuffer;
-	frameBuffer.insert( channelName, slice );
+	if( !found )
+	{
+		fprintf( stderr, "%s has no channel %s\n", qPrintable( filename ), qPrintable( channelName ) );
+		return false;
+	}
+
+	Image1f result( header.width(), header.height() );
+	if( !readPixels( file.data(), file.size(), header, offsetTable,
+		&( channelComponents[ 0 ] ), result.pixels(), 1 ) )
+	{
+		fprintf( stderr, "Unable to read the pixels of %s\n", qPrintable( filename ) );
+		return false;
+	}
+
+	image = result;
+	return true;
+}
+
+// static
+bool OpenEXRIO::write( QString filename, const Image4f& image,
+	ChannelType channelType, Compression compression, int tileSize )
+{
+	QVector< QString > channelNames;
+	channelNames.append( "R" );
+	channelNames.append( "G" );
+	channelNames.append( "B" );
+	channelNames.append( "A" );
+	return writePixels( filename, image.pixels(), image.width(), image.height(), 4,
+		channelNames, channelType, compression, tileSize );
+}
+
+// static
+bool OpenEXRIO::write( QString filename, const Image1f& image, QString channelName,
+	ChannelType channelType, Compression compression, int tileSize )
+{
+	QVector< QString > channelNames;
+	channelNames.append( channelName );
+	return writePixels( filename, image.pixels(), image.width(), image.height(), 1,
+		channelNames, channelType, compression, tileSize );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+bool OpenEXRIO::parseHeader( const ubyte* data, int64 size, Header& header, int64* pOffsetTable )
+{
+	if( size < 8 || loadLE< int32 >( data ) != MAGIC )
+	{
+		fprintf( stderr, "Not an OpenEXR file\n" );
+		return false;
+	}
 
-	inputFile.setFrameBuffer( frameBuffer );
-	inputFile.readPixels( dataWindow.min.y, dataWindow.max.y );
+	int32 version = loadLE< int32 >( data + 4 );
+	if( ( version & 0xff ) != VERSION || ( version & ( DEEP_FLAG | MULTIPART_FLAG ) ) != 0 )
+	{
+		fprintf( stderr, "Unsupported OpenEXR version / flags: 0x%x\n", version );
+		return false;
+	}
+	header.tiled = ( version & TILED_FLAG ) != 0;
+
+	const char* p = reinterpret_cast< const char* >( data ) + 8;
+	const char* end = reinterpret_cast< const char* >( data ) + size;
 
-	// copy data into MatrixFloat
-	FloatMatrix out( width, height );
-	for( int y = 0; y < height; ++y )
+	bool hasChannels = false;
+	bool hasDataWindow = false;
+	bool hasTiles = false;
+
+	// attributes, terminated by an empty name
+	while( true )
 	{
-		int yy = height - y - 1;
-		for( int x = 0; x < width; ++x )
+		const char* nameEnd = reinterpret_cast< const char* >( memchr( p, '\0', end - p ) );
+		if( nameEnd == nullptr )
+		{
+			fprintf( stderr, "Truncated OpenEXR header\n" );
+			return false;
+		}
+		if( nameEnd == p )
+		{
+			p = nameEnd + 1;
+			break;
+		}
+
+		QString name = QString::fromLatin1( p, static_cast< int >( nameEnd - p ) );
+		const char* typeBegin = nameEnd + 1;
+		const char* typeEnd = reinterpret_cast< const char* >( memchr( typeBegin, '\0', end - typeBegin ) );
+		if( typeEnd == nullptr || end - typeEnd < 5 )
 		{
-			out( x, y ) = arr[ yy ][ x ];
+			fprintf( stderr, "Truncated OpenEXR header\n" );
+			return false;
 		}
+
+		int32 attributeSize = loadLE< int32 >( reinterpret_cast< const ubyte* >( typeEnd + 1 ) );
+		const ubyte* value = reinterpret_cast< const ubyte* >( typeEnd + 5 );
+		if( attributeSize < 0 || attributeSize > end - reinterpret_cast< const char* >( value ) )
+		{
+			fprintf( stderr, "Truncated OpenEXR header\n" );
+			return false;
+		}
+
+		if( name == "channels" )
+		{
+			// name, int32 pixelType, uchar pLinear, 3 reserved, int32 xSampling, int32 ySampling
+			// terminated by an empty name
+			const char* q = reinterpret_cast< const char* >( value );
+			const char* valueEnd = q + attributeSize;
+			while( q < valueEnd && *q != '\0' )
+			{
+				const char* channelNameEnd = reinterpret_cast< const char* >( memchr( q, '\0', valueEnd - q ) );
+				if( channelNameEnd == nullptr || valueEnd - channelNameEnd < 17 )
+				{
+					fprintf( stderr, "Malformed OpenEXR channel list\n" );
+					return false;
+				}
+
+				const ubyte* channelData = reinterpret_cast< const ubyte* >( channelNameEnd + 1 );
+				Channel channel;
+				channel.name = QString::fromLatin1( q, static_cast< int >( channelNameEnd - q ) );
+				channel.pixelType = loadLE< int32 >( channelData );
+				channel.xSampling = loadLE< int32 >( channelData + 8 );
+				channel.ySampling = loadLE< int32 >( channelData + 12 );
+
+				if( channel.pixelType < PIXEL_TYPE_UINT || channel.pixelType > PIXEL_TYPE_FLOAT )
+				{
+					fprintf( stderr, "Unknown OpenEXR pixel type %d\n", channel.pixelType );
+					return false;
+				}
+				if( channel.xSampling != 1 || channel.ySampling != 1 )
+				{
+					fprintf( stderr, "Subsampled OpenEXR channels are not supported\n" );
+					return false;
+				}
+
+				header.channels.push_back( channel );
+				q = channelNameEnd + 17;
+			}
+			hasChannels = true;
+		}
+		else if( name == "compression" && attributeSize >= 1 )
+		{
+			header.compression = value[ 0 ];
+		}
+		else if( name == "dataWindow" && attributeSize >= 16 )
+		{
+			header.xMin = loadLE< int32 >( value );
+			header.yMin = loadLE< int32 >( value + 4 );
+			header.xMax = loadLE< int32 >( value + 8 );
+			header.yMax = loadLE< int32 >( value + 12 );
+			hasDataWindow = true;
+		}
+		else if( name == "tiles" && attributeSize >= 9 )
+		{
+			header.tileWidth = loadLE< int32 >( value );
+			header.tileHeight = loadLE< int32 >( value + 4 );
+			header.levelMode = value[ 8 ] & 0xf;
+			hasTiles = true;
+		}
+
+		p = reinterpret_cast< const char* >( value ) + attributeSize;
+	}
+
+	if( !hasChannels || !hasDataWindow )
+	{
+		fprintf( stderr, "OpenEXR header is missing channels or dataWindow\n" );
+		return false;
+	}
+
+	if( header.compression != NO_COMPRESSION &&
+		header.compression != ZIPS_COMPRESSION &&
+		header.compression != ZIP_COMPRESSION )
+	{
+		fprintf( stderr, "Unsupported OpenEXR compression %d (only NONE, ZIPS and ZIP are)\n", header.compression );
+		return false;
+	}
+
+	int64 width = static_cast< int64 >( header.xMax ) - header.xMin + 1;
+	int64 height = static_cast< int64 >( header.yMax ) - header.yMin + 1;
+	if( width <= 0 || height <= 0 || width * height > INT_MAX / 4 )
+	{
+		fprintf( stderr, "Invalid OpenEXR data window\n" );
+		return false;
 	}
-	
-	return out;
-#endif
+
+	if( header.tiled )
+	{
+		if( !hasTiles || header.tileWidth <= 0 || header.tileHeight <= 0 )
+		{
+			fprintf( stderr, "Tiled OpenEXR file without a tile description\n" );
+			return false;
+		}
+		if( header.levelMode != ONE_LEVEL )
+		{
+			fprintf( stderr, "Mipmapped and ripmapped OpenEXR files are not supported\n" );
+			return false;
+		}
+
+		// a tile bigger than the data window is only its first tile,
+		// and the tile counts can't overflow
+		header.tileWidth = static_cast< int >( std::min< int64 >( header.tileWidth, width ) );
+		header.tileHeight = static_cast< int >( std::min< int64 >( header.tileHeight, height ) );
+	}
+
+	// sort the channels by name: the order of the channels in each block
+	std::sort( header.channels.begin(), header.channels.end(),
+		[]( const Channel& a, const Channel& b )
+		{
+			return strcmp( a.name.toLatin1().constData(), b.name.toLatin1().constData() ) < 0;
+		} );
+
+	*pOffsetTable = p - reinterpret_cast< const char* >( data );
+	return true;
 }
 
-#if 0
 // static
-void OpenEXRIO::readZBuffer( const char* filename,
-							Array2D< float >& zPixels,
-							int& width, int& height )
+bool OpenEXRIO::readPixels( const ubyte* data, int64 size, const Header& header, int64 offsetTable,
+	const int* channelComponents, float* pixels, int nComponents )
 {
-	// TODO: check if image has z channel
-
-	InputFile inputFile( filename );
-	Box2i dataWindow = inputFile.header().dataWindow();
-	width = dataWindow.max.x - dataWindow.min.x + 1;
-	height = dataWindow.max.y - dataWindow.min.y + 1;
-
-	zPixels.resizeErase( height, width );
-
-	FrameBuffer frameBuffer;
-	frameBuffer.insert
-	(
-		"Z",																			// name
-		Slice
-		(
-			FLOAT,																		// type
-			( char* )( &zPixels[0][0] - dataWindow.min.x - dataWindow.min.y * width ),	// base
-			sizeof( zPixels[0][0] ) * 1,												// xStride
-			sizeof( zPixels[0][0] ) * width,											// yStride
-			1, 1,																		// x/y sampling
-			FLT_MAX																		// fillValue
-		)
-	);
-
-	inputFile.setFrameBuffer( frameBuffer );
-	inputFile.readPixels( dataWindow.min.y, dataWindow.max.y );
+	int width = header.width();
+	int height = header.height();
+	int nChannels = static_cast< int >( header.channels.size() );
+	int pixelSize = header.pixelSize();
+
+	int nBlocks;
+	int nTilesX = 0;
+	int nTilesY = 0;
+	if( header.tiled )
+	{
+		nTilesX = ( width + header.tileWidth - 1 ) / header.tileWidth;
+		nTilesY = ( height + header.tileHeight - 1 ) / header.tileHeight;
+		nBlocks = nTilesX * nTilesY;
+	}
+	else
+	{
+		nBlocks = ( height + header.linesPerBlock() - 1 ) / header.linesPerBlock();
+	}
+
+	if( offsetTable + 8 * static_cast< int64 >( nBlocks ) > size )
+	{
+		fprintf( stderr, "Truncated OpenEXR offset table\n" );
+		return false;
+	}
+
+	// blocks cover disjoint pixels: decode them in parallel
+	// failures are counted rather than returned from the workers
+	volatile long nFailures = 0;
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		uint64 blockOffset = loadLE< uint64 >( data + offsetTable + 8 * b );
+		int headerSize = header.tiled ? 20 : 8;
+		if( blockOffset < static_cast< uint64 >( offsetTable ) ||
+			blockOffset + headerSize > static_cast< uint64 >( size ) )
+		{
+			_InterlockedIncrement( &nFailures );
+			return;
+		}
+
+		const ubyte* block = data + blockOffset;
+
+		// the pixel rectangle [x0, x0 + blockWidth) x [line0, line0 + nLines) of the data window
+		int x0 = 0;
+		int blockWidth = width;
+		int line0;
+		int nLines;
+		if( header.tiled )
+		{
+			int tileX = loadLE< int32 >( block );
+			int tileY = loadLE< int32 >( block + 4 );
+			// check the tile before multiplying, which could overflow
+			if( tileX < 0 || tileY < 0 || tileX >= nTilesX || tileY >= nTilesY )
+			{
+				_InterlockedIncrement( &nFailures );
+				return;
+			}
+			x0 = tileX * header.tileWidth;
+			line0 = tileY * header.tileHeight;
+			blockWidth = std::min( header.tileWidth, width - x0 );
+			nLines = std::min( header.tileHeight, height - line0 );
+		}
+		else
+		{
+			line0 = loadLE< int32 >( block ) - header.yMin;
+			if( line0 < 0 || line0 >= height )
+			{
+				_InterlockedIncrement( &nFailures );
+				return;
+			}
+			nLines = std::min( header.linesPerBlock(), height - line0 );
+		}
+
+		int32 dataSize = loadLE< int32 >( block + headerSize - 4 );
+		const ubyte* blockData = block + headerSize;
+		int rawSize = nLines * blockWidth * pixelSize;
+		if( dataSize < 0 || blockOffset + headerSize + dataSize > static_cast< uint64 >( size ) )
+		{
+			_InterlockedIncrement( &nFailures );
+			return;
+		}
+
+		// a block that doesn't compress is stored raw
+		std::vector< ubyte > uncompressed;
+		const ubyte* raw = blockData;
+		if( dataSize != rawSize )
+		{
+			uncompressed.resize( rawSize );
+			if( header.compression == NO_COMPRESSION ||
+				!uncompressZIP( blockData, dataSize, &( uncompressed[ 0 ] ), rawSize ) )
+			{
+				_InterlockedIncrement( &nFailures );
+				return;
+			}
+			raw = &( uncompressed[ 0 ] );
+		}
+
+		// each line stores each channel's values in turn
+		for( int l = 0; l < nLines; ++l )
+		{
+			int y = height - 1 - ( line0 + l );
+			float* row = pixels + ( static_cast< int64 >( y ) * width + x0 ) * nComponents;
+			for( int c = 0; c < nChannels; ++c )
+			{
+				int32 pixelType = header.channels[ c ].pixelType;
+				if( channelComponents[ c ] != -1 )
+				{
+					decodeValues( raw, pixelType, blockWidth, row + channelComponents[ c ], nComponents );
+				}
+				raw += blockWidth * pixelTypeSize( pixelType );
+			}
+		}
+	} );
+
+	if( nFailures > 0 )
+	{
+		fprintf( stderr, "%ld of %d OpenEXR blocks are truncated or corrupt\n", nFailures, nBlocks );
+		return false;
+	}
+	return true;
 }
-#endif
 
-#endif
+// static
+bool OpenEXRIO::writePixels( QString filename, const float* pixels, int width, int height,
+	int nComponents, const QVector< QString >& channelNames,
+	ChannelType channelType, Compression compression, int tileSize )
+{
+	if( width <= 0 || height <= 0 )
+	{
+		fprintf( stderr, "OpenEXRIO: can't write an empty image\n" );
+		return false;
+	}
+	if( channelType != HALF && channelType != FLOAT )
+	{
+		fprintf( stderr, "OpenEXRIO: only HALF and FLOAT channels can be written\n" );
+		return false;
+	}
+
+	bool tiled = ( tileSize > 0 );
+	int32 pixelType = channelType;
+	int valueSize = pixelTypeSize( pixelType );
+
+	// channels are stored sorted by name
+	std::vector< int > sortedComponents( nComponents );
+	for( int i = 0; i < nComponents; ++i )
+	{
+		sortedComponents[ i ] = i;
+	}
+	std::sort( sortedComponents.begin(), sortedComponents.end(),
+		[&]( int a, int b )
+		{
+			return strcmp( channelNames[ a ].toLatin1().constData(), channelNames[ b ].toLatin1().constData() ) < 0;
+		} );
+
+	// ----- header -----
+	QByteArray header;
+	appendLE< int32 >( MAGIC, header );
+	appendLE< int32 >( VERSION | ( tiled ? TILED_FLAG : 0 ), header );
+
+	QByteArray channels;
+	for( int i = 0; i < nComponents; ++i )
+	{
+		appendString( channelNames[ sortedComponents[ i ] ].toLatin1().constData(), channels );
+		appendLE< int32 >( pixelType, channels );
+		appendLE< int32 >( 0, channels ); // pLinear and reserved
+		appendLE< int32 >( 1, channels ); // xSampling
+		appendLE< int32 >( 1, channels ); // ySampling
+	}
+	channels.append( '\0' );
+	appendAttribute( "channels", "chlist", channels, header );
+
+	QByteArray compressionValue;
+	compressionValue.append( static_cast< char >( compression ) );
+	appendAttribute( "compression", "compression", compressionValue, header );
+
+	QByteArray window;
+	appendLE< int32 >( 0, window );
+	appendLE< int32 >( 0, window );
+	appendLE< int32 >( width - 1, window );
+	appendLE< int32 >( height - 1, window );
+	appendAttribute( "dataWindow", "box2i", window, header );
+	appendAttribute( "displayWindow", "box2i", window, header );
+
+	QByteArray lineOrder;
+	lineOrder.append( '\0' ); // INCREASING_Y
+	appendAttribute( "lineOrder", "lineOrder", lineOrder, header );
+
+	QByteArray pixelAspectRatio;
+	appendLE< float >( 1.f, pixelAspectRatio );
+	appendAttribute( "pixelAspectRatio", "float", pixelAspectRatio, header );
+
+	QByteArray screenWindowCenter;
+	appendLE< float >( 0.f, screenWindowCenter );
+	appendLE< float >( 0.f, screenWindowCenter );
+	appendAttribute( "screenWindowCenter", "v2f", screenWindowCenter, header );
+
+	QByteArray screenWindowWidth;
+	appendLE< float >( 1.f, screenWindowWidth );
+	appendAttribute( "screenWindowWidth", "float", screenWindowWidth, header );
+
+	if( tiled )
+	{
+		QByteArray tiles;
+		appendLE< uint32 >( tileSize, tiles );
+		appendLE< uint32 >( tileSize, tiles );
+		tiles.append( static_cast< char >( ONE_LEVEL ) ); // round down
+		appendAttribute( "tiles", "tiledesc", tiles, header );
+	}
+
+	header.append( '\0' );
+
+	// ----- blocks -----
+	int nTilesX = 0;
+	int nBlocks;
+	int linesPerBlock = ( compression == ZIP_COMPRESSION ) ? ZIP_LINES_PER_BLOCK : 1;
+	if( tiled )
+	{
+		nTilesX = ( width + tileSize - 1 ) / tileSize;
+		int nTilesY = ( height + tileSize - 1 ) / tileSize;
+		nBlocks = nTilesX * nTilesY;
+	}
+	else
+	{
+		nBlocks = ( height + linesPerBlock - 1 ) / linesPerBlock;
+	}
+
+	// encode every block (with its chunk header) in parallel
+	std::vector< QByteArray > blocks( nBlocks );
+	Concurrency::parallel_for( 0, nBlocks, [&]( int b )
+	{
+		QByteArray& block = blocks[ b ];
+
+		int x0 = 0;
+		int blockWidth = width;
+		int line0;
+		int nLines;
+		if( tiled )
+		{
+			int tileX = b % nTilesX;
+			int tileY = b / nTilesX;
+			x0 = tileX * tileSize;
+			line0 = tileY * tileSize;
+			blockWidth = std::min( tileSize, width - x0 );
+			nLines = std::min( tileSize, height - line0 );
+
+			appendLE< int32 >( tileX, block );
+			appendLE< int32 >( tileY, block );
+			appendLE< int32 >( 0, block ); // level
+			appendLE< int32 >( 0, block );
+		}
+		else
+		{
+			line0 = b * linesPerBlock;
+			nLines = std::min( linesPerBlock, height - line0 );
+			appendLE< int32 >( line0, block );
+		}
+
+		int rawSize = nLines * blockWidth * nComponents * valueSize;
+		std::vector< ubyte > raw( rawSize );
+		ubyte* output = &( raw[ 0 ] );
+		for( int l = 0; l < nLines; ++l )
+		{
+			int y = height - 1 - ( line0 + l );
+			const float* row = pixels + ( static_cast< int64 >( y ) * width + x0 ) * nComponents;
+			for( int i = 0; i < nComponents; ++i )
+			{
+				encodeValues( row + sortedComponents[ i ], nComponents, pixelType, blockWidth, output );
+				output += blockWidth * valueSize;
+			}
+		}
+
+		QByteArray compressed;
+		if( compression != NO_COMPRESSION )
+		{
+			compressed = compressZIP( &( raw[ 0 ] ), rawSize );
+		}
+
+		// store raw if compression doesn't help
+		if( compression == NO_COMPRESSION || compressed.size() >= rawSize )
+		{
+			appendLE< int32 >( rawSize, block );
+			block.append( reinterpret_cast< const char* >( &( raw[ 0 ] ) ), rawSize );
+		}
+		else
+		{
+			appendLE< int32 >( compressed.size(), block );
+			block.append( compressed );
+		}
+	} );
+
+	// ----- offset table -----
+	QByteArray offsets;
+	int64 offset = header.size() + 8 * static_cast< int64 >( nBlocks );
+	for( int b = 0; b < nBlocks; ++b )
+	{
+		appendLE< uint64 >( offset, offsets );
+		offset += blocks[ b ].size();
+	}
+
+	QFile outputFile( filename );
+	if( !( outputFile.open( QIODevice::WriteOnly ) ) )
+	{
+		fprintf( stderr, "Unable to open %s for writing\n", qPrintable( filename ) );
+		return false;
+	}
+
+	bool succeeded =
+		outputFile.write( header ) == header.size() &&
+		outputFile.write( offsets ) == offsets.size();
+	for( int b = 0; b < nBlocks && succeeded; ++b )
+	{
+		succeeded = ( outputFile.write( blocks[ b ] ) == blocks[ b ].size() );
+	}
+	outputFile.close();
+
+	if( !succeeded )
+	{
+		fprintf( stderr, "Unable to write %s\n", qPrintable( filename ) );
+	}
+	return succeeded;
+}
@@ -0,0 +1,406 @@
+#include "io/PLYHeader.h"
+
+#include <cstdio>
+#include <cstring>
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+PLYHeader::Property::Property() :
+
+	type( INVALID_TYPE ),
+	isList( false ),
+	countType( INVALID_TYPE )
+
+{
+
+}
+
+PLYHeader::Element::Element() :
+
+	count( 0 )
+
+{
+
+}
+
+PLYHeader::PLYHeader() :
+
+	m_format( BINARY_LITTLE_ENDIAN )
+
+{
+
+}
+
+PLYHeader::Format PLYHeader::format() const
+{
+	return m_format;
+}
+
+void PLYHeader::setFormat( Format format )
+{
+	m_format = format;
+}
+
+const QStringList& PLYHeader::comments() const
+{
+	return m_comments;
+}
+
+void PLYHeader::addComment( QString comment )
+{
+	m_comments.append( comment );
+}
+
+int PLYHeader::numElements() const
+{
+	return static_cast< int >( m_elements.size() );
+}
+
+const PLYHeader::Element& PLYHeader::element( int elementIndex ) const
+{
+	return m_elements[ elementIndex ];
+}
+
+const std::vector< PLYHeader::Element >& PLYHeader::elements() const
+{
+	return m_elements;
+}
+
+int PLYHeader::findElement( QString name ) const
+{
+	for( int i = 0; i < numElements(); ++i )
+	{
+		if( m_elements[ i ].name == name )
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int PLYHeader::findProperty( int elementIndex, QString name ) const
+{
+	const std::vector< Property >& properties = m_elements[ elementIndex ].properties;
+	for( int i = 0; i < static_cast< int >( properties.size() ); ++i )
+	{
+		if( properties[ i ].name == name )
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void PLYHeader::addElement( QString name, int64 count )
+{
+	Element element;
+	element.name = name;
+	element.count = count;
+	m_elements.push_back( element );
+}
+
+void PLYHeader::addProperty( QString name, Type type )
+{
+	Property property;
+	property.name = name;
+	property.type = type;
+	m_elements.back().properties.push_back( property );
+}
+
+void PLYHeader::addListProperty( QString name, Type countType, Type valueType )
+{
+	Property property;
+	property.name = name;
+	property.type = valueType;
+	property.isList = true;
+	property.countType = countType;
+	m_elements.back().properties.push_back( property );
+}
+
+int64 PLYHeader::fixedInstanceSize( int elementIndex ) const
+{
+	const std::vector< Property >& properties = m_elements[ elementIndex ].properties;
+	int64 size = 0;
+	for( int i = 0; i < static_cast< int >( properties.size() ); ++i )
+	{
+		if( properties[ i ].isList )
+		{
+			return -1;
+		}
+		size += typeSize( properties[ i ].type );
+	}
+	return size;
+}
+
+bool PLYHeader::parse( const char* begin, const char* end, int64* pDataOffset )
+{
+	m_format = BINARY_LITTLE_ENDIAN;
+	m_comments.clear();
+	m_elements.clear();
+
+	bool hasFormat = false;
+	int lineNumber = 0;
+	const char* p = begin;
+
+	while( p < end )
+	{
+		const char* lineEnd = reinterpret_cast< const char* >( memchr( p, '\n', end - p ) );
+		if( lineEnd == nullptr )
+		{
+			break;
+		}
+		++lineNumber;
+
+		// the header is ascii: tolerate "\r\n" line endings
+		QString line = QString::fromLatin1( p, static_cast< int >( lineEnd - p ) ).trimmed();
+		p = lineEnd + 1;
+
+		if( lineNumber == 1 )
+		{
+			if( line != "ply" )
+			{
+				fprintf( stderr, "Not a PLY file: missing \"ply\" magic number\n" );
+				return false;
+			}
+			continue;
+		}
+
+		QStringList tokens = line.split( QRegExp( "\\s+" ), QString::SkipEmptyParts );
+		if( tokens.size() == 0 )
+		{
+			continue;
+		}
+
+		QString command = tokens[ 0 ];
+		if( command == "end_header" )
+		{
+			if( !hasFormat )
+			{
+				fprintf( stderr, "PLY header has no format\n" );
+				return false;
+			}
+			*pDataOffset = p - begin;
+			return true;
+		}
+		else if( command == "comment" || command == "obj_info" )
+		{
+			m_comments.append( line.mid( command.length() ).trimmed() );
+		}
+		else if( command == "format" )
+		{
+			if( tokens.size() < 2 )
+			{
+				fprintf( stderr, "PLY header line %d: malformed format\n", lineNumber );
+				return false;
+			}
+			if( tokens[ 1 ] == "ascii" )
+			{
+				m_format = ASCII;
+			}
+			else if( tokens[ 1 ] == "binary_little_endian" )
+			{
+				m_format = BINARY_LITTLE_ENDIAN;
+			}
+			else if( tokens[ 1 ] == "binary_big_endian" )
+			{
+				m_format = BINARY_BIG_ENDIAN;
+			}
+			else
+			{
+				fprintf( stderr, "PLY header line %d: unknown format %s\n",
+					lineNumber, qPrintable( tokens[ 1 ] ) );
+				return false;
+			}
+			hasFormat = true;
+		}
+		else if( command == "element" )
+		{
+			bool ok = false;
+			int64 count = ( tokens.size() == 3 ) ? tokens[ 2 ].toLongLong( &ok ) : 0;
+			if( !ok || count < 0 )
+			{
+				fprintf( stderr, "PLY header line %d: malformed element\n", lineNumber );
+				return false;
+			}
+			addElement( tokens[ 1 ], count );
+		}
+		else if( command == "property" )
+		{
+			if( m_elements.empty() )
+			{
+				fprintf( stderr, "PLY header line %d: property before any element\n", lineNumber );
+				return false;
+			}
+
+			if( tokens.size() == 5 && tokens[ 1 ] == "list" )
+			{
+				Type countType = typeFromName( tokens[ 2 ] );
+				Type valueType = typeFromName( tokens[ 3 ] );
+				if( !isInteger( countType ) || valueType == INVALID_TYPE )
+				{
+					fprintf( stderr, "PLY header line %d: malformed list property\n", lineNumber );
+					return false;
+				}
+				addListProperty( tokens[ 4 ], countType, valueType );
+			}
+			else if( tokens.size() == 3 && typeFromName( tokens[ 1 ] ) != INVALID_TYPE )
+			{
+				addProperty( tokens[ 2 ], typeFromName( tokens[ 1 ] ) );
+			}
+			else
+			{
+				fprintf( stderr, "PLY header line %d: malformed property\n", lineNumber );
+				return false;
+			}
+		}
+		else
+		{
+			fprintf( stderr, "PLY header line %d: unknown keyword %s\n",
+				lineNumber, qPrintable( command ) );
+			return false;
+		}
+	}
+
+	fprintf( stderr, "PLY header has no end_header\n" );
+	return false;
+}
+
+QByteArray PLYHeader::toByteArray() const
+{
+	QString header = "ply\n";
+
+	switch( m_format )
+	{
+	case ASCII:
+		header += "format ascii 1.0\n";
+		break;
+	case BINARY_LITTLE_ENDIAN:
+		header += "format binary_little_endian 1.0\n";
+		break;
+	case BINARY_BIG_ENDIAN:
+		header += "format binary_big_endian 1.0\n";
+		break;
+	}
+
+	for( int i = 0; i < m_comments.size(); ++i )
+	{
+		header += "comment " + m_comments[ i ] + "\n";
+	}
+
+	for( int i = 0; i < numElements(); ++i )
+	{
+		const Element& element = m_elements[ i ];
+		header += "element " + element.name + " " + QString::number( element.count ) + "\n";
+
+		for( int j = 0; j < static_cast< int >( element.properties.size() ); ++j )
+		{
+			const Property& property = element.properties[ j ];
+			if( property.isList )
+			{
+				header += QString( "property list " ) + typeName( property.countType ) + " " +
+					typeName( property.type ) + " " + property.name + "\n";
+			}
+			else
+			{
+				header += QString( "property " ) + typeName( property.type ) + " " + property.name + "\n";
+			}
+		}
+	}
+
+	header += "end_header\n";
+	return header.toLatin1();
+}
+
+// static
+int PLYHeader::typeSize( Type type )
+{
+	switch( type )
+	{
+	case INT8:
+	case UINT8:
+		return 1;
+	case INT16:
+	case UINT16:
+		return 2;
+	case INT32:
+	case UINT32:
+	case FLOAT32:
+		return 4;
+	case FLOAT64:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+// static
+const char* PLYHeader::typeName( Type type )
+{
+	switch( type )
+	{
+	case INT8:
+		return "char";
+	case UINT8:
+		return "uchar";
+	case INT16:
+		return "short";
+	case UINT16:
+		return "ushort";
+	case INT32:
+		return "int";
+	case UINT32:
+		return "uint";
+	case FLOAT32:
+		return "float";
+	case FLOAT64:
+		return "double";
+	default:
+		return "invalid";
+	}
+}
+
+// static
+PLYHeader::Type PLYHeader::typeFromName( const QString& name )
+{
+	if( name == "char" || name == "int8" )
+	{
+		return INT8;
+	}
+	if( name == "uchar" || name == "uint8" )
+	{
+		return UINT8;
+	}
+	if( name == "short" || name == "int16" )
+	{
+		return INT16;
+	}
+	if( name == "ushort" || name == "uint16" )
+	{
+		return UINT16;
+	}
+	if( name == "int" || name == "int32" )
+	{
+		return INT32;
+	}
+	if( name == "uint" || name == "uint32" )
+	{
+		return UINT32;
+	}
+	if( name == "float" || name == "float32" )
+	{
+		return FLOAT32;
+	}
+	if( name == "double" || name == "float64" )
+	{
+		return FLOAT64;
+	}
+	return INVALID_TYPE;
+}
+
+// static
+bool PLYHeader::isInteger( Type type )
+{
+	return( type != INVALID_TYPE && type != FLOAT32 && type != FLOAT64 );
+}
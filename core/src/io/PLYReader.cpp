@@ -0,0 +1,945 @@
+#include "io/PLYReader.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include <ppl.h>
+
+#include "geometry/PointCloud.h"
+#include "geometry/TriangleMesh.h"
+#include "io/ByteOrder.h"
+#include "io/NumberParser.h"
+
+namespace
+{
+	// instances of a fixed size element are decoded in parallel in blocks of this many
+	const int64 DECODE_BLOCK_SIZE = 65536;
+
+	static_assert( sizeof( Vector3f ) == 3 * sizeof( float ), "Vector3f must be tightly packed" );
+
+	template< typename T >
+	inline T loadValue( const ubyte* p, bool swapBytes )
+	{
+		T value;
+		if( !swapBytes || sizeof( T ) == 1 )
+		{
+			memcpy( &value, p, sizeof( T ) );
+		}
+		else if( sizeof( T ) == 2 )
+		{
+			uint16 bits;
+			memcpy( &bits, p, 2 );
+			bits = ByteOrder::swap( bits );
+			memcpy( &value, &bits, 2 );
+		}
+		else if( sizeof( T ) == 4 )
+		{
+			uint32 bits;
+			memcpy( &bits, p, 4 );
+			bits = ByteOrder::swap( bits );
+			memcpy( &value, &bits, 4 );
+		}
+		else
+		{
+			uint64 bits;
+			memcpy( &bits, p, 8 );
+			bits = ByteOrder::swap( bits );
+			memcpy( &value, &bits, 8 );
+		}
+		return value;
+	}
+
+	double loadAsDouble( const ubyte* p, PLYHeader::Type type, bool swapBytes )
+	{
+		switch( type )
+		{
+		case PLYHeader::INT8:
+			return loadValue< sbyte >( p, swapBytes );
+		case PLYHeader::UINT8:
+			return loadValue< ubyte >( p, swapBytes );
+		case PLYHeader::INT16:
+			return loadValue< int16 >( p, swapBytes );
+		case PLYHeader::UINT16:
+			return loadValue< uint16 >( p, swapBytes );
+		case PLYHeader::INT32:
+			return loadValue< int32 >( p, swapBytes );
+		case PLYHeader::UINT32:
+			return loadValue< uint32 >( p, swapBytes );
+		case PLYHeader::FLOAT32:
+			return loadValue< float >( p, swapBytes );
+		case PLYHeader::FLOAT64:
+			return loadValue< double >( p, swapBytes );
+		default:
+			return 0;
+		}
+	}
+
+	template< typename T >
+	double loadDouble( const ubyte* p, bool swapBytes )
+	{
+		return loadValue< T >( p, swapBytes );
+	}
+
+	// loadAsDouble for one type, chosen once per property
+	typedef double ( *DoubleLoader )( const ubyte* p, bool swapBytes );
+
+	DoubleLoader doubleLoader( PLYHeader::Type type )
+	{
+		switch( type )
+		{
+		case PLYHeader::INT8:
+			return &loadDouble< sbyte >;
+		case PLYHeader::UINT8:
+			return &loadDouble< ubyte >;
+		case PLYHeader::INT16:
+			return &loadDouble< int16 >;
+		case PLYHeader::UINT16:
+			return &loadDouble< uint16 >;
+		case PLYHeader::INT32:
+			return &loadDouble< int32 >;
+		case PLYHeader::UINT32:
+			return &loadDouble< uint32 >;
+		case PLYHeader::FLOAT32:
+			return &loadDouble< float >;
+		default:
+			return &loadDouble< double >;
+		}
+	}
+
+	// whether value converts to an int without overflowing (false for NaN)
+	inline bool fitsInInt( double value )
+	{
+		return( value >= INT_MIN && value <= INT_MAX );
+	}
+
+	// decodes the n values of type T at p into output
+	// returns false if one of them doesn't fit in an int
+	template< typename T >
+	bool decodeInts( const ubyte* p, int n, bool swapBytes, int* output )
+	{
+		for( int k = 0; k < n; ++k )
+		{
+			double value = loadValue< T >( p + k * sizeof( T ), swapBytes );
+			if( !fitsInInt( value ) )
+			{
+				return false;
+			}
+			output[ k ] = static_cast< int >( value );
+		}
+		return true;
+	}
+
+	// int32s are already ints: copy them all, then swap them all
+	template<>
+	bool decodeInts< int32 >( const ubyte* p, int n, bool swapBytes, int* output )
+	{
+		memcpy( output, p, n * sizeof( int32 ) );
+		if( swapBytes )
+		{
+			ByteOrder::swap32( output, n );
+		}
+		return true;
+	}
+
+	typedef bool ( *IntDecoder )( const ubyte* p, int n, bool swapBytes, int* output );
+
+	IntDecoder intDecoder( PLYHeader::Type type )
+	{
+		switch( type )
+		{
+		case PLYHeader::INT8:
+			return &decodeInts< sbyte >;
+		case PLYHeader::UINT8:
+			return &decodeInts< ubyte >;
+		case PLYHeader::INT16:
+			return &decodeInts< int16 >;
+		case PLYHeader::UINT16:
+			return &decodeInts< uint16 >;
+		case PLYHeader::INT32:
+			return &decodeInts< int32 >;
+		case PLYHeader::UINT32:
+			return &decodeInts< uint32 >;
+		case PLYHeader::FLOAT32:
+			return &decodeInts< float >;
+		default:
+			return &decodeInts< double >;
+		}
+	}
+
+	// decodes instances [first, last) of one property of a fixed size element
+	template< typename T >
+	void decodeColumn( const ubyte* values, int64 instanceSize, int64 first, int64 last,
+		bool swapBytes, float* output, int stride )
+	{
+		const ubyte* p = values + first * instanceSize;
+		float* q = output + first * stride;
+		for( int64 i = first; i < last; ++i )
+		{
+			*q = static_cast< float >( loadValue< T >( p, swapBytes ) );
+			p += instanceSize;
+			q += stride;
+		}
+	}
+
+	void decodeColumn( PLYHeader::Type type, const ubyte* values, int64 instanceSize,
+		int64 first, int64 last, bool swapBytes, float* output, int stride )
+	{
+		switch( type )
+		{
+		case PLYHeader::INT8:
+			decodeColumn< sbyte >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		case PLYHeader::UINT8:
+			decodeColumn< ubyte >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		case PLYHeader::INT16:
+			decodeColumn< int16 >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		case PLYHeader::UINT16:
+			decodeColumn< uint16 >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		case PLYHeader::INT32:
+			decodeColumn< int32 >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		case PLYHeader::UINT32:
+			decodeColumn< uint32 >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		case PLYHeader::FLOAT32:
+			decodeColumn< float >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		case PLYHeader::FLOAT64:
+			decodeColumn< double >( values, instanceSize, first, last, swapBytes, output, stride );
+			break;
+		default:
+			break;
+		}
+	}
+
+	inline bool isWhitespace( char c )
+	{
+		return( c == ' ' || c == '\t' || c == '\r' || c == '\n' );
+	}
+
+	// parses the next whitespace separated ascii value
+	// returns the end of the value, or nullptr if it's malformed or missing
+	const char* parseASCIIValue( const char* p, const char* end, PLYHeader::Type type, double* value )
+	{
+		while( p < end && isWhitespace( *p ) )
+		{
+			++p;
+		}
+
+		if( PLYHeader::isInteger( type ) )
+		{
+			int i;
+			const char* q = NumberParser::parseInt( p, end, &i );
+			if( q != nullptr && ( q == end || isWhitespace( *q ) ) )
+			{
+				*value = i;
+				return q;
+			}
+		}
+
+		// also catches uints larger than INT_MAX
+		float f;
+		const char* q = NumberParser::parseFloat( p, end, &f );
+		if( q == nullptr || ( q < end && !isWhitespace( *q ) ) )
+		{
+			return nullptr;
+		}
+		*value = f;
+		return q;
+	}
+
+	// the color scale that maps the range of type to [0,1]
+	float colorScale( PLYHeader::Type type )
+	{
+		switch( type )
+		{
+		case PLYHeader::UINT8:
+			return 1.f / 255.f;
+		case PLYHeader::UINT16:
+			return 1.f / 65535.f;
+		default:
+			return 1.f;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+PLYReader::ScalarTarget::ScalarTarget( QString propertyName, float* output, int stride ) :
+
+	propertyName( propertyName ),
+	output( output ),
+	stride( stride )
+
+{
+
+}
+
+PLYReader::ListTarget::ListTarget( QString propertyName,
+	std::vector< int >* counts, std::vector< int >* values ) :
+
+	propertyName( propertyName ),
+	counts( counts ),
+	values( values )
+
+{
+
+}
+
+// static
+bool PLYReader::readTriangleMesh( QString filename, TriangleMesh& mesh )
+{
+	PLYReader reader;
+	if( !reader.open( filename ) )
+	{
+		return false;
+	}
+	const PLYHeader& header = reader.header();
+
+	int vertexElement = header.findElement( "vertex" );
+	if( vertexElement == -1 ||
+		header.findProperty( vertexElement, "x" ) == -1 ||
+		header.findProperty( vertexElement, "y" ) == -1 ||
+		header.findProperty( vertexElement, "z" ) == -1 )
+	{
+		fprintf( stderr, "%s has no vertex positions\n", qPrintable( filename ) );
+		return false;
+	}
+
+	int64 nVertices = header.element( vertexElement ).count;
+	if( nVertices > INT_MAX )
+	{
+		fprintf( stderr, "%s has too many vertices\n", qPrintable( filename ) );
+		return false;
+	}
+
+	TriangleMesh result;
+	result.m_positions.resize( static_cast< size_t >( nVertices ) );
+	result.m_normals.resize( static_cast< size_t >( nVertices ) );
+
+	std::vector< ScalarTarget > vertexTargets;
+	if( nVertices > 0 )
+	{
+		float* positions = reinterpret_cast< float* >( &( result.m_positions[ 0 ] ) );
+		vertexTargets.push_back( ScalarTarget( "x", positions, 3 ) );
+		vertexTargets.push_back( ScalarTarget( "y", positions + 1, 3 ) );
+		vertexTargets.push_back( ScalarTarget( "z", positions + 2, 3 ) );
+
+		if( header.findProperty( vertexElement, "nx" ) != -1 &&
+			header.findProperty( vertexElement, "ny" ) != -1 &&
+			header.findProperty( vertexElement, "nz" ) != -1 )
+		{
+			float* normals = reinterpret_cast< float* >( &( result.m_normals[ 0 ] ) );
+			vertexTargets.push_back( ScalarTarget( "nx", normals, 3 ) );
+			vertexTargets.push_back( ScalarTarget( "ny", normals + 1, 3 ) );
+			vertexTargets.push_back( ScalarTarget( "nz", normals + 2, 3 ) );
+		}
+	}
+
+	if( !reader.readElement( vertexElement, vertexTargets ) )
+	{
+		return false;
+	}
+
+	int faceElement = header.findElement( "face" );
+	if( faceElement != -1 )
+	{
+		QString indicesName = "vertex_indices";
+		if( header.findProperty( faceElement, indicesName ) == -1 )
+		{
+			indicesName = "vertex_index";
+		}
+		if( header.findProperty( faceElement, indicesName ) == -1 )
+		{
+			fprintf( stderr, "%s has faces without vertex indices\n", qPrintable( filename ) );
+			return false;
+		}
+
+		std::vector< int > counts;
+		std::vector< int > indices;
+		std::vector< ListTarget > faceTargets;
+		faceTargets.push_back( ListTarget( indicesName, &counts, &indices ) );
+		if( !reader.readElement( faceElement, std::vector< ScalarTarget >(), faceTargets ) )
+		{
+			return false;
+		}
+
+		int nTriangles = 0;
+		for( int f = 0; f < static_cast< int >( counts.size() ); ++f )
+		{
+			if( counts[ f ] >= 3 )
+			{
+				nTriangles += counts[ f ] - 2;
+			}
+		}
+		result.m_faces.reserve( nTriangles );
+
+		// fan triangulate polygons
+		int nInvalidFaces = 0;
+		const int* faceIndices = indices.empty() ? nullptr : &( indices[ 0 ] );
+		for( int f = 0; f < static_cast< int >( counts.size() ); ++f )
+		{
+			int n = counts[ f ];
+
+			bool valid = ( n >= 3 );
+			for( int i = 0; i < n && valid; ++i )
+			{
+				valid = ( faceIndices[ i ] >= 0 && faceIndices[ i ] < nVertices );
+			}
+
+			if( valid )
+			{
+				for( int i = 1; i < n - 1; ++i )
+				{
+					result.m_faces.push_back( Vector3i( faceIndices[ 0 ], faceIndices[ i ], faceIndices[ i + 1 ] ) );
+				}
+			}
+			else
+			{
+				++nInvalidFaces;
+			}
+
+			faceIndices += n;
+		}
+
+		if( nInvalidFaces > 0 )
+		{
+			fprintf( stderr, "%s: skipped %d degenerate or out of range faces\n",
+				qPrintable( filename ), nInvalidFaces );
+		}
+	}
+
+	mesh = result;
+	return true;
+}
+
+// static
+bool PLYReader::readPointCloud( QString filename, PointCloud& cloud )
+{
+	PLYReader reader;
+	if( !reader.open( filename ) )
+	{
+		return false;
+	}
+	const PLYHeader& header = reader.header();
+
+	int vertexElement = header.findElement( "vertex" );
+	if( vertexElement == -1 ||
+		header.findProperty( vertexElement, "x" ) == -1 ||
+		header.findProperty( vertexElement, "y" ) == -1 ||
+		header.findProperty( vertexElement, "z" ) == -1 )
+	{
+		fprintf( stderr, "%s has no vertex positions\n", qPrintable( filename ) );
+		return false;
+	}
+
+	int64 nVertices = header.element( vertexElement ).count;
+	if( nVertices > INT_MAX )
+	{
+		fprintf( stderr, "%s has too many vertices\n", qPrintable( filename ) );
+		return false;
+	}
+
+	PointCloud result;
+	result.positions().resize( static_cast< size_t >( nVertices ) );
+
+	bool hasNormals =
+		header.findProperty( vertexElement, "nx" ) != -1 &&
+		header.findProperty( vertexElement, "ny" ) != -1 &&
+		header.findProperty( vertexElement, "nz" ) != -1;
+	int redProperty = header.findProperty( vertexElement, "red" );
+	bool hasColors = redProperty != -1 &&
+		header.findProperty( vertexElement, "green" ) != -1 &&
+		header.findProperty( vertexElement, "blue" ) != -1;
+
+	std::vector< ScalarTarget > vertexTargets;
+	if( nVertices > 0 )
+	{
+		float* positions = reinterpret_cast< float* >( &( result.positions()[ 0 ] ) );
+		vertexTargets.push_back( ScalarTarget( "x", positions, 3 ) );
+		vertexTargets.push_back( ScalarTarget( "y", positions + 1, 3 ) );
+		vertexTargets.push_back( ScalarTarget( "z", positions + 2, 3 ) );
+
+		if( hasNormals )
+		{
+			result.normals().resize( static_cast< size_t >( nVertices ) );
+			float* normals = reinterpret_cast< float* >( &( result.normals()[ 0 ] ) );
+			vertexTargets.push_back( ScalarTarget( "nx", normals, 3 ) );
+			vertexTargets.push_back( ScalarTarget( "ny", normals + 1, 3 ) );
+			vertexTargets.push_back( ScalarTarget( "nz", normals + 2, 3 ) );
+		}
+
+		if( hasColors )
+		{
+			result.colors().resize( static_cast< size_t >( nVertices ) );
+			float* colors = reinterpret_cast< float* >( &( result.colors()[ 0 ] ) );
+			vertexTargets.push_back( ScalarTarget( "red", colors, 3 ) );
+			vertexTargets.push_back( ScalarTarget( "green", colors + 1, 3 ) );
+			vertexTargets.push_back( ScalarTarget( "blue", colors + 2, 3 ) );
+		}
+	}
+
+	if( !reader.readElement( vertexElement, vertexTargets ) )
+	{
+		return false;
+	}
+
+	if( hasColors )
+	{
+		float scale = colorScale( header.element( vertexElement ).properties[ redProperty ].type );
+		if( scale != 1.f )
+		{
+			std::vector< Vector3f >& colors = result.colors();
+			for( int i = 0; i < static_cast< int >( colors.size() ); ++i )
+			{
+				colors[ i ] = scale * colors[ i ];
+			}
+		}
+	}
+
+	cloud = result;
+	return true;
+}
+
+PLYReader::PLYReader() :
+
+	m_swapBytes( false )
+
+{
+
+}
+
+bool PLYReader::open( QString filename )
+{
+	close();
+
+	if( !m_file.open( filename, MappedFile::SEQUENTIAL ) )
+	{
+		fprintf( stderr, "Unable to open %s\n", qPrintable( filename ) );
+		return false;
+	}
+
+	int64 dataOffset;
+	if( !m_header.parse( m_file.charData(), m_file.charData() + m_file.size(), &dataOffset ) )
+	{
+		fprintf( stderr, "Unable to parse the header of %s\n", qPrintable( filename ) );
+		close();
+		return false;
+	}
+
+	m_swapBytes =
+		( m_header.format() == PLYHeader::BINARY_LITTLE_ENDIAN && !ByteOrder::isLittleEndian() ) ||
+		( m_header.format() == PLYHeader::BINARY_BIG_ENDIAN && ByteOrder::isLittleEndian() );
+
+	m_elementOffsets.assign( m_header.numElements() + 1, -1 );
+	m_elementOffsets[ 0 ] = dataOffset;
+
+	return true;
+}
+
+void PLYReader::close()
+{
+	m_file.close();
+	m_header = PLYHeader();
+	m_swapBytes = false;
+	m_elementOffsets.clear();
+}
+
+bool PLYReader::isOpen() const
+{
+	return m_file.isOpen();
+}
+
+const PLYHeader& PLYReader::header() const
+{
+	return m_header;
+}
+
+bool PLYReader::readElement( int elementIndex,
+	const std::vector< ScalarTarget >& scalars,
+	const std::vector< ListTarget >& lists )
+{
+	if( !isOpen() || elementIndex < 0 || elementIndex >= m_header.numElements() )
+	{
+		fprintf( stderr, "PLYReader: invalid element %d\n", elementIndex );
+		return false;
+	}
+
+	const PLYHeader::Element& element = m_header.element( elementIndex );
+	int nProperties = static_cast< int >( element.properties.size() );
+
+	// the target of each property, if any
+	std::vector< const ScalarTarget* > scalarTargets( nProperties, nullptr );
+	std::vector< const ListTarget* > listTargets( nProperties, nullptr );
+
+	for( int i = 0; i < static_cast< int >( scalars.size() ); ++i )
+	{
+		int p = m_header.findProperty( elementIndex, scalars[ i ].propertyName );
+		if( p == -1 || element.properties[ p ].isList )
+		{
+			fprintf( stderr, "PLYReader: element %s has no scalar property %s\n",
+				qPrintable( element.name ), qPrintable( scalars[ i ].propertyName ) );
+			return false;
+		}
+		scalarTargets[ p ] = &( scalars[ i ] );
+	}
+
+	for( int i = 0; i < static_cast< int >( lists.size() ); ++i )
+	{
+		int p = m_header.findProperty( elementIndex, lists[ i ].propertyName );
+		if( p == -1 || !element.properties[ p ].isList )
+		{
+			fprintf( stderr, "PLYReader: element %s has no list property %s\n",
+				qPrintable( element.name ), qPrintable( lists[ i ].propertyName ) );
+			return false;
+		}
+		listTargets[ p ] = &( lists[ i ] );
+	}
+
+	int64 offset = elementOffset( elementIndex );
+	if( offset == -1 )
+	{
+		return false;
+	}
+
+	int64 endOffset;
+	if( m_header.format() == PLYHeader::ASCII )
+	{
+		endOffset = readASCIIElement( elementIndex, offset, scalarTargets, listTargets );
+	}
+	else
+	{
+		endOffset = readBinaryElement( elementIndex, offset, scalarTargets, listTargets );
+	}
+
+	if( endOffset == -1 )
+	{
+		return false;
+	}
+
+	m_elementOffsets[ elementIndex + 1 ] = endOffset;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+int64 PLYReader::elementOffset( int elementIndex )
+{
+	// find the last element with a known offset
+	int known = elementIndex;
+	while( m_elementOffsets[ known ] == -1 )
+	{
+		--known;
+	}
+
+	// and skip over the elements after it
+	std::vector< const ScalarTarget* > noScalarTargets;
+	std::vector< const ListTarget* > noListTargets;
+	for( int i = known; i < elementIndex; ++i )
+	{
+		int nProperties = static_cast< int >( m_header.element( i ).properties.size() );
+		noScalarTargets.assign( nProperties, nullptr );
+		noListTargets.assign( nProperties, nullptr );
+
+		int64 endOffset;
+		if( m_header.format() == PLYHeader::ASCII )
+		{
+			endOffset = readASCIIElement( i, m_elementOffsets[ i ], noScalarTargets, noListTargets );
+		}
+		else
+		{
+			endOffset = readBinaryElement( i, m_elementOffsets[ i ], noScalarTargets, noListTargets );
+		}
+
+		if( endOffset == -1 )
+		{
+			return -1;
+		}
+		m_elementOffsets[ i + 1 ] = endOffset;
+	}
+
+	return m_elementOffsets[ elementIndex ];
+}
+
+int64 PLYReader::readBinaryElement( int elementIndex, int64 offset,
+	const std::vector< const ScalarTarget* >& scalarTargets,
+	const std::vector< const ListTarget* >& listTargets )
+{
+	const PLYHeader::Element& element = m_header.element( elementIndex );
+	const std::vector< PLYHeader::Property >& properties = element.properties;
+	int nProperties = static_cast< int >( properties.size() );
+	int64 count = element.count;
+	bool swapBytes = m_swapBytes;
+
+	int64 instanceSize = m_header.fixedInstanceSize( elementIndex );
+	if( instanceSize >= 0 )
+	{
+		// fixed size: every property is a strided column that can be decoded independently
+		if( instanceSize > 0 && count > ( m_file.size() - offset ) / instanceSize )
+		{
+			fprintf( stderr, "PLYReader: element %s is truncated\n", qPrintable( element.name ) );
+			return -1;
+		}
+
+		std::vector< int64 > propertyOffsets( nProperties );
+		int64 propertyOffset = 0;
+		bool hasTargets = false;
+		for( int p = 0; p < nProperties; ++p )
+		{
+			propertyOffsets[ p ] = propertyOffset;
+			propertyOffset += PLYHeader::typeSize( properties[ p ].type );
+			hasTargets |= ( scalarTargets[ p ] != nullptr );
+		}
+
+		if( hasTargets && count > 0 )
+		{
+			const ubyte* values = m_file.data() + offset;
+			int nBlocks = static_cast< int >( ( count + DECODE_BLOCK_SIZE - 1 ) / DECODE_BLOCK_SIZE );
+			Concurrency::parallel_for( 0, nBlocks, [&]( int block )
+			{
+				int64 first = block * DECODE_BLOCK_SIZE;
+				int64 last = std::min( first + DECODE_BLOCK_SIZE, count );
+				for( int p = 0; p < nProperties; ++p )
+				{
+					const ScalarTarget* target = scalarTargets[ p ];
+					if( target != nullptr )
+					{
+						decodeColumn( properties[ p ].type, values + propertyOffsets[ p ], instanceSize,
+							first, last, swapBytes, target->output, target->stride );
+					}
+				}
+			} );
+		}
+
+		return offset + count * instanceSize;
+	}
+
+	// variable size: a first pass checks the list lengths
+	// and counts the values of each list, so the targets can be sized once,
+	// then a second decodes straight into them
+	// the loaders and decoders for each property's types are chosen up front
+	std::vector< DoubleLoader > loaders( nProperties, nullptr );
+	std::vector< IntDecoder > decoders( nProperties, nullptr );
+	std::vector< int64 > nValues( nProperties, 0 );
+	bool hasTargets = false;
+	for( int j = 0; j < nProperties; ++j )
+	{
+		const PLYHeader::Property& property = properties[ j ];
+		if( property.isList )
+		{
+			loaders[ j ] = doubleLoader( property.countType );
+			decoders[ j ] = intDecoder( property.type );
+		}
+		else
+		{
+			loaders[ j ] = doubleLoader( property.type );
+		}
+		hasTargets |= ( scalarTargets[ j ] != nullptr || listTargets[ j ] != nullptr );
+	}
+
+	const ubyte* data = m_file.data();
+	const ubyte* end = data + m_file.size();
+
+	const ubyte* p = data + offset;
+	for( int64 i = 0; i < count; ++i )
+	{
+		for( int j = 0; j < nProperties; ++j )
+		{
+			const PLYHeader::Property& property = properties[ j ];
+			int valueSize = PLYHeader::typeSize( property.type );
+
+			if( !property.isList )
+			{
+				if( end - p < valueSize )
+				{
+					fprintf( stderr, "PLYReader: element %s is truncated\n", qPrintable( element.name ) );
+					return -1;
+				}
+				p += valueSize;
+			}
+			else
+			{
+				int countSize = PLYHeader::typeSize( property.countType );
+				if( end - p < countSize )
+				{
+					fprintf( stderr, "PLYReader: element %s is truncated\n", qPrintable( element.name ) );
+					return -1;
+				}
+
+				double listLength = loaders[ j ]( p, swapBytes );
+				p += countSize;
+				if( !( listLength >= 0 && listLength <= INT_MAX ) || listLength * valueSize > end - p )
+				{
+					fprintf( stderr, "PLYReader: element %s is truncated or has an invalid list length\n",
+						qPrintable( element.name ) );
+					return -1;
+				}
+				int n = static_cast< int >( listLength );
+				nValues[ j ] += n;
+				p += static_cast< int64 >( n ) * valueSize;
+			}
+		}
+	}
+	int64 endOffset = p - data;
+
+	if( !hasTargets )
+	{
+		return endOffset;
+	}
+
+	// where each list target's counts and values go
+	std::vector< size_t > oldCounts( nProperties, 0 );
+	std::vector< size_t > oldValues( nProperties, 0 );
+	std::vector< int* > countOutputs( nProperties, nullptr );
+	std::vector< int* > valueOutputs( nProperties, nullptr );
+	for( int j = 0; j < nProperties; ++j )
+	{
+		const ListTarget* target = listTargets[ j ];
+		if( target != nullptr )
+		{
+			oldCounts[ j ] = target->counts->size();
+			oldValues[ j ] = target->values->size();
+			target->counts->resize( oldCounts[ j ] + static_cast< size_t >( count ) );
+			target->values->resize( oldValues[ j ] + static_cast< size_t >( nValues[ j ] ) );
+			if( count > 0 )
+			{
+				countOutputs[ j ] = &( ( *( target->counts ) )[ oldCounts[ j ] ] );
+			}
+			if( nValues[ j ] > 0 )
+			{
+				valueOutputs[ j ] = &( ( *( target->values ) )[ oldValues[ j ] ] );
+			}
+		}
+	}
+
+	p = data + offset;
+	for( int64 i = 0; i < count; ++i )
+	{
+		for( int j = 0; j < nProperties; ++j )
+		{
+			const PLYHeader::Property& property = properties[ j ];
+			int valueSize = PLYHeader::typeSize( property.type );
+
+			if( !property.isList )
+			{
+				const ScalarTarget* target = scalarTargets[ j ];
+				if( target != nullptr )
+				{
+					target->output[ i * target->stride ] = static_cast< float >( loaders[ j ]( p, swapBytes ) );
+				}
+				p += valueSize;
+				continue;
+			}
+
+			int n = static_cast< int >( loaders[ j ]( p, swapBytes ) );
+			p += PLYHeader::typeSize( property.countType );
+
+			const ListTarget* target = listTargets[ j ];
+			if( target != nullptr )
+			{
+				*( countOutputs[ j ]++ ) = n;
+				if( !decoders[ j ]( p, n, swapBytes, valueOutputs[ j ] ) )
+				{
+					fprintf( stderr, "PLYReader: element %s instance %lld: %s has a value that is not an int\n",
+						qPrintable( element.name ), i, qPrintable( property.name ) );
+					for( int k = 0; k < nProperties; ++k )
+					{
+						if( listTargets[ k ] != nullptr )
+						{
+							listTargets[ k ]->counts->resize( oldCounts[ k ] );
+							listTargets[ k ]->values->resize( oldValues[ k ] );
+						}
+					}
+					return -1;
+				}
+				valueOutputs[ j ] += n;
+			}
+			p += static_cast< int64 >( n ) * valueSize;
+		}
+	}
+
+	return endOffset;
+}
+
+int64 PLYReader::readASCIIElement( int elementIndex, int64 offset,
+	const std::vector< const ScalarTarget* >& scalarTargets,
+	const std::vector< const ListTarget* >& listTargets )
+{
+	const PLYHeader::Element& element = m_header.element( elementIndex );
+	const std::vector< PLYHeader::Property >& properties = element.properties;
+	int nProperties = static_cast< int >( properties.size() );
+	int64 count = element.count;
+
+	const char* begin = m_file.charData();
+	const char* p = begin + offset;
+	const char* end = begin + m_file.size();
+
+	for( int64 i = 0; i < count; ++i )
+	{
+		for( int j = 0; j < nProperties; ++j )
+		{
+			const PLYHeader::Property& property = properties[ j ];
+			double value;
+
+			if( !property.isList )
+			{
+				p = parseASCIIValue( p, end, property.type, &value );
+				if( p == nullptr )
+				{
+					fprintf( stderr, "PLYReader: element %s instance %lld: malformed %s\n",
+						qPrintable( element.name ), i, qPrintable( property.name ) );
+					return -1;
+				}
+
+				const ScalarTarget* target = scalarTargets[ j ];
+				if( target != nullptr )
+				{
+					target->output[ i * target->stride ] = static_cast< float >( value );
+				}
+			}
+			else
+			{
+				p = parseASCIIValue( p, end, property.countType, &value );
+				if( p == nullptr || !( value >= 0 && value <= INT_MAX ) )
+				{
+					fprintf( stderr, "PLYReader: element %s instance %lld: malformed %s\n",
+						qPrintable( element.name ), i, qPrintable( property.name ) );
+					return -1;
+				}
+				int n = static_cast< int >( value );
+
+				const ListTarget* target = listTargets[ j ];
+				if( target != nullptr )
+				{
+					target->counts->push_back( n );
+				}
+
+				for( int k = 0; k < n; ++k )
+				{
+					p = parseASCIIValue( p, end, property.type, &value );
+					if( p == nullptr || !fitsInInt( value ) )
+					{
+						fprintf( stderr, "PLYReader: element %s instance %lld: malformed %s\n",
+							qPrintable( element.name ), i, qPrintable( property.name ) );
+						return -1;
+					}
+					if( target != nullptr )
+					{
+						target->values->push_back( static_cast< int >( value ) );
+					}
+				}
+			}
+		}
+	}
+
+	return p - begin;
+}
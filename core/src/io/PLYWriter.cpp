@@ -0,0 +1,691 @@
+#include "io/PLYWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <QByteArray>
+#include <QFile>
+
+#include "geometry/PointCloud.h"
+#include "geometry/TriangleMesh.h"
+#include "io/ByteOrder.h"
+
+namespace
+{
+	// the buffer is written out when it grows past this many bytes
+	const size_t FLUSH_THRESHOLD = 1 << 20;
+
+	// binary instances are encoded a property at a time, in blocks of this many
+	const int64 ENCODE_BLOCK_SIZE = 16384;
+
+	static_assert( sizeof( Vector3f ) == 3 * sizeof( float ), "Vector3f must be tightly packed" );
+	static_assert( sizeof( Vector3i ) == 3 * sizeof( int ), "Vector3i must be tightly packed" );
+
+	// rounds value to the nearest integer in [minValue, maxValue]
+	double roundAndClamp( double value, double minValue, double maxValue )
+	{
+		value = floor( value + 0.5 );
+		if( value < minValue )
+		{
+			return minValue;
+		}
+		if( value > maxValue )
+		{
+			return maxValue;
+		}
+		return value;
+	}
+
+	// value as a T: integers are rounded and clamped to the range of T
+	template< typename T >
+	inline T convertValue( double value )
+	{
+		if( std::numeric_limits< T >::is_integer )
+		{
+			return static_cast< T >( roundAndClamp( value,
+				static_cast< double >( std::numeric_limits< T >::min() ),
+				static_cast< double >( std::numeric_limits< T >::max() ) ) );
+		}
+		return static_cast< T >( value );
+	}
+
+	template< typename T >
+	inline void storeValue( T value, bool swapBytes, ubyte* p )
+	{
+		if( !swapBytes || sizeof( T ) == 1 )
+		{
+			memcpy( p, &value, sizeof( T ) );
+		}
+		else if( sizeof( T ) == 2 )
+		{
+			uint16 bits;
+			memcpy( &bits, &value, 2 );
+			bits = ByteOrder::swap( bits );
+			memcpy( p, &bits, 2 );
+		}
+		else if( sizeof( T ) == 4 )
+		{
+			uint32 bits;
+			memcpy( &bits, &value, 4 );
+			bits = ByteOrder::swap( bits );
+			memcpy( p, &bits, 4 );
+		}
+		else
+		{
+			uint64 bits;
+			memcpy( &bits, &value, 8 );
+			bits = ByteOrder::swap( bits );
+			memcpy( p, &bits, 8 );
+		}
+	}
+
+	// encodes instances [first, last) of one scalar property,
+	// instance i at output + cursors[ i - first ], and advances the cursors past it
+	template< typename T >
+	void encodeColumn( const float* input, int stride, int64 first, int64 last,
+		bool swapBytes, ubyte* output, int64* cursors )
+	{
+		const float* p = input + first * stride;
+		for( int64 i = 0; i < last - first; ++i )
+		{
+			storeValue( convertValue< T >( *p ), swapBytes, output + cursors[ i ] );
+			cursors[ i ] += sizeof( T );
+			p += stride;
+		}
+	}
+
+	void encodeColumn( PLYHeader::Type type, const float* input, int stride, int64 first, int64 last,
+		bool swapBytes, ubyte* output, int64* cursors )
+	{
+		switch( type )
+		{
+		case PLYHeader::INT8:
+			encodeColumn< sbyte >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		case PLYHeader::UINT8:
+			encodeColumn< ubyte >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		case PLYHeader::INT16:
+			encodeColumn< int16 >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		case PLYHeader::UINT16:
+			encodeColumn< uint16 >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		case PLYHeader::INT32:
+			encodeColumn< int32 >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		case PLYHeader::UINT32:
+			encodeColumn< uint32 >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		case PLYHeader::FLOAT32:
+			encodeColumn< float >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		case PLYHeader::FLOAT64:
+			encodeColumn< double >( input, stride, first, last, swapBytes, output, cursors );
+			break;
+		default:
+			break;
+		}
+	}
+
+	// encodes n ints as T at output
+	// returns the end of what was written
+	template< typename T >
+	ubyte* encodeInts( const int* values, int n, bool swapBytes, ubyte* output )
+	{
+		for( int k = 0; k < n; ++k )
+		{
+			storeValue( convertValue< T >( values[ k ] ), swapBytes, output );
+			output += sizeof( T );
+		}
+		return output;
+	}
+
+	// ints are already int32s: copy them all, then swap them all
+	template<>
+	ubyte* encodeInts< int32 >( const int* values, int n, bool swapBytes, ubyte* output )
+	{
+		memcpy( output, values, n * sizeof( int32 ) );
+		if( swapBytes )
+		{
+			ByteOrder::swap32( output, n );
+		}
+		return output + n * sizeof( int32 );
+	}
+
+	typedef ubyte* ( *IntEncoder )( const int* values, int n, bool swapBytes, ubyte* output );
+
+	IntEncoder intEncoder( PLYHeader::Type type )
+	{
+		switch( type )
+		{
+		case PLYHeader::INT8:
+			return &encodeInts< sbyte >;
+		case PLYHeader::UINT8:
+			return &encodeInts< ubyte >;
+		case PLYHeader::INT16:
+			return &encodeInts< int16 >;
+		case PLYHeader::UINT16:
+			return &encodeInts< uint16 >;
+		case PLYHeader::INT32:
+			return &encodeInts< int32 >;
+		case PLYHeader::UINT32:
+			return &encodeInts< uint32 >;
+		case PLYHeader::FLOAT32:
+			return &encodeInts< float >;
+		default:
+			return &encodeInts< double >;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+PLYWriter::ScalarSource::ScalarSource( QString propertyName, const float* input, int stride ) :
+
+	propertyName( propertyName ),
+	input( input ),
+	stride( stride )
+
+{
+
+}
+
+PLYWriter::ListSource::ListSource( QString propertyName, const int* counts, const int* values ) :
+
+	propertyName( propertyName ),
+	counts( counts ),
+	fixedCount( 0 ),
+	values( values )
+
+{
+
+}
+
+PLYWriter::ListSource::ListSource( QString propertyName, int fixedCount, const int* values ) :
+
+	propertyName( propertyName ),
+	counts( nullptr ),
+	fixedCount( fixedCount ),
+	values( values )
+
+{
+
+}
+
+// static
+bool PLYWriter::writeTriangleMesh( QString filename, const TriangleMesh& mesh, PLYHeader::Format format )
+{
+	int nVertices = static_cast< int >( mesh.m_positions.size() );
+	int nFaces = static_cast< int >( mesh.m_faces.size() );
+	bool hasNormals = ( nVertices > 0 && mesh.m_normals.size() == mesh.m_positions.size() );
+
+	PLYHeader header;
+	header.setFormat( format );
+	header.addElement( "vertex", nVertices );
+	header.addProperty( "x", PLYHeader::FLOAT32 );
+	header.addProperty( "y", PLYHeader::FLOAT32 );
+	header.addProperty( "z", PLYHeader::FLOAT32 );
+	if( hasNormals )
+	{
+		header.addProperty( "nx", PLYHeader::FLOAT32 );
+		header.addProperty( "ny", PLYHeader::FLOAT32 );
+		header.addProperty( "nz", PLYHeader::FLOAT32 );
+	}
+	header.addElement( "face", nFaces );
+	header.addListProperty( "vertex_indices", PLYHeader::UINT8, PLYHeader::INT32 );
+
+	std::vector< ScalarSource > vertexSources;
+	if( nVertices > 0 )
+	{
+		const float* positions = reinterpret_cast< const float* >( &( mesh.m_positions[ 0 ] ) );
+		vertexSources.push_back( ScalarSource( "x", positions, 3 ) );
+		vertexSources.push_back( ScalarSource( "y", positions + 1, 3 ) );
+		vertexSources.push_back( ScalarSource( "z", positions + 2, 3 ) );
+		if( hasNormals )
+		{
+			const float* normals = reinterpret_cast< const float* >( &( mesh.m_normals[ 0 ] ) );
+			vertexSources.push_back( ScalarSource( "nx", normals, 3 ) );
+			vertexSources.push_back( ScalarSource( "ny", normals + 1, 3 ) );
+			vertexSources.push_back( ScalarSource( "nz", normals + 2, 3 ) );
+		}
+	}
+
+	std::vector< ListSource > faceSources;
+	if( nFaces > 0 )
+	{
+		faceSources.push_back( ListSource( "vertex_indices", 3,
+			reinterpret_cast< const int* >( &( mesh.m_faces[ 0 ] ) ) ) );
+	}
+
+	PLYWriter writer;
+	if( !writer.open( filename, header ) )
+	{
+		return false;
+	}
+	writer.writeElement( 0, vertexSources );
+	writer.writeElement( 1, std::vector< ScalarSource >(), faceSources );
+	return writer.close();
+}
+
+// static
+bool PLYWriter::writePointCloud( QString filename, const PointCloud& cloud, PLYHeader::Format format )
+{
+	int nPoints = cloud.numPoints();
+
+	PLYHeader header;
+	header.setFormat( format );
+	header.addElement( "vertex", nPoints );
+	header.addProperty( "x", PLYHeader::FLOAT32 );
+	header.addProperty( "y", PLYHeader::FLOAT32 );
+	header.addProperty( "z", PLYHeader::FLOAT32 );
+	if( cloud.hasNormals() )
+	{
+		header.addProperty( "nx", PLYHeader::FLOAT32 );
+		header.addProperty( "ny", PLYHeader::FLOAT32 );
+		header.addProperty( "nz", PLYHeader::FLOAT32 );
+	}
+	if( cloud.hasColors() )
+	{
+		header.addProperty( "red", PLYHeader::UINT8 );
+		header.addProperty( "green", PLYHeader::UINT8 );
+		header.addProperty( "blue", PLYHeader::UINT8 );
+	}
+
+	// colors are written as uchars in [0,255]
+	std::vector< Vector3f > colors;
+
+	std::vector< ScalarSource > sources;
+	if( nPoints > 0 )
+	{
+		const float* positions = reinterpret_cast< const float* >( &( cloud.positions()[ 0 ] ) );
+		sources.push_back( ScalarSource( "x", positions, 3 ) );
+		sources.push_back( ScalarSource( "y", positions + 1, 3 ) );
+		sources.push_back( ScalarSource( "z", positions + 2, 3 ) );
+
+		if( cloud.hasNormals() )
+		{
+			const float* normals = reinterpret_cast< const float* >( &( cloud.normals()[ 0 ] ) );
+			sources.push_back( ScalarSource( "nx", normals, 3 ) );
+			sources.push_back( ScalarSource( "ny", normals + 1, 3 ) );
+			sources.push_back( ScalarSource( "nz", normals + 2, 3 ) );
+		}
+
+		if( cloud.hasColors() )
+		{
+			colors.resize( nPoints );
+			for( int i = 0; i < nPoints; ++i )
+			{
+				colors[ i ] = 255.f * cloud.colors()[ i ];
+			}
+
+			const float* pColors = reinterpret_cast< const float* >( &( colors[ 0 ] ) );
+			sources.push_back( ScalarSource( "red", pColors, 3 ) );
+			sources.push_back( ScalarSource( "green", pColors + 1, 3 ) );
+			sources.push_back( ScalarSource( "blue", pColors + 2, 3 ) );
+		}
+	}
+
+	PLYWriter writer;
+	if( !writer.open( filename, header ) )
+	{
+		return false;
+	}
+	writer.writeElement( 0, sources );
+	return writer.close();
+}
+
+PLYWriter::PLYWriter() :
+
+	m_pFilePointer( nullptr ),
+	m_swapBytes( false ),
+	m_nextElement( 0 ),
+	m_failed( false )
+
+{
+
+}
+
+// virtual
+PLYWriter::~PLYWriter()
+{
+	close();
+}
+
+bool PLYWriter::open( QString filename, const PLYHeader& header )
+{
+	close();
+
+	m_pFilePointer = fopen( QFile::encodeName( filename ).constData(), "wb" );
+	if( m_pFilePointer == nullptr )
+	{
+		fprintf( stderr, "Unable to open %s for writing\n", qPrintable( filename ) );
+		return false;
+	}
+
+	m_header = header;
+	m_swapBytes =
+		( header.format() == PLYHeader::BINARY_LITTLE_ENDIAN && !ByteOrder::isLittleEndian() ) ||
+		( header.format() == PLYHeader::BINARY_BIG_ENDIAN && ByteOrder::isLittleEndian() );
+	m_nextElement = 0;
+	m_failed = false;
+
+	QByteArray headerBytes = header.toByteArray();
+	m_buffer.reserve( FLUSH_THRESHOLD + FLUSH_THRESHOLD / 2 );
+	m_buffer.assign( headerBytes.constData(), headerBytes.constData() + headerBytes.size() );
+	return true;
+}
+
+bool PLYWriter::close()
+{
+	if( m_pFilePointer == nullptr )
+	{
+		return false;
+	}
+
+	flush();
+	if( fclose( m_pFilePointer ) != 0 )
+	{
+		m_failed = true;
+	}
+	m_pFilePointer = nullptr;
+
+	if( m_nextElement != m_header.numElements() )
+	{
+		fprintf( stderr, "PLYWriter: only %d of %d elements were written\n",
+			m_nextElement, m_header.numElements() );
+		m_failed = true;
+	}
+
+	std::vector< char >().swap( m_buffer );
+	return !m_failed;
+}
+
+bool PLYWriter::writeElement( int elementIndex,
+	const std::vector< ScalarSource >& scalars,
+	const std::vector< ListSource >& lists )
+{
+	if( m_pFilePointer == nullptr || elementIndex != m_nextElement )
+	{
+		fprintf( stderr, "PLYWriter: elements must be written in order, expected %d, got %d\n",
+			m_nextElement, elementIndex );
+		m_failed = true;
+		return false;
+	}
+
+	const PLYHeader::Element& element = m_header.element( elementIndex );
+	const std::vector< PLYHeader::Property >& properties = element.properties;
+	int nProperties = static_cast< int >( properties.size() );
+
+	// the source of each property, if any
+	std::vector< const ScalarSource* > scalarSources( nProperties, nullptr );
+	std::vector< const ListSource* > listSources( nProperties, nullptr );
+
+	for( int i = 0; i < static_cast< int >( scalars.size() ); ++i )
+	{
+		int p = m_header.findProperty( elementIndex, scalars[ i ].propertyName );
+		if( p == -1 || properties[ p ].isList )
+		{
+			fprintf( stderr, "PLYWriter: element %s has no scalar property %s\n",
+				qPrintable( element.name ), qPrintable( scalars[ i ].propertyName ) );
+			m_failed = true;
+			return false;
+		}
+		scalarSources[ p ] = &( scalars[ i ] );
+	}
+
+	for( int i = 0; i < static_cast< int >( lists.size() ); ++i )
+	{
+		int p = m_header.findProperty( elementIndex, lists[ i ].propertyName );
+		if( p == -1 || !properties[ p ].isList )
+		{
+			fprintf( stderr, "PLYWriter: element %s has no list property %s\n",
+				qPrintable( element.name ), qPrintable( lists[ i ].propertyName ) );
+			m_failed = true;
+			return false;
+		}
+		listSources[ p ] = &( lists[ i ] );
+	}
+
+	// the next value of each list source
+	std::vector< const int* > listValues( nProperties, nullptr );
+	for( int p = 0; p < nProperties; ++p )
+	{
+		if( listSources[ p ] != nullptr )
+		{
+			listValues[ p ] = listSources[ p ]->values;
+		}
+	}
+
+	if( m_header.format() != PLYHeader::ASCII )
+	{
+		writeBinaryInstances( elementIndex, scalarSources, listSources, listValues );
+		++m_nextElement;
+		return !m_failed;
+	}
+
+	for( int64 i = 0; i < element.count; ++i )
+	{
+		for( int p = 0; p < nProperties; ++p )
+		{
+			const PLYHeader::Property& property = properties[ p ];
+			bool first = ( p == 0 );
+
+			if( !property.isList )
+			{
+				const ScalarSource* source = scalarSources[ p ];
+				double value = ( source != nullptr ) ? source->input[ i * source->stride ] : 0;
+				writeValue( value, property.type, first );
+			}
+			else
+			{
+				const ListSource* source = listSources[ p ];
+				int n = 0;
+				if( source != nullptr )
+				{
+					n = ( source->counts != nullptr ) ? source->counts[ i ] : source->fixedCount;
+				}
+
+				writeValue( n, property.countType, first );
+				for( int k = 0; k < n; ++k )
+				{
+					writeValue( listValues[ p ][ k ], property.type, false );
+				}
+				if( n > 0 )
+				{
+					listValues[ p ] += n;
+				}
+			}
+		}
+
+		m_buffer.push_back( '\n' );
+		flushIfFull();
+	}
+
+	++m_nextElement;
+	return !m_failed;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+void PLYWriter::writeBinaryInstances( int elementIndex,
+	const std::vector< const ScalarSource* >& scalarSources,
+	const std::vector< const ListSource* >& listSources,
+	std::vector< const int* >& listValues )
+{
+	const PLYHeader::Element& element = m_header.element( elementIndex );
+	const std::vector< PLYHeader::Property >& properties = element.properties;
+	int nProperties = static_cast< int >( properties.size() );
+
+	// the size of every instance, except for the values of lists with per instance counts
+	int64 fixedSize = 0;
+	std::vector< int > variableLists;
+	std::vector< IntEncoder > countEncoders( nProperties, nullptr );
+	std::vector< IntEncoder > valueEncoders( nProperties, nullptr );
+	for( int p = 0; p < nProperties; ++p )
+	{
+		const PLYHeader::Property& property = properties[ p ];
+		if( !property.isList )
+		{
+			fixedSize += PLYHeader::typeSize( property.type );
+			continue;
+		}
+
+		countEncoders[ p ] = intEncoder( property.countType );
+		valueEncoders[ p ] = intEncoder( property.type );
+		fixedSize += PLYHeader::typeSize( property.countType );
+
+		const ListSource* source = listSources[ p ];
+		if( source != nullptr && source->counts != nullptr )
+		{
+			variableLists.push_back( p );
+		}
+		else if( source != nullptr )
+		{
+			fixedSize += std::max( source->fixedCount, 0 ) * PLYHeader::typeSize( property.type );
+		}
+	}
+
+	std::vector< int64 > cursors;
+	for( int64 first = 0; first < element.count; first += ENCODE_BLOCK_SIZE )
+	{
+		int64 last = std::min( first + ENCODE_BLOCK_SIZE, element.count );
+		int64 nInstances = last - first;
+
+		// where each instance starts in the buffer
+		cursors.resize( nInstances );
+		int64 end = static_cast< int64 >( m_buffer.size() );
+		for( int64 i = 0; i < nInstances; ++i )
+		{
+			cursors[ i ] = end;
+			end += fixedSize;
+			for( int j = 0; j < static_cast< int >( variableLists.size() ); ++j )
+			{
+				int p = variableLists[ j ];
+				end += std::max( listSources[ p ]->counts[ first + i ], 0 ) * PLYHeader::typeSize( properties[ p ].type );
+			}
+		}
+
+		// properties without a source are left as zeros
+		m_buffer.resize( static_cast< size_t >( end ) );
+		if( m_buffer.empty() )
+		{
+			continue;
+		}
+		ubyte* output = reinterpret_cast< ubyte* >( &( m_buffer[ 0 ] ) );
+
+		// then each property, for the whole block
+		for( int p = 0; p < nProperties; ++p )
+		{
+			const PLYHeader::Property& property = properties[ p ];
+			if( !property.isList )
+			{
+				const ScalarSource* source = scalarSources[ p ];
+				if( source != nullptr )
+				{
+					encodeColumn( property.type, source->input, source->stride, first, last,
+						m_swapBytes, output, &( cursors[ 0 ] ) );
+				}
+				else
+				{
+					int size = PLYHeader::typeSize( property.type );
+					for( int64 i = 0; i < nInstances; ++i )
+					{
+						cursors[ i ] += size;
+					}
+				}
+				continue;
+			}
+
+			const ListSource* source = listSources[ p ];
+			if( source == nullptr )
+			{
+				int size = PLYHeader::typeSize( property.countType );
+				for( int64 i = 0; i < nInstances; ++i )
+				{
+					cursors[ i ] += size;
+				}
+				continue;
+			}
+
+			for( int64 i = 0; i < nInstances; ++i )
+			{
+				int n = ( source->counts != nullptr ) ? source->counts[ first + i ] : source->fixedCount;
+				int nValues = std::max( n, 0 );
+				ubyte* q = countEncoders[ p ]( &n, 1, m_swapBytes, output + cursors[ i ] );
+				q = valueEncoders[ p ]( listValues[ p ], nValues, m_swapBytes, q );
+				cursors[ i ] = q - output;
+				listValues[ p ] += nValues;
+			}
+		}
+
+		flushIfFull();
+	}
+}
+
+void PLYWriter::writeValue( double value, PLYHeader::Type type, bool firstOnLine )
+{
+	char text[ 64 ];
+	int length;
+	switch( type )
+	{
+	case PLYHeader::INT8:
+		length = sprintf( text, "%d", static_cast< int >( roundAndClamp( value, -128, 127 ) ) );
+		break;
+	case PLYHeader::UINT8:
+		length = sprintf( text, "%d", static_cast< int >( roundAndClamp( value, 0, 255 ) ) );
+		break;
+	case PLYHeader::INT16:
+		length = sprintf( text, "%d", static_cast< int >( roundAndClamp( value, -32768, 32767 ) ) );
+		break;
+	case PLYHeader::UINT16:
+		length = sprintf( text, "%d", static_cast< int >( roundAndClamp( value, 0, 65535 ) ) );
+		break;
+	case PLYHeader::INT32:
+		length = sprintf( text, "%d", static_cast< int >( roundAndClamp( value, -2147483648.0, 2147483647.0 ) ) );
+		break;
+	case PLYHeader::UINT32:
+		length = sprintf( text, "%u", static_cast< uint32 >( roundAndClamp( value, 0, 4294967295.0 ) ) );
+		break;
+	case PLYHeader::FLOAT32:
+		// 9 significant digits round trip any float
+		length = sprintf( text, "%.9g", static_cast< float >( value ) );
+		break;
+	default:
+		length = sprintf( text, "%.17g", value );
+		break;
+	}
+
+	if( !firstOnLine )
+	{
+		m_buffer.push_back( ' ' );
+	}
+	m_buffer.insert( m_buffer.end(), text, text + length );
+}
+
+void PLYWriter::flushIfFull()
+{
+	if( m_buffer.size() >= FLUSH_THRESHOLD )
+	{
+		flush();
+	}
+}
+
+void PLYWriter::flush()
+{
+	if( !m_buffer.empty() )
+	{
+		size_t nWritten = fwrite( &( m_buffer[ 0 ] ), 1, m_buffer.size(), m_pFilePointer );
+		if( nWritten != m_buffer.size() )
+		{
+			m_failed = true;
+		}
+		m_buffer.clear();
+	}
+}
@@ -1,127 +1,618 @@
 #include "io/PortablePixelMapIO.h"
 
 #include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <ppl.h>
+
 #include <QFile>
-#include <QDataStream>
-#include <QTextStream>
-#include <color/ColorUtils.h>
 
-// static
-bool PortablePixelMapIO::writeRGB( QString filename,								  
-								  ubyte* aubRGBArray,
-								  int width, int height,								  
-								  bool yAxisPointsUp )
+#include "color/ColorUtils.h"
+#include "imageproc/Image1f.h"
+#include "imageproc/Image4f.h"
+#include "io/BinaryFileWriter.h"
+#include "io/MappedFile.h"
+#include "io/NumberParser.h"
+
+namespace
 {
-	assert( aubRGBArray != NULL );
+	inline bool isWhitespace( char c )
+	{
+		return( c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f' );
+	}
 
-	QFile outputFile( filename );
+	// skips whitespace and '#' comments (which run to the end of the line)
+	const char* skipWhitespace( const char* p, const char* end )
+	{
+		while( p < end )
+		{
+			if( *p == '#' )
+			{
+				while( p < end && *p != '\n' )
+				{
+					++p;
+				}
+			}
+			else if( isWhitespace( *p ) )
+			{
+				++p;
+			}
+			else
+			{
+				break;
+			}
+		}
+		return p;
+	}
 
-	// try to open the file in write only mode
-	if( !( outputFile.open( QIODevice::WriteOnly ) ) )
+	// a netpbm sample, 16-bit samples are big endian
+	inline int netpbmSample( const ubyte* samples, int index, int bytesPerSample )
 	{
-		return false;
+		if( bytesPerSample == 1 )
+		{
+			return samples[ index ];
+		}
+		return( ( samples[ 2 * index ] << 8 ) | samples[ 2 * index + 1 ] );
 	}
 
-	QTextStream outputTextStream( &outputFile );
-	outputTextStream.setCodec( "ISO-8859-1" );
-	outputTextStream << "P6\n";
-	outputTextStream << width << " " << height << "\n";
-	outputTextStream << "255\n";
+	// clamps f to [0,1] and rescales it to [0, maxValue]
+	inline int quantize( float f, int maxValue )
+	{
+		return static_cast< int >( ColorUtils::saturate( f ) * maxValue + 0.5f );
+	}
 
-	outputTextStream.flush();
+	// stores a quantized sample in the host byte order
+	inline void setNetpbmSample( ubyte* samples, int index, int bytesPerSample, int value )
+	{
+		if( bytesPerSample == 1 )
+		{
+			samples[ index ] = static_cast< ubyte >( value );
+		}
+		else
+		{
+			reinterpret_cast< uint16* >( samples )[ index ] = static_cast< uint16 >( value );
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public
+//////////////////////////////////////////////////////////////////////////
+
+PortablePixelMapIO::Header::Header() :
+
+	format( PPM ),
+	width( 0 ),
+	height( 0 ),
+	maxValue( 255 ),
+	scale( 1.f ),
+	byteOrder( ByteOrder::LITTLE ),
+	dataOffset( 0 )
+
+{
 
-	QDataStream outputDataStream( &outputFile );	
+}
 
-	if( yAxisPointsUp )
+int PortablePixelMapIO::Header::numComponents() const
+{
+	switch( format )
 	{
-		for( int y = 0; y < height; ++y )
-		{
-			for( int x = 0; x < width; ++x )
-			{
-				int yy = height - y - 1;
+	case PGM:
+	case PFM_GRAY:
+		return 1;
+	case PFM_RGBA:
+		return 4;
+	default:
+		return 3;
+	}
+}
+
+int PortablePixelMapIO::Header::bytesPerSample() const
+{
+	if( isPFM() )
+	{
+		return sizeof( float );
+	}
+	return( maxValue > 255 ? 2 : 1 );
+}
 
-				int k = 3 * ( yy * width + x );
+int64 PortablePixelMapIO::Header::bytesPerRow() const
+{
+	return static_cast< int64 >( width ) * numComponents() * bytesPerSample();
+}
 
-				outputDataStream << aubRGBArray[ k ];
-				outputDataStream << aubRGBArray[ k + 1 ];
-				outputDataStream << aubRGBArray[ k + 2 ];
-			}
+bool PortablePixelMapIO::Header::isPFM() const
+{
+	return( format == PFM_GRAY || format == PFM_RGB || format == PFM_RGBA );
+}
+
+// static
+bool PortablePixelMapIO::parseHeader( const char* begin, const char* end, Header& header )
+{
+	const char* p = begin;
+	if( end - p < 3 || p[ 0 ] != 'P' )
+	{
+		fprintf( stderr, "Not a netpbm or PFM file\n" );
+		return false;
+	}
+
+	switch( p[ 1 ] )
+	{
+	case '5':
+		header.format = PGM;
+		p += 2;
+		break;
+	case '6':
+		header.format = PPM;
+		p += 2;
+		break;
+	case 'f':
+		header.format = PFM_GRAY;
+		p += 2;
+		break;
+	case 'F':
+		if( p[ 2 ] == '4' )
+		{
+			header.format = PFM_RGBA;
+			p += 3;
 		}
+		else
+		{
+			header.format = PFM_RGB;
+			p += 2;
+		}
+		break;
+	default:
+		fprintf( stderr, "Unsupported netpbm / PFM type %c%c (only P5, P6, Pf, PF and PF4 are)\n", p[ 0 ], p[ 1 ] );
+		return false;
 	}
-	else
+
+	// the magic number, width, height and maxValue / scale
+	// are separated by whitespace and comments
+	if( p == end || !isWhitespace( *p ) )
+	{
+		fprintf( stderr, "Malformed netpbm / PFM header\n" );
+		return false;
+	}
+
+	p = NumberParser::parseInt( skipWhitespace( p, end ), end, &( header.width ) );
+	if( p != nullptr )
+	{
+		p = NumberParser::parseInt( skipWhitespace( p, end ), end, &( header.height ) );
+	}
+	if( p != nullptr )
 	{
-		for( int y = 0; y < height; ++y )
+		if( header.isPFM() )
 		{
-			for( int x = 0; x < width; ++x )
+			// the sign of the scale is the byte order
+			float scale;
+			p = NumberParser::parseFloat( skipWhitespace( p, end ), end, &scale );
+			if( p != nullptr && scale != 0 )
 			{
-				int k = 3 * ( y * width + x );
-
-				outputDataStream << aubRGBArray[ k ];
-				outputDataStream << aubRGBArray[ k + 1 ];
-				outputDataStream << aubRGBArray[ k + 2 ];
+				header.byteOrder = ( scale < 0 ) ? ByteOrder::LITTLE : ByteOrder::BIG;
+				header.scale = fabs( scale );
+			}
+			else
+			{
+				p = nullptr;
+			}
+		}
+		else
+		{
+			p = NumberParser::parseInt( skipWhitespace( p, end ), end, &( header.maxValue ) );
+			if( p != nullptr && ( header.maxValue < 1 || header.maxValue > 65535 ) )
+			{
+				p = nullptr;
 			}
 		}
-	}	
+	}
+
+	// exactly one whitespace character separates the header from the samples
+	if( p == nullptr || p == end || !isWhitespace( *p ) ||
+		header.width <= 0 || header.height <= 0 )
+	{
+		fprintf( stderr, "Malformed netpbm / PFM header\n" );
+		return false;
+	}
+	++p;
+
+	// before any size arithmetic, which could overflow
+	if( static_cast< int64 >( header.width ) * header.height > INT_MAX / 4 )
+	{
+		fprintf( stderr, "netpbm / PFM image too large: %d x %d\n", header.width, header.height );
+		return false;
+	}
+
+	header.dataOffset = p - begin;
+	if( header.bytesPerRow() * header.height > end - p )
+	{
+		fprintf( stderr, "Truncated netpbm / PFM file: %d x %d needs %lld bytes, only %lld present\n",
+			header.width, header.height, header.bytesPerRow() * header.height,
+			static_cast< int64 >( end - p ) );
+		return false;
+	}
 
 	return true;
 }
 
 // static
-bool PortablePixelMapIO::writeRGB( QString filename,								  
-								  float* afRGBArray,
-								  int width, int height,								  
-								  bool yAxisPointsUp )
+bool PortablePixelMapIO::read( QString filename, Image4f& image )
 {
-	assert( afRGBArray != NULL );
+	MappedFile file( filename, MappedFile::SEQUENTIAL );
+	if( !file.isOpen() )
+	{
+		fprintf( stderr, "Unable to open %s\n", qPrintable( filename ) );
+		return false;
+	}
+
+	Header header;
+	if( !parseHeader( file.charData(), file.charData() + file.size(), header ) )
+	{
+		fprintf( stderr, "Unable to read %s\n", qPrintable( filename ) );
+		return false;
+	}
 
-	QFile outputFile( filename );
+	// the header is validated against the file size:
+	// nothing can fail past this point, so decode straight into image
+	if( image.width() != header.width || image.height() != header.height )
+	{
+		image = Image4f( header.width, header.height );
+	}
+	readPixels( file.data() + header.dataOffset, header, image.pixels(), 4 );
+	return true;
+}
 
-	// try to open the file in write only mode
-	if( !( outputFile.open( QIODevice::WriteOnly ) ) )
+// static
+bool PortablePixelMapIO::read( QString filename, Image1f& image )
+{
+	MappedFile file( filename, MappedFile::SEQUENTIAL );
+	if( !file.isOpen() )
 	{
+		fprintf( stderr, "Unable to open %s\n", qPrintable( filename ) );
 		return false;
 	}
 
-	QTextStream outputTextStream( &outputFile );
-	outputTextStream.setCodec( "ISO-8859-1" );
-	outputTextStream << "P6\n";
-	outputTextStream << width << " " << height << "\n";
-	outputTextStream << "255\n";
+	Header header;
+	if( !parseHeader( file.charData(), file.charData() + file.size(), header ) )
+	{
+		fprintf( stderr, "Unable to read %s\n", qPrintable( filename ) );
+		return false;
+	}
 
-	outputTextStream.flush();
+	if( header.numComponents() != 1 )
+	{
+		fprintf( stderr, "%s is not a single channel (P5 or Pf) image\n", qPrintable( filename ) );
+		return false;
+	}
+
+	if( image.width() != header.width || image.height() != header.height )
+	{
+		image = Image1f( header.width, header.height );
+	}
+	readPixels( file.data() + header.dataOffset, header, image.pixels(), 1 );
+	return true;
+}
+
+// static
+bool PortablePixelMapIO::writePPM( QString filename, const Image4f& image, int maxValue )
+{
+	if( image.isNull() || maxValue < 1 || maxValue > 65535 )
+	{
+		fprintf( stderr, "PortablePixelMapIO: can't write an empty image or maxValue %d\n", maxValue );
+		return false;
+	}
+
+	Header header;
+	header.format = PPM;
+	header.width = image.width();
+	header.height = image.height();
+	header.maxValue = maxValue;
 
-	QDataStream outputDataStream( &outputFile );	
+	int w = header.width;
+	int h = header.height;
+	int bytesPerSample = header.bytesPerSample();
+	const float* pixels = image.pixels();
 
-	if( yAxisPointsUp )
+	return writeRows( filename, header, [&]( int fileRow, std::vector< ubyte >& buffer ) -> const void*
 	{
-		for( int y = 0; y < height; ++y )
+		const float* src = pixels + 4 * static_cast< int64 >( w ) * ( h - 1 - fileRow );
+		ubyte* dst = &( buffer[ 0 ] );
+		for( int x = 0; x < w; ++x )
 		{
-			for( int x = 0; x < width; ++x )
+			for( int c = 0; c < 3; ++c )
 			{
-				int yy = height - y - 1;
+				setNetpbmSample( dst, 3 * x + c, bytesPerSample, quantize( src[ 4 * x + c ], maxValue ) );
+			}
+		}
+		return dst;
+	} );
+}
+
+// static
+bool PortablePixelMapIO::writePGM( QString filename, const Image1f& image, int maxValue )
+{
+	if( image.isNull() || maxValue < 1 || maxValue > 65535 )
+	{
+		fprintf( stderr, "PortablePixelMapIO: can't write an empty image or maxValue %d\n", maxValue );
+		return false;
+	}
 
-				int k = 3 * ( yy * width + x );
+	Header header;
+	header.format = PGM;
+	header.width = image.width();
+	header.height = image.height();
+	header.maxValue = maxValue;
 
-				outputDataStream << ColorUtils::floatToUnsignedByte( afRGBArray[ k ] );
-				outputDataStream << ColorUtils::floatToUnsignedByte( afRGBArray[ k + 1 ] );
-				outputDataStream << ColorUtils::floatToUnsignedByte( afRGBArray[ k + 2 ] );
-			}
+	int w = header.width;
+	int h = header.height;
+	int bytesPerSample = header.bytesPerSample();
+	const float* pixels = image.pixels();
+
+	return writeRows( filename, header, [&]( int fileRow, std::vector< ubyte >& buffer ) -> const void*
+	{
+		const float* src = pixels + static_cast< int64 >( w ) * ( h - 1 - fileRow );
+		ubyte* dst = &( buffer[ 0 ] );
+		for( int x = 0; x < w; ++x )
+		{
+			setNetpbmSample( dst, x, bytesPerSample, quantize( src[ x ], maxValue ) );
+		}
+		return dst;
+	} );
+}
+
+// static
+bool PortablePixelMapIO::writePFM( QString filename, const Image4f& image, bool includeAlpha,
+	ByteOrder::Order byteOrder )
+{
+	if( image.isNull() )
+	{
+		fprintf( stderr, "PortablePixelMapIO: can't write an empty image\n" );
+		return false;
+	}
+
+	Header header;
+	header.format = includeAlpha ? PFM_RGBA : PFM_RGB;
+	header.width = image.width();
+	header.height = image.height();
+	header.byteOrder = byteOrder;
+
+	int w = header.width;
+	const float* pixels = image.pixels();
+
+	// PFM rows are bottom-up, like Image4f
+	if( includeAlpha )
+	{
+		return writeRows( filename, header, [&]( int fileRow, std::vector< ubyte >& ) -> const void*
+		{
+			return pixels + 4 * static_cast< int64 >( w ) * fileRow;
+		} );
+	}
+
+	return writeRows( filename, header, [&]( int fileRow, std::vector< ubyte >& buffer ) -> const void*
+	{
+		const float* src = pixels + 4 * static_cast< int64 >( w ) * fileRow;
+		float* dst = reinterpret_cast< float* >( &( buffer[ 0 ] ) );
+		for( int x = 0; x < w; ++x )
+		{
+			dst[ 3 * x ] = src[ 4 * x ];
+			dst[ 3 * x + 1 ] = src[ 4 * x + 1 ];
+			dst[ 3 * x + 2 ] = src[ 4 * x + 2 ];
 		}
+		return dst;
+	} );
+}
+
+// static
+bool PortablePixelMapIO::writePFM( QString filename, const Image1f& image, ByteOrder::Order byteOrder )
+{
+	if( image.isNull() )
+	{
+		fprintf( stderr, "PortablePixelMapIO: can't write an empty image\n" );
+		return false;
 	}
-	else
+
+	Header header;
+	header.format = PFM_GRAY;
+	header.width = image.width();
+	header.height = image.height();
+	header.byteOrder = byteOrder;
+
+	int w = header.width;
+	const float* pixels = image.pixels();
+
+	return writeRows( filename, header, [&]( int fileRow, std::vector< ubyte >& ) -> const void*
+	{
+		return pixels + static_cast< int64 >( w ) * fileRow;
+	} );
+}
+
+// static
+bool PortablePixelMapIO::writeRGB( QString filename,
+								  ubyte* aubRGBArray,
+								  int width, int height,
+								  bool yAxisPointsUp )
+{
+	assert( aubRGBArray != NULL );
+
+	Header header;
+	header.format = PPM;
+	header.width = width;
+	header.height = height;
+
+	return writeRows( filename, header, [&]( int fileRow, std::vector< ubyte >& ) -> const void*
+	{
+		int y = yAxisPointsUp ? ( height - fileRow - 1 ) : fileRow;
+		return aubRGBArray + 3 * static_cast< int64 >( width ) * y;
+	} );
+}
+
+// static
+bool PortablePixelMapIO::writeRGB( QString filename,
+								  float* afRGBArray,
+								  int width, int height,
+								  bool yAxisPointsUp )
+{
+	assert( afRGBArray != NULL );
+
+	Header header;
+	header.format = PPM;
+	header.width = width;
+	header.height = height;
+
+	return writeRows( filename, header, [&]( int fileRow, std::vector< ubyte >& buffer ) -> const void*
+	{
+		int y = yAxisPointsUp ? ( height - fileRow - 1 ) : fileRow;
+		const float* src = afRGBArray + 3 * static_cast< int64 >( width ) * y;
+		for( int i = 0; i < 3 * width; ++i )
+		{
+			buffer[ i ] = ColorUtils::floatToUnsignedByte( src[ i ] );
+		}
+		return &( buffer[ 0 ] );
+	} );
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Private
+//////////////////////////////////////////////////////////////////////////
+
+// static
+void PortablePixelMapIO::readPixels( const ubyte* data, const Header& header,
+	float* destination, int nDestinationComponents )
+{
+	int w = header.width;
+	int h = header.height;
+	int nFileComponents = header.numComponents();
+	int bytesPerSample = header.bytesPerSample();
+	int64 bytesPerRow = header.bytesPerRow();
+	int64 destinationRowSize = static_cast< int64 >( nDestinationComponents ) * w;
+
+	bool isPFM = header.isPFM();
+	bool swapBytes = isPFM && ( header.byteOrder != ByteOrder::nativeOrder() );
+	float normalization = 1.f / header.maxValue;
+
+	Concurrency::parallel_for( 0, h, [&]( int fileRow )
 	{
-		for( int y = 0; y < height; ++y )
+		const ubyte* src = data + fileRow * bytesPerRow;
+
+		if( isPFM )
 		{
-			for( int x = 0; x < width; ++x )
+			// PFM rows are bottom-up, like the images
+			// copy the row to the end of the destination row,
+			// then spread it out in place from the front:
+			// pixel x is read before anything at or past it is overwritten
+			float* row = destination + fileRow * destinationRowSize;
+			int64 nSamples = static_cast< int64 >( w ) * nFileComponents;
+			float* samples = row + destinationRowSize - nSamples;
+			memcpy( samples, src, bytesPerRow );
+			if( swapBytes )
 			{
-				int k = 3 * ( y * width + x );
+				ByteOrder::swap32( samples, nSamples );
+			}
 
-				outputDataStream << ColorUtils::floatToUnsignedByte( afRGBArray[ k ] );
-				outputDataStream << ColorUtils::floatToUnsignedByte( afRGBArray[ k + 1 ] );
-				outputDataStream << ColorUtils::floatToUnsignedByte( afRGBArray[ k + 2 ] );
+			if( nFileComponents == 1 && nDestinationComponents == 4 )
+			{
+				for( int x = 0; x < w; ++x )
+				{
+					float v = samples[ x ];
+					row[ 4 * x ] = v;
+					row[ 4 * x + 1 ] = v;
+					row[ 4 * x + 2 ] = v;
+					row[ 4 * x + 3 ] = 1.f;
+				}
+			}
+			else if( nFileComponents == 3 && nDestinationComponents == 4 )
+			{
+				for( int x = 0; x < w; ++x )
+				{
+					float r = samples[ 3 * x ];
+					float g = samples[ 3 * x + 1 ];
+					float b = samples[ 3 * x + 2 ];
+					row[ 4 * x ] = r;
+					row[ 4 * x + 1 ] = g;
+					row[ 4 * x + 2 ] = b;
+					row[ 4 * x + 3 ] = 1.f;
+				}
+			}
+		}
+		else
+		{
+			// netpbm rows are top-down
+			float* row = destination + ( h - 1 - fileRow ) * destinationRowSize;
+			for( int x = 0; x < w; ++x )
+			{
+				if( nFileComponents == 1 )
+				{
+					float v = normalization * netpbmSample( src, x, bytesPerSample );
+					if( nDestinationComponents == 1 )
+					{
+						row[ x ] = v;
+					}
+					else
+					{
+						row[ 4 * x ] = v;
+						row[ 4 * x + 1 ] = v;
+						row[ 4 * x + 2 ] = v;
+						row[ 4 * x + 3 ] = 1.f;
+					}
+				}
+				else
+				{
+					row[ 4 * x ] = normalization * netpbmSample( src, 3 * x, bytesPerSample );
+					row[ 4 * x + 1 ] = normalization * netpbmSample( src, 3 * x + 1, bytesPerSample );
+					row[ 4 * x + 2 ] = normalization * netpbmSample( src, 3 * x + 2, bytesPerSample );
+					row[ 4 * x + 3 ] = 1.f;
+				}
 			}
 		}
-	}	
+	} );
+}
 
-	return true;
+// static
+template< typename GetRow >
+bool PortablePixelMapIO::writeRows( QString filename, const Header& header, GetRow getRow )
+{
+	// 16-bit netpbm samples are big endian
+	ByteOrder::Order byteOrder = header.isPFM() ? header.byteOrder : ByteOrder::BIG;
+	BinaryFileWriter* pWriter = BinaryFileWriter::open( QFile::encodeName( filename ).constData(), byteOrder );
+	if( pWriter == NULL )
+	{
+		fprintf( stderr, "Unable to open %s for writing\n", qPrintable( filename ) );
+		return false;
+	}
+
+	const char* magic[] = { "P5", "P6", "Pf", "PF", "PF4" };
+	char text[ 128 ];
+	if( header.isPFM() )
+	{
+		float scale = ( byteOrder == ByteOrder::LITTLE ) ? -header.scale : header.scale;
+		sprintf( text, "%s\n%d %d\n%g\n", magic[ header.format ], header.width, header.height, scale );
+	}
+	else
+	{
+		sprintf( text, "%s\n%d %d\n%d\n", magic[ header.format ], header.width, header.height, header.maxValue );
+	}
+	pWriter->writeBytes( text, strlen( text ) );
+
+	// rows are written in file order
+	// getRow fills the buffer, or returns a pointer into the image
+	int64 bytesPerRow = header.bytesPerRow();
+	int bytesPerSample = header.bytesPerSample();
+	std::vector< ubyte > buffer( static_cast< size_t >( bytesPerRow ) );
+	for( int fileRow = 0; fileRow < header.height; ++fileRow )
+	{
+		pWriter->writeBytes( getRow( fileRow, buffer ), bytesPerRow, bytesPerSample );
+	}
+
+	bool succeeded = pWriter->close();
+	delete pWriter;
+
+	if( !succeeded )
+	{
+		fprintf( stderr, "Unable to write %s\n", qPrintable( filename ) );
+	}
+	return succeeded;
 }